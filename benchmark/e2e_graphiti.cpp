@@ -1,4 +1,5 @@
 #include <io/netmp.h>
+#include <grasp/gas.h>
 #include <grasp/offline_evaluator.h>
 #include <grasp/online_evaluator.h>
 #include <utils/circuit.h>
@@ -117,44 +118,21 @@ common::utils::Circuit<Ring> generateMPACircuit(std::shared_ptr<io::NetIOMP> &ne
     }
 
 
-    // PROPAGATE
-    for (int i = num_vert - 1; i > 0; --i) {
-        dag_list[i] = circ.addGate(common::utils::GateType::kSub, dag_list[i], dag_list[i - 1]);
-    }
-    auto tmp1 = circ.addMGate(common::utils::GateType::kShuffle, dag_list, permutation);
-    std::vector<common::utils::wire_t> propagate_list(vec_size);
-    for (int i = 0; i < vec_size; ++i){
-        propagate_list[i] = tmp1[i];
-        circ.setAsOutput(propagate_list[i]);
-    }
-    for (int i = 1; i < vec_size; ++i) {
-        propagate_list[i] = circ.addGate(common::utils::GateType::kAdd, propagate_list[i], propagate_list[i - 1]);
-    }
-    for (int i = vec_size - 1; i > 0; --i) {
-        propagate_list[i] = circ.addGate(common::utils::GateType::kSub, propagate_list[i], tmp1[i]);
-    }
-
-    // SRC TO DST
-    auto dst_list = circ.addMGate(common::utils::GateType::kShuffle, propagate_list, permutation);
-
-    // GATHER
-    for (int i = 1; i < vec_size; ++i) {
-        dst_list[i] = circ.addGate(common::utils::GateType::kAdd, dst_list[i], dst_list[i - 1]);
-    }
-    auto tmp2 = circ.addMGate(common::utils::GateType::kShuffle, dst_list, permutation);
-    std::vector<common::utils::wire_t> gather_list(vec_size);
-    for (int i = 0; i < vec_size; ++i){
-        gather_list[i] = tmp2[i];
-    }
-    for (int i = vec_size - 1; i > 0; --i) {
-        gather_list[i] = circ.addGate(common::utils::GateType::kSub, gather_list[i], gather_list[i - 1]);
-    }
-
-    // APPLYV
-    for (int i = 0; i < gather_list.size(); ++i) {
-        auto pgr = circ.addConstOpGate(common::utils::GateType::kConstMul, gather_list[i], Ring(1));
-        gather_list[i] = circ.addConstOpGate(common::utils::GateType::kConstAdd, pgr, Ring(1));
-        circ.setAsOutput(gather_list[i]);
+    // Graphiti shuffles the DAG list of the whole graph.
+    GasGraph graph;
+    graph.backend = GasBackend::kGraphiti;
+    GasDagList dag;
+    dag.num_vert = num_vert;
+    dag.num_own = num_vert;
+    dag.edges.assign(dag_list.begin() + num_vert, dag_list.end());
+    dag.perm_s.secret = permutation;
+    dag.perm_d.secret = permutation;
+    dag.perm_v.secret = permutation;
+    graph.dag_lists.push_back(std::move(dag));
+
+    std::vector<common::utils::wire_t> vertices(dag_list.begin(), dag_list.begin() + num_vert);
+    for (auto w : addGasIteration(circ, graph, unitPageRankProgram(), vertices)) {
+        circ.setAsOutput(w);
     }
     return circ;
 
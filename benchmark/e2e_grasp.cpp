@@ -1,7 +1,13 @@
 #include <io/netmp.h>
 #include <grasp/offline_evaluator.h>
 #include <grasp/online_evaluator.h>
+#include <grasp/gas.h>
+#include <grasp/iterative_evaluator.h>
+#include <grasp/preproc_pool.h>
 #include <utils/circuit.h>
+#include <utils/graph.h>
+#include <utils/graph_partition.h>
+#include <utils/graph_store.h>
 
 #include <algorithm>
 #include <boost/program_options.hpp>
@@ -18,7 +24,129 @@ using namespace grasp;
 using json = nlohmann::json;
 namespace bpo = boost::program_options;
 
+// Default of --algorithm, set by the per-algorithm benchmark targets.
+#ifndef E2E_ALGORITHM
+#define E2E_ALGORITHM "pagerank"
+#endif
+
+// Sizes of the graph and of the DAG list of every party's subgraph.
+struct GraphShape {
+    size_t num_vert = 0;
+    // Vertices owned by each party.
+    std::vector<size_t> num_vert_set;
+    // Owned vertices and their outside neighbours.
+    std::vector<size_t> subg_num_vert;
+    std::vector<size_t> subg_num_edge;
+    std::vector<size_t> subg_num_dag_list;
+};
+
+// Synthetic shape of 'vec_size' tuples, 10% of which are vertices.
+GraphShape syntheticShape(int nP, size_t vec_size) {
+    GraphShape shape;
+    shape.num_vert = 0.1 * vec_size;
+    size_t num_edge = vec_size - shape.num_vert;
+    shape.num_vert_set.resize(nP);
+    shape.subg_num_vert.resize(nP);
+    shape.subg_num_edge.resize(nP);
+    shape.subg_num_dag_list.resize(nP);
+    for (int i = 0; i < nP; ++i) {
+        if (i != nP - 1) {
+            shape.num_vert_set[i] = shape.num_vert / nP;
+            shape.subg_num_edge[i] = num_edge / nP;
+        } else {
+            shape.num_vert_set[i] = shape.num_vert / nP + shape.num_vert % nP;
+            shape.subg_num_edge[i] = num_edge / nP + num_edge % nP;
+        }
+        shape.subg_num_vert[i] = std::min(shape.num_vert, 2 * shape.subg_num_edge[i]);
+        shape.subg_num_dag_list[i] = shape.subg_num_vert[i] + shape.subg_num_edge[i];
+    }
+    return shape;
+}
+
+GraphShape graphShape(size_t num_vert, const std::vector<common::utils::SubgraphDag> &subgraphs) {
+    GraphShape shape;
+    shape.num_vert = num_vert;
+    for (const auto &sub : subgraphs) {
+        shape.num_vert_set.push_back(sub.num_own);
+        shape.subg_num_vert.push_back(sub.vertices.size());
+        shape.subg_num_edge.push_back(sub.edges.size());
+        shape.subg_num_dag_list.push_back(sub.dagSize());
+    }
+    return shape;
+}
+
+GraphShape graphShape(const common::utils::GraphStore &store) {
+    GraphShape shape;
+    shape.num_vert = store.num_vert;
+    for (const auto &info : store.shards) {
+        shape.num_vert_set.push_back(info.num_own);
+        shape.subg_num_vert.push_back(info.num_vertices);
+        shape.subg_num_edge.push_back(info.num_edges);
+        shape.subg_num_dag_list.push_back(info.dagSize());
+    }
+    return shape;
+}
+
+// Inserted and deleted edges given as edge lists, in the IDs of the input
+// graph.
+common::utils::EdgeUpdates loadEdgeUpdates(const bpo::variables_map &opts, int threads) {
+    common::utils::EdgeUpdates updates;
+    if (opts.count("insert") != 0) {
+        auto inserted = common::utils::loadEdgeList(opts["insert"].as<std::string>(),
+                                                    common::utils::EdgeListFormat::kAuto, threads);
+        updates.inserted = std::move(inserted.edges);
+        updates.inserted_weights = std::move(inserted.weights);
+    }
+    if (opts.count("delete") != 0) {
+        updates.deleted = common::utils::loadEdgeList(opts["delete"].as<std::string>(),
+                                                      common::utils::EdgeListFormat::kAuto, threads).edges;
+    }
+    return updates;
+}
+
+// A party holding only its own shard of a graph store learns the sizes of
+// the other subgraphs after they were updated. The dealer updated all of
+// them.
+void exchangeSubgraphSizes(io::NetIOMP &network, int nP, int pid, GraphShape &shape) {
+    if (pid == 0) { return; }
+    std::array<uint64_t, 2> own = {shape.subg_num_vert[pid - 1], shape.subg_num_edge[pid - 1]};
+    for (int p = 1; p <= nP; ++p) {
+        if (p != pid) {
+            network.send(p, own.data(), sizeof(own));
+            network.flush(p);
+        }
+    }
+    for (int p = 1; p <= nP; ++p) {
+        if (p != pid) {
+            std::array<uint64_t, 2> sizes{};
+            network.recv(p, sizes.data(), sizeof(sizes));
+            shape.subg_num_vert[p - 1] = sizes[0];
+            shape.subg_num_edge[p - 1] = sizes[1];
+            shape.subg_num_dag_list[p - 1] = sizes[0] + sizes[1];
+        }
+    }
+}
+
+// Input wires of the vertex list and of the edges of every subgraph.
+struct GraphInputWires {
+    // Vertex values of every query, query after query.
+    std::vector<wire_t> vertices;
+    std::vector<std::vector<wire_t>> edges;
+    // Inverse out-degree of every vertex, for damped PageRank only.
+    std::vector<wire_t> inv_out_degree;
+    // Restart probabilities of every query, for damped PageRank of several
+    // queries only.
+    std::vector<std::vector<wire_t>> teleport;
+};
+
+// Permutations of party pid's subgraph, or the identity without a graph.
+static int initialPerm(const std::vector<common::utils::SubgraphDag> &subgraphs, int party,
+                       std::vector<int> common::utils::SubgraphDag::*perm, int i) {
+    return subgraphs.empty() ? i : (subgraphs[party].*perm)[i];
+}
+
 void initializePermutations(std::shared_ptr<io::NetIOMP> network, int nP, int pid, size_t num_vert, std::vector<size_t> &subg_num_dag_list,
+                            const std::vector<common::utils::SubgraphDag> &subgraphs,
                             std::vector<std::vector<int>> &perm_g, std::vector<std::vector<int>> &rand_perm_g,
                             std::vector<std::vector<int>> &perm_s, std::vector<std::vector<int>> &rand_perm_s,
                             std::vector<std::vector<int>> &perm_d, std::vector<std::vector<int>> &rand_perm_d,
@@ -43,7 +171,7 @@ void initializePermutations(std::shared_ptr<io::NetIOMP> network, int nP, int pi
         // initialize in parallel
         #pragma omp parallel for
         for (int i = 0; i < static_cast<int>(perm_g[0].size()); ++i) {
-            perm_g[0][i] = i;
+            perm_g[0][i] = initialPerm(subgraphs, pid - 1, &common::utils::SubgraphDag::perm_g, i);
             rand_perm_g[0][i] = i;
         }
 
@@ -54,7 +182,7 @@ void initializePermutations(std::shared_ptr<io::NetIOMP> network, int nP, int pi
         rand_perm_s[0] = std::vector<int>(subg_num_dag_list[pid - 1]);
         #pragma omp parallel for
         for (int i = 0; i < static_cast<int>(perm_s[0].size()); ++i) {
-            perm_s[0][i] = i;
+            perm_s[0][i] = initialPerm(subgraphs, pid - 1, &common::utils::SubgraphDag::perm_s, i);
             rand_perm_s[0][i] = i;
         }
 
@@ -65,7 +193,7 @@ void initializePermutations(std::shared_ptr<io::NetIOMP> network, int nP, int pi
         rand_perm_d[0] = std::vector<int>(subg_num_dag_list[pid - 1]);
         #pragma omp parallel for
         for (int i = 0; i < static_cast<int>(perm_d[0].size()); ++i) {
-            perm_d[0][i] = i;
+            perm_d[0][i] = initialPerm(subgraphs, pid - 1, &common::utils::SubgraphDag::perm_d, i);
             rand_perm_d[0][i] = i;
         }
 
@@ -76,7 +204,7 @@ void initializePermutations(std::shared_ptr<io::NetIOMP> network, int nP, int pi
         rand_perm_v[0] = std::vector<int>(subg_num_dag_list[pid - 1]);
         #pragma omp parallel for
         for (int i = 0; i < static_cast<int>(perm_v[0].size()); ++i) {
-            perm_v[0][i] = i;
+            perm_v[0][i] = initialPerm(subgraphs, pid - 1, &common::utils::SubgraphDag::perm_v, i);
             rand_perm_v[0][i] = i;
         }
 
@@ -178,7 +306,7 @@ void initializePermutations(std::shared_ptr<io::NetIOMP> network, int nP, int pi
             rand_perm_g[p] = std::vector<int>(num_vert);
             pub_perm_g[p] = std::vector<int>(num_vert, 0);
             for (int i = 0; i < static_cast<int>(perm_g[p].size()); ++i) {
-                perm_g[p][i] = i;
+                perm_g[p][i] = initialPerm(subgraphs, p, &common::utils::SubgraphDag::perm_g, i);
                 rand_perm_g[p][i] = i;
             }
 
@@ -187,7 +315,7 @@ void initializePermutations(std::shared_ptr<io::NetIOMP> network, int nP, int pi
             rand_perm_s[p] = std::vector<int>(subg_num_dag_list[p]);
             pub_perm_s[p] = std::vector<int>(subg_num_dag_list[p], 0);
             for (int i = 0; i < static_cast<int>(perm_s[p].size()); ++i) {
-                perm_s[p][i] = i;
+                perm_s[p][i] = initialPerm(subgraphs, p, &common::utils::SubgraphDag::perm_s, i);
                 rand_perm_s[p][i] = i;
             }
 
@@ -196,7 +324,7 @@ void initializePermutations(std::shared_ptr<io::NetIOMP> network, int nP, int pi
             rand_perm_d[p] = std::vector<int>(subg_num_dag_list[p]);
             pub_perm_d[p] = std::vector<int>(subg_num_dag_list[p], 0);
             for (int i = 0; i < static_cast<int>(perm_d[p].size()); ++i) {
-                perm_d[p][i] = i;
+                perm_d[p][i] = initialPerm(subgraphs, p, &common::utils::SubgraphDag::perm_d, i);
                 rand_perm_d[p][i] = i;
             }
 
@@ -205,7 +333,7 @@ void initializePermutations(std::shared_ptr<io::NetIOMP> network, int nP, int pi
             rand_perm_v[p] = std::vector<int>(subg_num_dag_list[p]);
             pub_perm_v[p] = std::vector<int>(subg_num_dag_list[p], 0);
             for (int i = 0; i < static_cast<int>(perm_v[p].size()); ++i) {
-                perm_v[p][i] = i;
+                perm_v[p][i] = initialPerm(subgraphs, p, &common::utils::SubgraphDag::perm_v, i);
                 rand_perm_v[p][i] = i;
             }
         }
@@ -214,7 +342,21 @@ void initializePermutations(std::shared_ptr<io::NetIOMP> network, int nP, int pi
     std::cout << "Initialization done" << std::endl;
 }
 
-common::utils::Circuit<Ring> generateCircuit(std::shared_ptr<io::NetIOMP> &network, int nP, int pid, size_t vec_size, int iter, int latency_usec,
+// Message passing program of 'algorithm': pagerank, bfs, cc or sssp.
+GasProgram algorithmProgram(const std::string &algorithm, double damping, const GraphInputWires &input_wires) {
+    if (algorithm == "pagerank") {
+        if (damping <= 0) { return unitPageRankProgram(); }
+        return input_wires.teleport.empty()
+                   ? dampedPageRankProgram(damping, input_wires.inv_out_degree)
+                   : personalizedPageRankProgram(damping, input_wires.inv_out_degree, input_wires.teleport);
+    }
+    if (algorithm == "bfs") { return bfsProgram(); }
+    if (algorithm == "cc") { return connectedComponentsProgram(); }
+    if (algorithm == "sssp") { return ssspProgram(); }
+    throw std::invalid_argument("Unknown algorithm: " + algorithm);
+}
+
+common::utils::Circuit<Ring> generateCircuit(std::shared_ptr<io::NetIOMP> &network, int nP, int pid, const GraphShape &shape, int iter, int queries, const std::string &algorithm, double damping, Ring threshold, int latency_usec,
                                              const std::vector<std::vector<int>> &rand_perm_g,
                                              const std::vector<std::vector<int>> &rand_perm_s,
                                              const std::vector<std::vector<int>> &rand_perm_d,
@@ -222,34 +364,23 @@ common::utils::Circuit<Ring> generateCircuit(std::shared_ptr<io::NetIOMP> &netwo
                                              const std::vector<std::vector<int>> &pub_perm_g,
                                              const std::vector<std::vector<int>> &pub_perm_s,
                                              const std::vector<std::vector<int>> &pub_perm_d,
-                                             const std::vector<std::vector<int>> &pub_perm_v) {
+                                             const std::vector<std::vector<int>> &pub_perm_v,
+                                             GraphInputWires &input_wires, wire_t &converged) {
 
     std::cout << "Generating circuit" << std::endl;
     
     common::utils::Circuit<Ring> circ;
 
-    size_t num_vert = 0.1 * vec_size;
-    size_t num_edge = vec_size - num_vert;
-    std::vector<size_t> num_vert_set(nP);
-    std::vector<size_t> subg_num_vert(nP);
-    std::vector<size_t> subg_num_edge(nP);
-    std::vector<size_t> subg_num_dag_list(nP);
-    for (int i = 0; i < subg_num_vert.size(); ++i) {
-        if (i != nP - 1) {
-            num_vert_set[i] = num_vert / nP;
-            subg_num_edge[i] = num_edge / nP;
-        } else {
-            num_vert_set[i] = num_vert / nP + num_vert % nP;
-            subg_num_edge[i] = num_edge / nP + num_edge % nP;
-        }
-        subg_num_vert[i] = std::min(num_vert, 2 * subg_num_edge[i]);
-        subg_num_dag_list[i] = subg_num_vert[i] + subg_num_edge[i];
-    }
+    size_t num_vert = shape.num_vert;
+    const auto &num_vert_set = shape.num_vert_set;
+    const auto &subg_num_vert = shape.subg_num_vert;
+    const auto &subg_num_edge = shape.subg_num_edge;
 
     // INPUT SHARING PHASE
-    std::vector<wire_t> full_vertex_list(num_vert);
-    for (int i = 0; i < num_vert; ++i) {
-        full_vertex_list[i] = circ.newInputWire();
+    // One vertex list per query.
+    std::vector<std::vector<wire_t>> full_vertex_list(queries, std::vector<wire_t>(num_vert));
+    for (auto &lane : full_vertex_list) {
+        for (auto &w : lane) { w = circ.newInputWire(); }
     }
     std::vector<std::vector<wire_t>> subg_edge_list(nP);
     for (int i = 0; i < subg_edge_list.size(); ++i) {
@@ -260,71 +391,50 @@ common::utils::Circuit<Ring> generateCircuit(std::shared_ptr<io::NetIOMP> &netwo
         }
         subg_edge_list[i] = subg_edge_list_party;
     }
-
-    // MESSAGE PASSING - permutations are passed as parameters
-        // MESSAGE PASSING
-        // DECOMPOSE
-        auto subg_sorted_vert_list = circ.addMOGate(common::utils::GateType::kAmortzdPnS, full_vertex_list, rand_perm_g, nP);
-        full_vertex_list.clear();
-        full_vertex_list.reserve(num_vert);
-
-        for (int i = 0; i < nP; ++i) {
-            // SUB GRAPH GEN
-            auto subg_permuted_vert_list = circ.addConstOpMGate(common::utils::GateType::kPublicPerm, subg_sorted_vert_list[i], pub_perm_g[i]);
-            std::vector<wire_t> subg_dag_list_party;
-            subg_dag_list_party.reserve(subg_num_dag_list[i]);
-            subg_dag_list_party.insert(subg_dag_list_party.end(), subg_permuted_vert_list.begin(),
-                                    subg_permuted_vert_list.begin() + subg_num_vert[i]);
-            subg_dag_list_party.insert(subg_dag_list_party.end(), subg_edge_list[i].begin(), subg_edge_list[i].end());
-
-            // PROPAGATE
-            std::vector<wire_t> prop_tmp1(subg_dag_list_party.size());
-            for (int j = subg_num_vert[i] - 1; j > 0; --j) {
-                prop_tmp1[j] = circ.addGate(common::utils::GateType::kSub, subg_dag_list_party[j], subg_dag_list_party[j - 1]);
-            }
-            auto prop_tmp2 = circ.addMGate(common::utils::GateType::kPermAndSh, prop_tmp1, rand_perm_s, i + 1);
-            auto prop_tmp3 = circ.addConstOpMGate(common::utils::GateType::kPublicPerm, prop_tmp2, pub_perm_s[i]);
-            std::vector<wire_t> prop_tmp4(prop_tmp3.size());
-            for (int j = 1; j < prop_tmp4.size(); ++j) {
-                prop_tmp4[j] = circ.addGate(common::utils::GateType::kAdd, prop_tmp3[j - 1], prop_tmp3[j]);
-            }
-            std::vector<wire_t> propagate_list(prop_tmp4.size());
-            for (int j = propagate_list.size() - 1; j > 0; --j) {
-                propagate_list[j] = circ.addGate(common::utils::GateType::kSub, prop_tmp4[j], prop_tmp3[j]);
-            }
-
-            // SRC TO DST
-            auto dst_tmp1 = circ.addMGate(common::utils::GateType::kPermAndSh, propagate_list, rand_perm_d, i + 1);
-            auto dst_dag_list = circ.addConstOpMGate(common::utils::GateType::kPublicPerm, dst_tmp1, pub_perm_d[i]);
-
-            // GATHER
-            std::vector<wire_t> gat_tmp1(dst_dag_list.size());
-            for (int j = 1; j < gat_tmp1.size(); ++j) {
-                gat_tmp1[j] = circ.addGate(common::utils::GateType::kAdd, dst_dag_list[j], dst_dag_list[j - 1]);
-            }
-            auto gat_tmp2 = circ.addMGate(common::utils::GateType::kPermAndSh, gat_tmp1, rand_perm_v, i + 1);
-            auto gat_tmp3 = circ.addConstOpMGate(common::utils::GateType::kPublicPerm, gat_tmp2, pub_perm_v[i]);
-            std::vector<wire_t> gather_list(gat_tmp3.size());
-            for (int j = gather_list.size() - 1; j > 0; --j) {
-                gather_list[j] = circ.addGate(common::utils::GateType::kSub, gat_tmp3[j], gat_tmp3[j - 1]);
-            }
-
-            // APPLYV - PAGERANK
-            std::vector<wire_t> applyv_list(gather_list.size());
-            for (int j = 0; j < applyv_list.size(); ++j) {
-                auto pgr = circ.addConstOpGate(common::utils::GateType::kConstMul, gather_list[j], Ring(1));
-                applyv_list[j] = circ.addConstOpGate(common::utils::GateType::kConstAdd, pgr, Ring(1));
-                // circ.setAsOutput(applyv_list[j]);
+    for (const auto &lane : full_vertex_list) {
+        input_wires.vertices.insert(input_wires.vertices.end(), lane.begin(), lane.end());
+    }
+    input_wires.edges = subg_edge_list;
+    if (damping > 0) {
+        input_wires.inv_out_degree.resize(num_vert);
+        for (auto &w : input_wires.inv_out_degree) { w = circ.newInputWire(); }
+        if (queries > 1) {
+            input_wires.teleport.assign(queries, std::vector<wire_t>(num_vert));
+            for (auto &lane : input_wires.teleport) {
+                for (auto &w : lane) { w = circ.newInputWire(); }
             }
-
-            // COMBINE
-            full_vertex_list.insert(full_vertex_list.end(), applyv_list.begin(), applyv_list.begin() + num_vert_set[i]);
-
         }
+    }
 
-    for (int i = 0; i < full_vertex_list.size(); ++i) {
-        circ.setAsOutput(full_vertex_list[i]);
+    // MESSAGE PASSING - permutations are passed as parameters
+    GasGraph graph;
+    graph.backend = GasBackend::kGraSP;
+    graph.perm_g = rand_perm_g;
+    for (int i = 0; i < nP; ++i) {
+        GasDagList dag;
+        dag.owner = i + 1;
+        dag.num_vert = subg_num_vert[i];
+        dag.num_own = num_vert_set[i];
+        dag.edges = subg_edge_list[i];
+        dag.pub_perm_g = pub_perm_g[i];
+        dag.perm_s = {ownerPermutations(rand_perm_s, pid, i + 1), pub_perm_s[i]};
+        dag.perm_d = {ownerPermutations(rand_perm_d, pid, i + 1), pub_perm_d[i]};
+        dag.perm_v = {ownerPermutations(rand_perm_v, pid, i + 1), pub_perm_v[i]};
+        graph.dag_lists.push_back(std::move(dag));
+    }
+    auto program = algorithmProgram(algorithm, damping, input_wires);
+    // The queries share the permutation gates and rounds of the iteration.
+    full_vertex_list = addGasIterationLanes(circ, graph, program, full_vertex_list);
+
+    std::vector<wire_t> outputs;
+    for (const auto &lane : full_vertex_list) {
+        for (auto w : lane) {
+            circ.setAsOutput(w);
+            outputs.push_back(w);
+        }
     }
+    // Not an output: only revealed by IterativeEvaluator::runUntilConverged.
+    if (threshold > 0) { converged = addConvergenceCheck(circ, input_wires.vertices, outputs, threshold); }
     return circ;
 }
 
@@ -340,12 +450,36 @@ void benchmark(const bpo::variables_map& opts) {
     auto nP = opts["num-parties"].as<int>();
     auto vec_size = opts["vec-size"].as<size_t>();
     auto iter = opts["iter"].as<int>();
+    auto damping = opts["damping"].as<double>();
+    auto algorithm = opts["algorithm"].as<std::string>();
+    auto source = opts["source"].as<uint32_t>();
+    auto queries = opts["queries"].as<int>();
+    auto tolerance = opts["tolerance"].as<double>();
     auto latency = opts["latency"].as<double>();
     auto pid = opts["pid"].as<size_t>();
     auto threads = opts["threads"].as<size_t>();
     auto seed = opts["seed"].as<size_t>();
     auto repeat = opts["repeat"].as<size_t>();
     auto port = opts["port"].as<int>();
+    auto seed_compressed = opts["seed-compressed"].as<bool>();
+
+    if (damping > 0 && algorithm != "pagerank") {
+        throw std::invalid_argument("Damping only applies to pagerank.");
+    }
+    if (queries < 1) {
+        throw std::invalid_argument("Expected at least one query.");
+    }
+    if (tolerance < 0 || (tolerance > 0 && algorithm == "pagerank" && damping <= 0)) {
+        throw std::invalid_argument("Tolerance needs to be positive, and undamped pagerank does not support it.");
+    }
+    // Convergence threshold on the vertex values, 0 for a fixed number of
+    // iterations. PageRank values are fixed point, the others integers.
+    Ring threshold = 0;
+    if (tolerance > 0) {
+        threshold = algorithm == "pagerank" ? common::utils::toFixed(tolerance, kPageRankFraction)
+                                            : static_cast<Ring>(std::ceil(tolerance));
+        threshold = std::max<Ring>(threshold, 1);
+    }
 
     omp_set_nested(1);
     // omp_set_num_threads(nP);
@@ -377,14 +511,126 @@ void benchmark(const bpo::variables_map& opts) {
     // Increase socket buffer sizes to prevent deadlocks with large messages
     increaseSocketBuffers(network.get(), 128 * 1024 * 1024);
 
+    // A loaded graph replaces the synthetic shape of vec_size tuples.
+    common::utils::Graph graph;
+    std::vector<int> vertex_owner;
+    std::vector<common::utils::SubgraphDag> subgraphs;
+    std::vector<size_t> out_degree;
+    // New ID of every vertex of an edge list, see relabelByOwner.
+    std::vector<uint32_t> new_id;
+    GraphShape shape;
+    double graph_load_ms = 0;
+    double graph_update_ms = 0;
+    bool graph_is_store = false;
+    auto partition = common::utils::partitionStrategyFromString(opts["partition"].as<std::string>());
+    // Edge cut and replication are only known for edge lists.
+    common::utils::PartitionStats partition_stats;
+    if (opts.count("graph") != 0) {
+        auto graph_path = opts["graph"].as<std::string>();
+        TimePoint load_start;
+        graph_is_store = common::utils::isGraphStore(graph_path);
+        if (graph_is_store) {
+            // Parties read their own shard, the dealer needs all of them.
+            std::vector<int> parties;
+            for (int p = 1; p <= nP; ++p) {
+                if (pid == 0 || p == pid) { parties.push_back(p); }
+            }
+            // Damped PageRank needs the out-degrees, counted from the CSR.
+            auto store = common::utils::loadGraphStore(graph_path, parties, damping > 0);
+            if (store.numParties() != nP) {
+                throw std::runtime_error("Graph store is partitioned for " + std::to_string(store.numParties()) +
+                                         " parties.");
+            }
+            shape = graphShape(store);
+            if (damping > 0) {
+                out_degree.assign(store.num_vert, 0);
+                for (auto src : store.in_sources) { out_degree[src]++; }
+            }
+            vertex_owner = std::move(store.owner);
+            subgraphs = std::move(store.subgraphs);
+            vec_size = store.num_vert + store.num_edges;
+        } else {
+            graph = common::utils::loadEdgeList(graph_path, common::utils::EdgeListFormat::kAuto,
+                                                static_cast<int>(threads));
+            vertex_owner = common::utils::partitionGraph(graph, nP, partition);
+            new_id = common::utils::relabelByOwner(graph, vertex_owner);
+            partition_stats = common::utils::partitionStats(graph, vertex_owner, nP);
+            subgraphs = common::utils::buildSubgraphs(graph, vertex_owner, nP);
+            shape = graphShape(graph.num_vert, subgraphs);
+            if (damping > 0) {
+                out_degree.assign(graph.num_vert, 0);
+                for (const auto &e : graph.edges) { out_degree[e.src]++; }
+            }
+            vec_size = graph.num_vert + graph.edges.size();
+        }
+        partition_stats.dag_sizes = shape.subg_num_dag_list;
+        partition_stats.imbalance = common::utils::imbalance(shape.subg_num_dag_list);
+        TimePoint load_end;
+        graph_load_ms = load_end - load_start;
+        std::cout << "Loaded graph with " << shape.num_vert << " vertices and " << vec_size - shape.num_vert
+                  << " edges in " << graph_load_ms << " ms" << std::endl;
+
+        // Edge updates patch the loaded subgraphs instead of rebuilding them.
+        // Every party patches its own, the dealer all of them.
+        if (opts.count("insert") != 0 || opts.count("delete") != 0) {
+            TimePoint update_start;
+            auto updates = loadEdgeUpdates(opts, static_cast<int>(threads));
+            for (auto *edges : {&updates.inserted, &updates.deleted}) {
+                for (auto &e : *edges) {
+                    if (e.src >= shape.num_vert || e.dst >= shape.num_vert) {
+                        throw std::runtime_error("Updated edge out of range of the graph.");
+                    }
+                    if (!new_id.empty()) { e = {new_id[e.src], new_id[e.dst]}; }
+                }
+            }
+            for (int p = 1; p <= nP; ++p) {
+                auto &sub = subgraphs[p - 1];
+                if (sub.perm_g.empty()) { continue; }
+                common::utils::applyEdgeUpdates(sub, vertex_owner, p, updates);
+                shape.subg_num_vert[p - 1] = sub.vertices.size();
+                shape.subg_num_edge[p - 1] = sub.edges.size();
+                shape.subg_num_dag_list[p - 1] = sub.dagSize();
+            }
+            if (graph_is_store) { exchangeSubgraphSizes(*network, nP, pid, shape); }
+            if (!out_degree.empty()) {
+                for (const auto &e : updates.inserted) { out_degree[e.src] += e.src != e.dst ? 1 : 0; }
+                for (const auto &e : updates.deleted) { out_degree[e.src] -= e.src != e.dst ? 1 : 0; }
+            }
+            vec_size = shape.num_vert;
+            for (auto num_edge : shape.subg_num_edge) { vec_size += num_edge; }
+            partition_stats.dag_sizes = shape.subg_num_dag_list;
+            partition_stats.imbalance = common::utils::imbalance(shape.subg_num_dag_list);
+            TimePoint update_end;
+            graph_update_ms = update_end - update_start;
+            std::cout << "Applied " << updates.inserted.size() << " insertions and " << updates.deleted.size()
+                      << " deletions in " << graph_update_ms << " ms" << std::endl;
+        }
+    } else {
+        shape = syntheticShape(nP, vec_size);
+    }
+
     json output_data;
     output_data["details"] = {{"num_parties", nP},
                               {"vec_size", vec_size},
+                              {"graph", opts.count("graph") != 0 ? opts["graph"].as<std::string>() : ""},
+                              {"num_vertices", shape.num_vert},
+                              {"subgraph_dag_sizes", shape.subg_num_dag_list},
+                              {"graph_load_ms", graph_load_ms},
+                              {"graph_update_ms", graph_update_ms},
+                              {"partition", graph_is_store ? "store" : common::utils::partitionStrategyName(partition)},
+                              {"dag_imbalance", common::utils::imbalance(shape.subg_num_dag_list)},
+                              {"edge_cut", partition_stats.edge_cut},
+                              {"replication", partition_stats.replication},
+                              {"algorithm", algorithm},
+                              {"queries", queries},
                               {"iterations", iter},
+                              {"tolerance", tolerance},
+                              {"damping", damping},
                               {"latency (ms)", latency},
                               {"pid", pid},
                               {"threads", threads},
                               {"seed", seed},
+                              {"seed_compressed", seed_compressed},
                               {"repeat", repeat}};
     output_data["benchmarks"] = json::array();
 
@@ -402,26 +648,11 @@ void benchmark(const bpo::variables_map& opts) {
     network->sync();
     StatsPoint init_start(*network);
     
-    size_t num_vert = 0.1 * vec_size;
-    std::vector<size_t> subg_num_dag_list(nP);
-    std::vector<size_t> subg_num_vert(nP);
-    std::vector<size_t> subg_num_edge(nP);
-    size_t num_edge = vec_size - num_vert;
-    for (int i = 0; i < nP; ++i) {
-        if (i != nP - 1) {
-            subg_num_edge[i] = num_edge / nP;
-        } else {
-            subg_num_edge[i] = num_edge / nP + num_edge % nP;
-        }
-        subg_num_vert[i] = std::min(num_vert, 2 * subg_num_edge[i]);
-        subg_num_dag_list[i] = subg_num_vert[i] + subg_num_edge[i];
-    }
-    
     std::vector<std::vector<int>> perm_g, rand_perm_g, pub_perm_g;
     std::vector<std::vector<int>> perm_s, rand_perm_s, pub_perm_s;
     std::vector<std::vector<int>> perm_d, rand_perm_d, pub_perm_d;
     std::vector<std::vector<int>> perm_v, rand_perm_v, pub_perm_v;
-    initializePermutations(network, nP, pid, num_vert, subg_num_dag_list,
+    initializePermutations(network, nP, pid, shape.num_vert, shape.subg_num_dag_list, subgraphs,
                            perm_g, rand_perm_g, perm_s, rand_perm_s, perm_d, rand_perm_d, perm_v, rand_perm_v,
                            pub_perm_g, pub_perm_s, pub_perm_d, pub_perm_v, latency_usec);
     
@@ -429,37 +660,106 @@ void benchmark(const bpo::variables_map& opts) {
     network->sync();
     
     // CIRCUIT GENERATION PHASE
-    auto circ = generateCircuit(network, nP, pid, vec_size, iter, latency_usec,
+    GraphInputWires input_wires;
+    wire_t converged = 0;
+    auto circ = generateCircuit(network, nP, pid, shape, iter, queries, algorithm, damping, threshold, latency_usec,
                                rand_perm_g, rand_perm_s, rand_perm_d, rand_perm_v,
-                               pub_perm_g, pub_perm_s, pub_perm_d, pub_perm_v).orderGatesByLevel();
+                               pub_perm_g, pub_perm_s, pub_perm_d, pub_perm_v, input_wires, converged).orderGatesByLevel();
     
 
     std::cout << "--- Circuit ---" << std::endl;
     std::cout << circ << std::endl;
     
     std::unordered_map<common::utils::wire_t, int> input_pid_map;
-    for (const auto& g : circ.gates_by_level[0]) {
-        if (g->type == common::utils::GateType::kInp) {
-            input_pid_map[g->out] = 1;
+    // With a graph, vertex values are input by their owners, with value 1,
+    // and the edges of a subgraph by its party, with the edge weights. Damped
+    // PageRank starts from rank 1 too, the value being 1 / out-degree. BFS
+    // and SSSP start from distance 0 at the source, and components from the
+    // vertex IDs. Query q uses source + q, and personalized PageRank restarts
+    // at the vertices v with v % queries = q.
+    std::unordered_map<common::utils::wire_t, Ring> graph_inputs;
+    if (subgraphs.empty()) {
+        for (const auto& g : circ.gates_by_level[0]) {
+            if (g->type == common::utils::GateType::kInp) {
+                input_pid_map[g->out] = 1;
+            }
+        }
+    } else {
+        size_t num_vert = shape.num_vert;
+        if (source >= num_vert) {
+            throw std::invalid_argument("Source vertex out of range of the graph.");
+        }
+        for (int q = 0; q < queries; ++q) {
+            size_t query_source = (source + q) % num_vert;
+            if (!new_id.empty()) { query_source = new_id[query_source]; }
+            for (size_t v = 0; v < num_vert; ++v) {
+                Ring value = 1;
+                if (algorithm == "bfs" || algorithm == "sssp") {
+                    value = v == query_source ? 0 : kGasInfinity;
+                } else if (algorithm == "cc") {
+                    value = static_cast<Ring>(v);
+                }
+                auto w = input_wires.vertices[q * num_vert + v];
+                input_pid_map[w] = vertex_owner[v];
+                graph_inputs[w] = value;
+            }
+        }
+        for (size_t v = 0; v < input_wires.inv_out_degree.size(); ++v) {
+            double inv = out_degree[v] == 0 ? 0.0 : 1.0 / static_cast<double>(out_degree[v]);
+            input_pid_map[input_wires.inv_out_degree[v]] = vertex_owner[v];
+            for (int q = 0; q < queries; ++q) {
+                graph_inputs[input_wires.vertices[q * num_vert + v]] = common::utils::toFixed(inv, kPageRankFraction);
+            }
+            graph_inputs[input_wires.inv_out_degree[v]] = common::utils::toFixed(inv, kPageRankWeightFraction);
+        }
+        for (size_t q = 0; q < input_wires.teleport.size(); ++q) {
+            for (size_t v = 0; v < num_vert; ++v) {
+                double restart = v % static_cast<size_t>(queries) == q ? static_cast<double>(queries) : 0.0;
+                input_pid_map[input_wires.teleport[q][v]] = vertex_owner[v];
+                graph_inputs[input_wires.teleport[q][v]] = common::utils::toFixed(restart, kPageRankFraction);
+            }
+        }
+        for (int i = 0; i < nP; ++i) {
+            const auto& sub = subgraphs[i];
+            for (size_t j = 0; j < input_wires.edges[i].size(); ++j) {
+                input_pid_map[input_wires.edges[i][j]] = i + 1;
+                graph_inputs[input_wires.edges[i][j]] = sub.weights.empty() ? 1 : sub.weights[j];
+            }
         }
     }
 
+    // Every iteration runs the same message passing circuit, so preprocessing
+    // for all of them is generated in one batch. With a tolerance, the
+    // instances of the iterations skipped after convergence stay unused.
+    auto circ_fp = common::utils::fingerprint(circ);
+    PreprocPool pool;
+
     std::cout << "Starting preprocessing" << std::endl;
     StatsPoint preproc_start(*network);
-    emp::PRG prg(&emp::zero_block, seed);
     int latency_ms = static_cast<int>(latency);  // Convert latency from double to int milliseconds
-    OfflineEvaluator off_eval(nP, pid, network, circ, threads, seed, latency_ms);
-    auto preproc = off_eval.run(input_pid_map);
+    OfflineEvaluator off_eval(nP, pid, network, circ, threads, seed, latency_ms, seed_compressed);
+    pool.add(circ_fp, off_eval.runBatch(input_pid_map, iter));
     std::cout << "Preprocessing complete" << std::endl;
     network->sync();
     StatsPoint preproc_end(*network);
 
     std::cout << "Starting online evaluation" << std::endl;
     StatsPoint online_start(*network);
-    OnlineEvaluator eval(nP, pid, network, std::move(preproc), circ, threads, seed, latency_ms);
-    eval.setRandomInputs();
-    for (size_t i = 0; i < circ.gates_by_level.size(); ++i) {
-        eval.evaluateGatesAtDepth(i);
+    OnlineEvaluator eval(nP, pid, network, pool.acquire(circ_fp), circ, threads, seed, latency_ms);
+    if (subgraphs.empty()) {
+        eval.setRandomInputs();
+    } else {
+        eval.setInputs(graph_inputs);
+    }
+    // The vertex values computed by an iteration are the vertex inputs of
+    // the next one.
+    IterativeEvaluator iterative(eval, pool, circ, circ.outputs, input_wires.vertices);
+    // With a tolerance, iter is only the maximum.
+    int iterations_run = iter;
+    if (threshold > 0) {
+        iterations_run = iterative.runUntilConverged(iter, converged);
+    } else {
+        iterative.run(iter);
     }
     std::cout << "Online evaluation complete" << std::endl;
     network->sync();
@@ -493,9 +793,10 @@ void benchmark(const bpo::variables_map& opts) {
         total_bytes_sent += val.get<int64_t>();
     }
 
-    // Adjust online to include init
-    double adjusted_online_time = init_rbench["time"].get<double>() + online_rbench["time"].get<double>() * iter;
-    size_t adjusted_online_bytes = init_bytes_sent + online_bytes_sent * iter;
+    // Adjust online to include init. Online stats per iteration are over the
+    // iterations actually run.
+    double adjusted_online_time = init_rbench["time"].get<double>() + online_rbench["time"].get<double>();
+    size_t adjusted_online_bytes = init_bytes_sent + online_bytes_sent;
 
     // std::cout << "--- Repetition " << r + 1 << " ---" << std::endl;
     std::cout << std::fixed << std::setprecision(2);
@@ -503,14 +804,30 @@ void benchmark(const bpo::variables_map& opts) {
     std::cout << "init sent: " << init_bytes_sent << " bytes" << std::endl;
     std::cout << "preproc time: " << preproc_rbench["time"] << " ms" << std::endl;
     std::cout << "preproc sent: " << pre_bytes_sent << " bytes" << std::endl;
+    std::cout << "preproc time per iteration: " << preproc_rbench["time"].get<double>() / iter << " ms" << std::endl;
     std::cout << "online time: " << adjusted_online_time << " ms" << std::endl;
     std::cout << "online sent: " << adjusted_online_bytes << " bytes" << std::endl;
+    std::cout << "iterations run: " << iterations_run << std::endl;
+    std::cout << "online time per iteration: " << online_rbench["time"].get<double>() / iterations_run << " ms" << std::endl;
+    std::cout << "online sent per iteration: " << online_bytes_sent / iterations_run << " bytes" << std::endl;
+    std::cout << "online rounds per iteration: " << eval.rounds() / iterations_run << std::endl;
+    std::cout << "online time per query: " << adjusted_online_time / queries << " ms" << std::endl;
+    std::cout << "online sent per query: " << adjusted_online_bytes / queries << " bytes" << std::endl;
     std::cout << "total time: " << total_rbench["time"] << " ms" << std::endl;
     std::cout << "total sent: " << total_bytes_sent << " bytes" << std::endl;
     std::cout << std::endl;
 
     output_data["stats"] = {{"peak_virtual_memory", peakVirtualMemory()},
-                            {"peak_resident_set_size", peakResidentSetSize()}};
+                            {"peak_resident_set_size", peakResidentSetSize()},
+                            {"iterations_run", iterations_run},
+                            {"online_rounds", eval.rounds()},
+                            {"online_rounds_per_iteration", eval.rounds() / iterations_run}};
+    // Load of the PermAndSh gates of each owner, in owner order.
+    output_data["stats"]["permandsh_owners"] = json::array();
+    for (const auto& owner_stats : eval.permAndShStats()) {
+        output_data["stats"]["permandsh_owners"].push_back(
+            {{"gates", owner_stats.gates}, {"elements", owner_stats.elements}, {"time", owner_stats.time_ms}});
+    }
 
     std::cout << "--- Statistics ---" << std::endl;
     for (const auto& [key, value] : output_data["stats"].items()) {
@@ -528,12 +845,22 @@ bpo::options_description programOptions() {
     bpo::options_description desc("Following options are supported by config file too.");
     desc.add_options()
         ("num-parties,n", bpo::value<int>()->required(), "Number of parties.")
-        ("vec-size,v", bpo::value<size_t>()->required(), "Number of gates at each level.")
+        ("vec-size,v", bpo::value<size_t>()->default_value(1000), "Number of tuples of the synthetic graph, if no graph is given.")
+        ("graph,g", bpo::value<std::string>(), "Graph store written by graph_ingest, or an edge list as text or as binary uint32 pairs if it ends in .bin.")
+        ("partition", bpo::value<std::string>()->default_value("range"), "Vertex partition of edge lists: range, hash, degree or edge-cut.")
+        ("insert", bpo::value<std::string>(), "Edge list of edges inserted into the graph, patched into the loaded subgraphs.")
+        ("delete", bpo::value<std::string>(), "Edge list of edges deleted from the graph, patched into the loaded subgraphs.")
         ("iter,i", bpo::value<int>()->default_value(1), "Number of iterations for message passing.")
+        ("algorithm", bpo::value<std::string>()->default_value(E2E_ALGORITHM), "Message passing algorithm: pagerank, bfs, cc or sssp.")
+        ("source", bpo::value<uint32_t>()->default_value(0), "Source vertex of bfs and sssp, as in the edge list.")
+        ("queries,q", bpo::value<int>()->default_value(1), "Number of queries evaluated together, query q starting from source + q.")
+        ("tolerance", bpo::value<double>()->default_value(0.0), "Stop once no vertex value moves by tolerance or more in an iteration, after at most iter iterations. 0 runs all iterations.")
+        ("damping", bpo::value<double>()->default_value(0.0), "Damping factor of fixed-point PageRank, in (0, 1). 0 runs the unit PageRank cost model.")
         ("latency,l", bpo::value<double>()->default_value(100.0), "Network latency in ms.")
         ("pid,p", bpo::value<size_t>()->required(), "Party ID.")
         ("threads,t", bpo::value<size_t>()->default_value(6), "Number of threads (recommended 6).")
         ("seed", bpo::value<size_t>()->default_value(200), "Value of the random seed.")
+        ("seed-compressed", bpo::bool_switch(), "Dealer sends PRG seeds and only correction terms during preprocessing.")
         ("net-config", bpo::value<std::string>(), "Path to JSON file containing network details of all parties.")
         ("localhost", bpo::bool_switch(), "All parties are on same machine.")
         ("port", bpo::value<int>()->default_value(10000), "Base port for networking.")
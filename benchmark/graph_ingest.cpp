@@ -0,0 +1,120 @@
+#include <utils/graph.h>
+#include <utils/graph_partition.h>
+#include <utils/graph_store.h>
+
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <omp.h>
+
+#include "utils.h"
+
+using json = nlohmann::json;
+namespace bpo = boost::program_options;
+
+void benchmark(const bpo::variables_map& opts) {
+    bool save_output = false;
+    std::string save_file;
+    if (opts.count("output") != 0) {
+        save_output = true;
+        save_file = opts["output"].as<std::string>();
+    }
+
+    auto input = opts["input"].as<std::string>();
+    auto store_path = opts["store"].as<std::string>();
+    auto nP = opts["num-parties"].as<int>();
+    auto threads = opts["threads"].as<size_t>();
+    auto partition = common::utils::partitionStrategyFromString(opts["partition"].as<std::string>());
+
+    omp_set_num_threads(static_cast<int>(threads));
+
+    json output_data;
+    output_data["details"] = {{"input", input},
+                              {"store", store_path},
+                              {"num_parties", nP},
+                              {"partition", common::utils::partitionStrategyName(partition)},
+                              {"threads", threads}};
+    std::cout << "--- Details ---\n" << output_data["details"].dump(4) << std::endl;
+
+    json rep;
+    TimePoint start;
+    auto graph = common::utils::loadEdgeList(input, common::utils::EdgeListFormat::kAuto, static_cast<int>(threads));
+    TimePoint parsed;
+    auto owner = common::utils::partitionGraph(graph, nP, partition);
+    common::utils::relabelByOwner(graph, owner);
+    TimePoint partitioned;
+    auto subgraphs = common::utils::buildSubgraphs(graph, owner, nP);
+    TimePoint built;
+    common::utils::writeGraphStore(store_path, graph, owner, subgraphs);
+    TimePoint written;
+    auto store = common::utils::loadGraphStore(store_path, {1});
+    TimePoint loaded;
+
+    rep["num_vertices"] = graph.num_vert;
+    rep["num_edges"] = graph.edges.size();
+    rep["parse_ms"] = parsed - start;
+    rep["partition_ms"] = partitioned - parsed;
+    rep["subgraphs_ms"] = built - partitioned;
+    rep["write_ms"] = written - built;
+    rep["load_shard_ms"] = loaded - written;
+    auto stats = common::utils::partitionStats(graph, owner, nP);
+    rep["subgraph_dag_sizes"] = stats.dag_sizes;
+    rep["dag_imbalance"] = stats.imbalance;
+    rep["edge_cut"] = stats.edge_cut;
+    rep["replication"] = stats.replication;
+    std::cout << "--- Ingestion (ms) ---\n" << rep.dump(4) << std::endl;
+    output_data["benchmarks"] = rep;
+
+    if (save_output) { saveJson(output_data, save_file); }
+}
+
+// clang-format off
+bpo::options_description programOptions() {
+    bpo::options_description desc("Following options are supported by config file too.");
+    desc.add_options()
+        ("input,i", bpo::value<std::string>()->required(), "Edge list, as text or as binary uint32 pairs if it ends in .bin.")
+        ("store,s", bpo::value<std::string>()->required(), "Graph store to write.")
+        ("num-parties,n", bpo::value<int>()->required(), "Number of parties the graph is split across.")
+        ("partition,p", bpo::value<std::string>()->default_value("range"), "Vertex partition: range, hash, degree or edge-cut.")
+        ("threads,t", bpo::value<size_t>()->default_value(6), "Number of threads.")
+        ("output,o", bpo::value<std::string>(), "File to save benchmarks.");
+  return desc;
+}
+// clang-format on
+
+int main(int argc, char* argv[]) {
+    auto prog_opts(programOptions());
+    bpo::options_description cmdline("Convert an edge list into a graph store with one shard per party.");
+    cmdline.add(prog_opts);
+    cmdline.add_options()(
+      "config,c", bpo::value<std::string>(),
+      "configuration file for easy specification of cmd line arguments")(
+      "help,h", "produce help message");
+    bpo::variables_map opts;
+    bpo::store(bpo::command_line_parser(argc, argv).options(cmdline).run(), opts);
+    if (opts.count("help") != 0) {
+        std::cout << cmdline << std::endl;
+        return 0;
+    }
+    if (opts.count("config") > 0) {
+        std::string cpath(opts["config"].as<std::string>());
+        std::ifstream fin(cpath.c_str());
+        if (fin.fail()) {
+            std::cerr << "Could not open configuration file at " << cpath << std::endl;
+            return 1;
+        }
+        bpo::store(bpo::parse_config_file(fin, prog_opts), opts);
+    }
+    try {
+        bpo::notify(opts);
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    try {
+        benchmark(opts);
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << "\nFatal error" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,6 +1,9 @@
 #include <io/netmp.h>
+#include <grasp/gas.h>
+#include <grasp/iterative_evaluator.h>
 #include <grasp/offline_evaluator.h>
 #include <grasp/online_evaluator.h>
+#include <grasp/preproc_pool.h>
 #include <utils/circuit.h>
 
 #include <algorithm>
@@ -18,7 +21,9 @@ using namespace grasp;
 using json = nlohmann::json;
 namespace bpo = boost::program_options;
 
-common::utils::Circuit<Ring> generateCircuit(std::shared_ptr<io::NetIOMP> &network, int nP, int pid, size_t vec_size, int iter) {
+// 'vertex_wires' is set to the input wires of the vertex values.
+common::utils::Circuit<Ring> generateCircuit(std::shared_ptr<io::NetIOMP> &network, int nP, int pid, size_t vec_size, int iter,
+                                             std::vector<wire_t> &vertex_wires) {
 
     std::cout << "Generating circuit" << std::endl;
     
@@ -55,92 +60,30 @@ common::utils::Circuit<Ring> generateCircuit(std::shared_ptr<io::NetIOMP> &netwo
     }
 
     // MESSAGE PASSING
-
-    std::vector<std::vector<int>> permutation;
-    std::vector<int> tmp_perm(num_vert);
-    for (int i = 0; i < num_vert; ++i) {
-        tmp_perm[i] = i;
-    }
-    permutation.push_back(tmp_perm);
-    if (pid == 0) {
-        for (int i = 1; i < nP; ++i) {
-            permutation.push_back(tmp_perm);
-        }
-    }
-
-    // DECOMPOSE
-    std::vector<wire_t> subg_sorted_vert_list(num_vert, 0);
+    // Every subgraph takes a prefix of the vertex list, without decomposition.
+    GasGraph graph;
+    graph.backend = GasBackend::kGraSP;
     for (int i = 0; i < nP; ++i) {
-        // SUB GRAPH GEN
-        auto num_subg_vert = std::min(num_vert, 2 * subg_num_edge[i]);
-        std::vector<wire_t> subg_dag_list_party;
-        subg_dag_list_party.reserve(num_subg_vert + subg_edge_list[i].size());
-        std::vector<wire_t> subg_permuted_vert_list(subg_sorted_vert_list.size());
-        for (int j = 0; j < subg_permuted_vert_list.size(); ++j) {
-            subg_permuted_vert_list[j] = full_vertex_list[j];
-        }
-        subg_dag_list_party.insert(subg_dag_list_party.end(), subg_permuted_vert_list.begin(), subg_permuted_vert_list.begin() + num_subg_vert);
-        subg_dag_list_party.insert(subg_dag_list_party.end(), subg_edge_list[i].begin(), subg_edge_list[i].end());
-
-        std::vector<std::vector<int>> subg_permutation;
-        std::vector<int> subg_tmp_perm(subg_dag_list_party.size());
-        for (int i = 0; i < subg_tmp_perm.size(); ++i) {
-            subg_tmp_perm[i] = i;
-        }
-        subg_permutation.push_back(subg_tmp_perm);
-        if (pid == 0) {
-            for (int i = 1; i < nP; ++i) {
-                subg_permutation.push_back(subg_tmp_perm);
-            }
-        }
-
-        // PROPAGATE
-        std::vector<wire_t> tmp(subg_dag_list_party.size());
-        for (int j = num_subg_vert - 1; j > 0; --j) {
-            tmp[j] = circ.addGate(common::utils::GateType::kSub, subg_dag_list_party[j], subg_dag_list_party[j - 1]);
-        }
-        auto permAndSh_list1 = circ.addMGate(common::utils::GateType::kPermAndSh, tmp, subg_permutation, i + 1);
-        std::vector<wire_t> propagate_list(permAndSh_list1.size());
-        for (int j = 0; j < permAndSh_list1.size(); ++j) {
-            propagate_list[j] = permAndSh_list1[j];
-        }
-        std::vector<wire_t> tmp1(propagate_list.size());
-        for (int j = 1; j < permAndSh_list1.size(); ++j) {
-            tmp1[j] = circ.addGate(common::utils::GateType::kAdd, propagate_list[j - 1], propagate_list[j]);
-        }
-        for (int j = propagate_list.size() - 1; j > 0; --j) {
-            propagate_list[j] = circ.addGate(common::utils::GateType::kSub, tmp1[j], propagate_list[j]);
-        }
-
-        // SRC TO DST
-        auto permAndSh_list2 = circ.addMGate(common::utils::GateType::kPermAndSh, propagate_list, subg_permutation, i + 1);
-        std::vector<wire_t> tmp2(permAndSh_list2.size());
-        for (int j = 1; j < permAndSh_list2.size(); ++j) {
-            tmp2[j] = permAndSh_list2[j];
-        }
-
-        // GATHER
-        std::vector<wire_t> permAndSh_list3(tmp2.size());
-        for (int j = 1; j < permAndSh_list3.size(); ++j) {
-            permAndSh_list3[j] = circ.addGate(common::utils::GateType::kAdd, tmp2[j], tmp2[j - 1]);
-        }
-        auto permAndSh_list4 = circ.addMGate(common::utils::GateType::kPermAndSh, permAndSh_list3, subg_permutation, i + 1);
-        std::vector<wire_t> tmp3(permAndSh_list4.size());
-        for (int j = 0; j < permAndSh_list4.size(); ++j) {
-            tmp3[j] = permAndSh_list4[j];
-        }
-        std::vector<wire_t> gather_list(tmp3.size());
-        for (int j = gather_list.size() - 1; j > 0; --j) {
-            gather_list[j] = circ.addGate(common::utils::GateType::kSub, tmp3[j], tmp3[j - 1]);
-        }
-
-        // APPLYV - PAGERANK
-        for (int j = 0; j < gather_list.size(); ++j) {
-            auto pgr = circ.addConstOpGate(common::utils::GateType::kConstMul, gather_list[j], Ring(1));
-            gather_list[j] = circ.addConstOpGate(common::utils::GateType::kConstAdd, pgr, Ring(1));
-            circ.setAsOutput(gather_list[j]);
+        GasDagList dag;
+        dag.owner = i + 1;
+        dag.num_vert = std::min(num_vert, 2 * subg_num_edge[i]);
+        dag.num_own = std::min(dag.num_vert, subg_num_vert[i]);
+        dag.edges = subg_edge_list[i];
+
+        std::vector<int> subg_tmp_perm(dag.num_vert + dag.edges.size());
+        for (int j = 0; j < subg_tmp_perm.size(); ++j) {
+            subg_tmp_perm[j] = j;
         }
+        std::vector<std::vector<int>> subg_permutation(pid == 0 ? nP : 1, subg_tmp_perm);
+        dag.perm_s.secret = ownerPermutations(subg_permutation, pid, i + 1);
+        dag.perm_d.secret = dag.perm_s.secret;
+        dag.perm_v.secret = dag.perm_s.secret;
+        graph.dag_lists.push_back(std::move(dag));
+    }
+    for (auto w : addGasIteration(circ, graph, unitPageRankProgram(), full_vertex_list)) {
+        circ.setAsOutput(w);
     }
+    vertex_wires = full_vertex_list;
     return circ;
 }
 
@@ -162,6 +105,7 @@ void benchmark(const bpo::variables_map& opts) {
     auto seed = opts["seed"].as<size_t>();
     auto repeat = opts["repeat"].as<size_t>();
     auto port = opts["port"].as<int>();
+    auto seed_compressed = opts["seed-compressed"].as<bool>();
 
     omp_set_nested(1);
     // omp_set_num_threads(nP);
@@ -201,6 +145,7 @@ void benchmark(const bpo::variables_map& opts) {
                               {"pid", pid},
                               {"threads", threads},
                               {"seed", seed},
+                              {"seed_compressed", seed_compressed},
                               {"repeat", repeat}};
     output_data["benchmarks"] = json::array();
 
@@ -214,7 +159,8 @@ void benchmark(const bpo::variables_map& opts) {
 
     network->sync();
     StatsPoint init_start(*network);
-    auto circ = generateCircuit(network, nP, pid, vec_size, iter).orderGatesByLevel();
+    std::vector<wire_t> vertex_wires;
+    auto circ = generateCircuit(network, nP, pid, vec_size, iter, vertex_wires).orderGatesByLevel();
     network->sync();
     StatsPoint init_end(*network);
 
@@ -228,23 +174,32 @@ void benchmark(const bpo::variables_map& opts) {
         }
     }
 
+    // Every iteration runs the same message passing circuit, so preprocessing
+    // for all of them is generated in one batch.
+    auto circ_fp = common::utils::fingerprint(circ);
+    PreprocPool pool;
+
     std::cout << "Starting preprocessing" << std::endl;
     StatsPoint preproc_start(*network);
-    emp::PRG prg(&emp::zero_block, seed);
     int latency_ms = static_cast<int>(latency);  // Convert latency from double to int milliseconds
-    OfflineEvaluator off_eval(nP, pid, network, circ, threads, seed, latency_ms);
-    auto preproc = off_eval.run(input_pid_map);
+    OfflineEvaluator off_eval(nP, pid, network, circ, threads, seed, latency_ms, seed_compressed);
+    pool.add(circ_fp, off_eval.runBatch(input_pid_map, iter));
     std::cout << "Preprocessing complete" << std::endl;
     network->sync();
     StatsPoint preproc_end(*network);
 
     std::cout << "Starting online evaluation" << std::endl;
     StatsPoint online_start(*network);
-    OnlineEvaluator eval(nP, pid, network, std::move(preproc), circ, threads, seed, latency_ms);
+    OnlineEvaluator eval(nP, pid, network, pool.acquire(circ_fp), circ, threads, seed, latency_ms);
     eval.setRandomInputs();
-    for (size_t i = 0; i < circ.gates_by_level.size(); ++i) {
-        eval.evaluateGatesAtDepth(i);
-    }
+    // The synthetic subgraphs do not partition the vertices, so new values
+    // are fed back to the vertex inputs in output order, which has the cost
+    // of a real iteration.
+    std::vector<wire_t> feedback_out(circ.outputs.begin(),
+                                     circ.outputs.begin() + std::min(circ.outputs.size(), vertex_wires.size()));
+    vertex_wires.resize(feedback_out.size());
+    IterativeEvaluator iterative(eval, pool, circ, feedback_out, vertex_wires);
+    iterative.run(iter);
     std::cout << "Online evaluation complete" << std::endl;
     network->sync();
     StatsPoint online_end(*network);
@@ -283,6 +238,7 @@ void benchmark(const bpo::variables_map& opts) {
     std::cout << "init sent: " << init_bytes_sent << " bytes" << std::endl;
     std::cout << "preproc time: " << preproc_rbench["time"] << " ms" << std::endl;
     std::cout << "preproc sent: " << pre_bytes_sent << " bytes" << std::endl;
+    std::cout << "preproc time per iteration: " << preproc_rbench["time"].get<double>() / iter << " ms" << std::endl;
     std::cout << "online time: " << online_rbench["time"] << " ms" << std::endl;
     std::cout << "online sent: " << online_bytes_sent << " bytes" << std::endl;
     std::cout << "total time: " << total_rbench["time"] << " ms" << std::endl;
@@ -291,6 +247,12 @@ void benchmark(const bpo::variables_map& opts) {
 
     output_data["stats"] = {{"peak_virtual_memory", peakVirtualMemory()},
                             {"peak_resident_set_size", peakResidentSetSize()}};
+    // Load of the PermAndSh gates of each owner, in owner order.
+    output_data["stats"]["permandsh_owners"] = json::array();
+    for (const auto& owner_stats : eval.permAndShStats()) {
+        output_data["stats"]["permandsh_owners"].push_back(
+            {{"gates", owner_stats.gates}, {"elements", owner_stats.elements}, {"time", owner_stats.time_ms}});
+    }
 
     std::cout << "--- Statistics ---" << std::endl;
     for (const auto& [key, value] : output_data["stats"].items()) {
@@ -314,6 +276,7 @@ bpo::options_description programOptions() {
         ("pid,p", bpo::value<size_t>()->required(), "Party ID.")
         ("threads,t", bpo::value<size_t>()->default_value(6), "Number of threads (recommended 6).")
         ("seed", bpo::value<size_t>()->default_value(200), "Value of the random seed.")
+        ("seed-compressed", bpo::bool_switch(), "Dealer sends PRG seeds and only correction terms during preprocessing.")
         ("net-config", bpo::value<std::string>(), "Path to JSON file containing network details of all parties.")
         ("localhost", bpo::bool_switch(), "All parties are on same machine.")
         ("port", bpo::value<int>()->default_value(10000), "Base port for networking.")
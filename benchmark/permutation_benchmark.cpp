@@ -0,0 +1,143 @@
+#include <utils/permutation.h>
+#include <utils/types.h>
+
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <numeric>
+#include <omp.h>
+#include <random>
+
+#include "utils.h"
+
+using common::utils::Ring;
+using json = nlohmann::json;
+namespace bpo = boost::program_options;
+
+// Milliseconds taken by the fastest of 'repeat' runs of f.
+template <class F>
+double fastestRun(size_t repeat, F&& f) {
+    double best = 0;
+    for (size_t r = 0; r < repeat; ++r) {
+        TimePoint start;
+        f();
+        TimePoint end;
+        double elapsed = end - start;
+        if (r == 0 || elapsed < best) { best = elapsed; }
+    }
+    return best;
+}
+
+void benchmark(const bpo::variables_map& opts) {
+    bool save_output = false;
+    std::string save_file;
+    if (opts.count("output") != 0) {
+        save_output = true;
+        save_file = opts["output"].as<std::string>();
+    }
+
+    auto min_size = opts["min-size"].as<size_t>();
+    auto max_size = opts["max-size"].as<size_t>();
+    auto threads = opts["threads"].as<size_t>();
+    auto seed = opts["seed"].as<size_t>();
+    auto repeat = std::max<size_t>(opts["repeat"].as<size_t>(), 1);
+
+    omp_set_num_threads(static_cast<int>(threads));
+
+    json output_data;
+    output_data["details"] = {{"min_size", min_size},
+                              {"max_size", max_size},
+                              {"threads", threads},
+                              {"seed", seed},
+                              {"repeat", repeat},
+                              {"block", common::utils::kPermuteBlock},
+                              {"blocked_min_bytes", common::utils::kPermuteBlockedMinBytes}};
+    output_data["benchmarks"] = json::array();
+    std::cout << "--- Details ---\n" << output_data["details"].dump(4) << std::endl;
+
+    std::mt19937_64 gen(seed);
+    for (size_t n = min_size; n <= max_size; n *= 10) {
+        std::vector<int> pi(n);
+        std::iota(pi.begin(), pi.end(), 0);
+        std::shuffle(pi.begin(), pi.end(), gen);
+        std::vector<Ring> src(n);
+        for (auto& val : src) { val = static_cast<Ring>(gen()); }
+        std::vector<Ring> naive(n);
+        std::vector<Ring> kernel(n);
+
+        json rep;
+        rep["size"] = n;
+        rep["scatter_naive"] = fastestRun(repeat, [&]() {
+            for (size_t i = 0; i < n; ++i) { naive[pi[i]] = src[i]; }
+        });
+        rep["scatter"] = fastestRun(repeat, [&]() {
+            common::utils::permuteScatter(src.data(), pi.data(), n, kernel.data());
+        });
+        if (naive != kernel) { throw std::runtime_error("Scatter kernel mismatch."); }
+
+        rep["gather_naive"] = fastestRun(repeat, [&]() {
+            for (size_t i = 0; i < n; ++i) { naive[i] = src[pi[i]]; }
+        });
+        rep["gather"] = fastestRun(repeat, [&]() {
+            common::utils::permuteGather(src.data(), pi.data(), n, kernel.data());
+        });
+        if (naive != kernel) { throw std::runtime_error("Gather kernel mismatch."); }
+
+        std::cout << "--- Size " << n << " (ms) ---\n" << rep.dump(4) << std::endl;
+        output_data["benchmarks"].push_back(rep);
+    }
+
+    if (save_output) { saveJson(output_data, save_file); }
+}
+
+// clang-format off
+bpo::options_description programOptions() {
+    bpo::options_description desc("Following options are supported by config file too.");
+    desc.add_options()
+        ("min-size", bpo::value<size_t>()->default_value(1000), "Smallest vector size.")
+        ("max-size", bpo::value<size_t>()->default_value(10000000), "Largest vector size, sizes grow tenfold.")
+        ("threads,t", bpo::value<size_t>()->default_value(6), "Number of threads.")
+        ("seed", bpo::value<size_t>()->default_value(200), "Value of the random seed.")
+        ("output,o", bpo::value<std::string>(), "File to save benchmarks.")
+        ("repeat,r", bpo::value<size_t>()->default_value(5), "Number of runs per size, the fastest is reported.");
+  return desc;
+}
+// clang-format on
+
+int main(int argc, char* argv[]) {
+    auto prog_opts(programOptions());
+    bpo::options_description cmdline("Benchmark permutation kernels against naive loops.");
+    cmdline.add(prog_opts);
+    cmdline.add_options()(
+      "config,c", bpo::value<std::string>(),
+      "configuration file for easy specification of cmd line arguments")(
+      "help,h", "produce help message");
+    bpo::variables_map opts;
+    bpo::store(bpo::command_line_parser(argc, argv).options(cmdline).run(), opts);
+    if (opts.count("help") != 0) {
+        std::cout << cmdline << std::endl;
+        return 0;
+    }
+    if (opts.count("config") > 0) {
+        std::string cpath(opts["config"].as<std::string>());
+        std::ifstream fin(cpath.c_str());
+        if (fin.fail()) {
+            std::cerr << "Could not open configuration file at " << cpath << std::endl;
+            return 1;
+        }
+        bpo::store(bpo::parse_config_file(fin, prog_opts), opts);
+    }
+    try {
+        bpo::notify(opts);
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    try {
+        benchmark(opts);
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << "\nFatal error" << std::endl;
+        return 1;
+    }
+    return 0;
+}
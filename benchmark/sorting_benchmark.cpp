@@ -1,6 +1,7 @@
 #include <io/netmp.h>
 #include <grasp/offline_evaluator.h>
 #include <grasp/online_evaluator.h>
+#include <grasp/sort.h>
 #include <utils/circuit.h>
 
 #include <algorithm>
@@ -8,7 +9,9 @@
 #include <cmath>
 #include <iostream>
 #include <memory>
+#include <numeric>
 #include <omp.h>
+#include <random>
 
 #include "utils.h"
 
@@ -18,68 +21,51 @@ using namespace grasp;
 using json = nlohmann::json;
 namespace bpo = boost::program_options;
 
-common::utils::Circuit<Ring> generateSortingCircuit(std::shared_ptr<io::NetIOMP> &network, int nP, int pid, size_t vec_size) {
+// Permutation applied by party 'pid' in the shuffle. Derived from the seed
+// so that the dealer, which knows all permutations, can compute it too.
+std::vector<int> shufflePermutation(size_t seed, int pid, size_t vec_size) {
+    std::vector<int> perm(vec_size);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::mt19937_64 gen(seed + pid);
+    std::shuffle(perm.begin(), perm.end(), gen);
+    return perm;
+}
+
+common::utils::Circuit<Ring> generateSortingCircuit(int nP, int pid, size_t vec_size, size_t seed, int cmp_radix,
+                                                    SortWires& sort_wires) {
 
     std::cout << "Generating sorting circuit" << std::endl;
-    
+
     common::utils::Circuit<Ring> circ;
+    circ.setComparisonRadix(cmp_radix);
 
-    // Create input wires for the vector
     std::vector<common::utils::wire_t> input_wires(vec_size);
     std::generate(input_wires.begin(), input_wires.end(), [&]() { return circ.newInputWire(); });
 
-    // Shuffle the vector first
-    std::cout << "Adding shuffle gate for " << vec_size << " elements" << std::endl;
-    
-    // Add shuffle gate - addMGate returns the output wires directly
     std::vector<std::vector<int>> perm;
-    std::vector<int> tmp_perm(vec_size);
-    #pragma omp parallel for
-    for (int i = 0; i < vec_size; ++i) {
-        tmp_perm[i] = i;
-    }
-    perm.push_back(tmp_perm);
     if (pid == 0) {
-        for (int i = 1; i < nP; ++i) {
-            perm.push_back(tmp_perm);
+        for (int i = 1; i <= nP; ++i) {
+            perm.push_back(shufflePermutation(seed, i, vec_size));
         }
+    } else {
+        perm.push_back(shufflePermutation(seed, pid, vec_size));
     }
 
-    std::vector<common::utils::wire_t> shuffled_wires = circ.addMGate(common::utils::GateType::kShuffle, input_wires, perm, 0);
-
-    // Current working wires start as shuffled wires
-    std::vector<common::utils::wire_t> current_wires = shuffled_wires;
-    
-    // Perform vec_size comparisons only once
-    std::cout << "Adding " << vec_size << " comparisons" << std::endl;
-    
-    // Perform vec_size comparisons (each addGate returns output wire directly)
-    std::vector<common::utils::wire_t> comparison_outputs(vec_size);
-    for (size_t i = 0; i < vec_size; ++i) {
-        size_t idx1 = i;
-        size_t idx2 = (i + 1) % vec_size; // Compare with next element (wrap around)
-        
-        // Compare current_wires[idx1] and current_wires[idx2]
-        // Compute diff = current_wires[idx1] - current_wires[idx2]
-        auto diff = circ.addGate(common::utils::GateType::kSub, current_wires[idx1], current_wires[idx2]);
-        
-        // Compute comparison result: cmp = (diff < 0)
-        auto cmp = circ.addGate(common::utils::GateType::kLtz, diff);
-        
-        comparison_outputs[i] = cmp;
-    }
-    
-    current_wires = comparison_outputs;
-    
-    // Set outputs
-    for (size_t i = 0; i < vec_size; ++i) {
-        circ.setAsOutput(current_wires[i]);
-    }
-    
+    sort_wires = addSortGates(circ, input_wires, perm, 0);
+    std::cout << "Reserved " << sort_wires.cmp.size() << " comparisons for " << vec_size << " elements" << std::endl;
+
     std::cout << "Sorting circuit generation complete" << std::endl;
     return circ;
 }
 
+size_t bytesSent(const json& rbench) {
+    size_t bytes = 0;
+    for (const auto& val : rbench["communication"]) {
+        bytes += val.get<int64_t>();
+    }
+    return bytes;
+}
+
 void benchmark(const bpo::variables_map& opts) {
 
     bool save_output = false;
@@ -97,6 +83,8 @@ void benchmark(const bpo::variables_map& opts) {
     auto seed = opts["seed"].as<size_t>();
     auto repeat = opts["repeat"].as<size_t>();
     auto port = opts["port"].as<int>();
+    auto cmp_radix = opts["cmp-radix"].as<int>();
+    auto king_policy = kingPolicyFromString(opts["king"].as<std::string>());
 
     omp_set_nested(1);
     if (nP < 10) { omp_set_num_threads(nP); }
@@ -127,17 +115,16 @@ void benchmark(const bpo::variables_map& opts) {
     // Increase socket buffer sizes to prevent deadlocks with large messages
     increaseSocketBuffers(network.get(), 128 * 1024 * 1024);
 
-    int num_rounds = static_cast<int>(std::ceil(std::log2(vec_size)));
-    
     json output_data;
     output_data["details"] = {{"num_parties", nP},
                               {"vec_size", vec_size},
-                              {"num_comparison_rounds", num_rounds},
-                              {"comparisons_executed", vec_size},
+                              {"comparison_budget", sortComparisonBudget(vec_size)},
                               {"latency (ms)", latency},
                               {"pid", pid},
                               {"threads", threads},
                               {"seed", seed},
+                              {"cmp_radix", cmp_radix},
+                              {"king_policy", kingPolicyName(king_policy)},
                               {"repeat", repeat}};
     output_data["benchmarks"] = json::array();
 
@@ -151,13 +138,14 @@ void benchmark(const bpo::variables_map& opts) {
 
     network->sync();
     StatsPoint init_start(*network);
-    auto circ = generateSortingCircuit(network, nP, pid, vec_size).orderGatesByLevel();
+    SortWires sort_wires;
+    auto circ = generateSortingCircuit(nP, pid, vec_size, seed, cmp_radix, sort_wires).orderGatesByLevel();
     network->sync();
     StatsPoint init_end(*network);
 
     std::cout << "--- Circuit ---" << std::endl;
     std::cout << circ << std::endl;
-    
+
     std::unordered_map<common::utils::wire_t, int> input_pid_map;
     for (const auto& g : circ.gates_by_level[0]) {
         if (g->type == common::utils::GateType::kInp) {
@@ -167,7 +155,6 @@ void benchmark(const bpo::variables_map& opts) {
 
     std::cout << "Starting preprocessing" << std::endl;
     StatsPoint preproc_start(*network);
-    emp::PRG prg(&emp::zero_block, seed);
     int latency_ms = static_cast<int>(latency);  // Convert latency from double to int milliseconds
     OfflineEvaluator off_eval(nP, pid, network, circ, threads, seed, latency_ms);
     auto preproc = off_eval.run(input_pid_map);
@@ -177,102 +164,72 @@ void benchmark(const bpo::variables_map& opts) {
 
     std::cout << "Starting online evaluation" << std::endl;
     OnlineEvaluator eval(nP, pid, network, std::move(preproc), circ, threads, seed, latency_ms);
-    eval.setRandomInputs();
-    
-    // Time the shuffle operation separately
+    eval.setKingPolicy(king_policy);
+    SecureSorter sorter(eval, circ, sort_wires, pid);
+
+    // Party 1 sorts values below 2^31 / vec_size, so that the differences of
+    // the sort keys value * vec_size + index do not overflow the signed
+    // comparison.
+    std::unordered_map<common::utils::wire_t, Ring> inputs;
+    std::mt19937_64 input_gen(seed);
+    uint64_t bound = std::max<uint64_t>((1ULL << (RINGSIZEBITS - 1)) / vec_size, 1);
+    for (const auto& [wire, owner] : input_pid_map) {
+        if (owner == static_cast<int>(pid)) {
+            inputs[wire] = static_cast<Ring>(input_gen() % bound);
+        }
+    }
+    eval.setInputs(inputs);
+
     network->sync();
-    StatsPoint shuffle_start(*network);
-    std::cout << "Evaluating shuffle at depth 1" << std::endl;
-    eval.evaluateGatesAtDepth(0); // Input gates
-    eval.evaluateGatesAtDepth(1); // Shuffle gate
+    StatsPoint online_start(*network);
+    std::cout << "Evaluating shuffle" << std::endl;
+    for (size_t i = 0; i < circ.gates_by_level.size(); ++i) {
+        eval.evaluateGatesAtDepth(i);
+    }
     network->sync();
     StatsPoint shuffle_end(*network);
-    
-    // Time the comparison operations
+
+    std::cout << "Sorting" << std::endl;
+    auto sorted_wires = sorter.sort();
     network->sync();
-    StatsPoint comparison_start(*network);
-    std::cout << "Evaluating comparisons" << std::endl;
-    for (size_t i = 2; i < circ.gates_by_level.size(); ++i) {
-        std::cout << "Evaluating depth " << i << std::endl;
-        eval.evaluateGatesAtDepth(i);
-    }
+    StatsPoint online_end(*network);
     std::cout << "Online evaluation complete" << std::endl;
-    network->sync();
-    StatsPoint comparison_end(*network);
-    
-    // Calculate projected time for log(vec_size) rounds
-    auto shuffle_rbench = shuffle_end - shuffle_start;
-    auto comparison_rbench = comparison_end - comparison_start;
-    
-    double shuffle_time = shuffle_rbench["time"].get<double>();
-    double comparison_time = comparison_rbench["time"].get<double>();
-    double projected_online_time = shuffle_time + num_rounds * comparison_time;
-    
-    size_t shuffle_comm = 0;
-    for (const auto& val : shuffle_rbench["communication"]) {
-        shuffle_comm += val.get<int64_t>();
-    }
-    size_t comparison_comm = 0;
-    for (const auto& val : comparison_rbench["communication"]) {
-        comparison_comm += val.get<int64_t>();
-    }
-    size_t projected_online_comm = shuffle_comm + num_rounds * comparison_comm;
-    
-    StatsPoint online_end = comparison_end;
 
     StatsPoint end(*network);
 
     auto init_rbench = init_end - init_start;
     auto preproc_rbench = preproc_end - preproc_start;
+    auto shuffle_rbench = shuffle_end - online_start;
+    auto sort_rbench = online_end - shuffle_end;
+    auto online_rbench = online_end - online_start;
     auto total_rbench = end - start;
-    
-    // Add individual benchmarks
+
     output_data["benchmarks"].push_back(init_rbench);
     output_data["benchmarks"].push_back(preproc_rbench);
     output_data["benchmarks"].push_back(shuffle_rbench);
-    output_data["benchmarks"].push_back(comparison_rbench);
+    output_data["benchmarks"].push_back(sort_rbench);
+    output_data["benchmarks"].push_back(online_rbench);
     output_data["benchmarks"].push_back(total_rbench);
-    
-    // Add projected sorting time
-    output_data["projected_sorting"] = {
-        {"shuffle_time_ms", shuffle_time},
-        {"comparison_time_ms", comparison_time},
-        {"num_rounds", num_rounds},
-        {"projected_total_time_ms", projected_online_time},
-        {"shuffle_comm_bytes", shuffle_comm},
-        {"comparison_comm_bytes", comparison_comm},
-        {"projected_total_comm_bytes", projected_online_comm}
-    };
-
-    size_t init_bytes_sent = 0;
-    for (const auto& val : init_rbench["communication"]) {
-        init_bytes_sent += val.get<int64_t>();
-    }
-    size_t pre_bytes_sent = 0;
-    for (const auto& val : preproc_rbench["communication"]) {
-        pre_bytes_sent += val.get<int64_t>();
-    }
-    size_t total_bytes_sent = 0;
-    for (const auto& val : total_rbench["communication"]) {
-        total_bytes_sent += val.get<int64_t>();
-    }
+
+    output_data["sorting"] = {{"comparison_rounds", sorter.rounds()},
+                              {"comparisons", sorter.comparisons()},
+                              {"comparison_budget", sort_wires.cmp.size()}};
 
     std::cout << "--- Benchmark Results ---" << std::endl;
     std::cout << std::fixed << std::setprecision(2);
     std::cout << "init time: " << init_rbench["time"] << " ms" << std::endl;
-    std::cout << "init sent: " << init_bytes_sent << " bytes" << std::endl;
+    std::cout << "init sent: " << bytesSent(init_rbench) << " bytes" << std::endl;
     std::cout << "preproc time: " << preproc_rbench["time"] << " ms" << std::endl;
-    std::cout << "preproc sent: " << pre_bytes_sent << " bytes" << std::endl;
-    std::cout << "shuffle time: " << shuffle_time << " ms" << std::endl;
-    std::cout << "shuffle sent: " << shuffle_comm << " bytes" << std::endl;
-    std::cout << "comparison time (" << vec_size << " comparisons): " << comparison_time << " ms" << std::endl;
-    std::cout << "comparison sent: " << comparison_comm << " bytes" << std::endl;
-    std::cout << "projected sorting time (shuffle + " << num_rounds << " rounds): " << projected_online_time << " ms" << std::endl;
-    std::cout << "projected sorting comm(shuffle + " << num_rounds << " rounds): " << projected_online_comm << " bytes" << std::endl;
-    std::cout << "online time: " << projected_online_time << " ms" << std::endl;
-    std::cout << "online sent: " << projected_online_comm << " bytes" << std::endl;
+    std::cout << "preproc sent: " << bytesSent(preproc_rbench) << " bytes" << std::endl;
+    std::cout << "shuffle time: " << shuffle_rbench["time"] << " ms" << std::endl;
+    std::cout << "shuffle sent: " << bytesSent(shuffle_rbench) << " bytes" << std::endl;
+    std::cout << "sort time (" << sorter.rounds() << " rounds, " << sorter.comparisons()
+              << " comparisons): " << sort_rbench["time"] << " ms" << std::endl;
+    std::cout << "sort sent: " << bytesSent(sort_rbench) << " bytes" << std::endl;
+    std::cout << "online time: " << online_rbench["time"] << " ms" << std::endl;
+    std::cout << "online sent: " << bytesSent(online_rbench) << " bytes" << std::endl;
     std::cout << "total time: " << total_rbench["time"] << " ms" << std::endl;
-    std::cout << "total sent: " << total_bytes_sent << " bytes" << std::endl;
+    std::cout << "total sent: " << bytesSent(total_rbench) << " bytes" << std::endl;
     std::cout << std::endl;
 
     output_data["stats"] = {{"peak_virtual_memory", peakVirtualMemory()},
@@ -303,14 +260,16 @@ bpo::options_description programOptions() {
         ("localhost", bpo::bool_switch(), "All parties are on same machine.")
         ("port", bpo::value<int>()->default_value(10000), "Base port for networking.")
         ("output,o", bpo::value<std::string>(), "File to save benchmarks.")
-        ("repeat,r", bpo::value<size_t>()->default_value(1), "Number of times to run benchmarks.");
+        ("repeat,r", bpo::value<size_t>()->default_value(1), "Number of times to run benchmarks.")
+        ("cmp-radix", bpo::value<int>()->default_value(4), "Fan-in (2, 3 or 4) of the AND gates in EQZ/LTZ; higher means fewer rounds.")
+        ("king", bpo::value<std::string>()->default_value("range"), "Assignment of reconstructed values to king parties: fixed, round-robin or range.");
   return desc;
 }
 // clang-format on
 
 int main(int argc, char* argv[]) {
     auto prog_opts(programOptions());
-    bpo::options_description cmdline("Benchmark sorting circuit with shuffle and log(n) comparison rounds.");
+    bpo::options_description cmdline("Benchmark secure sorting: shuffle followed by quicksort with batched comparisons.");
     cmdline.add(prog_opts);
     cmdline.add_options()(
       "config,c", bpo::value<std::string>(),
@@ -18,11 +18,12 @@ using namespace grasp;
 using json = nlohmann::json;
 namespace bpo = boost::program_options;
 
-common::utils::Circuit<Ring> generateEqzCircuit(int nP, int pid) {
+common::utils::Circuit<Ring> generateEqzCircuit(int nP, int pid, int cmp_radix) {
 
     std::cout << "Generating circuit" << std::endl;
     
     common::utils::Circuit<Ring> circ;
+    circ.setComparisonRadix(cmp_radix);
 
     std::vector<common::utils::wire_t> input_vector(1);
     std::generate(input_vector.begin(), input_vector.end(), [&]() { return circ.newInputWire(); });
@@ -54,6 +55,8 @@ void benchmark(const bpo::variables_map& opts) {
     auto repeat = opts["repeat"].as<size_t>();
     auto port = opts["port"].as<int>();
     auto use_pking = opts["use-pking"].as<bool>();
+    auto cmp_radix = opts["cmp-radix"].as<int>();
+    auto king_policy = kingPolicyFromString(opts["king"].as<std::string>());
 
     omp_set_nested(1);
     // omp_set_num_threads(nP);
@@ -94,6 +97,8 @@ void benchmark(const bpo::variables_map& opts) {
                               {"pid", pid},
                               {"threads", threads},
                               {"seed", seed},
+                              {"cmp_radix", cmp_radix},
+                              {"king_policy", kingPolicyName(king_policy)},
                               {"repeat", repeat}};
     output_data["benchmarks"] = json::array();
 
@@ -107,7 +112,7 @@ void benchmark(const bpo::variables_map& opts) {
     StatsPoint start(*network);
     network->sync();
 
-    auto circ = generateEqzCircuit(nP, pid).orderGatesByLevel();
+    auto circ = generateEqzCircuit(nP, pid, cmp_radix).orderGatesByLevel();
     network->sync();
 
 
@@ -133,6 +138,7 @@ void benchmark(const bpo::variables_map& opts) {
 
     std::cout << "Setting inputs" << std::endl;
     OnlineEvaluator eval(nP, pid, network, std::move(preproc), circ, threads, seed, latency_ms);
+    eval.setKingPolicy(king_policy);
     std::unordered_map<common::utils::wire_t, Ring> inputs;
     for (const auto& [wire, owner] : input_pid_map) {
         if (owner == static_cast<int>(pid)) {
@@ -216,6 +222,8 @@ bpo::options_description programOptions() {
         ("port", bpo::value<int>()->default_value(10000), "Base port for networking.")
         ("output,o", bpo::value<std::string>(), "File to save benchmarks.")
         ("repeat,r", bpo::value<size_t>()->default_value(1), "Number of times to run benchmarks.")
+        ("cmp-radix", bpo::value<int>()->default_value(4), "Fan-in (2, 3 or 4) of the AND gates in EQZ/LTZ; higher means fewer rounds.")
+        ("king", bpo::value<std::string>()->default_value("range"), "Assignment of reconstructed values to king parties: fixed, round-robin or range.")
         ("use-pking", bpo::value<bool>()->default_value(true), "Use king party for reconstruction (true) or direct reconstruction (false).");
   return desc;
 }
@@ -0,0 +1,402 @@
+#include "gas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace grasp {
+namespace {
+using common::utils::GateType;
+using common::utils::wire_t;
+
+std::vector<wire_t> addPermutation(common::utils::Circuit<Ring>& circ, GasBackend backend, int owner,
+                                   const std::vector<wire_t>& input, const GasPermutation& perm) {
+  std::vector<wire_t> res;
+  if (backend == GasBackend::kGraSP) {
+    res = circ.addMGate(GateType::kPermAndSh, input, perm.secret, owner);
+  } else {
+    res = circ.addMGate(GateType::kShuffle, input, perm.secret);
+  }
+  if (!perm.pub.empty()) {
+    res = circ.addConstOpMGate(GateType::kPublicPerm, res, perm.pub);
+  }
+  return res;
+}
+
+// Permutation of 'lanes' consecutive blocks of the size of 'perm', each
+// permuted by 'perm'. Empty permutations, of other owners, stay empty.
+std::vector<int> widenPermutation(const std::vector<int>& perm, size_t lanes) {
+  if (lanes == 1 || perm.empty()) { return perm; }
+  size_t n = perm.size();
+  std::vector<int> res(n * lanes);
+  for (size_t l = 0; l < lanes; ++l) {
+    for (size_t i = 0; i < n; ++i) { res[l * n + i] = static_cast<int>(l * n) + perm[i]; }
+  }
+  return res;
+}
+
+std::vector<std::vector<int>> widenPermutations(const std::vector<std::vector<int>>& perms, size_t lanes) {
+  std::vector<std::vector<int>> res;
+  res.reserve(perms.size());
+  for (const auto& perm : perms) { res.push_back(widenPermutation(perm, lanes)); }
+  return res;
+}
+
+GasPermutation widenPermutation(const GasPermutation& perm, size_t lanes) {
+  return {widenPermutations(perm.secret, lanes), widenPermutation(perm.pub, lanes)};
+}
+
+// addPrefixSumGates on each of the 'lanes' blocks of 'input'.
+std::vector<wire_t> addLanePrefixSumGates(common::utils::Circuit<Ring>& circ, const std::vector<wire_t>& input,
+                                          size_t lanes) {
+  size_t n = input.size() / lanes;
+  std::vector<wire_t> res;
+  res.reserve(input.size());
+  for (size_t l = 0; l < lanes; ++l) {
+    auto sums = addPrefixSumGates(circ, std::vector<wire_t>(input.begin() + l * n, input.begin() + (l + 1) * n));
+    res.insert(res.end(), sums.begin(), sums.end());
+  }
+  return res;
+}
+
+// Prefix minima of 'input' within segments, starts[p] being 1 if a segment
+// starts at p. starts[0] has to be 1. Hillis-Steele scan: after the step of
+// distance 'step', position p holds the minimum of its segment over
+// (p - 2 * step, p] and in 'starts' whether a segment starts in that range.
+std::vector<wire_t> addSegmentedMinGates(common::utils::Circuit<Ring>& circ, std::vector<wire_t> input,
+                                         std::vector<wire_t> starts) {
+  size_t n = input.size();
+  for (size_t step = 1; step < n; step *= 2) {
+    auto mins = input;
+    for (size_t p = step; p < n; ++p) {
+      // min(a, b) = b + (a < b) * (a - b), or b if a segment starts in the
+      // range of b.
+      auto diff = circ.addGate(GateType::kSub, input[p - step], input[p]);
+      auto less = circ.addGate(GateType::kLtz, diff);
+      auto open_diff = circ.addGate(GateType::kSub, diff, circ.addGate(GateType::kMul, starts[p], diff));
+      mins[p] = circ.addGate(GateType::kAdd, input[p], circ.addGate(GateType::kMul, less, open_diff));
+    }
+    if (2 * step < n) {
+      auto merged = starts;
+      for (size_t p = step; p < n; ++p) {
+        auto both = circ.addGate(GateType::kMul, starts[p], starts[p - step]);
+        merged[p] = circ.addGate(GateType::kSub, circ.addGate(GateType::kAdd, starts[p], starts[p - step]), both);
+      }
+      starts = std::move(merged);
+    }
+    input = std::move(mins);
+  }
+  return input;
+}
+
+// New values of the owned vertices of one DAG list in every lane, values[l]
+// holding the vertex values of lane l. The first owned vertex is at index
+// 'first_own' of the iteration result. The lanes are concatenated and share
+// every permutation gate.
+std::vector<std::vector<wire_t>> addDagListIteration(common::utils::Circuit<Ring>& circ, GasBackend backend,
+                                                     const GasDagList& dag, const GasProgram& program,
+                                                     const std::vector<std::vector<wire_t>>& values,
+                                                     size_t first_own) {
+  size_t lanes = values.size();
+  size_t num_vert = dag.num_vert;
+  size_t num_tuples = num_vert + dag.edges.size();
+  auto perm_s = widenPermutation(dag.perm_s, lanes);
+  auto perm_d = widenPermutation(dag.perm_d, lanes);
+  auto perm_v = widenPermutation(dag.perm_v, lanes);
+  std::vector<std::vector<wire_t>> msgs(lanes);
+  for (size_t l = 0; l < lanes; ++l) {
+    msgs[l].assign(values[l].begin(), values[l].begin() + num_vert);
+    if (program.scatter) {
+      for (auto& m : msgs[l]) { m = program.scatter(circ, m); }
+    }
+  }
+
+  // PROPAGATE: in source order a vertex precedes its out-edges, so the
+  // prefix sums of the differences of consecutive vertex messages, with
+  // zeros for the edges, give every edge the message of its source.
+  std::vector<wire_t> edge_zeros(dag.edges.size());
+  for (size_t k = 0; k < dag.edges.size(); ++k) {
+    edge_zeros[k] = circ.addConstOpGate(GateType::kConstMul, dag.edges[k], Ring(0));
+  }
+  std::vector<wire_t> diffs;
+  diffs.reserve(lanes * num_tuples);
+  for (size_t l = 0; l < lanes; ++l) {
+    for (size_t j = 0; j < num_vert; ++j) {
+      diffs.push_back(j == 0 ? msgs[l][0] : circ.addGate(GateType::kSub, msgs[l][j], msgs[l][j - 1]));
+    }
+    diffs.insert(diffs.end(), edge_zeros.begin(), edge_zeros.end());
+  }
+  auto src_order = addPermutation(circ, backend, dag.owner, diffs, perm_s);
+  auto propagated = addLanePrefixSumGates(circ, src_order, lanes);
+
+  // SRC TO DST
+  auto dst_order = addPermutation(circ, backend, dag.owner, propagated, perm_d);
+
+  std::vector<std::vector<wire_t>> res(lanes, std::vector<wire_t>(dag.num_own));
+  if (program.aggregation == GasAggregation::kSum) {
+    // GATHER: in destination order a vertex follows its in-edges, so the
+    // difference of the prefix sums at consecutive vertices, moved back to
+    // the DAG list, is the sum of the messages of a vertex and its in-edges.
+    auto sums = addPermutation(circ, backend, dag.owner, addLanePrefixSumGates(circ, dst_order, lanes), perm_v);
+
+    // APPLY
+    for (size_t l = 0; l < lanes; ++l) {
+      const auto* lane_sums = sums.data() + l * num_tuples;
+      for (size_t j = 0; j < dag.num_own; ++j) {
+        auto total = j == 0 ? lane_sums[0] : circ.addGate(GateType::kSub, lane_sums[j], lane_sums[j - 1]);
+        auto aggregate = circ.addGate(GateType::kSub, total, msgs[l][j]);
+        res[l][j] = program.apply ? program.apply(circ, l, first_own + j, values[l][j], aggregate) : aggregate;
+      }
+    }
+    return res;
+  }
+
+  // GATHER: the segments of the destination order end at the vertices, whose
+  // positions are secret, so a flag marking the vertices moves along with
+  // the messages, once for all lanes. So do corrections turning the message
+  // of a vertex into its value and adding the edge weights.
+  std::vector<wire_t> is_vertex(num_tuples);
+  for (size_t j = 0; j < num_vert; ++j) {
+    auto zero = circ.addConstOpGate(GateType::kConstMul, values[0][j], Ring(0));
+    is_vertex[j] = circ.addConstOpGate(GateType::kConstAdd, zero, Ring(1));
+  }
+  std::copy(edge_zeros.begin(), edge_zeros.end(), is_vertex.begin() + num_vert);
+  auto moved_is_vertex = addPermutation(circ, backend, dag.owner,
+                                        addPermutation(circ, backend, dag.owner, is_vertex, dag.perm_s), dag.perm_d);
+  if (program.scatter || program.edge_weights) {
+    std::vector<wire_t> corrections;
+    corrections.reserve(lanes * num_tuples);
+    for (size_t l = 0; l < lanes; ++l) {
+      for (size_t j = 0; j < num_vert; ++j) {
+        corrections.push_back(program.scatter ? circ.addGate(GateType::kSub, values[l][j], msgs[l][j])
+                                              : circ.addConstOpGate(GateType::kConstMul, values[l][j], Ring(0)));
+      }
+      const auto& edge_corrections = program.edge_weights ? dag.edges : edge_zeros;
+      corrections.insert(corrections.end(), edge_corrections.begin(), edge_corrections.end());
+    }
+    auto moved_corrections = addPermutation(
+        circ, backend, dag.owner, addPermutation(circ, backend, dag.owner, corrections, perm_s), perm_d);
+    for (size_t p = 0; p < dst_order.size(); ++p) {
+      dst_order[p] = circ.addGate(GateType::kAdd, dst_order[p], moved_corrections[p]);
+    }
+  }
+  std::vector<wire_t> starts(num_tuples);
+  if (num_tuples != 0) {
+    starts[0] = circ.addConstOpGate(GateType::kConstAdd,
+                                    circ.addConstOpGate(GateType::kConstMul, dst_order[0], Ring(0)), Ring(1));
+  }
+  for (size_t p = 1; p < num_tuples; ++p) { starts[p] = moved_is_vertex[p - 1]; }
+  std::vector<wire_t> lane_mins;
+  lane_mins.reserve(lanes * num_tuples);
+  for (size_t l = 0; l < lanes; ++l) {
+    auto mins = addSegmentedMinGates(
+        circ, std::vector<wire_t>(dst_order.begin() + l * num_tuples, dst_order.begin() + (l + 1) * num_tuples),
+        starts);
+    lane_mins.insert(lane_mins.end(), mins.begin(), mins.end());
+  }
+  auto mins = addPermutation(circ, backend, dag.owner, lane_mins, perm_v);
+
+  // APPLY
+  for (size_t l = 0; l < lanes; ++l) {
+    for (size_t j = 0; j < dag.num_own; ++j) {
+      auto aggregate = mins[l * num_tuples + j];
+      res[l][j] = program.apply ? program.apply(circ, l, first_own + j, values[l][j], aggregate) : aggregate;
+    }
+  }
+  return res;
+}
+};  // namespace
+
+std::vector<std::vector<int>> ownerPermutations(const std::vector<std::vector<int>>& perms, int pid, int owner) {
+  if (pid != 0) {
+    return {pid == owner ? perms.at(0) : std::vector<int>()};
+  }
+  std::vector<std::vector<int>> res(perms.size());
+  res.at(owner - 1) = perms[owner - 1];
+  return res;
+}
+
+std::vector<wire_t> addPrefixSumGates(common::utils::Circuit<Ring>& circ, const std::vector<wire_t>& input) {
+  size_t n = input.size();
+  std::vector<wire_t> res(n);
+  if (n == 0) { return res; }
+  auto block = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(n))));
+
+  // Prefix sums within blocks.
+  for (size_t begin = 0; begin < n; begin += block) {
+    res[begin] = input[begin];
+    for (size_t j = begin + 1; j < std::min(n, begin + block); ++j) {
+      res[j] = circ.addGate(GateType::kAdd, res[j - 1], input[j]);
+    }
+  }
+  // Every block is offset by the sum of the blocks before it.
+  wire_t offset = res[std::min(n, block) - 1];
+  for (size_t begin = block; begin < n; begin += block) {
+    size_t end = std::min(n, begin + block);
+    wire_t block_sum = res[end - 1];
+    for (size_t j = begin; j < end; ++j) {
+      res[j] = circ.addGate(GateType::kAdd, res[j], offset);
+    }
+    if (end < n) { offset = circ.addGate(GateType::kAdd, offset, block_sum); }
+  }
+  return res;
+}
+
+std::vector<wire_t> addGasIteration(common::utils::Circuit<Ring>& circ, const GasGraph& graph,
+                                    const GasProgram& program, const std::vector<wire_t>& vertices) {
+  return addGasIterationLanes(circ, graph, program, {vertices})[0];
+}
+
+std::vector<std::vector<wire_t>> addGasIterationLanes(common::utils::Circuit<Ring>& circ, const GasGraph& graph,
+                                                      const GasProgram& program,
+                                                      const std::vector<std::vector<wire_t>>& vertices) {
+  if (program.aggregation != GasAggregation::kSum && program.aggregation != GasAggregation::kMin) {
+    throw std::invalid_argument("Unsupported GAS aggregation.");
+  }
+  if (program.edge_weights && program.aggregation != GasAggregation::kMin) {
+    throw std::invalid_argument("Edge weights need min aggregation.");
+  }
+  if (graph.backend == GasBackend::kGraphiti && !graph.perm_g.empty()) {
+    throw std::invalid_argument("Graphiti has no vertex list decomposition.");
+  }
+  size_t lanes = vertices.size();
+  if (lanes == 0) {
+    throw std::invalid_argument("No lanes.");
+  }
+  size_t num_vert = vertices[0].size();
+  for (const auto& lane : vertices) {
+    if (lane.size() != num_vert) { throw std::invalid_argument("Lane size mismatch."); }
+  }
+  size_t num_dag_lists = graph.dag_lists.size();
+
+  // DECOMPOSE
+  std::vector<std::vector<wire_t>> decomposed;
+  if (!graph.perm_g.empty()) {
+    std::vector<wire_t> all_lanes;
+    all_lanes.reserve(lanes * num_vert);
+    for (const auto& lane : vertices) { all_lanes.insert(all_lanes.end(), lane.begin(), lane.end()); }
+    decomposed = circ.addMOGate(GateType::kAmortzdPnS, all_lanes, widenPermutations(graph.perm_g, lanes),
+                                static_cast<int>(num_dag_lists));
+  }
+
+  std::vector<std::vector<wire_t>> res(lanes);
+  for (auto& lane : res) { lane.reserve(num_vert); }
+  for (size_t i = 0; i < num_dag_lists; ++i) {
+    const auto& dag = graph.dag_lists[i];
+    if (dag.num_own > dag.num_vert || dag.num_vert > num_vert) {
+      throw std::invalid_argument("Invalid DAG list size.");
+    }
+    // SUB GRAPH GEN
+    const auto* values = &vertices;
+    std::vector<std::vector<wire_t>> permuted;
+    if (!decomposed.empty()) {
+      auto all_lanes = dag.pub_perm_g.empty()
+                           ? decomposed[i]
+                           : circ.addConstOpMGate(GateType::kPublicPerm, decomposed[i],
+                                                  widenPermutation(dag.pub_perm_g, lanes));
+      for (size_t l = 0; l < lanes; ++l) {
+        permuted.emplace_back(all_lanes.begin() + l * num_vert, all_lanes.begin() + (l + 1) * num_vert);
+      }
+      values = &permuted;
+    }
+    // COMBINE
+    auto owned = addDagListIteration(circ, graph.backend, dag, program, *values, res[0].size());
+    for (size_t l = 0; l < lanes; ++l) { res[l].insert(res[l].end(), owned[l].begin(), owned[l].end()); }
+  }
+  return res;
+}
+
+wire_t addConvergenceCheck(common::utils::Circuit<Ring>& circ, const std::vector<wire_t>& before,
+                           const std::vector<wire_t>& after, Ring threshold) {
+  if (before.size() != after.size() || before.empty()) {
+    throw std::invalid_argument("Mismatched convergence check inputs.");
+  }
+  if (threshold == 0 || threshold >= kGasInfinity) {
+    throw std::invalid_argument("Convergence threshold out of range.");
+  }
+  // |d| >= t iff t - 1 - d < 0 or d + t - 1 < 0, never both for t >= 1.
+  std::vector<wire_t> moved(after.size());
+  for (size_t i = 0; i < after.size(); ++i) {
+    auto up = circ.addConstOpGate(GateType::kConstAdd, circ.addGate(GateType::kSub, before[i], after[i]),
+                                  threshold - 1);
+    auto down = circ.addConstOpGate(GateType::kConstAdd, circ.addGate(GateType::kSub, after[i], before[i]),
+                                    threshold - 1);
+    moved[i] = circ.addGate(GateType::kAdd, circ.addGate(GateType::kLtz, up), circ.addGate(GateType::kLtz, down));
+  }
+  // Pairwise sums keep the local depth logarithmic.
+  while (moved.size() > 1) {
+    std::vector<wire_t> sums((moved.size() + 1) / 2);
+    for (size_t i = 0; i < moved.size() / 2; ++i) {
+      sums[i] = circ.addGate(GateType::kAdd, moved[2 * i], moved[2 * i + 1]);
+    }
+    if (moved.size() % 2 != 0) { sums.back() = moved.back(); }
+    moved = std::move(sums);
+  }
+  return circ.addGate(GateType::kEqz, moved[0]);
+}
+
+GasProgram unitPageRankProgram() {
+  GasProgram program;
+  program.apply = [](common::utils::Circuit<Ring>& circ, size_t /*lane*/, size_t /*vertex*/, wire_t /*value*/,
+                     wire_t aggregate) {
+    auto scaled = circ.addConstOpGate(GateType::kConstMul, aggregate, Ring(1));
+    return circ.addConstOpGate(GateType::kConstAdd, scaled, Ring(1));
+  };
+  return program;
+}
+
+GasProgram dampedPageRankProgram(double damping, std::vector<wire_t> inv_out_degree) {
+  if (damping <= 0 || damping >= 1) {
+    throw std::invalid_argument("Damping factor must be in (0, 1).");
+  }
+  GasProgram program;
+  program.apply = [damping, inv_out_degree = std::move(inv_out_degree)](
+                      common::utils::Circuit<Ring>& circ, size_t /*lane*/, size_t vertex, wire_t /*value*/,
+                      wire_t aggregate) {
+    auto damped = circ.addFixedConstMul(aggregate, damping, kPageRankWeightFraction);
+    auto rank = circ.addConstOpGate(GateType::kConstAdd, damped,
+                                    common::utils::toFixed(1 - damping, kPageRankFraction));
+    return circ.addFixedMul(rank, inv_out_degree.at(vertex), kPageRankWeightFraction);
+  };
+  return program;
+}
+
+GasProgram personalizedPageRankProgram(double damping, std::vector<wire_t> inv_out_degree,
+                                       std::vector<std::vector<wire_t>> teleport) {
+  if (damping <= 0 || damping >= 1) {
+    throw std::invalid_argument("Damping factor must be in (0, 1).");
+  }
+  GasProgram program;
+  program.apply = [damping, inv_out_degree = std::move(inv_out_degree), teleport = std::move(teleport)](
+                      common::utils::Circuit<Ring>& circ, size_t lane, size_t vertex, wire_t /*value*/,
+                      wire_t aggregate) {
+    auto damped = circ.addFixedConstMul(aggregate, damping, kPageRankWeightFraction);
+    auto restart = circ.addFixedConstMul(teleport.at(lane).at(vertex), 1 - damping, kPageRankWeightFraction);
+    auto rank = circ.addGate(GateType::kAdd, damped, restart);
+    return circ.addFixedMul(rank, inv_out_degree.at(vertex), kPageRankWeightFraction);
+  };
+  return program;
+}
+
+GasProgram bfsProgram() {
+  GasProgram program;
+  program.aggregation = GasAggregation::kMin;
+  program.scatter = [](common::utils::Circuit<Ring>& circ, wire_t value) {
+    return circ.addConstOpGate(GateType::kConstAdd, value, Ring(1));
+  };
+  return program;
+}
+
+GasProgram connectedComponentsProgram() {
+  GasProgram program;
+  program.aggregation = GasAggregation::kMin;
+  return program;
+}
+
+GasProgram ssspProgram() {
+  GasProgram program;
+  program.aggregation = GasAggregation::kMin;
+  program.edge_weights = true;
+  return program;
+}
+};  // namespace grasp
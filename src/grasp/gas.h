@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "../utils/circuit.h"
+#include "../utils/types.h"
+
+namespace grasp {
+using common::utils::Ring;
+
+// Protocol moving DAG lists between the orders of message passing.
+enum class GasBackend {
+  // Subgraphs held by the parties, permuted by their owner with kPermAndSh.
+  kGraSP,
+  // One DAG list of the whole graph, permuted with kShuffle.
+  kGraphiti
+};
+
+// Aggregation of the messages on the in-edges of a vertex.
+enum class GasAggregation {
+  kSum,
+  // Minimum, as signed values, of the messages and of the vertex value
+  // itself. The messages are compared by a segmented prefix minimum over the
+  // destination order, ceil(log2(n)) steps of n batched kLtz gates for a DAG
+  // list of n tuples.
+  kMin
+};
+
+// Secret permutation followed by an optional public one. 'secret' is in the
+// format of Circuit::addMGate: the permutation of the owner, or of every
+// party for the dealer.
+struct GasPermutation {
+  std::vector<std::vector<int>> secret;
+  std::vector<int> pub;
+};
+
+// DAG list of one subgraph: its vertices, in local ID order with the owned
+// ones first, followed by its edges. The permutations are those of
+// common::utils::SubgraphDag.
+struct GasDagList {
+  // Party permuting the DAG list with kPermAndSh, unused by kGraphiti.
+  int owner = 0;
+  size_t num_vert = 0;
+  // Vertices whose new values are kept.
+  size_t num_own = 0;
+  std::vector<common::utils::wire_t> edges;
+  // Public part of the permutation of the full vertex list to 'num_vert'
+  // vertices of this DAG list, unused without GasGraph::perm_g.
+  std::vector<int> pub_perm_g;
+  GasPermutation perm_s;
+  GasPermutation perm_d;
+  GasPermutation perm_v;
+};
+
+struct GasGraph {
+  GasBackend backend = GasBackend::kGraSP;
+  // Secret permutations of the kAmortzdPnS gate decomposing the full vertex
+  // list into the DAG lists, in the format of Circuit::addMOGate. If empty,
+  // a DAG list takes the first num_vert vertices of the full list.
+  std::vector<std::vector<int>> perm_g;
+  std::vector<GasDagList> dag_lists;
+};
+
+// Gather-apply-scatter program. Both functions add the gates computing
+// their result to the circuit and return its wire.
+struct GasProgram {
+  GasAggregation aggregation = GasAggregation::kSum;
+  // Message a vertex sends on its out-edges. The vertex value if empty.
+  std::function<common::utils::wire_t(common::utils::Circuit<Ring>&, common::utils::wire_t value)> scatter;
+  // New value of a vertex from its value and the aggregated messages.
+  // 'vertex' is the index of the vertex in the result of addGasIteration,
+  // and 'lane' the query of addGasIterationLanes, 0 for addGasIteration.
+  std::function<common::utils::wire_t(common::utils::Circuit<Ring>&, size_t lane, size_t vertex,
+                                      common::utils::wire_t value, common::utils::wire_t aggregate)>
+      apply;
+  // Add the edge wire of an edge to the message it carries, kMin only.
+  bool edge_weights = false;
+};
+
+// Permutations of a kPermAndSh gate of 'owner' from the permutations a
+// party holds: its own for parties, those of all parties for the dealer.
+// Only the owner's permutation is kept.
+std::vector<std::vector<int>> ownerPermutations(const std::vector<std::vector<int>>& perms, int pid, int owner);
+
+// Prefix sums of 'input' with local gates. Blocks of about sqrt(n) values
+// are summed in parallel and then offset, so the gates form O(sqrt(n))
+// sub-levels of local evaluation instead of a chain of n.
+std::vector<common::utils::wire_t> addPrefixSumGates(common::utils::Circuit<Ring>& circ,
+                                                     const std::vector<common::utils::wire_t>& input);
+
+// Add one iteration of 'program' on 'graph' to the circuit, 'vertices' being
+// the values of all vertices. Every DAG list propagates the messages of its
+// vertices to their out-edges, moves them to their destinations, aggregates
+// them and applies the program to its owned vertices only. Returns the new
+// values of the owned vertices of all DAG lists, in order.
+std::vector<common::utils::wire_t> addGasIteration(common::utils::Circuit<Ring>& circ, const GasGraph& graph,
+                                                   const GasProgram& program,
+                                                   const std::vector<common::utils::wire_t>& vertices);
+
+// addGasIteration for several queries on the same graph, vertices[l] being
+// the values of all vertices in lane l. The lanes are concatenated, so every
+// permutation gate serves all of them with the lane-wise extension of its
+// permutation, and the lanes share its rounds. Each lane keeps its own masks
+// in the preprocessing. Returns the new values of every lane.
+std::vector<std::vector<common::utils::wire_t>> addGasIterationLanes(
+    common::utils::Circuit<Ring>& circ, const GasGraph& graph, const GasProgram& program,
+    const std::vector<std::vector<common::utils::wire_t>>& vertices);
+
+// Wire that is 1 if |after[i] - before[i]| < threshold for all i, and 0
+// otherwise, e.g. to stop an iterative algorithm once it has converged.
+// Every value is compared in both directions by one batch of kLtz gates,
+// and the number of moved values, their OR, is compared to 0 by a single
+// kEqz gate. Values and threshold must stay below kGasInfinity.
+common::utils::wire_t addConvergenceCheck(common::utils::Circuit<Ring>& circ,
+                                          const std::vector<common::utils::wire_t>& before,
+                                          const std::vector<common::utils::wire_t>& after, Ring threshold);
+
+// Apply of the PageRank cost model of the benchmarks: aggregate * 1 + 1.
+GasProgram unitPageRankProgram();
+
+// Fractional bits of the vertex values of dampedPageRankProgram, and of its
+// damping factor and inverse out-degrees. Products are truncated right away,
+// so they have to stay below 2^(RINGSIZEBITS - 2): ranks below 2^(30 - 8 - 12)
+// = 1024.
+constexpr int kPageRankFraction = 8;
+constexpr int kPageRankWeightFraction = 12;
+
+// PageRank with damping factor 'damping' in fixed point. The value of vertex
+// v is its rank divided by its out-degree, the message it sends on every
+// out-edge, and inv_out_degree[v] holds 1 / out-degree with
+// kPageRankWeightFraction bits (0 for vertices without out-edges). Then
+//   rank = (1 - damping) + damping * aggregate
+//   value = rank * inv_out_degree[v]
+// which takes two truncation rounds per iteration.
+GasProgram dampedPageRankProgram(double damping, std::vector<common::utils::wire_t> inv_out_degree);
+
+// dampedPageRankProgram restarting at teleport[lane][v], the restart
+// probability of vertex v in query 'lane' with kPageRankFraction bits,
+// scaled like the ranks:
+//   rank = (1 - damping) * teleport + damping * aggregate
+GasProgram personalizedPageRankProgram(double damping, std::vector<common::utils::wire_t> inv_out_degree,
+                                       std::vector<std::vector<common::utils::wire_t>> teleport);
+
+// Distance of unreached vertices, and label bound, of the kMin programs
+// below. Values and edge weights have to stay below it, so that messages and
+// their differences stay in the signed range of the comparisons.
+constexpr Ring kGasInfinity = Ring(1) << 29;
+
+// Breadth-first search: the value of a vertex is its hop distance, 0 for the
+// sources and kGasInfinity for the others, and a vertex sends its distance
+// plus one. After k iterations the vertices within k hops have their
+// distance.
+GasProgram bfsProgram();
+
+// Label propagation: the value of a vertex is the smallest label among it and
+// the vertices reaching it, starting from distinct labels, e.g. the vertex
+// IDs. The weakly connected components of a directed graph need both
+// directions of its edges in the edge list.
+GasProgram connectedComponentsProgram();
+
+// Bellman-Ford single-source shortest paths: the value of a vertex is its
+// distance as in bfsProgram, and a vertex sends its distance plus the weight
+// of the edge, the edge wire.
+GasProgram ssspProgram();
+};  // namespace grasp
@@ -0,0 +1,47 @@
+#include "iterative_evaluator.h"
+
+#include <stdexcept>
+
+namespace grasp {
+
+IterativeEvaluator::IterativeEvaluator(OnlineEvaluator& eval, PreprocPool& pool,
+                                       const common::utils::LevelOrderedCircuit& circ,
+                                       std::vector<common::utils::wire_t> feedback_out,
+                                       std::vector<common::utils::wire_t> feedback_in)
+    : eval_(eval),
+      pool_(pool),
+      fp_(common::utils::fingerprint(circ)),
+      num_levels_(circ.gates_by_level.size()),
+      feedback_out_(std::move(feedback_out)),
+      feedback_in_(std::move(feedback_in)) {
+  if (feedback_out_.size() != feedback_in_.size()) {
+    throw std::invalid_argument("Feedback wire count mismatch.");
+  }
+}
+
+void IterativeEvaluator::step() {
+  if (iteration_ != 0) {
+    eval_.setPreproc(pool_.acquire(fp_));
+    eval_.copyWires(feedback_out_, feedback_in_);
+  }
+  for (size_t depth = 0; depth < num_levels_; ++depth) {
+    eval_.evaluateGatesAtDepth(depth);
+  }
+  iteration_++;
+}
+
+void IterativeEvaluator::run(int iterations) {
+  for (int it = 0; it < iterations; ++it) {
+    step();
+  }
+}
+
+int IterativeEvaluator::runUntilConverged(int max_iterations, common::utils::wire_t converged) {
+  for (int it = 0; it < max_iterations; ++it) {
+    step();
+    if (eval_.revealWires({converged})[0] == 1) { return it + 1; }
+  }
+  return max_iterations;
+}
+
+};  // namespace grasp
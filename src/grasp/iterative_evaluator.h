@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "online_evaluator.h"
+#include "preproc_pool.h"
+#include "../utils/circuit.h"
+
+namespace grasp {
+// Evaluates one iteration of an iterative algorithm, e.g. a message-passing
+// round, as many times as needed without regenerating the circuit. Before
+// every iteration but the first, the shares of the 'feedback_out' wires of
+// the previous iteration move to the 'feedback_in' input wires, and a fresh
+// preprocessing instance of the circuit is taken from the pool. Other input
+// wires keep their shares, so the caller only sets the inputs once.
+//
+// The evaluator must have been constructed with the preprocessing of the
+// first iteration, and the pool must hold one instance per later iteration.
+class IterativeEvaluator {
+  OnlineEvaluator& eval_;
+  PreprocPool& pool_;
+  uint64_t fp_;
+  size_t num_levels_;
+  std::vector<common::utils::wire_t> feedback_out_;
+  std::vector<common::utils::wire_t> feedback_in_;
+  int iteration_ = 0;
+
+ public:
+  IterativeEvaluator(OnlineEvaluator& eval, PreprocPool& pool, const common::utils::LevelOrderedCircuit& circ,
+                     std::vector<common::utils::wire_t> feedback_out, std::vector<common::utils::wire_t> feedback_in);
+
+  // Evaluate the next iteration.
+  void step();
+
+  // Evaluate 'iterations' more iterations.
+  void run(int iterations);
+
+  // Evaluate up to 'max_iterations' more iterations, stopping after the
+  // first one whose 'converged' wire reveals 1, see addConvergenceCheck.
+  // Only that bit is revealed, once per iteration. Returns the number of
+  // iterations evaluated.
+  int runUntilConverged(int max_iterations, common::utils::wire_t converged);
+
+  // Number of iterations evaluated so far.
+  [[nodiscard]] int iteration() const { return iteration_; }
+};
+};  // namespace grasp
@@ -5,33 +5,27 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <future>
 #include <thread>
 
 // #include "../utils/helpers.h"
 
 namespace grasp {
 
-// Static circuit template cache implementation.
-// These are lazily initialized on first use and shared across all preprocessing calls.
-const common::utils::LevelOrderedCircuit& OfflineEvaluator::getMultKCircuitTemplate() {
-  static const auto circuit = common::utils::Circuit<BoolRing>::generateMultK().orderGatesByLevel();
-  return circuit;
-}
-
-const common::utils::LevelOrderedCircuit& OfflineEvaluator::getPrefixORCircuitTemplate() {
-  static const auto circuit = common::utils::Circuit<BoolRing>::generateParaPrefixOR(2).orderGatesByLevel();
-  return circuit;
-}
 OfflineEvaluator::OfflineEvaluator(int nP, int my_id,
                                    std::shared_ptr<io::NetIOMP> network,
                                    common::utils::LevelOrderedCircuit circ,
-                                   int threads, int seed, int latency_ms)
+                                   int threads, int seed, int latency_ms, bool seed_compressed)
     : nP_(nP),
       id_(my_id),
-      rgen_(my_id, seed), 
+      rgen_(my_id, nP, seed), 
       network_(std::move(network)),
       circ_(std::move(circ)),
-      latency_usec_(latency_ms * 1000)
+      latency_usec_(latency_ms * 1000),
+      threads_(std::max(threads, 1)),
+      seed_compressed_(seed_compressed),
+      next_block_(0),
+      consume_perms_(true)
       // preproc_(circ.num_gates)
 
       { } // tpool_ = std::make_shared<ThreadPool>(threads); }
@@ -51,6 +45,38 @@ void OfflineEvaluator::randomShare(int nP, int pid, RandGenPool& rgen, AddShare<
   }
 }
 
+void OfflineEvaluator::randomShareVec(int nP, int pid, RandGenPool& rgen, std::vector<AddShare<Ring>>& share,
+                                      std::vector<TPShare<Ring>>& tpShare) {
+  // Vectors above this size are expanded by several threads; the generator
+  // is random access so the chunking does not change the values.
+  constexpr size_t kParallelChunk = 1 << 16;
+  size_t len = share.size();
+  std::vector<Ring> vals(len);
+  auto expand = [&](emp::PRG& prg) {
+    auto ctr = RandGenPool::fork(prg);
+    size_t num_chunks = (len + kParallelChunk - 1) / kParallelChunk;
+    #pragma omp parallel for if (num_chunks > 1)
+    for (size_t c = 0; c < num_chunks; ++c) {
+      size_t begin = c * kParallelChunk;
+      ctr.fill(begin, vals.data() + begin, std::min(kParallelChunk, len - begin));
+    }
+  };
+
+  if (pid == 0) {
+    for (size_t j = 0; j < len; ++j) {
+      share[j].pushValue(Ring(0));
+      tpShare[j].pushValues(Ring(0));
+    }
+    for (int i = 1; i <= nP; i++) {
+      expand(rgen.pi(i));
+      for (size_t j = 0; j < len; ++j) { tpShare[j].pushValues(vals[j]); }
+    }
+  } else {
+    expand(rgen.p0());
+    for (size_t j = 0; j < len; ++j) { share[j].pushValue(vals[j]); }
+  }
+}
+
 void OfflineEvaluator::randomShareSecret(int nP, int pid, RandGenPool& rgen,
                                          AddShare<Ring>& share, TPShare<Ring>& tpShare, Ring secret,
                                          std::vector<Ring>& rand_sh_sec, size_t& idx_rand_sh_sec) {
@@ -64,7 +90,7 @@ void OfflineEvaluator::randomShareSecret(int nP, int pid, RandGenPool& rgen,
       tpShare.pushValues(val);
       valn += val;
     }
-    valn = secret - val;
+    valn = secret - valn;
     tpShare.pushValues(valn);
     rand_sh_sec.push_back(valn);
   } else {
@@ -137,560 +163,430 @@ void OfflineEvaluator::generatePermAndShDeltaVector(int nP, int pid, RandGenPool
   }
 }
 
-void OfflineEvaluator::setWireMasksParty(const std::unordered_map<common::utils::wire_t, int>& input_pid_map, 
-                                         std::vector<Ring>& rand_sh_sec, std::vector<BoolRing>& b_rand_sh_sec,
-                                         std::vector<std::vector<Ring>>& delta_sh) {
-  size_t idx_rand_sh_sec = 0;
-  size_t idx_delta_sh = 0;
-  size_t b_idx_rand_sh_sec = 0;
-
+void OfflineEvaluator::setWireMasksParty(const std::unordered_map<common::utils::wire_t, int>& input_pid_map,
+                                         size_t range, RandGenPool& rgen, PreprocCorrections& corr,
+                                         PreprocCircuit<Ring>& preproc) {
   // Use cached boolean sub-circuit templates (shared across all invocations)
   // to avoid regenerating the same circuit topology for every gate or call.
   // This reduces memory churn and temporary allocations significantly.
-  const auto& multk_circ_template = getMultKCircuitTemplate();
-  const auto& prefixOR_circ_template = getPrefixORCircuitTemplate();
-
-  for (const auto& level : circ_.gates_by_level) {
-    for (const auto& gate : level) {
-      switch (gate->type) {
-        case common::utils::GateType::kInp: {
-          auto pregate = std::make_unique<PreprocInput<Ring>>();
-          auto pid = input_pid_map.at(gate->out);
-          pregate->pid = pid;
-          preproc_.gates[gate->out] = std::move(pregate);
-          break;
-        }
+  const auto& multk_circ_template = common::utils::multKCircuit(circ_.cmp_radix);
+  const auto& prefixOR_circ_template = common::utils::prefixORCircuit(circ_.cmp_radix);
+
+  size_t begin = range * kGateBlockSize;
+  size_t end = std::min(begin + kGateBlockSize, gates_flat_.size());
+  for (size_t gidx = begin; gidx < end; ++gidx) {
+    auto* gate = gates_flat_[gidx];
+    switch (gate->type) {
+      case common::utils::GateType::kInp: {
+        auto pregate = std::make_unique<PreprocInput<Ring>>();
+        auto pid = input_pid_map.at(gate->out);
+        pregate->pid = pid;
+        preproc.gates.at(gate->out) = std::move(pregate);
+        break;
+      }
 
-        case common::utils::GateType::kMul: {
-          AddShare<Ring> triple_a; // Holds one beaver triple share of a random value a
-          TPShare<Ring> tp_triple_a; // Holds all the beaver triple shares of a random value a
-          AddShare<Ring> triple_b; // Holds one beaver triple share of a random value b
-          TPShare<Ring> tp_triple_b; // Holds all the beaver triple shares of a random value b
-          AddShare<Ring> triple_c; // Holds one beaver triple share of c=a*b
-          TPShare<Ring> tp_triple_c; // Holds all the beaver triple shares of c=a*b
-          randomShare(nP_, id_, rgen_, triple_a, tp_triple_a);
-          randomShare(nP_, id_, rgen_, triple_b, tp_triple_b);
-          Ring tp_prod;
-          if (id_ == 0) { tp_prod = tp_triple_a.secret() * tp_triple_b.secret(); }
-          randomShareSecret(nP_, id_, rgen_, triple_c, tp_triple_c, tp_prod, rand_sh_sec, idx_rand_sh_sec);
-          preproc_.gates[gate->out] =
-              std::move(std::make_unique<PreprocMultGate<Ring>>(triple_a, tp_triple_a, triple_b, tp_triple_b, triple_c, tp_triple_c));
-          break;
-        }
+      case common::utils::GateType::kMul: {
+        AddShare<Ring> triple_a; // Holds one beaver triple share of a random value a
+        TPShare<Ring> tp_triple_a; // Holds all the beaver triple shares of a random value a
+        AddShare<Ring> triple_b; // Holds one beaver triple share of a random value b
+        TPShare<Ring> tp_triple_b; // Holds all the beaver triple shares of a random value b
+        AddShare<Ring> triple_c; // Holds one beaver triple share of c=a*b
+        TPShare<Ring> tp_triple_c; // Holds all the beaver triple shares of c=a*b
+        randomShare(nP_, id_, rgen, triple_a, tp_triple_a);
+        randomShare(nP_, id_, rgen, triple_b, tp_triple_b);
+        Ring tp_prod;
+        if (id_ == 0) { tp_prod = tp_triple_a.secret() * tp_triple_b.secret(); }
+        randomShareSecret(nP_, id_, rgen, triple_c, tp_triple_c, tp_prod, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        preproc.gates.at(gate->out) =
+            std::move(std::make_unique<PreprocMultGate<Ring>>(triple_a, tp_triple_a, triple_b, tp_triple_b, triple_c, tp_triple_c));
+        break;
+      }
 
-        case common::utils::GateType::kMul3: {
-          AddShare<Ring> share_a; // Holds one share of a random value a
-          TPShare<Ring> tp_share_a; // Holds all the shares of a random value a
-          AddShare<Ring> share_b; // Holds one share of a random value b
-          TPShare<Ring> tp_share_b; // Holds all the shares of a random value b
-          AddShare<Ring> share_c; // Holds one share of a random value c
-          TPShare<Ring> tp_share_c; // Holds all the shares of a random value c
-          AddShare<Ring> share_ab; // Holds one share of a*b
-          TPShare<Ring> tp_share_ab; // Holds all the shares of a*b
-          AddShare<Ring> share_bc; // Holds one share of b*c
-          TPShare<Ring> tp_share_bc; // Holds all the shares of b*c
-          AddShare<Ring> share_ca; // Holds one share of c*a
-          TPShare<Ring> tp_share_ca; // Holds all the shares of c*a
-          AddShare<Ring> share_abc; // Holds one share of a*b*c
-          TPShare<Ring> tp_share_abc; // Holds all the shares of a*b*c
-          randomShare(nP_, id_, rgen_, share_a, tp_share_a);
-          randomShare(nP_, id_, rgen_, share_b, tp_share_b);
-          randomShare(nP_, id_, rgen_, share_c, tp_share_c);
-          Ring tp_ab, tp_bc, tp_ca, tp_abc;
-          if (id_ == 0) {
-            tp_ab = tp_share_a.secret() * tp_share_b.secret();
-            tp_bc = tp_share_b.secret() * tp_share_c.secret();
-            tp_ca = tp_share_c.secret() * tp_share_a.secret();
-            tp_abc = tp_share_a.secret() * tp_share_b.secret() * tp_share_c.secret();
-          }
-          randomShareSecret(nP_, id_, rgen_, share_ab, tp_share_ab, tp_ab, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_bc, tp_share_bc, tp_bc, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_ca, tp_share_ca, tp_ca, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_abc, tp_share_abc, tp_abc, rand_sh_sec, idx_rand_sh_sec);
-          preproc_.gates[gate->out] =
-              std::move(std::make_unique<PreprocMult3Gate<Ring>>(share_a, tp_share_a, share_b, tp_share_b, share_c, tp_share_c,
-                                                                 share_ab, tp_share_ab, share_bc, tp_share_bc, share_ca, tp_share_ca,
-                                                                 share_abc, tp_share_abc));
-          break;
+      case common::utils::GateType::kMul3: {
+        AddShare<Ring> share_a; // Holds one share of a random value a
+        TPShare<Ring> tp_share_a; // Holds all the shares of a random value a
+        AddShare<Ring> share_b; // Holds one share of a random value b
+        TPShare<Ring> tp_share_b; // Holds all the shares of a random value b
+        AddShare<Ring> share_c; // Holds one share of a random value c
+        TPShare<Ring> tp_share_c; // Holds all the shares of a random value c
+        AddShare<Ring> share_ab; // Holds one share of a*b
+        TPShare<Ring> tp_share_ab; // Holds all the shares of a*b
+        AddShare<Ring> share_bc; // Holds one share of b*c
+        TPShare<Ring> tp_share_bc; // Holds all the shares of b*c
+        AddShare<Ring> share_ca; // Holds one share of c*a
+        TPShare<Ring> tp_share_ca; // Holds all the shares of c*a
+        AddShare<Ring> share_abc; // Holds one share of a*b*c
+        TPShare<Ring> tp_share_abc; // Holds all the shares of a*b*c
+        randomShare(nP_, id_, rgen, share_a, tp_share_a);
+        randomShare(nP_, id_, rgen, share_b, tp_share_b);
+        randomShare(nP_, id_, rgen, share_c, tp_share_c);
+        Ring tp_ab, tp_bc, tp_ca, tp_abc;
+        if (id_ == 0) {
+          tp_ab = tp_share_a.secret() * tp_share_b.secret();
+          tp_bc = tp_share_b.secret() * tp_share_c.secret();
+          tp_ca = tp_share_c.secret() * tp_share_a.secret();
+          tp_abc = tp_share_a.secret() * tp_share_b.secret() * tp_share_c.secret();
         }
+        randomShareSecret(nP_, id_, rgen, share_ab, tp_share_ab, tp_ab, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_bc, tp_share_bc, tp_bc, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_ca, tp_share_ca, tp_ca, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_abc, tp_share_abc, tp_abc, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        preproc.gates.at(gate->out) =
+            std::move(std::make_unique<PreprocMult3Gate<Ring>>(share_a, tp_share_a, share_b, tp_share_b, share_c, tp_share_c,
+                                                               share_ab, tp_share_ab, share_bc, tp_share_bc, share_ca, tp_share_ca,
+                                                               share_abc, tp_share_abc));
+        break;
+      }
 
-        case common::utils::GateType::kMul4: {
-          AddShare<Ring> share_a; // Holds one share of a random value a
-          TPShare<Ring> tp_share_a; // Holds all the shares of a random value a
-          AddShare<Ring> share_b; // Holds one of a random value b
-          TPShare<Ring> tp_share_b; // Holds all the shares of a random value b
-          AddShare<Ring> share_c; // Holds one share of a random value c
-          TPShare<Ring> tp_share_c; // Holds all the shares of a random value c
-          AddShare<Ring> share_d; // Holds one share of a random value d
-          TPShare<Ring> tp_share_d; // Holds all the shares of a random value d
-          AddShare<Ring> share_ab; // Holds one share of a*b
-          TPShare<Ring> tp_share_ab; // Holds all the shares of a*b
-          AddShare<Ring> share_ac; // Holds one share of a*c
-          TPShare<Ring> tp_share_ac; // Holds all the shares of a*c
-          AddShare<Ring> share_ad; // Holds one share of a*d
-          TPShare<Ring> tp_share_ad; // Holds all the shares of a*d
-          AddShare<Ring> share_bc; // Holds one share of b*c
-          TPShare<Ring> tp_share_bc; // Holds all the shares of b*c
-          AddShare<Ring> share_bd; // Holds one share of b*d
-          TPShare<Ring> tp_share_bd; // Holds all the shares of b*d
-          AddShare<Ring> share_cd; // Holds one share of c*d
-          TPShare<Ring> tp_share_cd; // Holds all the shares of c*d
-          AddShare<Ring> share_abc; // Holds one share of a*b*c
-          TPShare<Ring> tp_share_abc; // Holds all the shares of a*b*c
-          AddShare<Ring> share_abd; // Holds one share of a*b*d
-          TPShare<Ring> tp_share_abd; // Holds all the shares of a*b*d
-          AddShare<Ring> share_acd; // Holds one share of a*c*d
-          TPShare<Ring> tp_share_acd; // Holds all the shares of a*c*d
-          AddShare<Ring> share_bcd; // Holds one share of b*c*d
-          TPShare<Ring> tp_share_bcd; // Holds all the shares of b*c*d
-          AddShare<Ring> share_abcd; // Holds one share of a*b*c*d
-          TPShare<Ring> tp_share_abcd; // Holds all the shares of a*b*c*d
-          randomShare(nP_, id_, rgen_, share_a, tp_share_a);
-          randomShare(nP_, id_, rgen_, share_b, tp_share_b);
-          randomShare(nP_, id_, rgen_, share_c, tp_share_c);
-          randomShare(nP_, id_, rgen_, share_d, tp_share_d);
-          Ring tp_ab, tp_ac, tp_ad, tp_bc, tp_bd, tp_cd, tp_abc, tp_abd, tp_acd, tp_bcd, tp_abcd;
-          if (id_ == 0) {
-            tp_ab = tp_share_a.secret() * tp_share_b.secret();
-            tp_ac = tp_share_a.secret() * tp_share_c.secret();
-            tp_ad = tp_share_a.secret() * tp_share_d.secret();
-            tp_bc = tp_share_b.secret() * tp_share_c.secret();
-            tp_bd = tp_share_b.secret() * tp_share_d.secret();
-            tp_cd = tp_share_c.secret() * tp_share_d.secret();
-            tp_abc = tp_share_a.secret() * tp_share_b.secret() * tp_share_c.secret();
-            tp_abd = tp_share_a.secret() * tp_share_b.secret() * tp_share_d.secret();
-            tp_acd = tp_share_a.secret() * tp_share_c.secret() * tp_share_d.secret();
-            tp_bcd = tp_share_b.secret() * tp_share_c.secret() * tp_share_d.secret();
-            tp_abcd = tp_share_a.secret() * tp_share_b.secret() * tp_share_c.secret() * tp_share_d.secret();
-          }
-          randomShareSecret(nP_, id_, rgen_, share_ab, tp_share_ab, tp_ab, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_ac, tp_share_ac, tp_ac, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_ad, tp_share_ad, tp_ad, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_bc, tp_share_bc, tp_bc, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_bd, tp_share_bd, tp_bd, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_cd, tp_share_cd, tp_cd, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_abc, tp_share_abc, tp_abc, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_abd, tp_share_abd, tp_abd, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_acd, tp_share_acd, tp_acd, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_bcd, tp_share_bcd, tp_bcd, rand_sh_sec, idx_rand_sh_sec);
-          randomShareSecret(nP_, id_, rgen_, share_abcd, tp_share_abcd, tp_abcd, rand_sh_sec, idx_rand_sh_sec);
-          preproc_.gates[gate->out] =
-              std::move(std::make_unique<PreprocMult4Gate<Ring>>(share_a, tp_share_a, share_b, tp_share_b, share_c, tp_share_c,
-                                                                 share_d, tp_share_d, share_ab, tp_share_ab, share_ac, tp_share_ac,
-                                                                 share_ad, tp_share_ad, share_bc, tp_share_bc, share_bd, tp_share_bd,
-                                                                 share_cd, tp_share_cd, share_abc, tp_share_abc, share_abd, tp_share_abd,
-                                                                 share_acd, tp_share_acd, share_bcd, tp_share_bcd, share_abcd, tp_share_abcd));
-          break;
+      case common::utils::GateType::kMul4: {
+        AddShare<Ring> share_a; // Holds one share of a random value a
+        TPShare<Ring> tp_share_a; // Holds all the shares of a random value a
+        AddShare<Ring> share_b; // Holds one of a random value b
+        TPShare<Ring> tp_share_b; // Holds all the shares of a random value b
+        AddShare<Ring> share_c; // Holds one share of a random value c
+        TPShare<Ring> tp_share_c; // Holds all the shares of a random value c
+        AddShare<Ring> share_d; // Holds one share of a random value d
+        TPShare<Ring> tp_share_d; // Holds all the shares of a random value d
+        AddShare<Ring> share_ab; // Holds one share of a*b
+        TPShare<Ring> tp_share_ab; // Holds all the shares of a*b
+        AddShare<Ring> share_ac; // Holds one share of a*c
+        TPShare<Ring> tp_share_ac; // Holds all the shares of a*c
+        AddShare<Ring> share_ad; // Holds one share of a*d
+        TPShare<Ring> tp_share_ad; // Holds all the shares of a*d
+        AddShare<Ring> share_bc; // Holds one share of b*c
+        TPShare<Ring> tp_share_bc; // Holds all the shares of b*c
+        AddShare<Ring> share_bd; // Holds one share of b*d
+        TPShare<Ring> tp_share_bd; // Holds all the shares of b*d
+        AddShare<Ring> share_cd; // Holds one share of c*d
+        TPShare<Ring> tp_share_cd; // Holds all the shares of c*d
+        AddShare<Ring> share_abc; // Holds one share of a*b*c
+        TPShare<Ring> tp_share_abc; // Holds all the shares of a*b*c
+        AddShare<Ring> share_abd; // Holds one share of a*b*d
+        TPShare<Ring> tp_share_abd; // Holds all the shares of a*b*d
+        AddShare<Ring> share_acd; // Holds one share of a*c*d
+        TPShare<Ring> tp_share_acd; // Holds all the shares of a*c*d
+        AddShare<Ring> share_bcd; // Holds one share of b*c*d
+        TPShare<Ring> tp_share_bcd; // Holds all the shares of b*c*d
+        AddShare<Ring> share_abcd; // Holds one share of a*b*c*d
+        TPShare<Ring> tp_share_abcd; // Holds all the shares of a*b*c*d
+        randomShare(nP_, id_, rgen, share_a, tp_share_a);
+        randomShare(nP_, id_, rgen, share_b, tp_share_b);
+        randomShare(nP_, id_, rgen, share_c, tp_share_c);
+        randomShare(nP_, id_, rgen, share_d, tp_share_d);
+        Ring tp_ab, tp_ac, tp_ad, tp_bc, tp_bd, tp_cd, tp_abc, tp_abd, tp_acd, tp_bcd, tp_abcd;
+        if (id_ == 0) {
+          tp_ab = tp_share_a.secret() * tp_share_b.secret();
+          tp_ac = tp_share_a.secret() * tp_share_c.secret();
+          tp_ad = tp_share_a.secret() * tp_share_d.secret();
+          tp_bc = tp_share_b.secret() * tp_share_c.secret();
+          tp_bd = tp_share_b.secret() * tp_share_d.secret();
+          tp_cd = tp_share_c.secret() * tp_share_d.secret();
+          tp_abc = tp_share_a.secret() * tp_share_b.secret() * tp_share_c.secret();
+          tp_abd = tp_share_a.secret() * tp_share_b.secret() * tp_share_d.secret();
+          tp_acd = tp_share_a.secret() * tp_share_c.secret() * tp_share_d.secret();
+          tp_bcd = tp_share_b.secret() * tp_share_c.secret() * tp_share_d.secret();
+          tp_abcd = tp_share_a.secret() * tp_share_b.secret() * tp_share_c.secret() * tp_share_d.secret();
         }
+        randomShareSecret(nP_, id_, rgen, share_ab, tp_share_ab, tp_ab, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_ac, tp_share_ac, tp_ac, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_ad, tp_share_ad, tp_ad, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_bc, tp_share_bc, tp_bc, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_bd, tp_share_bd, tp_bd, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_cd, tp_share_cd, tp_cd, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_abc, tp_share_abc, tp_abc, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_abd, tp_share_abd, tp_abd, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_acd, tp_share_acd, tp_acd, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_bcd, tp_share_bcd, tp_bcd, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_abcd, tp_share_abcd, tp_abcd, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        preproc.gates.at(gate->out) =
+            std::move(std::make_unique<PreprocMult4Gate<Ring>>(share_a, tp_share_a, share_b, tp_share_b, share_c, tp_share_c,
+                                                               share_d, tp_share_d, share_ab, tp_share_ab, share_ac, tp_share_ac,
+                                                               share_ad, tp_share_ad, share_bc, tp_share_bc, share_bd, tp_share_bd,
+                                                               share_cd, tp_share_cd, share_abc, tp_share_abc, share_abd, tp_share_abd,
+                                                               share_acd, tp_share_acd, share_bcd, tp_share_bcd, share_abcd, tp_share_abcd));
+        break;
+      }
 
-        case common::utils::GateType::kDotprod: {
-          const auto* g = static_cast<common::utils::SIMDGate*>(gate.get());
-          auto vec_len = g->in1.size();
-          std::vector<AddShare<Ring>> triple_a_vec(vec_len);
-          std::vector<TPShare<Ring>> tp_triple_a_vec(vec_len);
-          std::vector<AddShare<Ring>> triple_b_vec(vec_len);
-          std::vector<TPShare<Ring>> tp_triple_b_vec(vec_len);
-          std::vector<AddShare<Ring>> triple_c_vec(vec_len);
-          std::vector<TPShare<Ring>> tp_triple_c_vec(vec_len);
-          for (int i = 0; i < vec_len; ++i) {
-            randomShare(nP_, id_, rgen_, triple_a_vec[i], tp_triple_a_vec[i]);
-            randomShare(nP_, id_, rgen_, triple_b_vec[i], tp_triple_b_vec[i]);
-            Ring tp_prod;
-            if (id_ == 0) { tp_prod = tp_triple_a_vec[i].secret() * tp_triple_b_vec[i].secret(); }
-            randomShareSecret(nP_, id_, rgen_, triple_c_vec[i], tp_triple_c_vec[i], tp_prod, rand_sh_sec, idx_rand_sh_sec);
-          }
-          preproc_.gates[gate->out] =
-              std::move(std::make_unique<PreprocDotpGate<Ring>>(triple_a_vec, tp_triple_a_vec, triple_b_vec, tp_triple_b_vec,
-                                                                triple_c_vec, tp_triple_c_vec));
-          break;
+      case common::utils::GateType::kDotprod: {
+        const auto* g = static_cast<common::utils::SIMDGate*>(gate);
+        auto vec_len = g->in1.size();
+        std::vector<AddShare<Ring>> triple_a_vec(vec_len);
+        std::vector<TPShare<Ring>> tp_triple_a_vec(vec_len);
+        std::vector<AddShare<Ring>> triple_b_vec(vec_len);
+        std::vector<TPShare<Ring>> tp_triple_b_vec(vec_len);
+        std::vector<AddShare<Ring>> triple_c_vec(vec_len);
+        std::vector<TPShare<Ring>> tp_triple_c_vec(vec_len);
+        randomShareVec(nP_, id_, rgen, triple_a_vec, tp_triple_a_vec);
+        randomShareVec(nP_, id_, rgen, triple_b_vec, tp_triple_b_vec);
+        for (int i = 0; i < vec_len; ++i) {
+          Ring tp_prod;
+          if (id_ == 0) { tp_prod = tp_triple_a_vec[i].secret() * tp_triple_b_vec[i].secret(); }
+          randomShareSecret(nP_, id_, rgen, triple_c_vec[i], tp_triple_c_vec[i], tp_prod, corr.rand_sh_sec, corr.idx_rand_sh_sec);
         }
+        preproc.gates.at(gate->out) =
+            std::move(std::make_unique<PreprocDotpGate<Ring>>(triple_a_vec, tp_triple_a_vec, triple_b_vec, tp_triple_b_vec,
+                                                              triple_c_vec, tp_triple_c_vec));
+        break;
+      }
 
-        case common::utils::GateType::kEqz: {
-          AddShare<Ring> share_r;
+      case common::utils::GateType::kEqz:
+      case common::utils::GateType::kLtz: {
+        // Comparison gates are preprocessed in groups of up to 64 at the first
+        // gate of the group, with one bit lane per gate.
+        auto group = cmp_groups_.find(gate->out);
+        if (group == cmp_groups_.end()) { break; }
+        size_t lanes = group->second;
+        bool is_ltz = gate->type == common::utils::GateType::kLtz;
+        auto pregate = std::make_unique<PreprocCmpGroup<Ring>>();
+        pregate->share_r.resize(lanes);
+        std::vector<Ring> tp_r(lanes, 0);
+        for (size_t l = 0; l < lanes; ++l) {
           TPShare<Ring> tp_share_r;
-          std::vector<AddShare<BoolRing>> share_r_bits(RINGSIZEBITS);
-          std::vector<TPShare<BoolRing>> tp_share_r_bits(RINGSIZEBITS);
-          randomShare(nP_, id_, rgen_, share_r, tp_share_r);
-          Ring tp_r = Ring(0);
-          std::vector<BoolRing> tp_r_bits(RINGSIZEBITS);
+          randomShare(nP_, id_, rgen, pregate->share_r[l], tp_share_r);
+          if (id_ == 0) { tp_r[l] = tp_share_r.secret(); }
+        }
+        pregate->share_r_bits.resize(RINGSIZEBITS);
+        for (int j = 0; j < RINGSIZEBITS; ++j) {
+          int bit = is_ltz ? RINGSIZEBITS - 1 - j : j;
+          uint64_t tp_r_bits = 0;
           if (id_ == 0) {
-            tp_r = tp_share_r.secret();
-            tp_r_bits = bitDecomposeTwo(tp_r);
-          }
-          for (int i = 0; i < RINGSIZEBITS; ++i) {
-            OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_r_bits[i], tp_share_r_bits[i], tp_r_bits[i],
-                                                    b_rand_sh_sec, b_idx_rand_sh_sec);
+            for (size_t l = 0; l < lanes; ++l) { tp_r_bits |= static_cast<uint64_t>((tp_r[l] >> bit) & 1) << l; }
           }
-          // preproc for multk gate (reuse template generated above)
-          const auto& multk_circ = multk_circ_template;
-          std::vector<preprocg_ptr_t<BoolRing>> multk_gates(multk_circ.num_gates);
-          for (const auto& multk_level : multk_circ.gates_by_level) {
-            for (auto& multk_gate : multk_level) {
-              switch (multk_gate->type) {
-                case common::utils::GateType::kInp:{
-                  auto pregate = std::make_unique<PreprocInput<BoolRing>>();
-                  pregate->pid = 0;
-                  multk_gates[multk_gate->out] = std::move(pregate);
-                  break;
-                }
-
-                case common::utils::GateType::kMul4:{
-                  AddShare<BoolRing> share_a;
-                  TPShare<BoolRing> tp_share_a;
-                  AddShare<BoolRing> share_b;
-                  TPShare<BoolRing> tp_share_b;
-                  AddShare<BoolRing> share_c;
-                  TPShare<BoolRing> tp_share_c;
-                  AddShare<BoolRing> share_d;
-                  TPShare<BoolRing> tp_share_d;
-                  AddShare<BoolRing> share_ab;
-                  TPShare<BoolRing> tp_share_ab;
-                  AddShare<BoolRing> share_ac;
-                  TPShare<BoolRing> tp_share_ac;
-                  AddShare<BoolRing> share_ad;
-                  TPShare<BoolRing> tp_share_ad;
-                  AddShare<BoolRing> share_bc;
-                  TPShare<BoolRing> tp_share_bc;
-                  AddShare<BoolRing> share_bd;
-                  TPShare<BoolRing> tp_share_bd;
-                  AddShare<BoolRing> share_cd;
-                  TPShare<BoolRing> tp_share_cd;
-                  AddShare<BoolRing> share_abc;
-                  TPShare<BoolRing> tp_share_abc;
-                  AddShare<BoolRing> share_abd;
-                  TPShare<BoolRing> tp_share_abd;
-                  AddShare<BoolRing> share_acd;
-                  TPShare<BoolRing> tp_share_acd;
-                  AddShare<BoolRing> share_bcd;
-                  TPShare<BoolRing> tp_share_bcd;
-                  AddShare<BoolRing> share_abcd;
-                  TPShare<BoolRing> tp_share_abcd;
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, share_a, tp_share_a);
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, share_b, tp_share_b);
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, share_c, tp_share_c);
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, share_d, tp_share_d);
-                  BoolRing tp_ab, tp_ac, tp_ad, tp_bc, tp_bd, tp_cd, tp_abc, tp_abd, tp_acd, tp_bcd, tp_abcd;
-                  if (id_ == 0) {
-                    tp_ab = tp_share_a.secret() * tp_share_b.secret();
-                    tp_ac = tp_share_a.secret() * tp_share_c.secret();
-                    tp_ad = tp_share_a.secret() * tp_share_d.secret();
-                    tp_bc = tp_share_b.secret() * tp_share_c.secret();
-                    tp_bd = tp_share_b.secret() * tp_share_d.secret();
-                    tp_cd = tp_share_c.secret() * tp_share_d.secret();
-                    tp_abc = tp_share_a.secret() * tp_share_b.secret() * tp_share_c.secret();
-                    tp_abd = tp_share_a.secret() * tp_share_b.secret() * tp_share_d.secret();
-                    tp_acd = tp_share_a.secret() * tp_share_c.secret() * tp_share_d.secret();
-                    tp_bcd = tp_share_b.secret() * tp_share_c.secret() * tp_share_d.secret();
-                    tp_abcd = tp_share_a.secret() * tp_share_b.secret() * tp_share_c.secret() * tp_share_d.secret();
-                  }
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_ab, tp_share_ab, tp_ab, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_ac, tp_share_ac, tp_ac, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_ad, tp_share_ad, tp_ad, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_bc, tp_share_bc, tp_bc, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_bd, tp_share_bd, tp_bd, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_cd, tp_share_cd, tp_cd, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_abc, tp_share_abc, tp_abc, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_abd, tp_share_abd, tp_abd, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_acd, tp_share_acd, tp_acd, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_bcd, tp_share_bcd, tp_bcd, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_abcd, tp_share_abcd, tp_abcd,
-                                                          b_rand_sh_sec, b_idx_rand_sh_sec);
-                  multk_gates[multk_gate->out] =
-                      std::move(std::make_unique<PreprocMult4Gate<BoolRing>>(share_a, tp_share_a, share_b, tp_share_b, share_c, tp_share_c,
-                                                                             share_d, tp_share_d, share_ab, tp_share_ab, share_ac, tp_share_ac,
-                                                                             share_ad, tp_share_ad, share_bc, tp_share_bc, share_bd,
-                                                                             tp_share_bd, share_cd, tp_share_cd, share_abc, tp_share_abc,
-                                                                             share_abd, tp_share_abd, share_acd, tp_share_acd, share_bcd,
-                                                                             tp_share_bcd, share_abcd, tp_share_abcd));
-                  break;
-                }
-              }
-            }
-          }
-          preproc_.gates[gate->out] =
-              std::make_unique<PreprocEqzGate<Ring>>(share_r, tp_share_r, share_r_bits, tp_share_r_bits, std::move(multk_gates));
-          break;
+          OfflineBoolEvaluator::randomShareSecretPacked(nP_, id_, rgen, pregate->share_r_bits[j], tp_r_bits,
+                                                        corr.packed_sec, corr.idx_packed_sec);
         }
-
-        case common::utils::GateType::kLtz: {
-          AddShare<Ring> share_r;
-          TPShare<Ring> tp_share_r;
-          std::vector<AddShare<BoolRing>> share_r_bits(RINGSIZEBITS);
-          std::vector<TPShare<BoolRing>> tp_share_r_bits(RINGSIZEBITS);
-          randomShare(nP_, id_, rgen_, share_r, tp_share_r);
-          Ring tp_r = Ring(0);
-          std::vector<BoolRing> tp_r_bits(RINGSIZEBITS);
+        pregate->share_mask.resize(lanes);
+        uint64_t tp_mask_bits = 0;
+        for (size_t l = 0; l < lanes; ++l) {
+          AddShare<Ring> share_m;
+          TPShare<Ring> tp_share_m;
+          randomShare(nP_, id_, rgen, share_m, tp_share_m);
+          Ring tp_mask = 0;
           if (id_ == 0) {
-            tp_r = tp_share_r.secret();
-            tp_r_bits = bitDecomposeTwo(tp_r);
-            std::reverse(tp_r_bits.begin(), tp_r_bits.end());
-          }
-          for (int i = 0; i < RINGSIZEBITS; ++i) {
-            OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_r_bits[i], tp_share_r_bits[i], tp_r_bits[i],
-                                                    b_rand_sh_sec, b_idx_rand_sh_sec);
+            tp_mask = tp_share_m.secret() & 1;
+            tp_mask_bits |= static_cast<uint64_t>(tp_mask) << l;
           }
-          // preproc for prefixOR gate (reuse template generated above)
-          const auto& prefixOR_circ = prefixOR_circ_template;
-          std::vector<preprocg_ptr_t<BoolRing>> prefixOR_gates(prefixOR_circ.num_gates);
-          for (const auto& prefixOR_level : prefixOR_circ.gates_by_level) {
-            for (auto& prefixOR_gate : prefixOR_level) {
-              switch (prefixOR_gate->type) {
-                case common::utils::GateType::kInp: {
-                  auto pregate = std::make_unique<PreprocInput<BoolRing>>();
-                  pregate->pid = 0;
-                  prefixOR_gates[prefixOR_gate->out] = std::move(pregate);
-                  break;
-                }
-
-                case common::utils::GateType::kMul: {
-                  AddShare<BoolRing> triple_a;
-                  TPShare<BoolRing> tp_triple_a;
-                  AddShare<BoolRing> triple_b;
-                  TPShare<BoolRing> tp_triple_b;
-                  AddShare<BoolRing> triple_c;
-                  TPShare<BoolRing> tp_triple_c;
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, triple_a, tp_triple_a);
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, triple_b, tp_triple_b);
-                  BoolRing tp_prod;
-                  if (id_ == 0) { tp_prod = tp_triple_a.secret() * tp_triple_b.secret(); }
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, triple_c, tp_triple_c, tp_prod, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  prefixOR_gates[prefixOR_gate->out] =
-                      std::move(std::make_unique<PreprocMultGate<BoolRing>>(triple_a, tp_triple_a, triple_b, tp_triple_b,
-                                                                            triple_c, tp_triple_c));
-                  break;
-                }
-
-                case common::utils::GateType::kMul3: {
-                  AddShare<BoolRing> share_a;
-                  TPShare<BoolRing> tp_share_a;
-                  AddShare<BoolRing> share_b;
-                  TPShare<BoolRing> tp_share_b;
-                  AddShare<BoolRing> share_c;
-                  TPShare<BoolRing> tp_share_c;
-                  AddShare<BoolRing> share_ab;
-                  TPShare<BoolRing> tp_share_ab;
-                  AddShare<BoolRing> share_bc;
-                  TPShare<BoolRing> tp_share_bc;
-                  AddShare<BoolRing> share_ca;
-                  TPShare<BoolRing> tp_share_ca;
-                  AddShare<BoolRing> share_abc;
-                  TPShare<BoolRing> tp_share_abc;
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, share_a, tp_share_a);
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, share_b, tp_share_b);
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, share_c, tp_share_c);
-                  BoolRing tp_ab, tp_bc, tp_ca, tp_abc;
-                  if (id_ == 0) {
-                    tp_ab = tp_share_a.secret() * tp_share_b.secret();
-                    tp_bc = tp_share_b.secret() * tp_share_c.secret();
-                    tp_ca = tp_share_c.secret() * tp_share_a.secret();
-                    tp_abc = tp_share_a.secret() * tp_share_b.secret() * tp_share_c.secret();
-                  }
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_ab, tp_share_ab, tp_ab, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_bc, tp_share_bc, tp_bc, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_ca, tp_share_ca, tp_ca, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_abc, tp_share_abc, tp_abc, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  prefixOR_gates[prefixOR_gate->out] =
-                      std::move(std::make_unique<PreprocMult3Gate<BoolRing>>(share_a, tp_share_a, share_b, tp_share_b, share_c, tp_share_c,
-                                                                             share_ab, tp_share_ab, share_bc, tp_share_bc,
-                                                                             share_ca, tp_share_ca, share_abc, tp_share_abc));
-                  break;
-                }
-
-                case common::utils::GateType::kMul4:{
-                  AddShare<BoolRing> share_a;
-                  TPShare<BoolRing> tp_share_a;
-                  AddShare<BoolRing> share_b;
-                  TPShare<BoolRing> tp_share_b;
-                  AddShare<BoolRing> share_c;
-                  TPShare<BoolRing> tp_share_c;
-                  AddShare<BoolRing> share_d;
-                  TPShare<BoolRing> tp_share_d;
-                  AddShare<BoolRing> share_ab;
-                  TPShare<BoolRing> tp_share_ab;
-                  AddShare<BoolRing> share_ac;
-                  TPShare<BoolRing> tp_share_ac;
-                  AddShare<BoolRing> share_ad;
-                  TPShare<BoolRing> tp_share_ad;
-                  AddShare<BoolRing> share_bc;
-                  TPShare<BoolRing> tp_share_bc;
-                  AddShare<BoolRing> share_bd;
-                  TPShare<BoolRing> tp_share_bd;
-                  AddShare<BoolRing> share_cd;
-                  TPShare<BoolRing> tp_share_cd;
-                  AddShare<BoolRing> share_abc;
-                  TPShare<BoolRing> tp_share_abc;
-                  AddShare<BoolRing> share_abd;
-                  TPShare<BoolRing> tp_share_abd;
-                  AddShare<BoolRing> share_acd;
-                  TPShare<BoolRing> tp_share_acd;
-                  AddShare<BoolRing> share_bcd;
-                  TPShare<BoolRing> tp_share_bcd;
-                  AddShare<BoolRing> share_abcd;
-                  TPShare<BoolRing> tp_share_abcd;
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, share_a, tp_share_a);
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, share_b, tp_share_b);
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, share_c, tp_share_c);
-                  OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, share_d, tp_share_d);
-                  BoolRing tp_ab, tp_ac, tp_ad, tp_bc, tp_bd, tp_cd, tp_abc, tp_abd, tp_acd, tp_bcd, tp_abcd;
-                  if (id_ == 0) {
-                    tp_ab = tp_share_a.secret() * tp_share_b.secret();
-                    tp_ac = tp_share_a.secret() * tp_share_c.secret();
-                    tp_ad = tp_share_a.secret() * tp_share_d.secret();
-                    tp_bc = tp_share_b.secret() * tp_share_c.secret();
-                    tp_bd = tp_share_b.secret() * tp_share_d.secret();
-                    tp_cd = tp_share_c.secret() * tp_share_d.secret();
-                    tp_abc = tp_share_a.secret() * tp_share_b.secret() * tp_share_c.secret();
-                    tp_abd = tp_share_a.secret() * tp_share_b.secret() * tp_share_d.secret();
-                    tp_acd = tp_share_a.secret() * tp_share_c.secret() * tp_share_d.secret();
-                    tp_bcd = tp_share_b.secret() * tp_share_c.secret() * tp_share_d.secret();
-                    tp_abcd = tp_share_a.secret() * tp_share_b.secret() * tp_share_c.secret() * tp_share_d.secret();
-                  }
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_ab, tp_share_ab, tp_ab, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_ac, tp_share_ac, tp_ac, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_ad, tp_share_ad, tp_ad, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_bc, tp_share_bc, tp_bc, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_bd, tp_share_bd, tp_bd, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_cd, tp_share_cd, tp_cd, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_abc, tp_share_abc, tp_abc, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_abd, tp_share_abd, tp_abd, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_acd, tp_share_acd, tp_acd, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_bcd, tp_share_bcd, tp_bcd, b_rand_sh_sec, b_idx_rand_sh_sec);
-                  OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, share_abcd, tp_share_abcd, tp_abcd,
-                                                          b_rand_sh_sec, b_idx_rand_sh_sec);
-                  prefixOR_gates[prefixOR_gate->out] =
-                      std::move(std::make_unique<PreprocMult4Gate<BoolRing>>(share_a, tp_share_a, share_b, tp_share_b, share_c, tp_share_c,
-                                                                             share_d, tp_share_d, share_ab, tp_share_ab, share_ac, tp_share_ac,
-                                                                             share_ad, tp_share_ad, share_bc, tp_share_bc, share_bd,
-                                                                             tp_share_bd, share_cd, tp_share_cd, share_abc, tp_share_abc,
-                                                                             share_abd, tp_share_abd, share_acd, tp_share_acd, share_bcd,
-                                                                             tp_share_bcd, share_abcd, tp_share_abcd));
-                  break;
-                }
-
-                case common::utils::GateType::kDotprod: {
-                  const auto* g = static_cast<common::utils::SIMDGate*>(prefixOR_gate.get());
-                  auto vec_len = g->in1.size();
-                  std::vector<AddShare<BoolRing>> triple_a_vec(vec_len);
-                  std::vector<TPShare<BoolRing>> tp_triple_a_vec(vec_len);
-                  std::vector<AddShare<BoolRing>> triple_b_vec(vec_len);
-                  std::vector<TPShare<BoolRing>> tp_triple_b_vec(vec_len);
-                  std::vector<AddShare<BoolRing>> triple_c_vec(vec_len);
-                  std::vector<TPShare<BoolRing>> tp_triple_c_vec(vec_len);
-                  for (int i = 0; i < vec_len; ++i) {
-                    OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, triple_a_vec[i], tp_triple_a_vec[i]);
-                    OfflineBoolEvaluator::randomShare(nP_, id_, rgen_, triple_b_vec[i], tp_triple_b_vec[i]);
-                    BoolRing tp_prod;
-                    if (id_ == 0) { tp_prod = tp_triple_a_vec[i].secret() * tp_triple_b_vec[i].secret(); }
-                    OfflineBoolEvaluator::randomShareSecret(nP_, id_, rgen_, triple_c_vec[i], tp_triple_c_vec[i], tp_prod,
-                                                            b_rand_sh_sec, b_idx_rand_sh_sec);
-                  }
-                  prefixOR_gates[prefixOR_gate->out] =
-                      std::move(std::make_unique<PreprocDotpGate<BoolRing>>(triple_a_vec, tp_triple_a_vec, triple_b_vec, tp_triple_b_vec,
-                                                                            triple_c_vec, tp_triple_c_vec));
-                  break;
-                }
-              }
-            }
-          }
-          preproc_.gates[gate->out] =
-              std::make_unique<PreprocLtzGate<Ring>>(share_r, tp_share_r, share_r_bits, tp_share_r_bits, std::move(prefixOR_gates));
-          break;
+          TPShare<Ring> tp_share_mask;
+          randomShareSecret(nP_, id_, rgen, pregate->share_mask[l], tp_share_mask, tp_mask, corr.rand_sh_sec,
+                            corr.idx_rand_sh_sec);
         }
+        OfflineBoolEvaluator::randomShareSecretPacked(nP_, id_, rgen, pregate->share_mask_bits, tp_mask_bits,
+                                                      corr.packed_sec, corr.idx_packed_sec);
+        // preproc for the multk or prefixOR circuit (reuse template generated above)
+        const auto& bool_circ = is_ltz ? prefixOR_circ_template : multk_circ_template;
+        pregate->bool_preproc = OfflineBoolEvaluator::packedPreproc(nP_, id_, rgen, bool_circ, lanes,
+                                                                    corr.packed_sec, corr.idx_packed_sec);
+        preproc.gates.at(gate->out) = std::move(pregate);
+        break;
+      }
 
-        case common::utils::GateType::kShuffle: {
-          auto *shuffle_g = static_cast<common::utils::SIMDOGate *>(gate.get());
-          auto vec_size = shuffle_g->in.size();
-          std::vector<AddShare<Ring>> a(vec_size); // Randomly sampled vector
-          std::vector<TPShare<Ring>> tp_a(vec_size); // Randomly sampled vector
-          std::vector<AddShare<Ring>> b(vec_size); // Randomly sampled vector
-          std::vector<TPShare<Ring>> tp_b(vec_size); // Randomly sampled vector
-          std::vector<AddShare<Ring>> c(vec_size); // Randomly sampled vector
-          std::vector<TPShare<Ring>> tp_c(vec_size); // Randomly sampled vector
-          for (int i = 0; i < vec_size; i++) {
-            randomShare(nP_, id_, rgen_, a[i], tp_a[i]);
-            randomShare(nP_, id_, rgen_, b[i], tp_b[i]);
-            randomShare(nP_, id_, rgen_, c[i], tp_c[i]);
-          }
+      case common::utils::GateType::kTrunc: {
+        const auto* g = static_cast<common::utils::TruncGate*>(gate);
+        AddShare<Ring> share_r;
+        TPShare<Ring> tp_share_r;
+        AddShare<Ring> share_r_hi;
+        TPShare<Ring> tp_share_r_hi;
+        AddShare<Ring> share_r_msb;
+        TPShare<Ring> tp_share_r_msb;
+        randomShare(nP_, id_, rgen, share_r, tp_share_r);
+        Ring tp_r_hi = 0;
+        Ring tp_r_msb = 0;
+        if (id_ == 0) {
+          tp_r_hi = tp_share_r.secret() >> g->shift;
+          tp_r_msb = tp_share_r.secret() >> (RINGSIZEBITS - 1);
+        }
+        randomShareSecret(nP_, id_, rgen, share_r_hi, tp_share_r_hi, tp_r_hi, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        randomShareSecret(nP_, id_, rgen, share_r_msb, tp_share_r_msb, tp_r_msb, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        preproc.gates.at(gate->out) =
+            std::move(std::make_unique<PreprocTruncGate<Ring>>(share_r, tp_share_r, share_r_hi, tp_share_r_hi,
+                                                               share_r_msb, tp_share_r_msb));
+        break;
+      }
 
-          std::vector<int> pi; // Randomly sampled permutation using HP
-          std::vector<std::vector<int>> tp_pi_all; // Randomly sampled permutations of all parties using HP
-          if (id_ != 0) {
+      case common::utils::GateType::kShuffle: {
+        auto *shuffle_g = static_cast<common::utils::SIMDOGate *>(gate);
+        auto vec_size = shuffle_g->in.size();
+        std::vector<AddShare<Ring>> a(vec_size); // Randomly sampled vector
+        std::vector<TPShare<Ring>> tp_a(vec_size); // Randomly sampled vector
+        std::vector<AddShare<Ring>> b(vec_size); // Randomly sampled vector
+        std::vector<TPShare<Ring>> tp_b(vec_size); // Randomly sampled vector
+        std::vector<AddShare<Ring>> c(vec_size); // Randomly sampled vector
+        std::vector<TPShare<Ring>> tp_c(vec_size); // Randomly sampled vector
+        randomShareVec(nP_, id_, rgen, a, tp_a);
+        randomShareVec(nP_, id_, rgen, b, tp_b);
+        randomShareVec(nP_, id_, rgen, c, tp_c);
+
+        std::vector<int> pi; // Randomly sampled permutation using HP
+        std::vector<std::vector<int>> tp_pi_all; // Randomly sampled permutations of all parties using HP
+        if (id_ != 0) {
+          if (consume_perms_) {
             pi = std::move(shuffle_g->permutation[0]);
           } else {
+            pi = shuffle_g->permutation[0];
+          }
+        } else {
+          if (consume_perms_) {
             tp_pi_all = std::move(shuffle_g->permutation);
+          } else {
+            tp_pi_all = shuffle_g->permutation;
           }
-
-          std::vector<int> pi_common(vec_size); // Common random permutation held by all parties except HP. HP holds dummy values
-          if (id_ != 0) { randomPermutation(nP_, id_, rgen_, pi_common, vec_size); }
-
-          std::vector<AddShare<Ring>> delta(vec_size); // Delta vector only held by the last party. Dummy values for the other parties
-          generateShuffleDeltaVector(nP_, id_, rgen_, delta, tp_a, tp_b, tp_c, tp_pi_all, vec_size, rand_sh_sec, idx_rand_sh_sec);
-          preproc_.gates[gate->out] =
-              std::move(std::make_unique<PreprocShuffleGate<Ring>>(a, tp_a, b, tp_b, c, tp_c, delta, pi, tp_pi_all, pi_common));
-          break;
         }
 
-        case common::utils::GateType::kPermAndSh: {
-          auto *permAndSh_g = static_cast<common::utils::SIMDOGate *>(gate.get());
-          auto vec_size = permAndSh_g->in.size();
-          std::vector<AddShare<Ring>> a(vec_size); // Randomly sampled vector
-          std::vector<TPShare<Ring>> tp_a(vec_size); // Randomly sampled vector
-          std::vector<AddShare<Ring>> b(vec_size); // Randomly sampled vector
-          std::vector<TPShare<Ring>> tp_b(vec_size); // Randomly sampled vector
-          for (int i = 0; i < vec_size; i++) {
-            randomShare(nP_, id_, rgen_, a[i], tp_a[i]);
-            randomShare(nP_, id_, rgen_, b[i], tp_b[i]);
-          }
+        std::vector<int> pi_common(vec_size); // Common random permutation held by all parties except HP. HP holds dummy values
+        if (id_ != 0) { randomPermutation(nP_, id_, rgen, pi_common, vec_size); }
+
+        std::vector<AddShare<Ring>> delta(vec_size); // Delta vector only held by the last party. Dummy values for the other parties
+        generateShuffleDeltaVector(nP_, id_, rgen, delta, tp_a, tp_b, tp_c, tp_pi_all, vec_size, corr.rand_sh_sec, corr.idx_rand_sh_sec);
+        preproc.gates.at(gate->out) =
+            std::move(std::make_unique<PreprocShuffleGate<Ring>>(a, tp_a, b, tp_b, c, tp_c, delta, pi, tp_pi_all, pi_common));
+        break;
+      }
 
-          std::vector<int> pi; // Randomly sampled permutation using HP
-          std::vector<std::vector<int>> tp_pi_all; // Randomly sampled permutation of gate owner party using HP.
-          if (id_ != 0) {
+      case common::utils::GateType::kPermAndSh: {
+        auto *permAndSh_g = static_cast<common::utils::SIMDOGate *>(gate);
+        auto vec_size = permAndSh_g->in.size();
+        std::vector<AddShare<Ring>> a(vec_size); // Randomly sampled vector
+        std::vector<TPShare<Ring>> tp_a(vec_size); // Randomly sampled vector
+        std::vector<AddShare<Ring>> b(vec_size); // Randomly sampled vector
+        std::vector<TPShare<Ring>> tp_b(vec_size); // Randomly sampled vector
+        randomShareVec(nP_, id_, rgen, a, tp_a);
+        randomShareVec(nP_, id_, rgen, b, tp_b);
+
+        std::vector<int> pi; // Randomly sampled permutation using HP
+        std::vector<std::vector<int>> tp_pi_all; // Randomly sampled permutation of gate owner party using HP.
+        if (id_ != 0) {
+          if (consume_perms_) {
             pi = std::move(permAndSh_g->permutation[0]);
           } else {
+            pi = permAndSh_g->permutation[0];
+          }
+        } else {
+          if (consume_perms_) {
             tp_pi_all = std::move(permAndSh_g->permutation);
+          } else {
+            tp_pi_all = permAndSh_g->permutation;
           }
-
-          std::vector<int> pi_common(vec_size); // Common random permutation held by all parties except HP. HP holds dummy values
-          if (id_ != 0) { randomPermutation(nP_, id_, rgen_, pi_common, vec_size); }
-
-          std::vector<AddShare<Ring>> delta(vec_size); // Delta vector only held by the gate owner party. Dummy values for the other parties
-          generatePermAndShDeltaVector(nP_, id_, rgen_, gate->owner, delta, tp_a, tp_b,
-                                       tp_pi_all[gate->owner - 1], vec_size, delta_sh[gate->owner - 1], idx_delta_sh);
-          preproc_.gates[gate->out] =
-              std::move(std::make_unique<PreprocPermAndShGate<Ring>>(a, tp_a, b, tp_b, delta, pi, tp_pi_all, pi_common));
-          break;
         }
 
-        case common::utils::GateType::kAmortzdPnS: {
-          auto *amortzdPnS_g = static_cast<common::utils::SIMDMOGate *>(gate.get());
-          auto vec_size = amortzdPnS_g->in.size();
-          std::vector<AddShare<Ring>> a(vec_size); // Randomly sampled vector
-          std::vector<TPShare<Ring>> tp_a(vec_size); // Randomly sampled vector
-          std::vector<AddShare<Ring>> b(vec_size); // Randomly sampled vector
-          std::vector<TPShare<Ring>> tp_b(vec_size); // Randomly sampled vector
-          for (int i = 0; i < vec_size; i++) {
-            randomShare(nP_, id_, rgen_, a[i], tp_a[i]);
-            randomShare(nP_, id_, rgen_, b[i], tp_b[i]);
-          }
+        std::vector<int> pi_common(vec_size); // Common random permutation held by all parties except HP. HP holds dummy values
+        if (id_ != 0) { randomPermutation(nP_, id_, rgen, pi_common, vec_size); }
 
-          std::vector<int> pi; // Randomly sampled permutation using HP
-          std::vector<std::vector<int>> tp_pi_all; // Randomly sampled permutations of all parties using HP
-          if (id_ != 0) {
+        std::vector<AddShare<Ring>> delta(vec_size); // Delta vector only held by the gate owner party. Dummy values for the other parties
+        generatePermAndShDeltaVector(nP_, id_, rgen, gate->owner, delta, tp_a, tp_b,
+                                     tp_pi_all[gate->owner - 1], vec_size, corr.delta_sh[gate->owner - 1], corr.idx_delta_sh);
+        preproc.gates.at(gate->out) =
+            std::move(std::make_unique<PreprocPermAndShGate<Ring>>(a, tp_a, b, tp_b, delta, pi, tp_pi_all, pi_common));
+        break;
+      }
+
+      case common::utils::GateType::kAmortzdPnS: {
+        auto *amortzdPnS_g = static_cast<common::utils::SIMDMOGate *>(gate);
+        auto vec_size = amortzdPnS_g->in.size();
+        std::vector<AddShare<Ring>> a(vec_size); // Randomly sampled vector
+        std::vector<TPShare<Ring>> tp_a(vec_size); // Randomly sampled vector
+        std::vector<AddShare<Ring>> b(vec_size); // Randomly sampled vector
+        std::vector<TPShare<Ring>> tp_b(vec_size); // Randomly sampled vector
+        randomShareVec(nP_, id_, rgen, a, tp_a);
+        randomShareVec(nP_, id_, rgen, b, tp_b);
+
+        std::vector<int> pi; // Randomly sampled permutation using HP
+        std::vector<std::vector<int>> tp_pi_all; // Randomly sampled permutations of all parties using HP
+        if (id_ != 0) {
+          if (consume_perms_) {
             pi = std::move(amortzdPnS_g->permutation[0]);
           } else {
+            pi = amortzdPnS_g->permutation[0];
+          }
+        } else {
+          if (consume_perms_) {
             tp_pi_all = std::move(amortzdPnS_g->permutation);
+          } else {
+            tp_pi_all = amortzdPnS_g->permutation;
           }
+        }
+
+        std::vector<int> pi_common(vec_size); // Common random permutation held by all parties except HP. HP holds dummy values
+        if (id_ != 0) { randomPermutation(nP_, id_, rgen, pi_common, vec_size); }
 
-          std::vector<int> pi_common(vec_size); // Common random permutation held by all parties except HP. HP holds dummy values
-          if (id_ != 0) { randomPermutation(nP_, id_, rgen_, pi_common, vec_size); }
+        std::vector<AddShare<Ring>> delta(vec_size); // Delta vector only held by all parties for their respective permutation
+        for (int pid = 1; pid <= nP_; ++pid) {
+          generatePermAndShDeltaVector(nP_, id_, rgen, pid, delta, tp_a, tp_b,
+                                       tp_pi_all[pid - 1], vec_size, corr.delta_sh[pid - 1], corr.idx_delta_sh);
+        }
+        preproc.gates.at(gate->out) =
+            std::move(std::make_unique<PreprocAmortzdPnSGate<Ring>>(a, tp_a, b, tp_b, delta, pi, tp_pi_all, pi_common));
+        break;
+      }
 
-          std::vector<AddShare<Ring>> delta(vec_size); // Delta vector only held by all parties for their respective permutation
-          for (int pid = 1; pid <= nP_; ++pid) {
-            generatePermAndShDeltaVector(nP_, id_, rgen_, pid, delta, tp_a, tp_b,
-                                         tp_pi_all[pid - 1], vec_size, delta_sh[pid - 1], idx_delta_sh);
+      default: {
+        break;
+      }
+    }
+  }
+}
+
+
+void OfflineEvaluator::distributeBlockSeeds() {
+  if (id_ == 0) {
+    // Fresh seeds from the system entropy source, not from the shared setup seed.
+    emp::PRG fresh;
+    for (int pid = 1; pid <= nP_; ++pid) {
+      emp::block seed;
+      fresh.random_block(&seed, 1);
+      rgen_.setBlockSeed(pid, seed);
+      network_->send(pid, &seed, sizeof(emp::block));
+      network_->flush(pid);
+    }
+  } else {
+    emp::block seed;
+    network_->recv(0, &seed, sizeof(emp::block));
+    rgen_.setBlockSeed(0, seed);
+  }
+}
+
+size_t OfflineEvaluator::numRanges() const {
+  return (gates_flat_.size() + kGateBlockSize - 1) / kGateBlockSize;
+}
+
+void OfflineEvaluator::prepareRanges(std::vector<PreprocCircuit<Ring>>& preprocs) {
+  gates_flat_.clear();
+  gates_flat_.reserve(circ_.num_gates);
+  cmp_groups_.clear();
+  for (const auto& level : circ_.gates_by_level) {
+    // Comparison gates of a level are grouped in level order, matching the
+    // order in which the online phase evaluates them.
+    size_t num_eqz = 0;
+    size_t num_ltz = 0;
+    common::utils::wire_t eqz_leader = 0;
+    common::utils::wire_t ltz_leader = 0;
+    for (const auto& gate : level) {
+      gates_flat_.push_back(gate.get());
+      switch (gate->type) {
+        case common::utils::GateType::kEqz:
+        case common::utils::GateType::kLtz: {
+          bool is_ltz = gate->type == common::utils::GateType::kLtz;
+          size_t& num = is_ltz ? num_ltz : num_eqz;
+          auto& leader = is_ltz ? ltz_leader : eqz_leader;
+          if (num % 64 == 0) {
+            leader = gate->out;
+            cmp_groups_[leader] = 0;
+            for (auto& preproc : preprocs) { preproc.gates.emplace(gate->out, nullptr); }
           }
-          preproc_.gates[gate->out] =
-              std::move(std::make_unique<PreprocAmortzdPnSGate<Ring>>(a, tp_a, b, tp_b, delta, pi, tp_pi_all, pi_common));
+          cmp_groups_[leader]++;
+          num++;
+          break;
+        }
+
+        case common::utils::GateType::kInp:
+        case common::utils::GateType::kMul:
+        case common::utils::GateType::kMul3:
+        case common::utils::GateType::kMul4:
+        case common::utils::GateType::kDotprod:
+        case common::utils::GateType::kTrunc:
+        case common::utils::GateType::kShuffle:
+        case common::utils::GateType::kPermAndSh:
+        case common::utils::GateType::kAmortzdPnS: {
+          for (auto& preproc : preprocs) { preproc.gates.emplace(gate->out, nullptr); }
           break;
         }
 
@@ -702,90 +598,189 @@ void OfflineEvaluator::setWireMasksParty(const std::unordered_map<common::utils:
   }
 }
 
+void OfflineEvaluator::setWireMasksAllRanges(const std::unordered_map<common::utils::wire_t, int>& input_pid_map,
+                                             std::vector<PreprocCorrections>& corr,
+                                             std::vector<PreprocCircuit<Ring>>& preprocs, size_t begin, size_t end) {
+  size_t num_ranges = numRanges();
+  // Every range re-keys its own copy of the PRGs, so the result does not
+  // depend on the number of threads or on the order ranges are scheduled in.
+  #pragma omp parallel for schedule(dynamic, 1) num_threads(threads_)
+  for (size_t range = begin; range < end; ++range) {
+    RandGenPool rgen = rgen_;
+    rgen.reseedBlock(next_block_ + range);
+    setWireMasksParty(input_pid_map, range % num_ranges, rgen, corr[range], preprocs[range / num_ranges]);
+  }
+}
 
-void OfflineEvaluator::setWireMasks(const std::unordered_map<common::utils::wire_t, int>& input_pid_map) {
-  std::vector<Ring> rand_sh_sec;
-  std::vector<BoolRing> b_rand_sh_sec;
-  std::vector<std::vector<Ring>> delta_sh(nP_, std::vector<Ring>());
+void OfflineEvaluator::sendCorrections(int pid, const std::vector<PreprocCorrections>& corr, size_t begin,
+                                       size_t end) {
+  size_t num = end - begin;
+  if (pid != nP_) {
+    // Per-range counts first so that the receiver can split the payload.
+    std::vector<size_t> delta_counts(num);
+    std::vector<Ring> delta_sh;
+    for (size_t r = begin; r < end; ++r) {
+      delta_counts[r - begin] = corr[r].delta_sh[pid - 1].size();
+      delta_sh.insert(delta_sh.end(), corr[r].delta_sh[pid - 1].begin(), corr[r].delta_sh[pid - 1].end());
+    }
+    network_->send(pid, delta_counts.data(), sizeof(size_t) * num);
+    network_->send(pid, delta_sh.data(), sizeof(Ring) * delta_sh.size());
+  } else {
+    // Everything the last party can expand from its seed is skipped; only the
+    // correction terms follow the header.
+    std::vector<size_t> lengths(4 * num);
+    std::vector<Ring> rand_sh_sec;
+    std::vector<BoolRing> b_rand_sh_sec;
+    std::vector<Ring> delta_sh;
+    std::vector<uint64_t> packed_sec;
+    for (size_t r = begin; r < end; ++r) {
+      size_t k = r - begin;
+      lengths[4 * k] = corr[r].rand_sh_sec.size();
+      lengths[4 * k + 1] = corr[r].b_rand_sh_sec.size();
+      lengths[4 * k + 2] = corr[r].delta_sh[nP_ - 1].size();
+      lengths[4 * k + 3] = corr[r].packed_sec.size();
+      rand_sh_sec.insert(rand_sh_sec.end(), corr[r].rand_sh_sec.begin(), corr[r].rand_sh_sec.end());
+      b_rand_sh_sec.insert(b_rand_sh_sec.end(), corr[r].b_rand_sh_sec.begin(), corr[r].b_rand_sh_sec.end());
+      delta_sh.insert(delta_sh.end(), corr[r].delta_sh[nP_ - 1].begin(), corr[r].delta_sh[nP_ - 1].end());
+      packed_sec.insert(packed_sec.end(), corr[r].packed_sec.begin(), corr[r].packed_sec.end());
+    }
+    network_->send(nP_, lengths.data(), sizeof(size_t) * lengths.size());
 
-  if (id_ == 0) {
-    setWireMasksParty(input_pid_map, rand_sh_sec, b_rand_sh_sec, delta_sh);
+    auto net_data = BoolRing::pack(b_rand_sh_sec.data(), b_rand_sh_sec.size());
+    network_->send(nP_, rand_sh_sec.data(), sizeof(Ring) * rand_sh_sec.size());
+    network_->send(nP_, net_data.data(), sizeof(uint8_t) * net_data.size());
+    network_->send(nP_, delta_sh.data(), sizeof(Ring) * delta_sh.size());
+    network_->send(nP_, packed_sec.data(), sizeof(uint64_t) * packed_sec.size());
+  }
+  network_->flush(pid);
+}
 
-    for (int pid = 1; pid < nP_; ++pid) {
-      size_t delta_sh_num = delta_sh[pid - 1].size();
-      network_->send(pid, &delta_sh_num, sizeof(size_t));
-      network_->send(pid, delta_sh[pid - 1].data(), delta_sh_num * sizeof(Ring));
+void OfflineEvaluator::recvCorrections(std::vector<PreprocCorrections>& corr, size_t begin, size_t end) {
+  size_t num = end - begin;
+  if (id_ != nP_) {
+    std::vector<size_t> delta_counts(num);
+    network_->recv(0, delta_counts.data(), sizeof(size_t) * num);
+    size_t delta_sh_num = 0;
+    for (auto count : delta_counts) { delta_sh_num += count; }
+    std::vector<Ring> delta_sh(delta_sh_num);
+    network_->recv(0, delta_sh.data(), delta_sh_num * sizeof(Ring));
+
+    auto it = delta_sh.begin();
+    for (size_t r = begin; r < end; ++r) {
+      corr[r].delta_sh[id_ - 1].assign(it, it + delta_counts[r - begin]);
+      it += delta_counts[r - begin];
+    }
+  } else {
+    std::vector<size_t> lengths(4 * num);
+    network_->recv(0, lengths.data(), sizeof(size_t) * lengths.size());
+    size_t rand_sh_sec_num = 0;
+    size_t b_rand_sh_sec_num = 0;
+    size_t delta_sh_num = 0;
+    size_t packed_sec_num = 0;
+    for (size_t k = 0; k < num; ++k) {
+      rand_sh_sec_num += lengths[4 * k];
+      b_rand_sh_sec_num += lengths[4 * k + 1];
+      delta_sh_num += lengths[4 * k + 2];
+      packed_sec_num += lengths[4 * k + 3];
     }
 
-    size_t rand_sh_sec_num = rand_sh_sec.size();
-    size_t b_rand_sh_sec_num = b_rand_sh_sec.size();
-    size_t delta_sh_last_num = delta_sh[nP_ - 1].size();
-    size_t arith_comm = rand_sh_sec_num;
-    size_t bool_comm = b_rand_sh_sec_num;
-    std::vector<size_t> lengths(5);
-    lengths[0] = arith_comm;
-    lengths[1] = rand_sh_sec_num;
-    lengths[2] = bool_comm;
-    lengths[3] = b_rand_sh_sec_num;
-    lengths[4] = delta_sh_last_num;
-  
-    network_->send(nP_, lengths.data(), sizeof(size_t) * lengths.size());
+    std::vector<Ring> rand_sh_sec(rand_sh_sec_num);
+    network_->recv(0, rand_sh_sec.data(), sizeof(Ring) * rand_sh_sec_num);
 
-    std::vector<Ring> offline_arith_comm(arith_comm);
-    std::vector<BoolRing> offline_bool_comm(bool_comm);
-    for (size_t i = 0; i < rand_sh_sec_num; i++) {
-      offline_arith_comm[i] = rand_sh_sec[i];
-    }
-    for (size_t i = 0; i < b_rand_sh_sec_num; i++) {
-      offline_bool_comm[i] = b_rand_sh_sec[i];
+    size_t nbytes = (b_rand_sh_sec_num + 7) / 8;
+    std::vector<uint8_t> net_data(nbytes);
+    network_->recv(0, net_data.data(), nbytes * sizeof(uint8_t));
+    std::vector<Ring> delta_sh(delta_sh_num);
+    network_->recv(0, delta_sh.data(), sizeof(Ring) * delta_sh_num);
+    std::vector<uint64_t> packed_sec(packed_sec_num);
+    network_->recv(0, packed_sec.data(), sizeof(uint64_t) * packed_sec_num);
+    auto b_rand_sh_sec = BoolRing::unpack(net_data.data(), b_rand_sh_sec_num);
+
+    auto it_arith = rand_sh_sec.begin();
+    auto it_bool = b_rand_sh_sec.begin();
+    auto it_delta = delta_sh.begin();
+    auto it_packed = packed_sec.begin();
+    for (size_t r = begin; r < end; ++r) {
+      size_t k = r - begin;
+      corr[r].rand_sh_sec.assign(it_arith, it_arith + lengths[4 * k]);
+      corr[r].b_rand_sh_sec.assign(it_bool, it_bool + lengths[4 * k + 1]);
+      corr[r].delta_sh[id_ - 1].assign(it_delta, it_delta + lengths[4 * k + 2]);
+      corr[r].packed_sec.assign(it_packed, it_packed + lengths[4 * k + 3]);
+      it_arith += lengths[4 * k];
+      it_bool += lengths[4 * k + 1];
+      it_delta += lengths[4 * k + 2];
+      it_packed += lengths[4 * k + 3];
     }
-    auto net_data = BoolRing::pack(offline_bool_comm.data(), bool_comm);
-    network_->send(nP_, offline_arith_comm.data(), sizeof(Ring) * arith_comm);
-    network_->send(nP_, net_data.data(), sizeof(uint8_t) * net_data.size());
-    network_->send(nP_, delta_sh[nP_ - 1].data(), sizeof(Ring) * delta_sh_last_num);
+  }
+}
 
-  } else if (id_ != nP_) {
+void OfflineEvaluator::setWireMasks(const std::unordered_map<common::utils::wire_t, int>& input_pid_map) {
+  auto preprocs = runBatch(input_pid_map, 1);
+  preproc_ = std::move(preprocs[0]);
+}
 
-    size_t delta_sh_num;
-    usleep(latency_usec_);
-    network_->recv(0, &delta_sh_num, sizeof(size_t));
-    std::vector<std::vector<Ring>> delta_sh(nP_);
-    delta_sh[id_ - 1] = std::vector<Ring>(delta_sh_num);
-    network_->recv(0, delta_sh[id_ - 1].data(), delta_sh_num * sizeof(Ring));
-    setWireMasksParty(input_pid_map, rand_sh_sec, b_rand_sh_sec, delta_sh);
+std::vector<PreprocCircuit<Ring>> OfflineEvaluator::runBatch(
+    const std::unordered_map<common::utils::wire_t, int>& input_pid_map, size_t k) {
+  if (seed_compressed_) { distributeBlockSeeds(); }
+
+  std::vector<PreprocCircuit<Ring>> preprocs(k);
+  prepareRanges(preprocs);
+  // Instances are generated concurrently and all need the permutations.
+  consume_perms_ = (k == 1);
+  size_t num_ranges = numRanges() * k;
+  std::vector<PreprocCorrections> corr(num_ranges, PreprocCorrections(nP_));
+
+  // Ranges are generated and exchanged in chunks of kStreamChunkRanges so
+  // that communication of one chunk overlaps with the computation of the next.
+  size_t num_chunks = (num_ranges + kStreamChunkRanges - 1) / kStreamChunkRanges;
+  auto chunk_begin = [&](size_t chunk) { return chunk * kStreamChunkRanges; };
+  auto chunk_end = [&](size_t chunk) { return std::min(num_ranges, (chunk + 1) * kStreamChunkRanges); };
+  // Correction terms are only needed while their range is being generated.
+  auto release = [&](size_t chunk) {
+    for (size_t r = chunk_begin(chunk); r < chunk_end(chunk); ++r) { corr[r] = PreprocCorrections(); }
+  };
+
+  if (id_ == 0) {
+    // Each party has its own channel, so a chunk is sent to all parties
+    // concurrently while the next chunk is generated.
+    std::vector<std::future<void>> sends;
+    for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+      size_t begin = chunk_begin(chunk);
+      size_t end = chunk_end(chunk);
+      setWireMasksAllRanges(input_pid_map, corr, preprocs, begin, end);
+
+      for (auto& send : sends) { send.get(); }
+      sends.clear();
+      if (chunk != 0) { release(chunk - 1); }
+      for (int pid = 1; pid <= nP_; ++pid) {
+        sends.push_back(std::async(std::launch::async,
+                                   [this, pid, &corr, begin, end]() { sendCorrections(pid, corr, begin, end); }));
+      }
+    }
+    for (auto& send : sends) { send.get(); }
+    if (num_chunks != 0) { release(num_chunks - 1); }
 
   } else {
 
-    std::vector<size_t> lengths(5);
     usleep(latency_usec_);
-    network_->recv(0, lengths.data(), sizeof(size_t) * lengths.size());
-    size_t arith_comm = lengths[0];
-    size_t rand_sh_sec_num = lengths[1];
-    size_t bool_comm = lengths[2];
-    size_t b_rand_sh_sec_num = lengths[3];
-    size_t delta_sh_num = lengths[4];
-
-    std::vector<Ring> offline_arith_comm(arith_comm);
-    network_->recv(0, offline_arith_comm.data(), sizeof(Ring) * arith_comm);
-
-    size_t nbytes = (bool_comm + 7) / 8;
-    std::vector<uint8_t> net_data(nbytes);
-    network_->recv(0, net_data.data(), nbytes * sizeof(uint8_t));
-    std::vector<std::vector<Ring>> delta_sh(nP_);
-    delta_sh[id_ - 1] = std::vector<Ring>(delta_sh_num);
-    network_->recv(0, delta_sh[id_ - 1].data(), sizeof(Ring) * delta_sh_num);
-    auto offline_bool_comm = BoolRing::unpack(net_data.data(), bool_comm);
-
-    rand_sh_sec.resize(rand_sh_sec_num);
-    for (int i = 0; i < rand_sh_sec_num; i++) {
-      rand_sh_sec[i] = offline_arith_comm[i];
+    // Receive the next chunk while generating the current one.
+    std::future<void> next;
+    if (num_chunks != 0) {
+      next = std::async(std::launch::async, [&]() { recvCorrections(corr, chunk_begin(0), chunk_end(0)); });
     }
-    b_rand_sh_sec.resize(b_rand_sh_sec_num);
-    for (int i = 0; i < b_rand_sh_sec_num; i++) {
-      b_rand_sh_sec[i] = offline_bool_comm[i];
+    for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+      next.get();
+      if (chunk + 1 < num_chunks) {
+        next = std::async(std::launch::async,
+                          [&, chunk]() { recvCorrections(corr, chunk_begin(chunk + 1), chunk_end(chunk + 1)); });
+      }
+      setWireMasksAllRanges(input_pid_map, corr, preprocs, chunk_begin(chunk), chunk_end(chunk));
+      release(chunk);
     }
-    setWireMasksParty(input_pid_map, rand_sh_sec, b_rand_sh_sec, delta_sh);
   }
+
+  next_block_ += num_ranges;
+  return preprocs;
 }
 
 PreprocCircuit<Ring> OfflineEvaluator::getPreproc() {
@@ -801,7 +796,7 @@ OfflineBoolEvaluator::OfflineBoolEvaluator(int nP, int my_id, std::shared_ptr<io
                                            common::utils::LevelOrderedCircuit circ, int seed, int latency_ms)
   : nP_(nP),
     id_(my_id),
-    rgen_(my_id, seed),
+    rgen_(my_id, nP, seed),
     network_(std::move(network)),
     circ_(std::move(circ)),
     latency_usec_(latency_ms * 1000),
@@ -859,4 +854,116 @@ OfflineBoolEvaluator::OfflineBoolEvaluator(int nP, int my_id, std::shared_ptr<io
 }
 
 
+void OfflineBoolEvaluator::randomSharePacked(int nP, int pid, RandGenPool& rgen, uint64_t& share, uint64_t& secret) {
+  share = 0;
+  secret = 0;
+  if (pid == 0) {
+    for (int i = 1; i <= nP; ++i) {
+      uint64_t val;
+      rgen.pi(i).random_data(&val, sizeof(uint64_t));
+      secret ^= val;
+    }
+  } else {
+    rgen.p0().random_data(&share, sizeof(uint64_t));
+  }
+}
+
+void OfflineBoolEvaluator::randomShareSecretPacked(int nP, int pid, RandGenPool& rgen, uint64_t& share, uint64_t secret,
+                                                   std::vector<uint64_t>& rand_sh_sec, size_t& idx_rand_sh_sec) {
+  share = 0;
+  if (pid == 0) {
+    uint64_t valn = secret;
+    for (int i = 1; i < nP; ++i) {
+      uint64_t val;
+      rgen.pi(i).random_data(&val, sizeof(uint64_t));
+      valn ^= val;
+    }
+    rand_sh_sec.push_back(valn);
+  } else if (pid != nP) {
+    rgen.p0().random_data(&share, sizeof(uint64_t));
+  } else {
+    share = rand_sh_sec[idx_rand_sh_sec];
+    idx_rand_sh_sec++;
+  }
+}
+
+PackedBoolPreproc OfflineBoolEvaluator::packedPreproc(int nP, int pid, RandGenPool& rgen,
+                                                      const common::utils::LevelOrderedCircuit& circ, size_t lanes,
+                                                      std::vector<uint64_t>& rand_sh_sec, size_t& idx_rand_sh_sec) {
+  PackedBoolPreproc packed;
+  packed.num_instances = lanes;
+  packed.num_words = 1;
+  packed.gates.resize(circ.num_wires);
+
+  // Secrets are only known to the dealer.
+  auto random = [&](std::vector<uint64_t>& vals) {
+    uint64_t secret;
+    vals.push_back(0);
+    randomSharePacked(nP, pid, rgen, vals.back(), secret);
+    return secret;
+  };
+  auto product = [&](std::vector<uint64_t>& vals, uint64_t secret) {
+    vals.push_back(0);
+    randomShareSecretPacked(nP, pid, rgen, vals.back(), secret, rand_sh_sec, idx_rand_sh_sec);
+  };
+
+  for (const auto& level : circ.gates_by_level) {
+    for (const auto& gate : level) {
+      auto& vals = packed.gates[gate->out];
+      switch (gate->type) {
+        case common::utils::GateType::kMul: {
+          auto a = random(vals);
+          auto b = random(vals);
+          product(vals, a & b);
+          break;
+        }
+
+        case common::utils::GateType::kMul3: {
+          auto a = random(vals);
+          auto b = random(vals);
+          auto c = random(vals);
+          product(vals, a & b);
+          product(vals, b & c);
+          product(vals, c & a);
+          product(vals, a & b & c);
+          break;
+        }
+
+        case common::utils::GateType::kMul4: {
+          auto a = random(vals);
+          auto b = random(vals);
+          auto c = random(vals);
+          auto d = random(vals);
+          product(vals, a & b);
+          product(vals, a & c);
+          product(vals, a & d);
+          product(vals, b & c);
+          product(vals, b & d);
+          product(vals, c & d);
+          product(vals, a & b & c);
+          product(vals, a & b & d);
+          product(vals, a & c & d);
+          product(vals, b & c & d);
+          product(vals, a & b & c & d);
+          break;
+        }
+
+        case common::utils::GateType::kDotprod: {
+          const auto* g = static_cast<common::utils::SIMDGate*>(gate.get());
+          for (size_t i = 0; i < g->in1.size(); ++i) {
+            auto a = random(vals);
+            auto b = random(vals);
+            product(vals, a & b);
+          }
+          break;
+        }
+
+        default:
+          break;
+      }
+    }
+  }
+  return packed;
+}
+
 };  // namespace grasp
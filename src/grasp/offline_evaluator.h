@@ -19,6 +19,26 @@
 using namespace common::utils;
 
 namespace grasp {
+// Correction terms of one gate range. The dealer fills the vectors and the
+// receiving parties consume them in the same order through the indices.
+struct PreprocCorrections {
+  std::vector<Ring> rand_sh_sec;
+  std::vector<BoolRing> b_rand_sh_sec;
+  std::vector<std::vector<Ring>> delta_sh;
+  size_t idx_rand_sh_sec{0};
+  size_t b_idx_rand_sh_sec{0};
+  size_t idx_delta_sh{0};
+  // Packed Boolean values, 64 lanes per word.
+  std::vector<uint64_t> packed_sec;
+  size_t idx_packed_sec{0};
+
+  explicit PreprocCorrections(int nP = 0) : delta_sh(nP) {}
+};
+
+// Number of gate ranges the dealer generates before streaming their
+// correction terms to the parties.
+constexpr size_t kStreamChunkRanges = 64;
+
 class OfflineEvaluator {
   int nP_;  
   int id_;
@@ -28,6 +48,26 @@ class OfflineEvaluator {
   std::shared_ptr<ThreadPool> tpool_;
   PreprocCircuit<Ring> preproc_;
   int latency_usec_;
+  int threads_;
+  // Gates in level order. Range r covers gates [r * kGateBlockSize,
+  // (r + 1) * kGateBlockSize) and draws its randomness from PRG block r.
+  std::vector<common::utils::Gate*> gates_flat_;
+  // First gate of every group of comparison gates and the size of the group.
+  std::unordered_map<common::utils::wire_t, size_t> cmp_groups_;
+  // If set, the dealer hands every party a fresh PRG seed and all correlated
+  // randomness is expanded per gate block (see kGateBlockSize). Only the
+  // correction terms are sent explicitly.
+  bool seed_compressed_;
+  // PRG block of the first range of the next preprocessing run. Advanced
+  // after every run so that repeated runs never reuse a stream.
+  uint64_t next_block_;
+  // Move permutations out of the circuit instead of copying them. Only valid
+  // if a single preprocessing instance is generated.
+  bool consume_perms_;
+
+  // Dealer samples one seed per party and sends it; parties install it as the
+  // key of their PRG shared with the dealer.
+  void distributeBlockSeeds();
 
   // Used for running common coin protocol. Returns common random PRG key which
   // is then used to generate randomness for common coin output.
@@ -35,11 +75,17 @@ class OfflineEvaluator {
 
   public:
   OfflineEvaluator(int nP, int my_id, std::shared_ptr<io::NetIOMP> network,
-                   common::utils::LevelOrderedCircuit circ, int threads, int seed = 200, int latency_ms = 100);
+                   common::utils::LevelOrderedCircuit circ, int threads, int seed = 200, int latency_ms = 100,
+                   bool seed_compressed = false);
 
   // Generate sharing of a random unknown value.
   static void randomShare(int nP, int pid, RandGenPool& rgen, AddShare<Ring>& share, TPShare<Ring>& tpShare);
 
+  // Vector variant of randomShare. Each party's values are expanded in bulk
+  // from a counter-mode generator forked off its PRG stream.
+  static void randomShareVec(int nP, int pid, RandGenPool& rgen, std::vector<AddShare<Ring>>& share,
+                             std::vector<TPShare<Ring>>& tpShare);
+
   // Generate sharing of a random value known to party. Should be called by
   // dealer when other parties call other variant.
   static void randomShareSecret(int nP, int pid, RandGenPool& rgen,
@@ -60,11 +106,15 @@ class OfflineEvaluator {
 
   // Following methods implement various preprocessing subprotocols.
 
+  // Set masks for the gates of one range into 'preproc'. 'rgen' must already
+  // be keyed to the range's PRG stream. Ranges touch disjoint preprocessing
+  // entries and may run concurrently.
+  void setWireMasksParty(const std::unordered_map<common::utils::wire_t, int>& input_pid_map,
+                         size_t range, RandGenPool& rgen, PreprocCorrections& corr,
+                         PreprocCircuit<Ring>& preproc);
+
   // Set masks for each wire. Should be called before running any of the other
   // subprotocols.
-  void setWireMasksParty(const std::unordered_map<common::utils::wire_t, int>& input_pid_map,
-                         std::vector<Ring>& rand_sh_sec, std::vector<BoolRing>& b_rand_sh_sec,
-                         std::vector<std::vector<Ring>>& delta_sh);
 
   void setWireMasks(const std::unordered_map<common::utils::wire_t, int>& input_pid_map);
 
@@ -73,11 +123,32 @@ class OfflineEvaluator {
   // Efficiently runs above subprotocols.
   PreprocCircuit<Ring> run(const std::unordered_map<common::utils::wire_t, int>& input_pid_map);
 
+  // Generate preprocessing for 'k' independent evaluations of the circuit in
+  // a single pass, with one round of correction messages for all of them.
+  // Each instance must be consumed by exactly one online evaluation.
+  std::vector<PreprocCircuit<Ring>> runBatch(const std::unordered_map<common::utils::wire_t, int>& input_pid_map,
+                                             size_t k);
+
  private:
-  // Cache Boolean circuit templates to avoid regenerating them for every preprocessing call.
-  // These are shared across all OfflineEvaluator instances and invocations.
-  static const common::utils::LevelOrderedCircuit& getMultKCircuitTemplate();
-  static const common::utils::LevelOrderedCircuit& getPrefixORCircuitTemplate();
+  size_t numRanges() const;
+
+  // Flatten the circuit and create the preprocessing entries of all gates in
+  // every instance so that ranges can fill them without modifying the maps.
+  void prepareRanges(std::vector<PreprocCircuit<Ring>>& preprocs);
+
+  // Run setWireMasksParty over ranges [begin, end) of all instances with
+  // 'threads_' workers. Instance i owns corr[i * numRanges(), (i + 1) *
+  // numRanges()).
+  void setWireMasksAllRanges(const std::unordered_map<common::utils::wire_t, int>& input_pid_map,
+                             std::vector<PreprocCorrections>& corr, std::vector<PreprocCircuit<Ring>>& preprocs,
+                             size_t begin, size_t end);
+
+  // Dealer sends party 'pid' its correction terms of ranges [begin, end).
+  // Safe to call concurrently for different parties.
+  void sendCorrections(int pid, const std::vector<PreprocCorrections>& corr, size_t begin, size_t end);
+
+  // Party receives its correction terms of ranges [begin, end) from the dealer.
+  void recvCorrections(std::vector<PreprocCorrections>& corr, size_t begin, size_t end);
 };
 
 class OfflineBoolEvaluator {
@@ -98,6 +169,18 @@ class OfflineBoolEvaluator {
   static void randomShareSecret(int nP, int pid, RandGenPool& rgen,
                                 AddShare<BoolRing>& share, TPShare<BoolRing>& tpShare, BoolRing secret,
                                 std::vector<BoolRing>& rand_sh_sec, size_t& idx_rand_sh_sec);
+
+  // Packed variants of the above for 64 independent bits per word. 'secret'
+  // is only meaningful for the dealer.
+  static void randomSharePacked(int nP, int pid, RandGenPool& rgen, uint64_t& share, uint64_t& secret);
+
+  static void randomShareSecretPacked(int nP, int pid, RandGenPool& rgen, uint64_t& share, uint64_t secret,
+                                      std::vector<uint64_t>& rand_sh_sec, size_t& idx_rand_sh_sec);
+
+  // Preprocessing of 'lanes' (at most 64) instances of 'circ' in the
+  // PackedBoolPreproc layout with one word per value.
+  static PackedBoolPreproc packedPreproc(int nP, int pid, RandGenPool& rgen, const common::utils::LevelOrderedCircuit& circ,
+                                         size_t lanes, std::vector<uint64_t>& rand_sh_sec, size_t& idx_rand_sh_sec);
 };
 
 };  // namespace grasp
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "../io/netmp.h"
@@ -14,6 +17,44 @@
 using namespace common::utils;
 
 namespace grasp {
+  // Gates of one level bucketed by type, so that each bucket can be evaluated
+  // in parallel. Messages of the k-th gate of a multiplication bucket are at
+  // a fixed offset in the send buffers.
+  struct LevelPlan {
+    std::vector<common::utils::FIn2Gate *> mult;
+    std::vector<common::utils::FIn3Gate *> mult3;
+    std::vector<common::utils::FIn4Gate *> mult4;
+    std::vector<common::utils::SIMDGate *> dotp;
+    // First term of each dot product; dotp_offset.back() is the total.
+    std::vector<size_t> dotp_offset;
+    // Local gates in topological sub-levels. A gate only depends on gates of
+    // earlier sub-levels or earlier levels, so every sub-level is evaluated
+    // in parallel.
+    std::vector<std::vector<common::utils::Gate *>> local;
+  };
+
+  // Assignment of reconstructed values to the king parties that collect their
+  // shares and send back the result. A single king receives nP - 1 times the
+  // traffic of the other parties; the other policies give every party about
+  // 1/nP of the values, by index modulo nP or by contiguous range.
+  enum class KingPolicy { kFixed, kRoundRobin, kRange };
+
+  // Parses "fixed", "round-robin" or "range".
+  KingPolicy kingPolicyFromString(const std::string &name);
+
+  std::string kingPolicyName(KingPolicy policy);
+
+  // Load of the kPermAndSh gates of one owner as seen by this party, summed
+  // over all evaluated levels.
+  struct PermAndShOwnerStats {
+    size_t gates = 0;
+    // Vector entries masked by the other parties and aggregated by the owner.
+    size_t elements = 0;
+    // Wall time of this party's send pipeline to the owner or, for its own
+    // gates, of the aggregation.
+    double time_ms = 0;
+  };
+
   class OnlineEvaluator {
     int nP_;
     int id_;
@@ -23,7 +64,74 @@ namespace grasp {
     common::utils::LevelOrderedCircuit circ_;
     std::vector<Ring> wires_;
     std::shared_ptr<ThreadPool> tpool_;
+    int num_threads_;
     int latency_usec_;
+    // Lazily built evaluation plan of each level.
+    std::vector<std::unique_ptr<LevelPlan>> plans_;
+    // Comparison gates skipped by evaluateGatesAtDepth, see deferGates.
+    std::unordered_set<common::utils::wire_t> deferred_;
+    // Tagged channels of network_ used by runConcurrently.
+    std::vector<std::shared_ptr<io::NetIOMP>> channels_;
+    // Indexed by owner - 1.
+    std::vector<PermAndShOwnerStats> permAndSh_stats_;
+    KingPolicy king_policy_ = KingPolicy::kRange;
+    // Communication rounds on the critical path so far, see rounds().
+    size_t rounds_ = 0;
+
+    const LevelPlan &levelPlan(size_t depth);
+
+    void evaluateLocalGate(const common::utils::Gate *gate);
+
+    // Run f(begin, end) on static chunks of [0, n) on the thread pool.
+    template <class F>
+    void parallelFor(size_t n, F &&f);
+
+    // Round coordinator: run the interactive sub-protocols of a level at the
+    // same time, the i-th one on tagged channel i of network_. Returns the
+    // rounds of the slowest one.
+    size_t runConcurrently(const std::vector<std::function<void(const std::shared_ptr<io::NetIOMP> &)>> &rounds);
+
+    // Send this party's masked multiplication inputs to all parties. On return
+    // the vectors hold the values of all parties in the layout expected by
+    // evaluateGatesAtDepthPartyRecv.
+    void exchangeMultVals(const std::shared_ptr<io::NetIOMP> &net, std::vector<Ring> &mult_vals,
+                          std::vector<Ring> &mult3_vals, std::vector<Ring> &mult4_vals, std::vector<Ring> &dotp_vals);
+
+    // Sum of 'shares' over all parties, reconstructed by the kings of
+    // king_policy_.
+    std::vector<Ring> reconstruct(const std::shared_ptr<io::NetIOMP> &net, std::vector<Ring> shares);
+
+    // Sub-protocols communicating over 'net'.
+    void eqzEvaluate(const std::shared_ptr<io::NetIOMP> &net, const std::vector<common::utils::FIn1Gate> &eqz_gates);
+
+    // Comparison outputs are arithmetic shares of the result bit, or the bit
+    // itself at every party if 'reveal' is set.
+    void ltzEvaluate(const std::shared_ptr<io::NetIOMP> &net, const std::vector<common::utils::FIn1Gate> &ltz_gates,
+                     bool reveal = false);
+
+    // Write the shares of the comparison results whose XOR with the output
+    // masks of their groups is 'masked', 64 gates per word.
+    void unmaskCmpOutputs(const std::vector<common::utils::FIn1Gate> &gates,
+                          const std::vector<PreprocCmpGroup<Ring> *> &groups, const std::vector<uint64_t> &masked);
+
+    void truncEvaluate(const std::shared_ptr<io::NetIOMP> &net, const std::vector<common::utils::TruncGate> &trunc_gates);
+
+    void shuffleEvaluate(const std::shared_ptr<io::NetIOMP> &net, const std::vector<common::utils::SIMDOGate> &shuffle_gates);
+
+    void permAndShEvaluate(const std::shared_ptr<io::NetIOMP> &net,
+                           const std::vector<common::utils::SIMDOGate> &permAndSh_gates);
+
+    void amortzdPnSEvaluate(const std::shared_ptr<io::NetIOMP> &net,
+                            const std::vector<common::utils::SIMDMOGate> &amortzdPnS_gates);
+
+    // Halves of permAndShEvaluate for the gates 'owned' by one owner, whose
+    // masked inputs form one stream with gate k starting at offset[k].
+    void permAndShSend(const std::shared_ptr<io::NetIOMP> &net, int owner,
+                       const std::vector<const common::utils::SIMDOGate *> &owned, const std::vector<size_t> &offset);
+
+    void permAndShAggregate(const std::shared_ptr<io::NetIOMP> &net,
+                            const std::vector<const common::utils::SIMDOGate *> &owned,
+                            const std::vector<size_t> &offset);
 
     // write reconstruction function
   public:
@@ -41,6 +149,20 @@ namespace grasp {
 
     void setRandomInputs();
 
+    // Replace the preprocessing consumed by the next evaluation. Lets one
+    // evaluator run several evaluations back to back, e.g. from a PreprocPool.
+    void setPreproc(PreprocCircuit<Ring> preproc);
+
+    // Copy the shares of wires 'from' to wires 'to', e.g. the outputs of one
+    // evaluation to the inputs of the next. Local, as wires hold additive
+    // shares.
+    void copyWires(const std::vector<common::utils::wire_t> &from, const std::vector<common::utils::wire_t> &to);
+
+    // All parties must use the same policy.
+    void setKingPolicy(KingPolicy policy) { king_policy_ = policy; }
+
+    KingPolicy kingPolicy() const { return king_policy_; }
+
     void evaluateGatesAtDepthPartySend(size_t depth, std::vector<Ring> &mult_vals, std::vector<Ring> &mult3_vals,
                                        std::vector<Ring> &mult4_vals, std::vector<Ring> &dotp_vals);
 
@@ -56,9 +178,30 @@ namespace grasp {
     // Free preprocessing data for a specific depth (used for progressive cleanup)
     void freeDepthPreproc(size_t depth);
 
+    // Preprocessing groups of comparison gates of one level, one per 64 gates.
+    std::vector<PreprocCmpGroup<Ring> *> cmpGroups(const std::vector<common::utils::FIn1Gate> &gates);
+
     void eqzEvaluate(const std::vector<common::utils::FIn1Gate> &eqz_gates);
   
-    void ltzEvaluate(const std::vector<common::utils::FIn1Gate> &ltz_gates);
+    void ltzEvaluate(const std::vector<common::utils::FIn1Gate> &ltz_gates, bool reveal = false);
+
+    // Skip the kEqz/kLtz gates with outputs 'outs' when evaluating their level.
+    // Their preprocessing is left for revealLessThan.
+    void deferGates(const std::vector<common::utils::wire_t> &outs);
+
+    // Reveal lhs[i] < rhs[i] (as signed values) for all i with one batched LTZ,
+    // consuming the preprocessing of the deferred kLtz gates cmp_gates[i].
+    // cmp_gates[0] must be the first gate of a preprocessing group and the
+    // gates consecutive in level order.
+    std::vector<Ring> revealLessThan(const std::vector<common::utils::wire_t> &lhs,
+                                     const std::vector<common::utils::wire_t> &rhs,
+                                     const std::vector<common::utils::wire_t> &cmp_gates);
+
+    // Reveal the values of 'wires' to all parties and the dealer, e.g. a
+    // public stopping condition. Party 1 forwards them to the dealer.
+    std::vector<Ring> revealWires(const std::vector<common::utils::wire_t> &wires);
+
+    void truncEvaluate(const std::vector<common::utils::TruncGate> &trunc_gates);
 
     void shuffleEvaluate(const std::vector<common::utils::SIMDOGate> &shuffle_gates);
 
@@ -66,6 +209,15 @@ namespace grasp {
 
     void amortzdPnSEvaluate(const std::vector<common::utils::SIMDMOGate> &amortzdPnS_gates);
 
+    // Per owner load of the kPermAndSh gates evaluated so far, indexed by
+    // owner - 1.
+    const std::vector<PermAndShOwnerStats> &permAndShStats() const { return permAndSh_stats_; }
+
+    // Communication rounds of the levels evaluated so far, each level costing
+    // those of its slowest sub-protocol. A round is one simulated latency
+    // wait.
+    [[nodiscard]] size_t rounds() const { return rounds_; }
+
     std::vector<Ring> getOutputs();
 
     // Ring reconstruct(AddShare<Ring> &shares);
@@ -101,4 +253,36 @@ namespace grasp {
     std::vector<std::vector<BoolRing>> getOutputShares();
   };
 
+  // Evaluates many independent instances of a Boolean circuit at once. Every
+  // wire holds one bit per instance packed into 64-bit words, so XOR and AND
+  // act on 64 instances per instruction and messages are packed bits.
+  struct BitslicedBoolEval {
+    int id;
+    int nP;
+    std::shared_ptr<io::NetIOMP> network;
+    PackedBoolPreproc preproc;
+    common::utils::LevelOrderedCircuit circ;
+    size_t num_words;
+    // Wire w occupies words [w * num_words, (w + 1) * num_words).
+    std::vector<uint64_t> wires;
+    int latency_usec;
+
+    BitslicedBoolEval(int my_id, int nP, std::shared_ptr<io::NetIOMP> network, PackedBoolPreproc preproc,
+                      common::utils::LevelOrderedCircuit circ, int latency_ms = 100);
+
+    // Bitslice per-instance preprocessing, vpreproc[i] being the gate array of
+    // instance i.
+    static PackedBoolPreproc pack(const std::vector<preprocg_ptr_t<BoolRing> *> &vpreproc,
+                                  const common::utils::LevelOrderedCircuit &circ);
+
+    uint64_t *wire(common::utils::wire_t w) { return wires.data() + w * num_words; }
+
+    void evaluateGatesAtDepth(size_t depth);
+
+    void evaluateAllLevels();
+
+    // Packed shares of the j-th output wire.
+    const uint64_t *output(size_t j) { return wire(circ.outputs[j]); }
+  };
+
 }; // namespace grasp
@@ -1,24 +1,43 @@
 #include "online_evaluator.h"
 
 #include "../utils/helpers.h"
+#include "../utils/permutation.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
 #include <omp.h>
 
 namespace grasp
 {
+    // Entries per message of the kPermAndSh streams.
+    constexpr size_t kPermAndShChunk = 1 << 14;
+
+    // Simulated latency waits of the current thread, one per communication
+    // round. runConcurrently counts them per sub-protocol.
+    thread_local size_t latency_waits = 0;
+
+    static void waitLatency(int latency_usec) {
+        ++latency_waits;
+        usleep(latency_usec);
+    }
+
     OnlineEvaluator::OnlineEvaluator(int nP, int id, std::shared_ptr<io::NetIOMP> network,
                                      PreprocCircuit<Ring> preproc,
                                      common::utils::LevelOrderedCircuit circ,
                                      int threads, int seed, int latency_ms)
         : nP_(nP),
           id_(id),
-          rgen_(id, seed),
+          rgen_(id, nP, seed),
           network_(std::move(network)),
           preproc_(std::move(preproc)),
           circ_(std::move(circ)),
           wires_(circ.num_wires),
+          num_threads_(std::max(threads, 1)),
           latency_usec_(latency_ms * 1000)
     {
-        // tpool_ = std::make_shared<ThreadPool>(threads);
+        if (id_ != 0 && num_threads_ > 1) { tpool_ = std::make_shared<ThreadPool>(num_threads_ - 1); }
     }
 
     OnlineEvaluator::OnlineEvaluator(int nP, int id, std::shared_ptr<io::NetIOMP> network,
@@ -27,14 +46,142 @@ namespace grasp
                                      std::shared_ptr<ThreadPool> tpool, int seed, int latency_ms)
         : nP_(nP),
           id_(id),
-          rgen_(id, seed),
+          rgen_(id, nP, seed),
           network_(std::move(network)),
           preproc_(std::move(preproc)),
           circ_(std::move(circ)),
           tpool_(std::move(tpool)),
           wires_(circ.num_wires),
+          num_threads_(tpool_ ? tpool_->size() + 1 : 1),
           latency_usec_(latency_ms * 1000) {}
 
+    template <class F>
+    void OnlineEvaluator::parallelFor(size_t n, F &&f) {
+        // Below this many items per chunk dispatching costs more than it saves.
+        constexpr size_t kMinChunk = 512;
+        size_t num_chunks = std::min<size_t>(num_threads_, (n + kMinChunk - 1) / kMinChunk);
+        if (!tpool_ || num_chunks <= 1) {
+            f(size_t(0), n);
+            return;
+        }
+        size_t chunk = (n + num_chunks - 1) / num_chunks;
+        std::vector<std::future<void>> done;
+        done.reserve(num_chunks - 1);
+        for (size_t begin = chunk; begin < n; begin += chunk) {
+            size_t end = std::min(n, begin + chunk);
+            done.push_back(tpool_->enqueue([&f, begin, end]() { f(begin, end); }));
+        }
+        // The calling thread takes the first chunk.
+        f(size_t(0), std::min(n, chunk));
+        for (auto &d : done) { d.get(); }
+    }
+
+    const LevelPlan &OnlineEvaluator::levelPlan(size_t depth) {
+        if (plans_.size() != circ_.gates_by_level.size()) {
+            plans_.clear();
+            plans_.resize(circ_.gates_by_level.size());
+        }
+        if (plans_[depth]) { return *plans_[depth]; }
+
+        auto plan = std::make_unique<LevelPlan>();
+        plan->dotp_offset.push_back(0);
+        // Sub-level of the outputs of local gates of this level.
+        std::unordered_map<common::utils::wire_t, size_t> local_level;
+        auto sub_level = [&](common::utils::wire_t w) {
+            auto it = local_level.find(w);
+            return it == local_level.end() ? size_t(0) : it->second + 1;
+        };
+        for (auto &gate : circ_.gates_by_level[depth]) {
+            size_t sub = 0;
+            switch (gate->type) {
+                case common::utils::GateType::kMul:
+                    plan->mult.push_back(static_cast<common::utils::FIn2Gate *>(gate.get()));
+                    continue;
+                case common::utils::GateType::kMul3:
+                    plan->mult3.push_back(static_cast<common::utils::FIn3Gate *>(gate.get()));
+                    continue;
+                case common::utils::GateType::kMul4:
+                    plan->mult4.push_back(static_cast<common::utils::FIn4Gate *>(gate.get()));
+                    continue;
+                case common::utils::GateType::kDotprod: {
+                    auto *g = static_cast<common::utils::SIMDGate *>(gate.get());
+                    plan->dotp.push_back(g);
+                    plan->dotp_offset.push_back(plan->dotp_offset.back() + g->in1.size());
+                    continue;
+                }
+                case common::utils::GateType::kAdd:
+                case common::utils::GateType::kSub: {
+                    auto *g = static_cast<common::utils::FIn2Gate *>(gate.get());
+                    sub = std::max(sub_level(g->in1), sub_level(g->in2));
+                    local_level[g->out] = sub;
+                    break;
+                }
+                case common::utils::GateType::kConstAdd:
+                case common::utils::GateType::kConstMul: {
+                    auto *g = static_cast<common::utils::ConstOpGate<Ring> *>(gate.get());
+                    sub = sub_level(g->in);
+                    local_level[g->out] = sub;
+                    break;
+                }
+                case common::utils::GateType::kPublicPerm: {
+                    auto *g = static_cast<common::utils::SIMDOGate *>(gate.get());
+                    for (auto w : g->in) { sub = std::max(sub, sub_level(w)); }
+                    for (auto w : g->outs) { local_level[w] = sub; }
+                    break;
+                }
+                default:
+                    continue;
+            }
+            if (plan->local.size() <= sub) { plan->local.resize(sub + 1); }
+            plan->local[sub].push_back(gate.get());
+        }
+        plans_[depth] = std::move(plan);
+        return *plans_[depth];
+    }
+
+    void OnlineEvaluator::evaluateLocalGate(const common::utils::Gate *gate) {
+        switch (gate->type) {
+            case common::utils::GateType::kAdd: {
+                auto *g = static_cast<const common::utils::FIn2Gate *>(gate);
+                wires_[g->out] = wires_[g->in1] + wires_[g->in2];
+                break;
+            }
+
+            case common::utils::GateType::kSub: {
+                auto *g = static_cast<const common::utils::FIn2Gate *>(gate);
+                wires_[g->out] = wires_[g->in1] - wires_[g->in2];
+                break;
+            }
+
+            case common::utils::GateType::kConstAdd: {
+                auto *g = static_cast<const common::utils::ConstOpGate<Ring> *>(gate);
+                // Only 1 party needs to add the constant
+                wires_[g->out] = (id_ == 1) ? wires_[g->in] + g->cval : wires_[g->in];
+                break;
+            }
+
+            case common::utils::GateType::kConstMul: {
+                auto *g = static_cast<const common::utils::ConstOpGate<Ring> *>(gate);
+                wires_[g->out] = wires_[g->in] * g->cval;
+                break;
+            }
+
+            case common::utils::GateType::kPublicPerm: {
+                auto *g = static_cast<const common::utils::SIMDOGate *>(gate);
+                auto vec_len = g->in.size();
+                std::vector<Ring> vals(vec_len);
+                std::vector<Ring> permuted(vec_len);
+                for (size_t i = 0; i < vec_len; ++i) { vals[i] = wires_[g->in[i]]; }
+                common::utils::permuteScatter(vals.data(), g->permutation[0].data(), vec_len, permuted.data());
+                for (size_t i = 0; i < vec_len; ++i) { wires_[g->outs[i]] = permuted[i]; }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
     void OnlineEvaluator::setInputs(const std::unordered_map<common::utils::wire_t, Ring> &inputs) {
         // Input gates have depth 0
         for (auto &g : circ_.gates_by_level[0]) {
@@ -42,24 +189,38 @@ namespace grasp
                 auto *pre_input = static_cast<PreprocInput<Ring> *>(preproc_.gates[g->out].get());
                 auto pid = pre_input->pid;
                 if (id_ != 0) {
-                    if (pid == id_) {
-                        Ring accumulated_val = Ring(0);
-                        for (size_t i = 1; i <= nP_; i++) {
-                            if (i != pid) {
-                                Ring rand_sh;
-                                rgen_.pi(i).random_data(&rand_sh, sizeof(Ring));
-                                accumulated_val += rand_sh;
-                            }
+                    // Share i is drawn from pi(i). Every party advances the
+                    // streams of all non-owners, so that they stay in sync
+                    // when inputs have different owners.
+                    Ring accumulated_val = Ring(0);
+                    Ring own_sh = Ring(0);
+                    for (int i = 1; i <= nP_; i++) {
+                        if (i != pid) {
+                            Ring rand_sh;
+                            rgen_.pi(i).random_data(&rand_sh, sizeof(Ring));
+                            accumulated_val += rand_sh;
+                            if (i == id_) { own_sh = rand_sh; }
                         }
-                        wires_[g->out] = inputs.at(g->out) - accumulated_val;
-                    } else {
-                        rgen_.pi(id_).random_data(&wires_[g->out], sizeof(Ring));
                     }
+                    wires_[g->out] = pid == id_ ? inputs.at(g->out) - accumulated_val : own_sh;
                 }
             }
         }
     }
 
+    void OnlineEvaluator::setPreproc(PreprocCircuit<Ring> preproc) {
+        preproc_ = std::move(preproc);
+    }
+
+    void OnlineEvaluator::copyWires(const std::vector<common::utils::wire_t> &from,
+                                    const std::vector<common::utils::wire_t> &to) {
+        if (from.size() != to.size()) { throw std::invalid_argument("Wire count mismatch."); }
+        // Read all shares first, the two lists may overlap.
+        std::vector<Ring> shares(from.size());
+        for (size_t i = 0; i < from.size(); ++i) { shares[i] = wires_[from[i]]; }
+        for (size_t i = 0; i < to.size(); ++i) { wires_[to[i]] = shares[i]; }
+    }
+
     void OnlineEvaluator::setRandomInputs() {
         // Input gates have depth 0.
         for (auto &g : circ_.gates_by_level[0]) {
@@ -69,450 +230,622 @@ namespace grasp
         }
     }
 
-    void OnlineEvaluator::eqzEvaluate(const std::vector<common::utils::FIn1Gate> &eqz_gates) {
-        if (id_ == 0) { return; }
-        int pKing = 1; // Designated king party
-        auto multk_circ = common::utils::Circuit<BoolRing>::generateMultK().orderGatesByLevel();
-        size_t num_eqz_gates = eqz_gates.size();
-        std::vector<Ring> all_share_send;
-        all_share_send.reserve(num_eqz_gates);
-        std::vector<preprocg_ptr_t<BoolRing> *> vpreproc;
-        vpreproc.reserve(num_eqz_gates);
+    KingPolicy kingPolicyFromString(const std::string &name) {
+        if (name == "fixed") { return KingPolicy::kFixed; }
+        if (name == "round-robin") { return KingPolicy::kRoundRobin; }
+        if (name == "range") { return KingPolicy::kRange; }
+        throw std::invalid_argument("Unknown king policy: " + name + ".");
+    }
 
-        // Compute share of d = input + random_value
-        for (auto &eqz_gate : eqz_gates) {
-            auto *pre_eqz = static_cast<PreprocEqzGate<Ring> *>(preproc_.gates[eqz_gate.out].get());
-            Ring share_d = eqz_gate.in + pre_eqz->share_r.valueAt();
-            all_share_send.push_back(share_d);
-            vpreproc.push_back(pre_eqz->multk_gates.data());
+    std::string kingPolicyName(KingPolicy policy) {
+        switch (policy) {
+            case KingPolicy::kFixed: return "fixed";
+            case KingPolicy::kRoundRobin: return "round-robin";
+            case KingPolicy::kRange: return "range";
         }
+        return "unknown";
+    }
 
-        // Reconstruct the masked input d
-        std::vector<Ring> recon_vals(num_eqz_gates, 0);
-        if (id_ != pKing) {
-            network_->send(pKing, all_share_send.data(), all_share_send.size() * sizeof(Ring));
-            usleep(latency_usec_);
-            network_->recv(pKing, recon_vals.data(), recon_vals.size() * sizeof(Ring));
-        } else {
-            std::vector<std::vector<Ring>> share_recv(nP_);
-            usleep(latency_usec_);
-            #pragma omp parallel for
-            for (int pid = 1; pid <= nP_; ++pid) {
-                share_recv[pid - 1] = std::vector<Ring>();
-                if (pid != pKing) {
-                    share_recv[pid - 1].resize(num_eqz_gates);
-                    network_->recv(pid, share_recv[pid - 1].data(), share_recv[pid - 1].size() * sizeof(Ring));
-                } else {
-                    share_recv[pid - 1].insert(share_recv[pid - 1].begin(), all_share_send.begin(), all_share_send.end());
-                }
+    // Elements begin, begin + stride, ... (count of them) of a vector of n
+    // values, the ones reconstructed by king 'pid'.
+    struct KingSlice {
+        size_t begin;
+        size_t stride;
+        size_t count;
+
+        size_t at(size_t k) const { return begin + k * stride; }
+    };
+
+    static KingSlice kingSlice(KingPolicy policy, int nP, int pid, size_t n) {
+        switch (policy) {
+            case KingPolicy::kRoundRobin: {
+                size_t first = pid - 1;
+                return {first, static_cast<size_t>(nP), n > first ? (n - first + nP - 1) / nP : 0};
             }
-            for (int pid = 0; pid < nP_; ++pid) {
-                for (int i = 0; i < num_eqz_gates; ++i) {
-                    recon_vals[i] += share_recv[pid][i];
-                }
+            case KingPolicy::kRange: {
+                size_t begin = n * (pid - 1) / nP;
+                return {begin, 1, n * pid / nP - begin};
             }
-            for (int pid = 1; pid <= nP_; ++pid) {
-                if (pid != pKing) {
-                    network_->send(pid, recon_vals.data(), recon_vals.size() * sizeof(Ring));
-                }
-            }
-            // Free share_recv after reconstruction
-            share_recv.clear();
-            share_recv.shrink_to_fit();
-        }
-        // Free all_share_send after reconstruction
-        all_share_send.clear();
-        all_share_send.shrink_to_fit();
-
-        // Evaluate the multK circuit with bits of d as input
-        BoolEval bool_eval(id_, nP_, network_, vpreproc, multk_circ, 200, latency_usec_ / 1000);
-        for (int i = 0; i < num_eqz_gates; ++i) {
-            auto *pre_eqz = static_cast<PreprocEqzGate<Ring> *>(preproc_.gates[eqz_gates[i].out].get());
-            Ring recon_d = recon_vals[i];
-            auto recon_d_bits = bitDecomposeTwo(recon_d); // Treat as constant
-            for (size_t j = 0; j < multk_circ.gates_by_level[0].size(); ++j) {
-                const auto &bool_gate = multk_circ.gates_by_level[0][j];
-                if (bool_gate->type == common::utils::GateType::kInp) {
-                    bool_eval.vwires[i][bool_gate->out] = 1 + recon_d_bits[j] + pre_eqz->share_r_bits[j].valueAt();
-                }
+            case KingPolicy::kFixed:
+            default:
+                return {0, 1, pid == 1 ? n : 0};
+        }
+    }
+
+    // Reconstruct 'shares' combined with 'op' over all parties in two rounds.
+    // Every value is reconstructed by the king 'policy' assigns to it, which
+    // also combines flip[k] into value k if present and sends the result
+    // back to the other parties.
+    template <class T, class Op>
+    static std::vector<T> kingReconstruct(int id, int nP, KingPolicy policy, io::NetIOMP &network, int latency_usec,
+                                          std::vector<T> shares, const std::vector<T> &flip, Op op) {
+        size_t n = shares.size();
+        std::vector<KingSlice> slices(nP);
+        for (int pid = 1; pid <= nP; ++pid) { slices[pid - 1] = kingSlice(policy, nP, pid, n); }
+
+        std::vector<T> packed;
+        for (int pid = 1; pid <= nP; ++pid) {
+            const auto &slice = slices[pid - 1];
+            if (pid == id || slice.count == 0) { continue; }
+            if (slice.stride == 1) {
+                network.send(pid, shares.data() + slice.begin, slice.count * sizeof(T));
+            } else {
+                packed.resize(slice.count);
+                for (size_t k = 0; k < slice.count; ++k) { packed[k] = shares[slice.at(k)]; }
+                network.send(pid, packed.data(), slice.count * sizeof(T));
             }
+            network.flush(pid);
         }
-        bool_eval.evaluateAllLevels();
-        auto output_shares = bool_eval.getOutputShares();
-
-        // Reconstruct the output shares of the multK circuit to compute EQZ and share it in clear
-        std::vector<BoolRing> all_out_send(output_shares.size()); // Each EQZ gate has just 1 output wire. So size=1*num_eqz
-        for (int i = 0; i < output_shares.size(); ++i) {
-            all_out_send[i] = output_shares[i][0];
-        }
-        std::vector<Ring> recon_out(num_eqz_gates);
-        if (id_ != pKing) {
-            auto net_data_send = BoolRing::pack(all_out_send.data(), all_out_send.size());
-            network_->send(pKing, net_data_send.data(), net_data_send.size() * sizeof(uint8_t));
-            usleep(latency_usec_);
-            network_->recv(pKing, recon_out.data(), recon_out.size() * sizeof(Ring));
-        } else {
-            auto nbytes = (all_out_send.size() + 7) / 8;
-            std::vector<std::vector<BoolRing>> all_out_recv(nP_);
-            std::vector<BoolRing> out(num_eqz_gates, BoolRing(0));
-            usleep(latency_usec_);
+        waitLatency(latency_usec);
+
+        const auto &mine = slices[id - 1];
+        std::vector<std::vector<T>> recv_party(nP);
+        if (mine.count != 0) {
             #pragma omp parallel for
-            for (int pid = 1; pid <= nP_; ++pid) {
-                if (pid != pKing) {
-                    std::vector<uint8_t> out_recv(nbytes);
-                    network_->recv(pid, out_recv.data(), out_recv.size() * sizeof(uint8_t));
-                    all_out_recv[pid - 1] = BoolRing::unpack(out_recv.data(), all_out_send.size());
-                } else {
-                    all_out_recv[pid - 1] = all_out_send;
+            for (int pid = 1; pid <= nP; ++pid) {
+                if (pid != id) {
+                    recv_party[pid - 1].resize(mine.count);
+                    network.recv(pid, recv_party[pid - 1].data(), mine.count * sizeof(T));
                 }
             }
-            for (int pid = 0; pid < nP_; ++pid) {
-                for (int i = 0; i < num_eqz_gates; ++i) {
-                    out[i] += all_out_recv[pid][i];
+            std::vector<T> vals(mine.count);
+            for (size_t k = 0; k < mine.count; ++k) {
+                size_t idx = mine.at(k);
+                T val = shares[idx];
+                for (int pid = 1; pid <= nP; ++pid) {
+                    if (pid != id) { val = op(val, recv_party[pid - 1][k]); }
                 }
+                if (idx < flip.size()) { val = op(val, flip[idx]); }
+                vals[k] = val;
+                shares[idx] = val;
             }
-            for (int i = 0; i < out.size(); ++i) {
-                if (out[i] == BoolRing(1)) {
-                    recon_out[i] = Ring(1);
-                } else {
-                    recon_out[i] = Ring(0);
+            for (int pid = 1; pid <= nP; ++pid) {
+                if (pid != id) {
+                    network.send(pid, vals.data(), mine.count * sizeof(T));
+                    network.flush(pid);
                 }
             }
-            for (int pid = 1; pid <= nP_; ++pid) {
-                if (pid != pKing) {
-                    network_->send(pid, recon_out.data(), recon_out.size() * sizeof(Ring));
+        }
+
+        #pragma omp parallel for
+        for (int pid = 1; pid <= nP; ++pid) {
+            const auto &slice = slices[pid - 1];
+            if (pid == id || slice.count == 0) { continue; }
+            recv_party[pid - 1].resize(slice.count);
+            network.recv(pid, recv_party[pid - 1].data(), slice.count * sizeof(T));
+            for (size_t k = 0; k < slice.count; ++k) { shares[slice.at(k)] = recv_party[pid - 1][k]; }
+        }
+        return shares;
+    }
+
+    // Reveal the packed bits 'shares' XORed over all parties. The kings
+    // optionally flip the bits in 'flip' before sending the result back.
+    static std::vector<uint64_t> revealPackedBits(int id, int nP, KingPolicy policy, io::NetIOMP &network, int latency_usec,
+                                                  std::vector<uint64_t> shares, const std::vector<uint64_t> &flip) {
+        return kingReconstruct(id, nP, policy, network, latency_usec, std::move(shares), flip,
+                               [](uint64_t lhs, uint64_t rhs) { return lhs ^ rhs; });
+    }
+
+    std::vector<Ring> OnlineEvaluator::reconstruct(const std::shared_ptr<io::NetIOMP> &net, std::vector<Ring> shares) {
+        return kingReconstruct(id_, nP_, king_policy_, *net, latency_usec_, std::move(shares), std::vector<Ring>(),
+                               [](Ring lhs, Ring rhs) { return lhs + rhs; });
+    }
+
+    std::vector<PreprocCmpGroup<Ring> *> OnlineEvaluator::cmpGroups(const std::vector<common::utils::FIn1Gate> &gates) {
+        std::vector<PreprocCmpGroup<Ring> *> groups;
+        groups.reserve((gates.size() + 63) / 64);
+        for (size_t i = 0; i < gates.size(); i += 64) {
+            groups.push_back(static_cast<PreprocCmpGroup<Ring> *>(preproc_.gates.at(gates[i].out).get()));
+        }
+        return groups;
+    }
+
+    // Concatenate the one-word preprocessing of every group into the layout
+    // of BitslicedBoolEval, group g providing word g.
+    static PackedBoolPreproc stackBoolPreproc(const std::vector<PreprocCmpGroup<Ring> *> &groups, size_t num_instances) {
+        PackedBoolPreproc packed;
+        packed.num_instances = num_instances;
+        packed.num_words = groups.size();
+        if (groups.empty()) { return packed; }
+        size_t nw = groups.size();
+        size_t num_wires = groups[0]->bool_preproc.gates.size();
+        packed.gates.resize(num_wires);
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (size_t w = 0; w < num_wires; ++w) {
+            size_t num_vals = groups[0]->bool_preproc.gates[w].size();
+            if (num_vals == 0) { continue; }
+            auto &dst = packed.gates[w];
+            dst.resize(num_vals * nw);
+            for (size_t g = 0; g < nw; ++g) {
+                const auto &src = groups[g]->bool_preproc.gates[w];
+                for (size_t v = 0; v < num_vals; ++v) { dst[v * nw + g] = src[v]; }
+            }
+        }
+        return packed;
+    }
+
+    void OnlineEvaluator::eqzEvaluate(const std::vector<common::utils::FIn1Gate> &eqz_gates) {
+        eqzEvaluate(network_, eqz_gates);
+    }
+
+    void OnlineEvaluator::eqzEvaluate(const std::shared_ptr<io::NetIOMP> &net, const std::vector<common::utils::FIn1Gate> &eqz_gates) {
+        if (id_ == 0) { return; }
+        const auto &multk_circ = common::utils::multKCircuit(circ_.cmp_radix);
+        size_t num_eqz_gates = eqz_gates.size();
+        std::vector<Ring> all_share_send;
+        all_share_send.reserve(num_eqz_gates);
+        // Gate i is lane i % 64 of the preprocessing group stored at gate 64 * (i / 64).
+        auto groups = cmpGroups(eqz_gates);
+
+        // Compute share of d = input + random_value
+        for (size_t i = 0; i < num_eqz_gates; ++i) {
+            Ring share_d = wires_[eqz_gates[i].in] + groups[i / 64]->share_r[i % 64].valueAt();
+            all_share_send.push_back(share_d);
+        }
+
+        // Reconstruct the masked input d
+        auto recon_vals = reconstruct(net, std::move(all_share_send));
+
+        // Evaluate the multK circuit with bits of d as input, 64 gates per word.
+        // The complemented bits of d are public and input by party 1.
+        BitslicedBoolEval bool_eval(id_, nP_, net, stackBoolPreproc(groups, num_eqz_gates), multk_circ,
+                                    latency_usec_ / 1000);
+        const auto &inputs = multk_circ.gates_by_level[0];
+        #pragma omp parallel for
+        for (size_t w = 0; w < bool_eval.num_words; ++w) {
+            size_t end = std::min(num_eqz_gates, 64 * (w + 1));
+            for (size_t i = 64 * w; i < end; ++i) {
+                for (size_t j = 0; j < inputs.size(); ++j) {
+                    if (inputs[j]->type != common::utils::GateType::kInp) { continue; }
+                    uint64_t d_bit = (recon_vals[i] >> j) & 1;
+                    if (id_ == 1) { bool_eval.wire(inputs[j]->out)[w] |= (~d_bit & 1) << (i % 64); }
                 }
             }
+            // Add the shares of the mask bits, 64 lanes at a time.
+            for (size_t j = 0; j < inputs.size(); ++j) {
+                if (inputs[j]->type != common::utils::GateType::kInp) { continue; }
+                bool_eval.wire(inputs[j]->out)[w] ^= groups[w]->share_r_bits[j];
+            }
         }
-        for (int i = 0; i < num_eqz_gates; ++i) {
-            wires_[eqz_gates[i].out] = recon_out[i]; // Reconstructed output
+        bool_eval.evaluateAllLevels();
+
+        // Reveal the output of the multK circuit masked by the output bits
+        const uint64_t *out_share = bool_eval.output(0);
+        std::vector<uint64_t> masked_out(out_share, out_share + bool_eval.num_words);
+        for (size_t w = 0; w < masked_out.size(); ++w) { masked_out[w] ^= groups[w]->share_mask_bits; }
+        auto recon_out = revealPackedBits(id_, nP_, king_policy_, *net, latency_usec_, std::move(masked_out), {});
+        unmaskCmpOutputs(eqz_gates, groups, recon_out);
+    }
+
+    void OnlineEvaluator::unmaskCmpOutputs(const std::vector<common::utils::FIn1Gate> &gates,
+                                           const std::vector<PreprocCmpGroup<Ring> *> &groups,
+                                           const std::vector<uint64_t> &masked) {
+        // With c = b ^ m public, b = c + m - 2cm is linear in the shares of m.
+        for (size_t i = 0; i < gates.size(); ++i) {
+            Ring c = (masked[i / 64] >> (i % 64)) & 1;
+            Ring out = groups[i / 64]->share_mask[i % 64].valueAt() * (Ring(1) - 2 * c);
+            if (id_ == 1) { out += c; }
+            wires_[gates[i].out] = out;
         }
     }
 
-    void OnlineEvaluator::ltzEvaluate(const std::vector<common::utils::FIn1Gate> &ltz_gates) {
+    void OnlineEvaluator::truncEvaluate(const std::vector<common::utils::TruncGate> &trunc_gates) {
+        truncEvaluate(network_, trunc_gates);
+    }
+
+    void OnlineEvaluator::truncEvaluate(const std::shared_ptr<io::NetIOMP> &net,
+                                        const std::vector<common::utils::TruncGate> &trunc_gates) {
         if (id_ == 0) { return; }
-        int pKing = 1; // Designated king party
-        auto prefixOR_circ = common::utils::Circuit<BoolRing>::generateParaPrefixOR(2).orderGatesByLevel();
+        // Inputs are shifted by 2^(l-2) to be non-negative and below 2^(l-1),
+        // so x + r wraps around iff the MSB of r is set and that of the
+        // revealed value is not.
+        constexpr Ring kOffset = Ring(1) << (RINGSIZEBITS - 2);
+        size_t num_trunc_gates = trunc_gates.size();
+        std::vector<Ring> all_share_send(num_trunc_gates);
+        for (size_t i = 0; i < num_trunc_gates; ++i) {
+            auto *pregate = static_cast<PreprocTruncGate<Ring> *>(preproc_.gates.at(trunc_gates[i].out).get());
+            all_share_send[i] = wires_[trunc_gates[i].in] + pregate->share_r.valueAt() + (id_ == 1 ? kOffset : Ring(0));
+        }
+
+        auto recon_vals = reconstruct(net, std::move(all_share_send));
+
+        for (size_t i = 0; i < num_trunc_gates; ++i) {
+            const auto &g = trunc_gates[i];
+            auto *pregate = static_cast<PreprocTruncGate<Ring> *>(preproc_.gates.at(g.out).get());
+            Ring c = recon_vals[i];
+            Ring c_msb = c >> (RINGSIZEBITS - 1);
+            Ring out = (Ring(1) - c_msb) * (pregate->share_r_msb.valueAt() << (RINGSIZEBITS - g.shift))
+                       - pregate->share_r_hi.valueAt();
+            if (id_ == 1) { out += (c >> g.shift) - (kOffset >> g.shift); }
+            wires_[g.out] = out;
+        }
+    }
+
+    void OnlineEvaluator::ltzEvaluate(const std::vector<common::utils::FIn1Gate> &ltz_gates, bool reveal) {
+        ltzEvaluate(network_, ltz_gates, reveal);
+    }
+
+    void OnlineEvaluator::ltzEvaluate(const std::shared_ptr<io::NetIOMP> &net, const std::vector<common::utils::FIn1Gate> &ltz_gates,
+                                      bool reveal) {
+        if (id_ == 0) { return; }
+        const auto &prefixOR_circ = common::utils::prefixORCircuit(circ_.cmp_radix);
         size_t num_ltz_gates = ltz_gates.size();
         std::vector<Ring> all_share_send;
         all_share_send.reserve(num_ltz_gates);
-        std::vector<preprocg_ptr_t<BoolRing> *> vpreproc;
-        vpreproc.reserve(num_ltz_gates);
+        // Gate i is lane i % 64 of the preprocessing group stored at gate 64 * (i / 64).
+        auto groups = cmpGroups(ltz_gates);
 
         // Compute share of a = input + random_value
-        for (auto &ltz_gate : ltz_gates) {
-            auto *pre_ltz = static_cast<PreprocLtzGate<Ring> *>(preproc_.gates[ltz_gate.out].get());
-            Ring share_a = ltz_gate.in + pre_ltz->share_r.valueAt();
+        for (size_t i = 0; i < num_ltz_gates; ++i) {
+            Ring share_a = wires_[ltz_gates[i].in] + groups[i / 64]->share_r[i % 64].valueAt();
             all_share_send.push_back(share_a);
-            vpreproc.push_back(pre_ltz->PrefixOR_gates.data());
         }
 
         // Reconstruct the masked input a
         // Use integer bit-shift instead of pow to avoid double->Ring overflow
         Ring M = (Ring(1) << (RINGSIZEBITS - 1)); // M = half of ring size
-        std::vector<Ring> recon_vals_a(num_ltz_gates, 0); // a = x + r
-        std::vector<Ring> recon_vals_b(num_ltz_gates, M); // b = a + M
-        if (id_ != pKing) {
-            network_->send(pKing, all_share_send.data(), all_share_send.size() * sizeof(Ring));
-            usleep(latency_usec_);
-            network_->recv(pKing, recon_vals_a.data(), recon_vals_a.size() * sizeof(Ring));
-            for (int i = 0; i < num_ltz_gates; ++i) {
-                recon_vals_b[i] += recon_vals_a[i];
-            }
-        } else {
-            std::vector<std::vector<Ring>> share_recv(nP_);
-            usleep(latency_usec_);
-            #pragma omp parallel for
-            for (int pid = 1; pid <= nP_; ++pid) {
-                share_recv[pid - 1] = std::vector<Ring>();
-                if (pid != pKing) {
-                    share_recv[pid - 1].resize(num_ltz_gates);
-                    network_->recv(pid, share_recv[pid - 1].data(), share_recv[pid - 1].size() * sizeof(Ring));
-                } else {
-                    share_recv[pid - 1].insert(share_recv[pid - 1].begin(), all_share_send.begin(), all_share_send.end());
-                }
-            }
-            for (int pid = 0; pid < nP_; ++pid) {
-                for (int i = 0; i < num_ltz_gates; ++i) {
-                    recon_vals_a[i] += share_recv[pid][i];
-                    recon_vals_b[i] += share_recv[pid][i];
-                }
-            }
-            for (int pid = 1; pid <= nP_; ++pid) {
-                if (pid != pKing) {
-                    network_->send(pid, recon_vals_a.data(), recon_vals_a.size() * sizeof(Ring));
-                }
-            }
+        auto recon_vals_a = reconstruct(net, std::move(all_share_send)); // a = x + r
+        std::vector<Ring> recon_vals_b(num_ltz_gates); // b = a + M
+        for (size_t i = 0; i < num_ltz_gates; ++i) {
+            recon_vals_b[i] = recon_vals_a[i] + M;
         }
 
-        // Evaluate the prefixOR circuit with bits of a and b as inputs
-        BoolEval bool_eval(id_, nP_, network_, vpreproc, prefixOR_circ);
-        for (int i = 0; i < num_ltz_gates; ++i) {
-            auto recon_a_bits = bitDecomposeTwo(recon_vals_a[i]);
-            auto recon_b_bits = bitDecomposeTwo(recon_vals_b[i]);
-            for (int j = 0; j < prefixOR_circ.gates_by_level[0].size(); ++j) {
-                const auto &gate = prefixOR_circ.gates_by_level[0][j];
-                if (gate->type == common::utils::GateType::kInp) {
-                    if (j < RINGSIZEBITS) {
-                        bool_eval.vwires[i][gate->out] = 1 + recon_a_bits[RINGSIZEBITS - 1 - j];
-                    } else if (j < 2 * RINGSIZEBITS) {
-                        bool_eval.vwires[i][gate->out] = 1 + recon_b_bits[2 * RINGSIZEBITS - 1 - j];
-                    } else if (j < 3 * RINGSIZEBITS) {
-                        bool_eval.vwires[i][gate->out] = 0;
-                    } else {
-                        bool_eval.vwires[i][gate->out] = 0;
-                    }
+        // Evaluate the prefixOR circuit with bits of a and b as inputs, 64 gates per word.
+        // The complemented bits of a and b are public and input by party 1.
+        BitslicedBoolEval bool_eval(id_, nP_, net, stackBoolPreproc(groups, num_ltz_gates), prefixOR_circ,
+                                    latency_usec_ / 1000);
+        const auto &inputs = prefixOR_circ.gates_by_level[0];
+        // b < M is public and XORed into the output by the king.
+        std::vector<uint64_t> lt_bM(bool_eval.num_words, 0);
+        #pragma omp parallel for
+        for (size_t w = 0; w < bool_eval.num_words; ++w) {
+            size_t end = std::min(num_ltz_gates, 64 * (w + 1));
+            for (size_t i = 64 * w; i < end; ++i) {
+                uint64_t bit = 1ULL << (i % 64);
+                for (size_t j = 0; j < inputs.size() && j < 2 * RINGSIZEBITS; ++j) {
+                    if (inputs[j]->type != common::utils::GateType::kInp) { continue; }
+                    bool val = j < RINGSIZEBITS ? (recon_vals_a[i] >> (RINGSIZEBITS - 1 - j)) & 1
+                                                : (recon_vals_b[i] >> (2 * RINGSIZEBITS - 1 - j)) & 1;
+                    if (!val && id_ == 1) { bool_eval.wire(inputs[j]->out)[w] |= bit; }
                 }
+                if (recon_vals_b[i] < M) { lt_bM[w] |= bit; }
+            }
+            // Both comparisons are against r: its bits are XORed into the
+            // complemented bits of a and b, and select the bit at the first
+            // difference in the dot product inputs.
+            for (size_t j = 0; j < inputs.size() && j < 4 * RINGSIZEBITS; ++j) {
+                if (inputs[j]->type != common::utils::GateType::kInp) { continue; }
+                bool_eval.wire(inputs[j]->out)[w] ^= groups[w]->share_r_bits[j % RINGSIZEBITS];
             }
         }
         bool_eval.evaluateAllLevels();
-        auto output_shares = bool_eval.getOutputShares();
-
-        // Reconstruct the output shares of the prefix_OR circuit to compute LTZ and share it in clear
-        std::vector<BoolRing> all_out_send(output_shares.size()); // Each LTZ gate has just 1 output wire. So size=1*num_ltz
-        for (int i = 0; i < output_shares.size(); ++i) {
-            all_out_send[i] = output_shares[i][0];
-        }
-        std::vector<Ring> recon_out(num_ltz_gates);
-        if (id_ != pKing) {
-            auto net_data_send = BoolRing::pack(all_out_send.data(), all_out_send.size());
-            network_->send(pKing, net_data_send.data(), net_data_send.size() * sizeof(uint8_t));
-            usleep(250);
-            network_->recv(pKing, recon_out.data(), recon_out.size() * sizeof(Ring));
-        } else {
-            auto nbytes = (all_out_send.size() + 7) / 8;
-            std::vector<std::vector<BoolRing>> all_out_recv(nP_);
-            std::vector<BoolRing> out(num_ltz_gates, BoolRing(0));
-            usleep(250);
-            #pragma omp parallel for
-            for (int pid = 1; pid <= nP_; ++pid) {
-                std::vector<uint8_t> out_recv(nbytes);
-                if (pid != pKing) {
-                    network_->recv(pid, out_recv.data(), out_recv.size() * sizeof(uint8_t));
-                    all_out_recv[pid - 1] = BoolRing::unpack(out_recv.data(), all_out_send.size());
-                } else {
-                    all_out_recv[pid - 1] = all_out_send;
-                }
-            }
-            for (int pid = 0; pid < nP_; ++pid) {
-                for (int i = 0; i < num_ltz_gates; ++i) {
-                    out[i] += all_out_recv[pid][i];
-                }
-            }
-            for (int i = 0; i < out.size(); ++i) {
-                auto lt_bM = recon_vals_b[i] < M; // Locally compute if b<M and XOR to output of prefixOR circuit
-                auto ltz = out[i].val() ^ lt_bM;
-                if (ltz) {
-                    recon_out[i] = Ring(1);
-                } else {
-                    recon_out[i] = Ring(0);
-                }
-            }
-            for (int pid = 1; pid <= nP_; ++pid) {
-                if (pid != pKing) {
-                    network_->send(pid, recon_out.data(), recon_out.size() * sizeof(Ring));
-                }
-            }
+
+        // Reveal the output of the prefix_OR circuit, masked by the output bits
+        // unless the result is public.
+        const uint64_t *out_share = bool_eval.output(0);
+        std::vector<uint64_t> masked_out(out_share, out_share + bool_eval.num_words);
+        if (!reveal) {
+            for (size_t w = 0; w < masked_out.size(); ++w) { masked_out[w] ^= groups[w]->share_mask_bits; }
+        }
+        auto recon_out = revealPackedBits(id_, nP_, king_policy_, *net, latency_usec_, std::move(masked_out), lt_bM);
+        if (!reveal) {
+            unmaskCmpOutputs(ltz_gates, groups, recon_out);
+            return;
+        }
+        for (size_t i = 0; i < num_ltz_gates; ++i) {
+            wires_[ltz_gates[i].out] = Ring((recon_out[i / 64] >> (i % 64)) & 1); // Reconstructed output
+        }
+    }
+
+    void OnlineEvaluator::deferGates(const std::vector<common::utils::wire_t> &outs) {
+        deferred_.insert(outs.begin(), outs.end());
+    }
+
+    std::vector<Ring> OnlineEvaluator::revealLessThan(const std::vector<common::utils::wire_t> &lhs,
+                                                      const std::vector<common::utils::wire_t> &rhs,
+                                                      const std::vector<common::utils::wire_t> &cmp_gates) {
+        if (lhs.size() != rhs.size() || cmp_gates.size() < lhs.size()) {
+            throw std::invalid_argument("Mismatched comparison inputs.");
+        }
+        std::vector<Ring> res(lhs.size(), 0);
+        if (id_ == 0 || lhs.empty()) { return res; }
+        // The output wire of each gate holds the difference to compare until
+        // ltzEvaluate overwrites it with the result.
+        std::vector<common::utils::FIn1Gate> ltz_gates;
+        ltz_gates.reserve(lhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            wires_[cmp_gates[i]] = wires_[lhs[i]] - wires_[rhs[i]];
+            ltz_gates.emplace_back(common::utils::GateType::kLtz, cmp_gates[i], cmp_gates[i]);
+        }
+        size_t waits_before = latency_waits;
+        ltzEvaluate(ltz_gates, true);
+        rounds_ += latency_waits - waits_before;
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            res[i] = wires_[cmp_gates[i]];
         }
-        for (int i = 0; i < num_ltz_gates; ++i) {
-            wires_[ltz_gates[i].out] = recon_out[i]; // Reconstructed output
+        // The preprocessing is single use.
+        for (size_t i = 0; i < lhs.size(); i += 64) {
+            preproc_.gates.erase(cmp_gates[i]);
         }
+        return res;
     }
 
+    std::vector<Ring> OnlineEvaluator::revealWires(const std::vector<common::utils::wire_t> &wires) {
+        std::vector<Ring> res(wires.size());
+        if (wires.empty()) { return res; }
+        if (id_ == 0) {
+            network_->recv(1, res.data(), res.size() * sizeof(Ring));
+            return res;
+        }
+        for (size_t i = 0; i < wires.size(); ++i) { res[i] = wires_[wires[i]]; }
+        size_t waits_before = latency_waits;
+        res = reconstruct(network_, std::move(res));
+        rounds_ += latency_waits - waits_before;
+        if (id_ == 1) {
+            network_->send(0, res.data(), res.size() * sizeof(Ring));
+            network_->flush(0);
+        }
+        return res;
+    }
 
     void OnlineEvaluator::shuffleEvaluate(const std::vector<common::utils::SIMDOGate> &shuffle_gates) {
+        shuffleEvaluate(network_, shuffle_gates);
+    }
+
+    void OnlineEvaluator::shuffleEvaluate(const std::shared_ptr<io::NetIOMP> &net, const std::vector<common::utils::SIMDOGate> &shuffle_gates) {
         if (id_ == 0) { return; }
-        std::vector<Ring> z_all;
-        std::vector<std::vector<Ring>> z_sum;
-        size_t total_comm = 0;
+        // The masked vectors pass through the parties one gate at a time, so
+        // party i + 1 permutes gate g while party i works on gate g + 1.
+        // Vectors are received in chunks that are permuted as they arrive.
+        // The permutations themselves stay uniformly random, so a gate is
+        // only forwarded once all of it has been received.
+        constexpr size_t kChunk = 1 << 14;
+
+        if (id_ != 1) {
+            std::vector<Ring> z_all;
+            for (auto &gate : shuffle_gates) {
+                auto *pre_shuffle = static_cast<PreprocShuffleGate<Ring> *>(preproc_.gates.at(gate.out).get());
+                for (size_t i = 0; i < gate.in.size(); ++i) {
+                    z_all.push_back(wires_[gate.in[i]] - pre_shuffle->a[i].valueAt());
+                }
+            }
+            net->send(1, z_all.data(), z_all.size() * sizeof(Ring));
+            net->flush(1);
+        }
+        waitLatency(latency_usec_);
 
+        std::vector<Ring> z;
+        std::vector<Ring> z_send;
+        std::vector<std::vector<Ring>> z_recv_all(nP_);
         for (auto &gate : shuffle_gates) {
-            auto *pre_shuffle = static_cast<PreprocShuffleGate<Ring> *>(preproc_.gates[gate.out].get());
+            auto *pre_shuffle = static_cast<PreprocShuffleGate<Ring> *>(preproc_.gates.at(gate.out).get());
             size_t vec_size = gate.in.size();
-            total_comm += vec_size;
-            std::vector<Ring> z(vec_size, 0);
-            if (id_ != 1) {
-                for (int i = 0; i < vec_size; ++i) {
-                    z[i] = wires_[gate.in[i]] - pre_shuffle->a[i].valueAt();
+            z_send.assign(vec_size, 0);
+            if (id_ == 1) {
+                #pragma omp parallel for
+                for (int pid = 2; pid <= nP_; ++pid) {
+                    z_recv_all[pid - 1].resize(vec_size);
+                    net->recv(pid, z_recv_all[pid - 1].data(), vec_size * sizeof(Ring));
+                }
+                z.resize(vec_size);
+                for (size_t i = 0; i < vec_size; ++i) {
+                    z[i] = wires_[gate.in[i]];
+                    for (int pid = 2; pid <= nP_; ++pid) { z[i] += z_recv_all[pid - 1][i]; }
                 }
-                z_all.insert(z_all.end(), z.begin(), z.end());
+                // Position i moves to pi[i], matching the dealer's delta.
+                common::utils::permuteScatter(z.data(), pre_shuffle->pi.data(), vec_size, z_send.data());
             } else {
-                z_sum.push_back(z);
-            }
-        }
-
-        if (id_ == 1) {
-            usleep(latency_usec_);
-            std::vector<std::vector<Ring>> z_recv_all(nP_);
-            #pragma omp parallel for
-            for (int pid = 2; pid <= nP_; ++pid) {
-                z_recv_all[pid - 1] = std::vector<Ring>(total_comm);
-                network_->recv(pid, z_recv_all[pid - 1].data(), z_recv_all[pid - 1].size() * sizeof(Ring));
-            }
-            for (int pid = 1; pid < nP_; ++pid) {
-                size_t idx_vec = 0;
-                for (int idx_gate = 0; idx_gate < shuffle_gates.size(); ++idx_gate) {
-                    size_t vec_size = shuffle_gates[idx_gate].in.size();
-                    std::vector<Ring> z(z_recv_all[pid].begin() + idx_vec, z_recv_all[pid].begin() + idx_vec + vec_size);
-                    for (int i = 0; i < vec_size; ++i) {
-                        z_sum[idx_gate][i] += z[i];
-                    }
-                    idx_vec += vec_size;
+                z.resize(vec_size);
+                for (size_t begin = 0; begin < vec_size; begin += kChunk) {
+                    size_t end = std::min(vec_size, begin + kChunk);
+                    net->recv(id_ - 1, z.data() + begin, (end - begin) * sizeof(Ring));
+                    common::utils::permuteScatter(z.data() + begin, pre_shuffle->pi.data() + begin, end - begin,
+                                                  z_send.data());
                 }
             }
-
-            z_all.reserve(total_comm);
-            for (int idx_gate = 0; idx_gate < shuffle_gates.size(); ++idx_gate) {
-                auto *pre_shuffle = static_cast<PreprocShuffleGate<Ring> *>(preproc_.gates[shuffle_gates[idx_gate].out].get());
-                size_t vec_size = shuffle_gates[idx_gate].in.size();
-                std::vector<Ring> z(vec_size);
-                for (int i = 0; i < vec_size; ++i) {
-                    z[i] = z_sum[idx_gate][pre_shuffle->pi[i]] + wires_[shuffle_gates[idx_gate].in[pre_shuffle->pi[i]]]
-                           - pre_shuffle->c[i].valueAt();
-                    wires_[shuffle_gates[idx_gate].outs[i]] = pre_shuffle->b[i].valueAt();
-                }
-                z_all.insert(z_all.end(), z.begin(), z.end());
-            }
-            network_->send(2, z_all.data(), z_all.size() * sizeof(Ring));
-        } else {
-            network_->send(1, z_all.data(), z_all.size() * sizeof(Ring));
-            network_->flush(1);
-
-            z_all.clear();
-            z_all.resize(total_comm);
-            network_->recv(id_ - 1, z_all.data(), z_all.size() * sizeof(Ring));
-            usleep(latency_usec_);
-            for (int idx_gate = 0, idx_vec = 0; idx_gate < shuffle_gates.size(); ++idx_gate) {
-                auto *pre_shuffle = static_cast<PreprocShuffleGate<Ring> *>(preproc_.gates[shuffle_gates[idx_gate].out].get());
-                size_t vec_size = shuffle_gates[idx_gate].in.size();
-                std::vector<Ring> z(z_all.begin() + idx_vec, z_all.begin() + idx_vec + vec_size);
-                std::vector<Ring> z_send(vec_size);
-                for (int i = 0; i < vec_size; ++i) {
-                    if (id_ != nP_) {
-                        z_send[i] = z[pre_shuffle->pi[i]] - pre_shuffle->c[i].valueAt();
-                        wires_[shuffle_gates[idx_gate].outs[i]] = pre_shuffle->b[i].valueAt();
-                    } else {
-                        z_send[i] = z[pre_shuffle->pi[i]] + pre_shuffle->delta[i].valueAt();
-                        wires_[shuffle_gates[idx_gate].outs[i]] = z_send[i];
-                    }
-                    z_all[idx_vec++] = z_send[i];
+            for (size_t i = 0; i < vec_size; ++i) {
+                if (id_ != nP_) {
+                    z_send[i] -= pre_shuffle->c[i].valueAt();
+                } else {
+                    z_send[i] += pre_shuffle->delta[i].valueAt();
                 }
             }
+
             if (id_ != nP_) {
-                network_->send(id_ + 1, z_all.data(), z_all.size() * sizeof(Ring));
+                net->send(id_ + 1, z_send.data(), z_send.size() * sizeof(Ring));
+                net->flush(id_ + 1);
+                for (size_t i = 0; i < vec_size; ++i) {
+                    wires_[gate.outs[i]] = pre_shuffle->b[i].valueAt();
+                }
+            } else {
+                for (size_t i = 0; i < vec_size; ++i) {
+                    wires_[gate.outs[i]] = z_send[i];
+                }
             }
         }
     }
 
     void OnlineEvaluator::permAndShEvaluate(const std::vector<common::utils::SIMDOGate> &permAndSh_gates) {
-        if (id_ == 0) { return; }
-        #pragma omp parallel sections
-        {
-            #pragma omp section
-            {
-                if (nP_ < 10) { omp_set_num_threads(nP_); }
-                else { omp_set_num_threads(10); }
-                #pragma omp parallel for
-                for (int idx_gate = 0; idx_gate < permAndSh_gates.size(); ++idx_gate) {
-                    auto *pre_permAndSh = static_cast<PreprocPermAndShGate<Ring> *>(preproc_.gates[permAndSh_gates[idx_gate].out].get());
-                    size_t vec_size = permAndSh_gates[idx_gate].in.size();
-                    std::vector<Ring> z(vec_size, 0);
-                    if (id_ != permAndSh_gates[idx_gate].owner) {
-                        for (int i = 0; i < vec_size; ++i) {
-                            z[i] = wires_[permAndSh_gates[idx_gate].in[i]] - pre_permAndSh->a[i].valueAt();
-                            wires_[permAndSh_gates[idx_gate].outs[i]] = pre_permAndSh->b[i].valueAt();
-                        }
-                        network_->send(permAndSh_gates[idx_gate].owner, z.data(), z.size() * sizeof(Ring));
-                        network_->flush(permAndSh_gates[idx_gate].owner);
-                    }
+        permAndShEvaluate(network_, permAndSh_gates);
+    }
+
+    void OnlineEvaluator::permAndShEvaluate(const std::shared_ptr<io::NetIOMP> &net, const std::vector<common::utils::SIMDOGate> &permAndSh_gates) {
+        if (id_ == 0 || permAndSh_gates.empty()) { return; }
+        // The gates of a level are batched by owner. Every party streams its
+        // masked inputs to each other owner, while it aggregates the streams
+        // of its own gates as they arrive.
+        std::vector<std::vector<const common::utils::SIMDOGate *>> owned(nP_);
+        std::vector<std::vector<size_t>> offset(nP_, std::vector<size_t>(1, 0));
+        for (const auto &gate : permAndSh_gates) {
+            if (gate.owner < 1 || gate.owner > nP_) { throw std::invalid_argument("Invalid PermAndSh gate owner."); }
+            owned[gate.owner - 1].push_back(&gate);
+            offset[gate.owner - 1].push_back(offset[gate.owner - 1].back() + gate.in.size());
+        }
+        permAndSh_stats_.resize(nP_);
+        for (int owner = 1; owner <= nP_; ++owner) {
+            permAndSh_stats_[owner - 1].gates += owned[owner - 1].size();
+            permAndSh_stats_[owner - 1].elements += offset[owner - 1].back();
+        }
+
+        // Each send pipeline talks to a different party, so they run
+        // alongside each other and the aggregation.
+        std::vector<std::future<void>> senders;
+        for (int owner = 1; owner <= nP_; ++owner) {
+            if (owner == id_ || owned[owner - 1].empty()) { continue; }
+            senders.push_back(std::async(std::launch::async, [&, owner]() {
+                permAndShSend(net, owner, owned[owner - 1], offset[owner - 1]);
+            }));
+        }
+        if (!owned[id_ - 1].empty()) { permAndShAggregate(net, owned[id_ - 1], offset[id_ - 1]); }
+        for (auto &s : senders) { s.get(); }
+    }
+
+    void OnlineEvaluator::permAndShSend(const std::shared_ptr<io::NetIOMP> &net, int owner,
+                                        const std::vector<const common::utils::SIMDOGate *> &owned,
+                                        const std::vector<size_t> &offset) {
+        auto start = std::chrono::steady_clock::now();
+        // The stream is sent in chunks of kPermAndShChunk entries, so the
+        // owner can aggregate the first gates while the rest is in flight.
+        std::vector<Ring> z(std::min(kPermAndShChunk, offset.back()));
+        size_t filled = 0;
+        for (const auto *gate : owned) {
+            auto *pre_permAndSh = static_cast<PreprocPermAndShGate<Ring> *>(preproc_.gates.at(gate->out).get());
+            for (size_t i = 0; i < gate->in.size(); ++i) {
+                z[filled++] = wires_[gate->in[i]] - pre_permAndSh->a[i].valueAt();
+                wires_[gate->outs[i]] = pre_permAndSh->b[i].valueAt();
+                if (filled == z.size()) {
+                    net->send(owner, z.data(), filled * sizeof(Ring));
+                    net->flush(owner);
+                    filled = 0;
                 }
             }
+        }
+        if (filled != 0) {
+            net->send(owner, z.data(), filled * sizeof(Ring));
+            net->flush(owner);
+        }
+        permAndSh_stats_[owner - 1].time_ms +=
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
 
-            #pragma omp section
-            {
-                usleep(250);
-                for (int idx_gate = 0; idx_gate < permAndSh_gates.size(); ++idx_gate) {
-                    if (id_ == permAndSh_gates[idx_gate].owner) {
-                        auto *pre_permAndSh = static_cast<PreprocPermAndShGate<Ring> *>(preproc_.gates[permAndSh_gates[idx_gate].out].get());
-                        size_t vec_size = permAndSh_gates[idx_gate].in.size();
-                        std::vector<std::vector<Ring>> z(nP_, std::vector<Ring>(vec_size, 0));
-                        #pragma omp parallel for
-                        for (int pid = 1; pid <= nP_; ++pid) {
-                            if (pid != permAndSh_gates[idx_gate].owner) {
-                                std::vector<Ring> z_recv(vec_size);
-                                network_->recv(pid, z_recv.data(), z_recv.size() * sizeof(Ring));
-                                for (int i = 0; i < vec_size; ++i) {
-                                    z[pid - 1][i] += z_recv[i];
-                                }
-                            } else {
-                                for (int i = 0; i < vec_size; ++i) {
-                                    z[pid - 1][i] += wires_[permAndSh_gates[idx_gate].in[i]];
-                                }
-                            }
-                        }
-                        for (int i = 0; i < vec_size; ++i) {
-                            Ring sum = Ring(0);
-                            for (int pid = 0; pid < nP_; ++pid) {
-                                sum += z[pid][pre_permAndSh->pi[i]];
-                            }
-                            wires_[permAndSh_gates[idx_gate].outs[i]] = sum + pre_permAndSh->delta[i].valueAt();
-                        }
+    void OnlineEvaluator::permAndShAggregate(const std::shared_ptr<io::NetIOMP> &net,
+                                             const std::vector<const common::utils::SIMDOGate *> &owned,
+                                             const std::vector<size_t> &offset) {
+        auto start = std::chrono::steady_clock::now();
+        size_t total = offset.back();
+        // Entries of the stream received from each party so far.
+        std::vector<std::vector<Ring>> z_recv(nP_);
+        std::vector<size_t> received(nP_, total);
+        std::mutex mtx;
+        std::condition_variable cv;
+        std::vector<std::future<void>> receivers;
+        for (int pid = 1; pid <= nP_; ++pid) {
+            if (pid == id_) { continue; }
+            z_recv[pid - 1].resize(total);
+            received[pid - 1] = 0;
+            receivers.push_back(std::async(std::launch::async, [&, pid]() {
+                for (size_t begin = 0; begin < total; begin += kPermAndShChunk) {
+                    size_t end = std::min(total, begin + kPermAndShChunk);
+                    net->recv(pid, z_recv[pid - 1].data() + begin, (end - begin) * sizeof(Ring));
+                    {
+                        std::lock_guard<std::mutex> lock(mtx);
+                        received[pid - 1] = end;
                     }
+                    cv.notify_one();
                 }
+            }));
+        }
+        waitLatency(latency_usec_);
+
+        std::vector<Ring> z;
+        std::vector<Ring> z_perm;
+        for (size_t k = 0; k < owned.size(); ++k) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&]() {
+                    return *std::min_element(received.begin(), received.end()) >= offset[k + 1];
+                });
             }
+            const auto *gate = owned[k];
+            auto *pre_permAndSh = static_cast<PreprocPermAndShGate<Ring> *>(preproc_.gates.at(gate->out).get());
+            size_t vec_size = gate->in.size();
+            z.resize(vec_size);
+            z_perm.resize(vec_size);
+            // Sum before permuting, so the permutation is applied once.
+            parallelFor(vec_size, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    z[i] = wires_[gate->in[i]];
+                    for (int pid = 1; pid <= nP_; ++pid) {
+                        if (pid != id_) { z[i] += z_recv[pid - 1][offset[k] + i]; }
+                    }
+                }
+            });
+            // Entry i moves to pi[i], matching the dealer's delta.
+            common::utils::permuteScatter(z.data(), pre_permAndSh->pi.data(), vec_size, z_perm.data());
+            parallelFor(vec_size, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    wires_[gate->outs[i]] = z_perm[i] + pre_permAndSh->delta[i].valueAt();
+                }
+            });
         }
+        for (auto &r : receivers) { r.get(); }
+        permAndSh_stats_[id_ - 1].time_ms +=
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
     }
 
     void OnlineEvaluator::amortzdPnSEvaluate(const std::vector<common::utils::SIMDMOGate> &amortzdPnS_gates) {
-        if (id_ == 0) { return; }
-        int pKing = 1; // Designated king party
-        std::vector<std::vector<Ring>> z_sum(nP_);
-        size_t total_comm = 0;
+        amortzdPnSEvaluate(network_, amortzdPnS_gates);
+    }
 
+    void OnlineEvaluator::amortzdPnSEvaluate(const std::shared_ptr<io::NetIOMP> &net, const std::vector<common::utils::SIMDMOGate> &amortzdPnS_gates) {
+        if (id_ == 0 || amortzdPnS_gates.empty()) { return; }
+        // The masked inputs of all gates are reconstructed together.
+        std::vector<size_t> offset(1, 0);
+        std::vector<Ring> z;
         for (auto &gate : amortzdPnS_gates) {
-            auto *pre_amortzdPnS = static_cast<PreprocAmortzdPnSGate<Ring> *>(preproc_.gates[gate.out].get());
-            size_t vec_size = gate.in.size();
-
-            std::vector<Ring> z(vec_size);
-            for (int i = 0; i < vec_size; ++i) {
-                z[i] = wires_[gate.in[i]] - pre_amortzdPnS->a[i].valueAt();
-            }
-
-            std::vector<Ring> z_recon(vec_size, 0);
-            if (id_ != pKing) {
-                network_->send(pKing, z.data(), z.size() * sizeof(Ring));
-                network_->flush(pKing);
-                usleep(250);
-                network_->recv(pKing, z_recon.data(), z_recon.size() * sizeof(Ring));
-            } else {
-                usleep(250);
-                #pragma omp parallel for
-                for (int pid = 1; pid <= nP_; ++pid) {
-                    std::vector<Ring> z_recv(vec_size);
-                    if (pid != pKing) {
-                        network_->recv(pid, z_recv.data(), z_recv.size() * sizeof(Ring));
-                        z_sum[pid - 1] = z_recv;
-                    } else {
-                        z_sum[pid - 1] = z;
-                    }
-                }
-                for (int i = 0; i < vec_size; ++i) {
-                    for (int pid = 0; pid < nP_; ++pid) {
-                        z_recon[i] += z_sum[pid][i];
-                    }
-                }
-                for (int pid = 1; pid <= nP_; ++pid) {
-                    if (pid != pKing) {
-                        network_->send(pid, z_recon.data(), z_recon.size() * sizeof(Ring));
-                        network_->flush(pid);
-                    }
-                }
+            auto *pre_amortzdPnS = static_cast<PreprocAmortzdPnSGate<Ring> *>(preproc_.gates.at(gate.out).get());
+            for (size_t i = 0; i < gate.in.size(); ++i) {
+                z.push_back(wires_[gate.in[i]] - pre_amortzdPnS->a[i].valueAt());
             }
+            offset.push_back(z.size());
+        }
+        auto z_recon = reconstruct(net, std::move(z));
 
+        std::vector<Ring> z_perm;
+        for (size_t g = 0; g < amortzdPnS_gates.size(); ++g) {
+            const auto &gate = amortzdPnS_gates[g];
+            auto *pre_amortzdPnS = static_cast<PreprocAmortzdPnSGate<Ring> *>(preproc_.gates.at(gate.out).get());
+            size_t vec_size = gate.in.size();
+            // As for kPermAndSh, the block of a party permutes its own share
+            // unmasked, and is scattered to match the dealer's delta.
+            std::vector<Ring> z_own(z_recon.begin() + offset[g], z_recon.begin() + offset[g + 1]);
+            for (size_t i = 0; i < vec_size; ++i) { z_own[i] += pre_amortzdPnS->a[i].valueAt(); }
+            z_perm.resize(vec_size);
+            common::utils::permuteScatter(z_own.data(), pre_amortzdPnS->pi.data(), vec_size, z_perm.data());
             for (int pid = 0; pid < nP_; ++pid) {
-                for (int i = 0; i < vec_size; ++i) {
-                    if (pid == id_) {
-                        wires_[gate.multi_outs[pid][i]] = z_recon[pre_amortzdPnS->pi[i]] + pre_amortzdPnS->delta[i].valueAt();
+                for (size_t i = 0; i < vec_size; ++i) {
+                    if (pid + 1 == id_) {
+                        wires_[gate.multi_outs[pid][i]] = z_perm[i] + pre_amortzdPnS->delta[i].valueAt();
                     } else {
                         wires_[gate.multi_outs[pid][i]] = pre_amortzdPnS->b[i].valueAt();
                     }
@@ -524,202 +857,180 @@ namespace grasp
     void OnlineEvaluator::evaluateGatesAtDepthPartySend(size_t depth, std::vector<Ring> &mult_vals, std::vector<Ring> &mult3_vals,
                                                         std::vector<Ring> &mult4_vals, std::vector<Ring> &dotp_vals) {
         if (id_ == 0) { return; }
-        for (auto &gate : circ_.gates_by_level[depth]) {
-            switch (gate->type) {
-                case common::utils::GateType::kMul: {
-                    auto *g = static_cast<common::utils::FIn2Gate *>(gate.get());
-                    auto *pre_out = static_cast<PreprocMultGate<Ring> *>(preproc_.gates[g->out].get());
-                    auto u = pre_out->triple_a.valueAt() - wires_[g->in1];
-                    auto v = pre_out->triple_b.valueAt() - wires_[g->in2];
-                    mult_vals.push_back(u);
-                    mult_vals.push_back(v);
-                    break;
-                }
-
-                case common::utils::GateType::kMul3: {
-                    auto *g = static_cast<common::utils::FIn3Gate *>(gate.get());
-                    auto *pre_out = static_cast<PreprocMult3Gate<Ring> *>(preproc_.gates[g->out].get());
-                    auto u = pre_out->share_a.valueAt() - wires_[g->in1];
-                    auto v = pre_out->share_b.valueAt() - wires_[g->in2];
-                    auto w = pre_out->share_c.valueAt() - wires_[g->in3];
-                    mult3_vals.push_back(u);
-                    mult3_vals.push_back(v);
-                    mult3_vals.push_back(w);
-                    break;
-                }
-
-                case common::utils::GateType::kMul4: {
-                    auto *g = static_cast<common::utils::FIn4Gate *>(gate.get());
-                    auto *pre_out = static_cast<PreprocMult4Gate<Ring> *>(preproc_.gates[g->out].get());
-                    auto u = pre_out->share_a.valueAt() - wires_[g->in1];
-                    auto v = pre_out->share_b.valueAt() - wires_[g->in2];
-                    auto w = pre_out->share_c.valueAt() - wires_[g->in3];
-                    auto x = pre_out->share_d.valueAt() - wires_[g->in4];
-                    mult4_vals.push_back(u);
-                    mult4_vals.push_back(v);
-                    mult4_vals.push_back(w);
-                    mult4_vals.push_back(x);
-                    break;
-                }
-
-                case common::utils::GateType::kDotprod: {
-                    auto *g = static_cast<common::utils::SIMDGate *>(gate.get());
-                    auto *pre_out = static_cast<PreprocDotpGate<Ring> *>(preproc_.gates[g->out].get());
-                    auto vec_len = g->in1.size();
-                    for (int i = 0; i < vec_len; ++i) {
-                        auto u = pre_out->triple_a_vec[i].valueAt() - wires_[g->in1[i]];
-                        auto v = pre_out->triple_b_vec[i].valueAt() - wires_[g->in2[i]];
-                        dotp_vals.push_back(u);
-                        dotp_vals.push_back(v);
-                    }
-                    break;
+        const auto &plan = levelPlan(depth);
+        // Gate k of a bucket writes its masked inputs at k times its fan-in.
+        mult_vals.resize(2 * plan.mult.size());
+        mult3_vals.resize(3 * plan.mult3.size());
+        mult4_vals.resize(4 * plan.mult4.size());
+        dotp_vals.resize(2 * plan.dotp_offset.back());
+
+        parallelFor(plan.mult.size(), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                auto *g = plan.mult[k];
+                auto *pre_out = static_cast<PreprocMultGate<Ring> *>(preproc_.gates.at(g->out).get());
+                mult_vals[2 * k] = pre_out->triple_a.valueAt() - wires_[g->in1];
+                mult_vals[2 * k + 1] = pre_out->triple_b.valueAt() - wires_[g->in2];
+            }
+        });
+
+        parallelFor(plan.mult3.size(), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                auto *g = plan.mult3[k];
+                auto *pre_out = static_cast<PreprocMult3Gate<Ring> *>(preproc_.gates.at(g->out).get());
+                mult3_vals[3 * k] = pre_out->share_a.valueAt() - wires_[g->in1];
+                mult3_vals[3 * k + 1] = pre_out->share_b.valueAt() - wires_[g->in2];
+                mult3_vals[3 * k + 2] = pre_out->share_c.valueAt() - wires_[g->in3];
+            }
+        });
+
+        parallelFor(plan.mult4.size(), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                auto *g = plan.mult4[k];
+                auto *pre_out = static_cast<PreprocMult4Gate<Ring> *>(preproc_.gates.at(g->out).get());
+                mult4_vals[4 * k] = pre_out->share_a.valueAt() - wires_[g->in1];
+                mult4_vals[4 * k + 1] = pre_out->share_b.valueAt() - wires_[g->in2];
+                mult4_vals[4 * k + 2] = pre_out->share_c.valueAt() - wires_[g->in3];
+                mult4_vals[4 * k + 3] = pre_out->share_d.valueAt() - wires_[g->in4];
+            }
+        });
+
+        parallelFor(plan.dotp.size(), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                auto *g = plan.dotp[k];
+                auto *pre_out = static_cast<PreprocDotpGate<Ring> *>(preproc_.gates.at(g->out).get());
+                size_t offset = 2 * plan.dotp_offset[k];
+                auto vec_len = g->in1.size();
+                for (size_t i = 0; i < vec_len; ++i) {
+                    dotp_vals[offset + 2 * i] = pre_out->triple_a_vec[i].valueAt() - wires_[g->in1[i]];
+                    dotp_vals[offset + 2 * i + 1] = pre_out->triple_b_vec[i].valueAt() - wires_[g->in2[i]];
                 }
-
-                default:
-                    break;
             }
-        }
+        });
     }
 
     void OnlineEvaluator::evaluateGatesAtDepthPartyRecv(size_t depth, std::vector<Ring> &mult_vals, std::vector<Ring> &mult3_vals,
                                                         std::vector<Ring> &mult4_vals, std::vector<Ring> &dotp_vals) {
         if (id_ == 0) { return; }
-        size_t idx_mult = 0;
-        size_t idx_mult3 = 0;
-        size_t idx_mult4 = 0;
-        size_t idx_dotp = 0;
-        for (auto &gate : circ_.gates_by_level[depth]) {
-            switch (gate->type) {
-                case common::utils::GateType::kAdd: {
-                    auto *g = static_cast<common::utils::FIn2Gate *>(gate.get());
-                    wires_[g->out] = wires_[g->in1] + wires_[g->in2];
-                    break;
-                }
-
-                case common::utils::GateType::kSub: {
-                    auto *g = static_cast<common::utils::FIn2Gate *>(gate.get());
-                    wires_[g->out] = wires_[g->in1] - wires_[g->in2];
-                    break;
-                }
-
-                case common::utils::GateType::kConstAdd: {
-                    auto *g = static_cast<common::utils::ConstOpGate<Ring> *>(gate.get());
-                    if (id_ == 1) { wires_[g->out] = wires_[g->in] + g->cval; } // Only 1 party needs to add the constant
-                    break;
+        const auto &plan = levelPlan(depth);
+        // Multiplications only read wires of earlier levels. The values of all
+        // parties for gate k start at k * nP_ times the gate's fan-in.
+        parallelFor(plan.mult.size(), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                auto *g = plan.mult[k];
+                auto *pre_out = static_cast<PreprocMultGate<Ring> *>(preproc_.gates.at(g->out).get());
+                size_t idx_mult = 2 * nP_ * k;
+                Ring u = Ring(0);
+                Ring v = Ring(0);
+                Ring a = pre_out->triple_a.valueAt();
+                Ring b = pre_out->triple_b.valueAt();
+                Ring c = pre_out->triple_c.valueAt();
+                for (int i = 1; i <= nP_; ++i) {
+                    u += mult_vals[idx_mult++];
+                    v += mult_vals[idx_mult++];
                 }
-
-                case common::utils::GateType::kConstMul: {
-                    auto *g = static_cast<common::utils::ConstOpGate<Ring> *>(gate.get());
-                    wires_[g->out] = wires_[g->in] * g->cval;
-                    break;
-                }
-
-                case common::utils::GateType::kMul: {
-                    auto *g = static_cast<common::utils::FIn2Gate *>(gate.get());
-                    auto *pre_out = static_cast<PreprocMultGate<Ring> *>(preproc_.gates[g->out].get());
-                    Ring u = Ring(0);
-                    Ring v = Ring(0);
-                    Ring a = pre_out->triple_a.valueAt();
-                    Ring b = pre_out->triple_b.valueAt();
-                    Ring c = pre_out->triple_c.valueAt();
-                    for (int i = 1; i <= nP_; ++i) {
-                        u += mult_vals[idx_mult++];
-                        v += mult_vals[idx_mult++];
-                    }
-                    wires_[g->out] = u * v + u * b + v * a + c;
-                    break;
+                // u = a - x and v = b - y, so xy = c - ub - va + uv, with
+                // the public uv added by one party.
+                wires_[g->out] = c - u * b - v * a + (id_ == 1 ? u * v : Ring(0));
+            }
+        });
+
+        parallelFor(plan.mult3.size(), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                auto *g = plan.mult3[k];
+                auto *pre_out = static_cast<PreprocMult3Gate<Ring> *>(preproc_.gates.at(g->out).get());
+                size_t idx_mult3 = 3 * nP_ * k;
+                Ring u = Ring(0);
+                Ring v = Ring(0);
+                Ring w = Ring(0);
+                Ring a = pre_out->share_a.valueAt();
+                Ring b = pre_out->share_b.valueAt();
+                Ring c = pre_out->share_c.valueAt();
+                Ring ab = pre_out->share_ab.valueAt();
+                Ring bc = pre_out->share_bc.valueAt();
+                Ring ca = pre_out->share_ca.valueAt();
+                Ring abc = pre_out->share_abc.valueAt();
+                for (int i = 1; i <= nP_; ++i) {
+                    u += mult3_vals[idx_mult3++];
+                    v += mult3_vals[idx_mult3++];
+                    w += mult3_vals[idx_mult3++];
                 }
-
-                case common::utils::GateType::kMul3: {
-                    auto *g = static_cast<common::utils::FIn3Gate *>(gate.get());
-                    auto *pre_out = static_cast<PreprocMult3Gate<Ring> *>(preproc_.gates[g->out].get());
-                    Ring u = Ring(0);
-                    Ring v = Ring(0);
-                    Ring w = Ring(0);
-                    Ring a = pre_out->share_a.valueAt();
-                    Ring b = pre_out->share_b.valueAt();
-                    Ring c = pre_out->share_c.valueAt();
-                    Ring ab = pre_out->share_ab.valueAt();
-                    Ring bc = pre_out->share_bc.valueAt();
-                    Ring ca = pre_out->share_ca.valueAt();
-                    Ring abc = pre_out->share_abc.valueAt();
-                    for (int i = 1; i <= nP_; ++i) {
-                        u += mult3_vals[idx_mult3++];
-                        v += mult3_vals[idx_mult3++];
-                        w += mult3_vals[idx_mult3++];
-                    }
-                    wires_[g->out] = (u * v * w) + (u * v * c) + (u * w * b) + (v * w * a) + (u * bc) + (v * ca) + (w * ab) + abc;
-                    break;
+                // u = a - x, v = b - y and w = c - z, so xyz = abc - u bc - v ca
+                // - w ab + uv c + uw b + vw a - uvw, with the public uvw
+                // added by one party.
+                wires_[g->out] = abc - (u * bc) - (v * ca) - (w * ab) + (u * v * c) + (u * w * b) + (v * w * a)
+                                 - (id_ == 1 ? u * v * w : Ring(0));
+            }
+        });
+
+        parallelFor(plan.mult4.size(), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                auto *g = plan.mult4[k];
+                auto *pre_out = static_cast<PreprocMult4Gate<Ring> *>(preproc_.gates.at(g->out).get());
+                size_t idx_mult4 = 4 * nP_ * k;
+                Ring u = Ring(0);
+                Ring v = Ring(0);
+                Ring w = Ring(0);
+                Ring x = Ring(0);
+                Ring a = pre_out->share_a.valueAt();
+                Ring b = pre_out->share_b.valueAt();
+                Ring c = pre_out->share_c.valueAt();
+                Ring d = pre_out->share_d.valueAt();
+                Ring ab = pre_out->share_ab.valueAt();
+                Ring ac = pre_out->share_ac.valueAt();
+                Ring ad = pre_out->share_ad.valueAt();
+                Ring bc = pre_out->share_bc.valueAt();
+                Ring bd = pre_out->share_bd.valueAt();
+                Ring cd = pre_out->share_cd.valueAt();
+                Ring abc = pre_out->share_abc.valueAt();
+                Ring abd = pre_out->share_abd.valueAt();
+                Ring acd = pre_out->share_acd.valueAt();
+                Ring bcd = pre_out->share_bcd.valueAt();
+                Ring abcd = pre_out->share_abcd.valueAt();
+                for (int i = 1; i <= nP_; ++i) {
+                    u += mult4_vals[idx_mult4++];
+                    v += mult4_vals[idx_mult4++];
+                    w += mult4_vals[idx_mult4++];
+                    x += mult4_vals[idx_mult4++];
                 }
-
-                case common::utils::GateType::kMul4: {
-                    auto *g = static_cast<common::utils::FIn4Gate *>(gate.get());
-                    auto *pre_out = static_cast<PreprocMult4Gate<Ring> *>(preproc_.gates[g->out].get());
+                // As for kMul3, the terms with an odd number of masked
+                // differences are subtracted and the public uvwx is added by
+                // one party.
+                wires_[g->out] = abcd - (u * bcd) - (v * acd) - (w * abd) - (x * abc)
+                                 + (u * v * cd) + (u * w * bd) + (u * x * bc) + (v * w * ad) + (v * x * ac) + (w * x * ab)
+                                 - (u * v * w * d) - (u * v * x * c) - (u * w * x * b) - (v * w * x * a)
+                                 + (id_ == 1 ? u * v * w * x : Ring(0));
+            }
+        });
+
+        parallelFor(plan.dotp.size(), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                auto *g = plan.dotp[k];
+                auto *pre_out = static_cast<PreprocDotpGate<Ring> *>(preproc_.gates.at(g->out).get());
+                size_t idx_dotp = 2 * nP_ * plan.dotp_offset[k];
+                auto vec_len = g->in1.size();
+                Ring out = Ring(0);
+                for (size_t i = 0; i < vec_len; ++i) {
                     Ring u = Ring(0);
                     Ring v = Ring(0);
-                    Ring w = Ring(0);
-                    Ring x = Ring(0);
-                    Ring a = pre_out->share_a.valueAt();
-                    Ring b = pre_out->share_b.valueAt();
-                    Ring c = pre_out->share_c.valueAt();
-                    Ring d = pre_out->share_c.valueAt();
-                    Ring ab = pre_out->share_ab.valueAt();
-                    Ring ac = pre_out->share_ac.valueAt();
-                    Ring ad = pre_out->share_ad.valueAt();
-                    Ring bc = pre_out->share_bc.valueAt();
-                    Ring bd = pre_out->share_bd.valueAt();
-                    Ring cd = pre_out->share_cd.valueAt();
-                    Ring abc = pre_out->share_abc.valueAt();
-                    Ring abd = pre_out->share_abd.valueAt();
-                    Ring acd = pre_out->share_acd.valueAt();
-                    Ring bcd = pre_out->share_bcd.valueAt();
-                    Ring abcd = pre_out->share_abcd.valueAt();
-                    for (int i = 1; i <= nP_; ++i) {
-                        u += mult4_vals[idx_mult4++];
-                        v += mult4_vals[idx_mult4++];
-                        w += mult4_vals[idx_mult4++];
-                        x += mult4_vals[idx_mult4++];
-                    }
-                    wires_[g->out] = (u * v * w * x) + (u * v * w * d) + (u * v * x * c) + (u * w * x * b) + (v * w * x * a)
-                                    + (u * v * cd) + (u * w * bd) + (u * x * bc) + (v * w * ad) + (v * x * ac) + (w * x * ab)
-                                    + (u * bcd) + (v * acd) + (w * abd) + (x * abc) + abcd;
-                    break;
-                }
-
-                case common::utils::GateType::kDotprod: {
-                    auto *g = static_cast<common::utils::SIMDGate *>(gate.get());
-                    auto *pre_out = static_cast<PreprocDotpGate<Ring> *>(preproc_.gates[g->out].get());
-                    auto vec_len = g->in1.size();
-                    Ring out = Ring(0);
-                    for (int i = 0; i < vec_len; ++i) {
-                        Ring u = Ring(0);
-                        Ring v = Ring(0);
-                        Ring a = pre_out->triple_a_vec[i].valueAt();
-                        Ring b = pre_out->triple_b_vec[i].valueAt();
-                        Ring c = pre_out->triple_c_vec[i].valueAt();
-                        for (int i = 1; i <= nP_; ++i) {
-                            u += dotp_vals[idx_dotp++];
-                            v += dotp_vals[idx_dotp++];
-                        }
-                        out += u * v + u * b + v * a + c;
+                    Ring a = pre_out->triple_a_vec[i].valueAt();
+                    Ring b = pre_out->triple_b_vec[i].valueAt();
+                    Ring c = pre_out->triple_c_vec[i].valueAt();
+                    for (int pid = 1; pid <= nP_; ++pid) {
+                        u += dotp_vals[idx_dotp++];
+                        v += dotp_vals[idx_dotp++];
                     }
-                    wires_[g->out] = out;
-                    break;
+                    out += c - u * b - v * a + (id_ == 1 ? u * v : Ring(0));
                 }
-
-                case common::utils::GateType::kPublicPerm: {
-                    auto *g = static_cast<common::utils::SIMDOGate *>(gate.get());
-                    auto vec_len = g->in.size();
-                    for (int i = 0; i < vec_len; ++i) {
-                        auto idx_perm = g->permutation[0][i];
-                        wires_[g->outs[idx_perm]] = wires_[g->in[i]];
-                    }
-                    break;
-                }
-
-                default:
-                    break;
+                wires_[g->out] = out;
             }
+        });
+
+        // Local gates may depend on the multiplications above and on each
+        // other, so they run one sub-level at a time.
+        for (const auto &bucket : plan.local) {
+            parallelFor(bucket.size(), [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; ++k) { evaluateLocalGate(bucket[k]); }
+            });
         }
     }
 
@@ -731,6 +1042,7 @@ namespace grasp
         size_t dotp_num = 0;
         size_t eqz_num = 0;
         size_t ltz_num = 0;
+        size_t trunc_num = 0;
         size_t shuffle_num = 0;
         size_t permAndSh_num = 0;
         size_t amortzdPnS_num = 0;
@@ -744,6 +1056,7 @@ namespace grasp
                 case common::utils::GateType::kDotprod: dotp_num++; break;
                 case ::common::utils::GateType::kEqz: eqz_num++; break;
                 case ::common::utils::GateType::kLtz: ltz_num++; break;
+                case common::utils::GateType::kTrunc: trunc_num++; break;
                 case common::utils::GateType::kShuffle: shuffle_num++; break;
                 case common::utils::GateType::kPermAndSh: permAndSh_num++; break;
                 case common::utils::GateType::kAmortzdPnS: amortzdPnS_num++; break;
@@ -762,6 +1075,8 @@ namespace grasp
         eqz_gates.reserve(eqz_num);
         std::vector<common::utils::FIn1Gate> ltz_gates;
         ltz_gates.reserve(ltz_num);
+        std::vector<common::utils::TruncGate> trunc_gates;
+        trunc_gates.reserve(trunc_num);
         std::vector<common::utils::SIMDOGate> shuffle_gates;
         shuffle_gates.reserve(shuffle_num);
         std::vector<common::utils::SIMDOGate> permAndSh_gates;
@@ -793,6 +1108,7 @@ namespace grasp
 
                 case ::common::utils::GateType::kEqz: {
                     auto *g = static_cast<common::utils::FIn1Gate *>(gate.get());
+                    if (deferred_.count(g->out) != 0) { break; }
                     eqz_gates.push_back(*g);
                     eqz_num++;
                     break;
@@ -800,11 +1116,19 @@ namespace grasp
 
                 case ::common::utils::GateType::kLtz: {
                     auto *g = static_cast<common::utils::FIn1Gate *>(gate.get());
+                    if (deferred_.count(g->out) != 0) { break; }
                     ltz_gates.push_back(*g);
                     ltz_num++;
                     break;
                 }
 
+                case common::utils::GateType::kTrunc: {
+                    auto *g = static_cast<common::utils::TruncGate *>(gate.get());
+                    trunc_gates.push_back(*g);
+                    trunc_num++;
+                    break;
+                }
+
                 case common::utils::GateType::kShuffle: {
                     auto *g = static_cast<common::utils::SIMDOGate *>(gate.get());
                     shuffle_gates.push_back(*g);
@@ -828,27 +1152,74 @@ namespace grasp
             }
         }
 
-        if (eqz_num > 0) {
-            eqzEvaluate(eqz_gates);
-        }
+        // The interactive sub-protocols of a level only read wires of earlier
+        // levels, so they run concurrently, each on its own channel, and the
+        // level costs the rounds of its slowest sub-protocol.
+        evaluateGatesAtDepthPartySend(depth, mult_vals, mult3_vals, mult4_vals, dotp_vals);
+        bool has_mult = !mult_vals.empty() || !mult3_vals.empty() || !mult4_vals.empty() || !dotp_vals.empty();
 
-        if (ltz_num > 0) {
-            ltzEvaluate(ltz_gates);
+        std::vector<std::function<void(const std::shared_ptr<io::NetIOMP> &)>> rounds;
+        if (!eqz_gates.empty()) {
+            rounds.emplace_back([&](const std::shared_ptr<io::NetIOMP> &net) { eqzEvaluate(net, eqz_gates); });
         }
-
-        if (shuffle_num > 0) {
-            shuffleEvaluate(shuffle_gates);
+        if (!ltz_gates.empty()) {
+            rounds.emplace_back([&](const std::shared_ptr<io::NetIOMP> &net) { ltzEvaluate(net, ltz_gates); });
         }
-
-        if (permAndSh_num > 0) {
-            permAndShEvaluate(permAndSh_gates);
+        if (!trunc_gates.empty()) {
+            rounds.emplace_back([&](const std::shared_ptr<io::NetIOMP> &net) { truncEvaluate(net, trunc_gates); });
+        }
+        if (!shuffle_gates.empty()) {
+            rounds.emplace_back([&](const std::shared_ptr<io::NetIOMP> &net) { shuffleEvaluate(net, shuffle_gates); });
+        }
+        if (!permAndSh_gates.empty()) {
+            rounds.emplace_back([&](const std::shared_ptr<io::NetIOMP> &net) { permAndShEvaluate(net, permAndSh_gates); });
         }
+        if (!amortzdPnS_gates.empty()) {
+            rounds.emplace_back([&](const std::shared_ptr<io::NetIOMP> &net) { amortzdPnSEvaluate(net, amortzdPnS_gates); });
+        }
+        if (has_mult) {
+            rounds.emplace_back([&](const std::shared_ptr<io::NetIOMP> &net) {
+                exchangeMultVals(net, mult_vals, mult3_vals, mult4_vals, dotp_vals);
+            });
+        }
+        rounds_ += runConcurrently(rounds);
+
+        // Multiplications and local gates may use the outputs of the
+        // sub-protocols above.
+        evaluateGatesAtDepthPartyRecv(depth, mult_vals, mult3_vals, mult4_vals, dotp_vals);
+    }
 
-        if (amortzdPnS_num > 0) {
-            amortzdPnSEvaluate(amortzdPnS_gates);
+    size_t OnlineEvaluator::runConcurrently(const std::vector<std::function<void(const std::shared_ptr<io::NetIOMP> &)>> &rounds) {
+        if (rounds.empty()) { return 0; }
+        size_t waits_before = latency_waits;
+        // A single sub-protocol keeps the untagged connections.
+        if (rounds.size() == 1) {
+            rounds[0](network_);
+            return latency_waits - waits_before;
         }
+        // Every party builds the same list of sub-protocols for a level, so
+        // the i-th one talks to its counterparts on channel i.
+        while (channels_.size() < rounds.size()) {
+            channels_.push_back(network_->channel(static_cast<int>(channels_.size())));
+        }
+        std::vector<std::future<size_t>> done;
+        done.reserve(rounds.size());
+        for (size_t i = 1; i < rounds.size(); ++i) {
+            done.push_back(std::async(std::launch::async, [&, i]() {
+                latency_waits = 0;
+                rounds[i](channels_[i]);
+                return latency_waits;
+            }));
+        }
+        rounds[0](channels_[0]);
+        size_t level_rounds = latency_waits - waits_before;
+        for (auto &d : done) { level_rounds = std::max(level_rounds, d.get()); }
+        return level_rounds;
+    }
 
-        evaluateGatesAtDepthPartySend(depth, mult_vals, mult3_vals, mult4_vals, dotp_vals);
+    void OnlineEvaluator::exchangeMultVals(const std::shared_ptr<io::NetIOMP> &net, std::vector<Ring> &mult_vals,
+                                           std::vector<Ring> &mult3_vals, std::vector<Ring> &mult4_vals,
+                                           std::vector<Ring> &dotp_vals) {
         size_t total_comm_send = mult_vals.size() + mult3_vals.size() + mult4_vals.size() + dotp_vals.size();
         size_t total_comm_recv = nP_ * total_comm_send;
         std::vector<Ring> online_comm_send;
@@ -874,17 +1245,17 @@ namespace grasp
 
         for (int pid = 1; pid <= nP_; ++pid) {
             if (pid != id_) {
-                network_->send(pid, online_comm_send.data(), sizeof(Ring) * online_comm_send.size());
+                net->send(pid, online_comm_send.data(), sizeof(Ring) * online_comm_send.size());
             }
         }
 
-        usleep(latency_usec_);
+        waitLatency(latency_usec_);
         std::vector<std::vector<Ring>> online_comm_recv_party(nP_);
         #pragma omp parallel for
         for (int pid = 1; pid <= nP_; ++pid) {
             if (pid != id_) {
                 online_comm_recv_party[pid - 1] = std::vector<Ring>(total_comm_send);
-                network_->recv(pid, online_comm_recv_party[pid - 1].data(), sizeof(Ring) * online_comm_recv_party[pid - 1].size());
+                net->recv(pid, online_comm_recv_party[pid - 1].data(), sizeof(Ring) * online_comm_recv_party[pid - 1].size());
             }
         }
         for (int pid = 0; pid < nP_; ++pid) {
@@ -937,25 +1308,11 @@ namespace grasp
             j += (pid + 1) / nP_;
             pid = (pid + 1) % nP_;
         }
-        evaluateGatesAtDepthPartyRecv(depth, mult_all, mult3_all, mult4_all, dotp_all);
-        
-        // Free communication buffers immediately after use
-        online_comm_send.clear(); online_comm_send.shrink_to_fit();
-        online_comm_recv.clear(); online_comm_recv.shrink_to_fit();
-        mult_all.clear(); mult_all.shrink_to_fit();
-        mult3_all.clear(); mult3_all.shrink_to_fit();
-        mult4_all.clear(); mult4_all.shrink_to_fit();
-        dotp_all.clear(); dotp_all.shrink_to_fit();
-        
-        // Free gates collected at this depth
-        eqz_gates.clear(); eqz_gates.shrink_to_fit();
-        ltz_gates.clear(); ltz_gates.shrink_to_fit();
-        shuffle_gates.clear(); shuffle_gates.shrink_to_fit();
-        permAndSh_gates.clear(); permAndSh_gates.shrink_to_fit();
-        amortzdPnS_gates.clear(); amortzdPnS_gates.shrink_to_fit();
-        
-        // Progressive preproc cleanup: free preprocessing data for this depth
-        // freeDepthPreproc(depth);
+
+        mult_vals = std::move(mult_all);
+        mult3_vals = std::move(mult3_all);
+        mult4_vals = std::move(mult4_all);
+        dotp_vals = std::move(dotp_all);
     }
 
     std::vector<Ring> OnlineEvaluator::getOutputs() {
@@ -974,7 +1331,7 @@ namespace grasp
                     network_->send(pid, output_shares[id_ - 1].data(), output_shares[id_ - 1].size() * sizeof(Ring));
                 }
             }
-            usleep(latency_usec_);
+            waitLatency(latency_usec_);
             #pragma omp parallel for
             for (int pid = 1; pid <= nP_; ++pid) {
                 if (pid != id_) {
@@ -1029,6 +1386,9 @@ namespace grasp
         circ_.gates_by_level.clear();
         circ_.gates_by_level.shrink_to_fit();
 
+        plans_.clear();
+        plans_.shrink_to_fit();
+
         // Clear preprocessed gate data
         preproc_.gates.clear();
         preproc_.gates.rehash(0);
@@ -1055,7 +1415,7 @@ namespace grasp
                        common::utils::LevelOrderedCircuit circ, int seed, int latency_ms)
         : id(my_id),
           nP(nP),
-          rgen(id, seed),
+          rgen(id, nP, seed),
           network(std::move(network)),
           vwires(vpreproc.size(), std::vector<BoolRing>(circ.num_wires)),
           vpreproc(std::move(vpreproc)),
@@ -1334,7 +1694,7 @@ namespace grasp
             }
         }
 
-        usleep(latency_usec);
+        waitLatency(latency_usec);
         size_t nbytes = (total_comm_send + 7) / 8;
         std::vector<std::vector<BoolRing>> online_comm_recv_party(nP);
         #pragma omp parallel for
@@ -1419,4 +1779,323 @@ namespace grasp
         }
         return outputs;
     }
+
+    BitslicedBoolEval::BitslicedBoolEval(int my_id, int nP, std::shared_ptr<io::NetIOMP> network,
+                                         PackedBoolPreproc preproc, common::utils::LevelOrderedCircuit circ,
+                                         int latency_ms)
+        : id(my_id),
+          nP(nP),
+          network(std::move(network)),
+          preproc(std::move(preproc)),
+          circ(std::move(circ)),
+          num_words(this->preproc.num_words),
+          wires(this->circ.num_wires * num_words, 0),
+          latency_usec(latency_ms * 1000) {}
+
+    PackedBoolPreproc BitslicedBoolEval::pack(const std::vector<preprocg_ptr_t<BoolRing> *> &vpreproc,
+                                              const common::utils::LevelOrderedCircuit &circ) {
+        PackedBoolPreproc packed;
+        packed.num_instances = vpreproc.size();
+        packed.num_words = (packed.num_instances + 63) / 64;
+        packed.gates.resize(circ.num_wires);
+        size_t nw = packed.num_words;
+
+        std::vector<const common::utils::Gate *> mult_gates;
+        for (const auto &level : circ.gates_by_level) {
+            for (const auto &gate : level) {
+                size_t num_vals = 0;
+                switch (gate->type) {
+                    case common::utils::GateType::kMul: num_vals = 3; break;
+                    case common::utils::GateType::kMul3: num_vals = 7; break;
+                    case common::utils::GateType::kMul4: num_vals = 15; break;
+                    case common::utils::GateType::kDotprod: {
+                        num_vals = 3 * static_cast<common::utils::SIMDGate *>(gate.get())->in1.size();
+                        break;
+                    }
+                    default: break;
+                }
+                if (num_vals != 0) {
+                    packed.gates[gate->out].assign(num_vals * nw, 0);
+                    mult_gates.push_back(gate.get());
+                }
+            }
+        }
+
+        // Each word is written by a single thread.
+        #pragma omp parallel for
+        for (size_t w = 0; w < nw; ++w) {
+            size_t end = std::min(packed.num_instances, 64 * (w + 1));
+            for (size_t i = 64 * w; i < end; ++i) {
+                uint64_t bit = 1ULL << (i % 64);
+                const auto *preproc = vpreproc[i];
+                for (const auto *gate : mult_gates) {
+                    uint64_t *dst = packed.gates[gate->out].data() + w;
+                    auto set = [&](size_t idx, const AddShare<BoolRing> &share) {
+                        if (share.valueAt().val()) { dst[idx * nw] |= bit; }
+                    };
+                    switch (gate->type) {
+                        case common::utils::GateType::kMul: {
+                            auto *pre = static_cast<PreprocMultGate<BoolRing> *>(preproc[gate->out].get());
+                            set(0, pre->triple_a);
+                            set(1, pre->triple_b);
+                            set(2, pre->triple_c);
+                            break;
+                        }
+
+                        case common::utils::GateType::kMul3: {
+                            auto *pre = static_cast<PreprocMult3Gate<BoolRing> *>(preproc[gate->out].get());
+                            set(0, pre->share_a);
+                            set(1, pre->share_b);
+                            set(2, pre->share_c);
+                            set(3, pre->share_ab);
+                            set(4, pre->share_bc);
+                            set(5, pre->share_ca);
+                            set(6, pre->share_abc);
+                            break;
+                        }
+
+                        case common::utils::GateType::kMul4: {
+                            auto *pre = static_cast<PreprocMult4Gate<BoolRing> *>(preproc[gate->out].get());
+                            set(0, pre->share_a);
+                            set(1, pre->share_b);
+                            set(2, pre->share_c);
+                            set(3, pre->share_d);
+                            set(4, pre->share_ab);
+                            set(5, pre->share_ac);
+                            set(6, pre->share_ad);
+                            set(7, pre->share_bc);
+                            set(8, pre->share_bd);
+                            set(9, pre->share_cd);
+                            set(10, pre->share_abc);
+                            set(11, pre->share_abd);
+                            set(12, pre->share_acd);
+                            set(13, pre->share_bcd);
+                            set(14, pre->share_abcd);
+                            break;
+                        }
+
+                        case common::utils::GateType::kDotprod: {
+                            auto *pre = static_cast<PreprocDotpGate<BoolRing> *>(preproc[gate->out].get());
+                            for (size_t j = 0; j < pre->triple_a_vec.size(); ++j) {
+                                set(3 * j, pre->triple_a_vec[j]);
+                                set(3 * j + 1, pre->triple_b_vec[j]);
+                                set(3 * j + 2, pre->triple_c_vec[j]);
+                            }
+                            break;
+                        }
+
+                        default:
+                            break;
+                    }
+                }
+            }
+        }
+        return packed;
+    }
+
+    void BitslicedBoolEval::evaluateGatesAtDepth(size_t depth) {
+        if (id == 0) { return; }
+        const auto &level = circ.gates_by_level[depth];
+        size_t nw = num_words;
+
+        // Masked inputs of multiplication gates, num_words words per input.
+        std::vector<size_t> offset(level.size() + 1, 0);
+        for (size_t g = 0; g < level.size(); ++g) {
+            size_t num_open = 0;
+            switch (level[g]->type) {
+                case common::utils::GateType::kMul: num_open = 2; break;
+                case common::utils::GateType::kMul3: num_open = 3; break;
+                case common::utils::GateType::kMul4: num_open = 4; break;
+                case common::utils::GateType::kDotprod: {
+                    num_open = 2 * static_cast<common::utils::SIMDGate *>(level[g].get())->in1.size();
+                    break;
+                }
+                default: break;
+            }
+            offset[g + 1] = offset[g] + num_open * nw;
+        }
+        size_t total_comm = offset.back();
+
+        std::vector<uint64_t> opened(total_comm);
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (size_t g = 0; g < level.size(); ++g) {
+            auto *gate = level[g].get();
+            uint64_t *msg = opened.data() + offset[g];
+            auto mask = [&](size_t idx, size_t val, common::utils::wire_t in) {
+                const uint64_t *pre = preproc.gates[gate->out].data() + val * nw;
+                const uint64_t *x = wire(in);
+                for (size_t k = 0; k < nw; ++k) { msg[idx * nw + k] = pre[k] ^ x[k]; }
+            };
+            switch (gate->type) {
+                case common::utils::GateType::kMul: {
+                    auto *g2 = static_cast<common::utils::FIn2Gate *>(gate);
+                    mask(0, 0, g2->in1);
+                    mask(1, 1, g2->in2);
+                    break;
+                }
+
+                case common::utils::GateType::kMul3: {
+                    auto *g3 = static_cast<common::utils::FIn3Gate *>(gate);
+                    mask(0, 0, g3->in1);
+                    mask(1, 1, g3->in2);
+                    mask(2, 2, g3->in3);
+                    break;
+                }
+
+                case common::utils::GateType::kMul4: {
+                    auto *g4 = static_cast<common::utils::FIn4Gate *>(gate);
+                    mask(0, 0, g4->in1);
+                    mask(1, 1, g4->in2);
+                    mask(2, 2, g4->in3);
+                    mask(3, 3, g4->in4);
+                    break;
+                }
+
+                case common::utils::GateType::kDotprod: {
+                    auto *gd = static_cast<common::utils::SIMDGate *>(gate);
+                    for (size_t j = 0; j < gd->in1.size(); ++j) {
+                        mask(2 * j, 3 * j, gd->in1[j]);
+                        mask(2 * j + 1, 3 * j + 1, gd->in2[j]);
+                    }
+                    break;
+                }
+
+                default:
+                    break;
+            }
+        }
+
+        // Every party broadcasts its masked inputs and XORs in the others'.
+        if (total_comm != 0) {
+            for (int pid = 1; pid <= nP; ++pid) {
+                if (pid != id) {
+                    network->send(pid, opened.data(), sizeof(uint64_t) * total_comm);
+                }
+            }
+            waitLatency(latency_usec);
+            std::vector<std::vector<uint64_t>> recv_party(nP);
+            #pragma omp parallel for
+            for (int pid = 1; pid <= nP; ++pid) {
+                if (pid != id) {
+                    recv_party[pid - 1].resize(total_comm);
+                    network->recv(pid, recv_party[pid - 1].data(), sizeof(uint64_t) * total_comm);
+                }
+            }
+            for (int pid = 1; pid <= nP; ++pid) {
+                if (pid != id) {
+                    const auto &recv = recv_party[pid - 1];
+                    for (size_t k = 0; k < total_comm; ++k) { opened[k] ^= recv[k]; }
+                }
+            }
+        }
+
+        // Multiplications only read wires of earlier levels and run in parallel.
+        // Products of opened values only are public and added by party 1, as
+        // the shares are XORed over all parties.
+        const uint64_t pub = id == 1 ? ~0ULL : 0ULL;
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (size_t g = 0; g < level.size(); ++g) {
+            auto *gate = level[g].get();
+            uint64_t *out = wire(gate->out);
+            const uint64_t *pre = preproc.gates[gate->out].data();
+            const uint64_t *open = opened.data() + offset[g];
+            switch (gate->type) {
+                case common::utils::GateType::kMul: {
+                    const uint64_t *a = pre, *b = pre + nw, *c = pre + 2 * nw;
+                    const uint64_t *u = open, *v = open + nw;
+                    for (size_t k = 0; k < nw; ++k) {
+                        out[k] = (u[k] & v[k] & pub) ^ (u[k] & b[k]) ^ (v[k] & a[k]) ^ c[k];
+                    }
+                    break;
+                }
+
+                case common::utils::GateType::kMul3: {
+                    const uint64_t *u = open, *v = open + nw, *w = open + 2 * nw;
+                    for (size_t k = 0; k < nw; ++k) {
+                        uint64_t a = pre[k], b = pre[nw + k], c = pre[2 * nw + k];
+                        uint64_t ab = pre[3 * nw + k], bc = pre[4 * nw + k], ca = pre[5 * nw + k];
+                        uint64_t abc = pre[6 * nw + k];
+                        out[k] = (u[k] & v[k] & w[k] & pub) ^ (u[k] & v[k] & c) ^ (u[k] & w[k] & b) ^ (v[k] & w[k] & a)
+                                 ^ (u[k] & bc) ^ (v[k] & ca) ^ (w[k] & ab) ^ abc;
+                    }
+                    break;
+                }
+
+                case common::utils::GateType::kMul4: {
+                    const uint64_t *u = open, *v = open + nw, *w = open + 2 * nw, *x = open + 3 * nw;
+                    for (size_t k = 0; k < nw; ++k) {
+                        uint64_t a = pre[k], b = pre[nw + k], c = pre[2 * nw + k], d = pre[3 * nw + k];
+                        uint64_t ab = pre[4 * nw + k], ac = pre[5 * nw + k], ad = pre[6 * nw + k];
+                        uint64_t bc = pre[7 * nw + k], bd = pre[8 * nw + k], cd = pre[9 * nw + k];
+                        uint64_t abc = pre[10 * nw + k], abd = pre[11 * nw + k], acd = pre[12 * nw + k];
+                        uint64_t bcd = pre[13 * nw + k], abcd = pre[14 * nw + k];
+                        uint64_t uv = u[k] & v[k], wx = w[k] & x[k];
+                        out[k] = (uv & wx & pub) ^ (uv & w[k] & d) ^ (uv & x[k] & c) ^ (u[k] & wx & b) ^ (v[k] & wx & a)
+                                 ^ (uv & cd) ^ (u[k] & w[k] & bd) ^ (u[k] & x[k] & bc) ^ (v[k] & w[k] & ad)
+                                 ^ (v[k] & x[k] & ac) ^ (wx & ab) ^ (u[k] & bcd) ^ (v[k] & acd) ^ (w[k] & abd)
+                                 ^ (x[k] & abc) ^ abcd;
+                    }
+                    break;
+                }
+
+                case common::utils::GateType::kDotprod: {
+                    auto *gd = static_cast<common::utils::SIMDGate *>(gate);
+                    std::fill(out, out + nw, 0);
+                    for (size_t j = 0; j < gd->in1.size(); ++j) {
+                        const uint64_t *a = pre + 3 * j * nw, *b = a + nw, *c = b + nw;
+                        const uint64_t *u = open + 2 * j * nw, *v = u + nw;
+                        for (size_t k = 0; k < nw; ++k) {
+                            out[k] ^= (u[k] & v[k] & pub) ^ (u[k] & b[k]) ^ (v[k] & a[k]) ^ c[k];
+                        }
+                    }
+                    break;
+                }
+
+                default:
+                    break;
+            }
+        }
+
+        // Linear gates share the level of their inputs, which may be computed
+        // earlier in the same level, so they are evaluated in order.
+        for (const auto &gate_ptr : level) {
+            auto *gate = gate_ptr.get();
+            uint64_t *out = wire(gate->out);
+            switch (gate->type) {
+                case common::utils::GateType::kAdd:
+                case common::utils::GateType::kSub: {
+                    auto *g2 = static_cast<common::utils::FIn2Gate *>(gate);
+                    const uint64_t *x = wire(g2->in1);
+                    const uint64_t *y = wire(g2->in2);
+                    for (size_t k = 0; k < nw; ++k) { out[k] = x[k] ^ y[k]; }
+                    break;
+                }
+
+                case common::utils::GateType::kConstAdd: {
+                    auto *gc = static_cast<common::utils::ConstOpGate<BoolRing> *>(gate);
+                    const uint64_t *x = wire(gc->in);
+                    uint64_t c = gc->cval.val() && id == 1 ? ~0ULL : 0ULL;
+                    for (size_t k = 0; k < nw; ++k) { out[k] = x[k] ^ c; }
+                    break;
+                }
+
+                case common::utils::GateType::kConstMul: {
+                    auto *gc = static_cast<common::utils::ConstOpGate<BoolRing> *>(gate);
+                    const uint64_t *x = wire(gc->in);
+                    uint64_t c = gc->cval.val() ? ~0ULL : 0ULL;
+                    for (size_t k = 0; k < nw; ++k) { out[k] = x[k] & c; }
+                    break;
+                }
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    void BitslicedBoolEval::evaluateAllLevels() {
+        for (size_t i = 0; i < circ.gates_by_level.size(); ++i) {
+            evaluateGatesAtDepth(i);
+        }
+    }
 }; // namespace grasp
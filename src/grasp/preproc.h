@@ -164,44 +164,56 @@ struct PreprocDotpGate : public PreprocGate<R> {
         triple_c_vec(triple_c_vec), tp_triple_c_vec(tp_triple_c_vec) {}
 };
 
+// Boolean preprocessing for many instances of one circuit in bitsliced form.
+// Bit (i % 64) of word (i / 64) belongs to instance i.
+struct PackedBoolPreproc {
+  size_t num_instances{0};
+  size_t num_words{0};
+  // Mask shares of multiplication gates indexed by output wire. Each value
+  // takes num_words words, and values follow the member order of
+  // PreprocMultGate, PreprocMult3Gate and PreprocMult4Gate. Dot products store
+  // a, b and c of every term in turn.
+  std::vector<std::vector<uint64_t>> gates;
+  PackedBoolPreproc() = default;
+};
+
+// Preprocessing of a group of up to 64 EQZ (or LTZ) gates of one level,
+// stored at the first gate of the group. Lane i belongs to the i-th gate of
+// the group, in level order.
 template <class R>
-struct PreprocEqzGate : public PreprocGate<R> {
-  AddShare<R> share_r;
-  TPShare<R> tp_share_r;
-  std::vector<AddShare<BoolRing>> share_r_bits;
-  std::vector<TPShare<BoolRing>> tp_share_r_bits;
-  std::vector<preprocg_ptr_t<BoolRing>> multk_gates;
-  PreprocEqzGate() = default;
-  PreprocEqzGate(const AddShare<R> &share_r, const TPShare<R> &tp_share_r,
-                 const std::vector<AddShare<BoolRing>> &share_r_bits, const std::vector<TPShare<BoolRing>> &tp_share_r_bits,
-                 std::vector<preprocg_ptr_t<BoolRing>> multk_gates)
-    : PreprocGate<R>(), share_r(share_r), tp_share_r(tp_share_r), share_r_bits(share_r_bits), tp_share_r_bits(tp_share_r_bits),
-      multk_gates(std::move(multk_gates)) {}
+struct PreprocCmpGroup : public PreprocGate<R> {
+  // Mask of each lane.
+  std::vector<AddShare<R>> share_r;
+  // Word j holds bit j of the masks of all lanes. For LTZ the bit order is
+  // reversed, matching the PrefixOR inputs.
+  std::vector<uint64_t> share_r_bits;
+  // MultK (EQZ) or PrefixOR (LTZ) preprocessing, one word per value.
+  PackedBoolPreproc bool_preproc;
+  // Random output bit of each lane, shared arithmetically and packed like
+  // share_r_bits. The comparison results are revealed XORed with these bits
+  // and converted back to arithmetic shares.
+  std::vector<AddShare<R>> share_mask;
+  uint64_t share_mask_bits = 0;
+  PreprocCmpGroup() = default;
 };
 
+// Probabilistic truncation by a random r known to no party: the online
+// phase reveals x + r + 2^(l-2) and corrects with the high bits of r.
 template <class R>
-struct PreprocLtzGate : public PreprocGate<R> {
-  AddShare<R> share_r;
+struct PreprocTruncGate : public PreprocGate<R> {
+  AddShare<R> share_r;     // Share of the mask r
   TPShare<R> tp_share_r;
-  std::vector<AddShare<BoolRing>> share_r_bits;
-  std::vector<TPShare<BoolRing>> tp_share_r_bits;
-  std::vector<preprocg_ptr_t<BoolRing>> PrefixOR_gates;
-  PreprocLtzGate() = default;
-
-  // Enable efficient move semantics to avoid unnecessary copies of large
-  // per-gate preprocessed vectors (bit shares and prefix OR gate preproc).
-  PreprocLtzGate(PreprocLtzGate&&) noexcept = default;
-  PreprocLtzGate& operator=(PreprocLtzGate&&) noexcept = default;
-
-  // Keep copy operations default (if ever needed).
-  PreprocLtzGate(const PreprocLtzGate&) = default;
-  PreprocLtzGate& operator=(const PreprocLtzGate&) = default;
-
-  PreprocLtzGate(const AddShare<R> &share_r, const TPShare<R> &tp_share_r,
-                 const std::vector<AddShare<BoolRing>> &share_r_bits, const std::vector<TPShare<BoolRing>> &tp_share_r_bits,
-                 std::vector<preprocg_ptr_t<BoolRing>> PrefixOR_gates)
-    : PreprocGate<R>(), share_r(share_r), tp_share_r(tp_share_r), share_r_bits(share_r_bits), tp_share_r_bits(tp_share_r_bits),
-      PrefixOR_gates(std::move(PrefixOR_gates)) {}
+  AddShare<R> share_r_hi;  // Share of r >> shift, as a logical shift
+  TPShare<R> tp_share_r_hi;
+  AddShare<R> share_r_msb; // Share of the most significant bit of r
+  TPShare<R> tp_share_r_msb;
+  PreprocTruncGate() = default;
+  PreprocTruncGate(const AddShare<R>& share_r, const TPShare<R>& tp_share_r,
+                   const AddShare<R>& share_r_hi, const TPShare<R>& tp_share_r_hi,
+                   const AddShare<R>& share_r_msb, const TPShare<R>& tp_share_r_msb)
+      : PreprocGate<R>(), share_r(share_r), tp_share_r(tp_share_r),
+        share_r_hi(share_r_hi), tp_share_r_hi(tp_share_r_hi),
+        share_r_msb(share_r_msb), tp_share_r_msb(tp_share_r_msb) {}
 };
 
 template <class R>
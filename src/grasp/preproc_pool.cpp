@@ -0,0 +1,32 @@
+#include "preproc_pool.h"
+
+#include <stdexcept>
+
+namespace grasp {
+
+void PreprocPool::add(uint64_t fp, PreprocCircuit<Ring> preproc) {
+  pool_[fp].push_back(std::move(preproc));
+}
+
+void PreprocPool::add(uint64_t fp, std::vector<PreprocCircuit<Ring>> preprocs) {
+  auto& queue = pool_[fp];
+  for (auto& preproc : preprocs) { queue.push_back(std::move(preproc)); }
+}
+
+size_t PreprocPool::available(uint64_t fp) const {
+  auto it = pool_.find(fp);
+  if (it == pool_.end()) { return 0; }
+  return it->second.size();
+}
+
+PreprocCircuit<Ring> PreprocPool::acquire(uint64_t fp) {
+  auto it = pool_.find(fp);
+  if (it == pool_.end() || it->second.empty()) {
+    throw std::runtime_error("No preprocessing left for circuit.");
+  }
+  auto preproc = std::move(it->second.front());
+  it->second.pop_front();
+  return preproc;
+}
+
+};  // namespace grasp
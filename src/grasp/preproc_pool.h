@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "preproc.h"
+#include "../utils/types.h"
+
+namespace grasp {
+// Store of preprocessing instances keyed by circuit fingerprint (see
+// common::utils::fingerprint). Instances generated in one batched offline run
+// are handed out one per online evaluation of a structurally identical
+// circuit.
+class PreprocPool {
+  std::unordered_map<uint64_t, std::deque<PreprocCircuit<Ring>>> pool_;
+
+ public:
+  PreprocPool() = default;
+
+  // Add instances for circuits with fingerprint 'fp'.
+  void add(uint64_t fp, PreprocCircuit<Ring> preproc);
+  void add(uint64_t fp, std::vector<PreprocCircuit<Ring>> preprocs);
+
+  // Number of unused instances for fingerprint 'fp'.
+  size_t available(uint64_t fp) const;
+
+  // Remove and return the oldest instance for fingerprint 'fp'. Throws
+  // std::runtime_error if none is left, since reusing preprocessing across
+  // evaluations is insecure.
+  PreprocCircuit<Ring> acquire(uint64_t fp);
+
+  void clear() { pool_.clear(); }
+};
+};  // namespace grasp
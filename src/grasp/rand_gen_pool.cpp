@@ -7,8 +7,9 @@
 namespace grasp {
 
   RandGenPool::RandGenPool(int my_id, int num_parties, uint64_t seed) 
-    : id_{my_id}, k_pi(num_parties + 1) { 
+    : id_{my_id}, k_pi(num_parties + 1), block_seeds_(num_parties + 1) { 
     auto seed_block = emp::makeBlock(seed, 0); 
+    std::fill(block_seeds_.begin(), block_seeds_.end(), BlockSeed{seed_block});
     k_self.reseed(&seed_block, 0);
     k_all.reseed(&seed_block, 0);
     k_all_minus_0.reseed(&seed_block, 0);
@@ -27,4 +28,28 @@ emp::PRG& RandGenPool::p0() { return k_p0; }
 
 emp::PRG& RandGenPool::pi(int i) { return k_pi[i]; }
 
+void RandGenPool::setBlockSeed(int idx, const emp::block& seed) { block_seeds_[idx].block = seed; }
+
+void RandGenPool::reseedBlock(uint64_t block_idx) {
+  // emp::PRG::reseed keys AES with seed ^ block_idx and restarts the counter,
+  // so every gate block gets an independent counter-mode stream.
+  k_p0.reseed(&block_seeds_[0].block, block_idx);
+  for (size_t i = 1; i < k_pi.size(); i++) { k_pi[i].reseed(&block_seeds_[i].block, block_idx); }
+}
+
+void RandGenPool::fill(emp::PRG& prg, Ring* data, size_t len) {
+  // emp::PRG::random_data takes an int byte count.
+  constexpr size_t kMaxChunk = (size_t(1) << 28) / sizeof(Ring);
+  for (size_t i = 0; i < len; i += kMaxChunk) {
+    size_t n = std::min(kMaxChunk, len - i);
+    prg.random_data(data + i, static_cast<int>(n * sizeof(Ring)));
+  }
+}
+
+CtrPRG RandGenPool::fork(emp::PRG& prg) {
+  emp::block key;
+  prg.random_block(&key, 1);
+  return CtrPRG(key);
+}
+
 };  // namespace grasp
@@ -3,12 +3,62 @@
 
 #include <vector>
 #include <algorithm>
+#include <cstring>
 #include "../utils/helpers.h"
 
 using namespace common::utils;
 
 namespace grasp {
 
+// Number of consecutive gates (in level order) whose correlated randomness is
+// expanded from the same PRG key when preprocessing is seed-compressed.
+constexpr size_t kGateBlockSize = 1024;
+
+// Counter-mode AES generator with random access. The i-th value of type T is
+// read from AES_k(i * sizeof(T) / 16), so any index range can be expanded
+// independently, e.g. by different threads, with identical results.
+class CtrPRG {
+  emp::AES_KEY aes_;
+
+  // Number of counter blocks encrypted per AES-NI call.
+  static constexpr size_t kBatchBlocks = 8;
+
+ public:
+  CtrPRG() = default;
+  explicit CtrPRG(const emp::block& key) { emp::AES_set_encrypt_key(key, &aes_); }
+
+  template <class T>
+  T at(uint64_t idx) const {
+    static_assert(16 % sizeof(T) == 0, "Value type must divide the AES block size.");
+    constexpr uint64_t per_block = 16 / sizeof(T);
+    emp::block blk = emp::makeBlock(0, idx / per_block);
+    emp::AES_ecb_encrypt_blks(&blk, 1, &aes_);
+    T vals[per_block];
+    std::memcpy(vals, &blk, sizeof(blk));
+    return vals[idx % per_block];
+  }
+
+  // Write values [offset, offset + len) to out.
+  template <class T>
+  void fill(uint64_t offset, T* out, size_t len) const {
+    static_assert(16 % sizeof(T) == 0, "Value type must divide the AES block size.");
+    constexpr uint64_t per_block = 16 / sizeof(T);
+    emp::block blks[kBatchBlocks];
+    size_t done = 0;
+    while (done < len) {
+      uint64_t idx = offset + done;
+      uint64_t first_blk = idx / per_block;
+      size_t lane = idx % per_block;
+      size_t nvals = std::min<size_t>(len - done, kBatchBlocks * per_block - lane);
+      size_t nblks = (lane + nvals + per_block - 1) / per_block;
+      for (size_t b = 0; b < nblks; ++b) { blks[b] = emp::makeBlock(0, first_blk + b); }
+      emp::AES_ecb_encrypt_blks(blks, nblks, &aes_);
+      std::memcpy(out + done, reinterpret_cast<const T*>(blks) + lane, nvals * sizeof(T));
+      done += nvals;
+    }
+  }
+};
+
 // Collection of PRGs.
 class RandGenPool {
   int id_;
@@ -18,7 +68,15 @@ class RandGenPool {
   emp::PRG k_all_minus_0;
   emp::PRG k_all;
   std::vector<emp::PRG> k_pi;
-  
+
+  // Seeds keying the per-gate-block streams. Index 0 keys p0(), index i > 0
+  // keys pi(i). They default to the setup seed and are replaced by dealer
+  // sampled seeds in seed-compressed preprocessing. The block is wrapped, as
+  // std::vector would drop the vector attributes of emp::block.
+  struct alignas(16) BlockSeed {
+    emp::block block;
+  };
+  std::vector<BlockSeed> block_seeds_;
 
  public:
   explicit RandGenPool(int my_id, int num_parties, uint64_t seed = 200);
@@ -28,6 +86,22 @@ class RandGenPool {
   emp::PRG& all(); // { return k_all; }
   emp::PRG& p0(); // { return k_p0; }
   emp::PRG& pi(int i);
+
+  // Install a seed received from (or sent by) the dealer.
+  void setBlockSeed(int idx, const emp::block& seed);
+
+  // Re-key p0() and pi(i) to the AES counter stream of gate block
+  // 'block_idx'. Streams of different blocks are independent, so blocks can
+  // be expanded in any order or in parallel.
+  void reseedBlock(uint64_t block_idx);
+
+  // Fill data[0..len) from prg with as few AES calls as possible.
+  static void fill(emp::PRG& prg, Ring* data, size_t len);
+  static void fill(emp::PRG& prg, std::vector<Ring>& data) { fill(prg, data.data(), data.size()); }
+
+  // Draw a key from prg and return a random-access generator keyed with it.
+  // Both ends of a shared prg obtain the same generator.
+  static CtrPRG fork(emp::PRG& prg);
 };
 
 };  // namespace grasp
@@ -0,0 +1,137 @@
+#include "sort.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace grasp {
+
+size_t sortComparisonBudget(size_t n) {
+  if (n < 2) { return 0; }
+  auto log_n = static_cast<size_t>(std::ceil(std::log2(static_cast<double>(n))));
+  size_t budget = 2 * n * log_n + 3 * 64 * log_n;
+  return (budget + 63) / 64 * 64;
+}
+
+SortWires addSortGates(common::utils::Circuit<Ring>& circ, const std::vector<common::utils::wire_t>& input,
+                       const std::vector<std::vector<int>>& permutation, int owner) {
+  size_t n = input.size();
+  // Keys and values are permuted alike, as the two halves of one shuffle.
+  std::vector<common::utils::wire_t> keyed;
+  keyed.reserve(2 * n);
+  for (size_t i = 0; i < n; ++i) {
+    auto scaled = circ.addConstOpGate(common::utils::GateType::kConstMul, input[i], static_cast<Ring>(n));
+    keyed.push_back(circ.addConstOpGate(common::utils::GateType::kConstAdd, scaled, static_cast<Ring>(i)));
+  }
+  keyed.insert(keyed.end(), input.begin(), input.end());
+  std::vector<std::vector<int>> wide(permutation.size());
+  for (size_t p = 0; p < permutation.size(); ++p) {
+    if (permutation[p].empty()) { continue; }
+    wide[p] = permutation[p];
+    for (int idx : permutation[p]) { wide[p].push_back(idx + static_cast<int>(n)); }
+  }
+  auto shuffled = circ.addMGate(common::utils::GateType::kShuffle, keyed, wide, owner);
+
+  SortWires res;
+  res.keys.assign(shuffled.begin(), shuffled.begin() + n);
+  res.shuffled.assign(shuffled.begin() + n, shuffled.end());
+  size_t budget = sortComparisonBudget(input.size());
+  res.cmp.reserve(budget);
+  // The inputs of the reserved gates are placeholders, SecureSorter supplies
+  // the differences it compares.
+  for (size_t i = 0; i < budget; ++i) {
+    res.cmp.push_back(circ.addGate(common::utils::GateType::kLtz, res.shuffled.back()));
+  }
+  return res;
+}
+
+SecureSorter::SecureSorter(OnlineEvaluator& eval, const common::utils::LevelOrderedCircuit& circ, SortWires wires,
+                           int id)
+    : eval_(eval), wires_(std::move(wires)), id_(id), next_cmp_(0), rounds_(0), comparisons_(0) {
+  if (wires_.cmp.empty()) { return; }
+  // The preprocessing of comparison gates is grouped per level, so the
+  // reserved gates are only usable in batches if they make up all kLtz gates
+  // of their level, in order.
+  std::vector<common::utils::wire_t> level_ltz;
+  for (const auto& level : circ.gates_by_level) {
+    for (const auto& gate : level) {
+      if (gate->out == wires_.cmp[0]) {
+        for (const auto& g : level) {
+          if (g->type == common::utils::GateType::kLtz) { level_ltz.push_back(g->out); }
+        }
+        break;
+      }
+    }
+    if (!level_ltz.empty()) { break; }
+  }
+  if (level_ltz != wires_.cmp) {
+    throw std::invalid_argument("Sort comparison gates must be the only LTZ gates on their level.");
+  }
+  eval_.deferGates(wires_.cmp);
+}
+
+std::vector<common::utils::wire_t> SecureSorter::sort() {
+  if (id_ == 0) { return wires_.shuffled; }
+
+  // Indices of the shuffled values, ordered by their keys.
+  std::vector<size_t> order(wires_.shuffled.size());
+  for (size_t i = 0; i < order.size(); ++i) { order[i] = i; }
+
+  // Unsorted partitions [begin, end) of 'order' with at least two elements.
+  std::vector<std::pair<size_t, size_t>> parts;
+  if (order.size() > 1) { parts.emplace_back(0, order.size()); }
+
+  std::vector<common::utils::wire_t> lhs;
+  std::vector<common::utils::wire_t> rhs;
+  std::vector<size_t> next_order(order.size());
+  while (!parts.empty()) {
+    // Compare every element of every partition with the partition's first
+    // element, which is a uniformly random pivot after the shuffle.
+    lhs.clear();
+    rhs.clear();
+    for (const auto& [begin, end] : parts) {
+      for (size_t i = begin + 1; i < end; ++i) {
+        lhs.push_back(wires_.keys[order[i]]);
+        rhs.push_back(wires_.keys[order[begin]]);
+      }
+    }
+    size_t num_cmp = lhs.size();
+    // Every batch starts at a fresh group of 64 comparison gates.
+    size_t used = (num_cmp + 63) / 64 * 64;
+    if (next_cmp_ + num_cmp > wires_.cmp.size()) {
+      throw std::runtime_error("Sort ran out of preprocessed comparisons.");
+    }
+    std::vector<common::utils::wire_t> cmp(wires_.cmp.begin() + next_cmp_, wires_.cmp.begin() + next_cmp_ + num_cmp);
+    auto less = eval_.revealLessThan(lhs, rhs, cmp);
+    next_cmp_ = std::min(next_cmp_ + used, wires_.cmp.size());
+    rounds_++;
+    comparisons_ += num_cmp;
+
+    std::vector<std::pair<size_t, size_t>> next_parts;
+    size_t idx = 0;
+    for (const auto& [begin, end] : parts) {
+      size_t left = begin;
+      size_t right = end;
+      for (size_t i = begin + 1; i < end; ++i, ++idx) {
+        if (less[idx] != 0) {
+          next_order[left++] = order[i];
+        } else {
+          next_order[--right] = order[i];
+        }
+      }
+      next_order[left] = order[begin];
+      // Elements right of the pivot were written back to front.
+      std::reverse(next_order.begin() + right, next_order.begin() + end);
+      std::copy(next_order.begin() + begin, next_order.begin() + end, order.begin() + begin);
+      if (left - begin > 1) { next_parts.emplace_back(begin, left); }
+      if (end - right > 1) { next_parts.emplace_back(right, end); }
+    }
+    parts = std::move(next_parts);
+  }
+
+  std::vector<common::utils::wire_t> sorted(order.size());
+  for (size_t i = 0; i < order.size(); ++i) { sorted[i] = wires_.shuffled[order[i]]; }
+  return sorted;
+}
+};  // namespace grasp
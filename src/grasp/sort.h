@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "online_evaluator.h"
+#include "../utils/circuit.h"
+#include "../utils/types.h"
+
+namespace grasp {
+// Wires of a secure sort added to a circuit with addSortGates.
+struct SortWires {
+  // Outputs of the shuffle gate, i.e. the values being sorted.
+  std::vector<common::utils::wire_t> shuffled;
+  // Distinct sort keys value * n + input index, shuffled with the values.
+  std::vector<common::utils::wire_t> keys;
+  // kLtz gates whose preprocessing is consumed by the comparisons of the
+  // sort. They are never evaluated as part of their level.
+  std::vector<common::utils::wire_t> cmp;
+};
+
+// Number of comparisons preprocessed for sorting n values: about twice the
+// expected 1.39 n log2(n) comparisons of quicksort, plus one group of 64 per
+// expected round for lanes left unused at the end of a round.
+size_t sortComparisonBudget(size_t n);
+
+// Shuffle 'input' and its sort keys with one kShuffle gate (see
+// Circuit::addMGate for the format of 'permutation', of input.size()
+// elements) and reserve sortComparisonBudget(input.size()) kLtz gates for
+// sorting the shuffled values with SecureSorter. The reserved gates must be
+// the only kLtz gates on their level, so other comparisons of the shuffled
+// values should be added after the sort.
+SortWires addSortGates(common::utils::Circuit<Ring>& circ, const std::vector<common::utils::wire_t>& input,
+                       const std::vector<std::vector<int>>& permutation, int owner = 0);
+
+// Shuffle-then-sort: the values are shuffled by a kShuffle gate, after which
+// revealing the outcome of comparisons only leaks the order of a random
+// permutation of the input. Sorting is a quicksort in which every round
+// compares all elements of all unsorted partitions with their pivot in one
+// batched LTZ, so the number of LTZ rounds is the recursion depth, O(log n)
+// with high probability. The keys compared are value * n + input index, so
+// they are distinct and equal values neither slow the sort down nor show in
+// the comparisons. For n values, (max - min + 1) * n must not exceed
+// 2^(RINGSIZEBITS - 1), e.g. values below 2^21 for 1024 values.
+class SecureSorter {
+  OnlineEvaluator& eval_;
+  SortWires wires_;
+  int id_;
+  size_t next_cmp_;
+  size_t rounds_;
+  size_t comparisons_;
+
+ public:
+  // 'circ' is the level ordered circuit evaluated by 'eval'. Marks the
+  // reserved comparison gates as deferred in 'eval', so the circuit can be
+  // evaluated level by level as usual before calling sort().
+  SecureSorter(OnlineEvaluator& eval, const common::utils::LevelOrderedCircuit& circ, SortWires wires, int id);
+
+  // Sort the shuffled values in ascending order, interpreting them as signed
+  // values. Must be called after the shuffle gate has been evaluated. Returns
+  // the shuffled wires in sorted order; party 0 takes no part in the online
+  // phase and gets the shuffled wires unchanged. Throws std::runtime_error if
+  // the preprocessed comparisons run out.
+  std::vector<common::utils::wire_t> sort();
+
+  [[nodiscard]] size_t rounds() const { return rounds_; }
+  [[nodiscard]] size_t comparisons() const { return comparisons_; }
+};
+};  // namespace grasp
@@ -23,12 +23,19 @@
 // The following code has been adopted from
 // https://github.com/emp-toolkit/emp-agmpc. It has been modified to define the
 // class within a namespace and add additional methods (sendRelative,
-// recvRelative).
+// recvRelative) and tagged channels.
 
 #pragma once
 
 #include <emp-tool/emp-tool.h>
 #include "../utils/types.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 namespace io {
@@ -42,10 +49,15 @@ class NetIOMP {
   int party;
   int nP;
   double latency;
-  std::vector<bool> sent;
+  // Not std::vector<bool>, so that different destinations can be sent to
+  // from different threads.
+  std::vector<uint8_t> sent;
 
   NetIOMP(int party, int nP, double latency, int port, char* IP[], bool localhost = false)
       : ios(nP), ios2(nP), party(party), nP(nP), latency(latency), sent(nP, false) {
+    for (int i = 0; i < nP; ++i) {
+      mux_.push_back(std::make_unique<Mux>());
+    }
     #pragma omp parallel for
     for (int i = 0; i < nP; ++i) {
       for (int j = i + 1; j < nP; ++j) {
@@ -86,7 +98,20 @@ class NetIOMP {
     }
   }
 
+  // Independent message stream 'tag' over the connections of this network.
+  // Channels with different tags can send and receive from different threads
+  // at the same time; data sent on a channel is received by the channel with
+  // the same tag at the peer. Messages are framed with their tag and length
+  // and flushed immediately. A channel must not outlive this object, and
+  // untagged messages must not be in flight while channels are in use.
+  std::shared_ptr<NetIOMP> channel(int tag) {
+    return std::shared_ptr<NetIOMP>(new NetIOMP(this, tag));
+  }
+
   int64_t count() {
+    if (parent_ != nullptr) {
+      return parent_->count();
+    }
     int64_t res = 0;
     for (int i = 0; i < nP; ++i)
       if (i != party) {
@@ -97,6 +122,10 @@ class NetIOMP {
   }
 
   void resetStats() {
+    if (parent_ != nullptr) {
+      parent_->resetStats();
+      return;
+    }
     for (int i = 0; i < nP; ++i) {
       if (i != party) {
         ios[i]->counter = 0;
@@ -106,6 +135,10 @@ class NetIOMP {
   }
 
   void send(int dst, const void* data, size_t len) {
+    if (parent_ != nullptr) {
+      parent_->sendTagged(tag_, dst, data, len);
+      return;
+    }
     if (dst != -1 and dst != party) {
       if (party < dst)
         ios[dst]->send_data(data, len);
@@ -158,6 +191,10 @@ class NetIOMP {
   }
 
   void recv(int src, void* data, size_t len) {
+    if (parent_ != nullptr) {
+      parent_->recvTagged(tag_, src, data, len);
+      return;
+    }
     if (src != -1 && src != party) {
       if (sent[src]) flush(src);
       if (src < party)
@@ -229,6 +266,10 @@ class NetIOMP {
   }
 
   void flush(int idx = -1) {
+    // Messages of channels are flushed when sent.
+    if (parent_ != nullptr) {
+      return;
+    }
     if (idx == -1) {
       for (int i = 0; i < nP; ++i) {
         if (i != party) {
@@ -260,5 +301,83 @@ class NetIOMP {
       }
     }
   }
+
+ private:
+  // Per peer state of the tagged channels.
+  struct Mux {
+    std::mutex send_mutex;
+    std::mutex recv_mutex;
+    std::condition_variable recv_cv;
+    // Set while some thread reads a frame from the connection.
+    bool reading = false;
+    // Received frames per tag, and bytes already consumed of the first one.
+    std::map<int, std::deque<std::vector<uint8_t>>> frames;
+    std::map<int, size_t> offset;
+  };
+
+  std::vector<std::unique_ptr<Mux>> mux_;
+  NetIOMP* parent_ = nullptr;
+  int tag_ = -1;
+
+  NetIOMP(NetIOMP* parent, int tag)
+      : party(parent->party), nP(parent->nP), latency(parent->latency), sent(parent->nP, false),
+        parent_(parent), tag_(tag) {}
+
+  void sendTagged(int tag, int dst, const void* data, size_t len) {
+    if (dst == -1 || dst == party) {
+      return;
+    }
+    uint64_t header[2] = {static_cast<uint64_t>(tag), static_cast<uint64_t>(len)};
+    std::lock_guard<std::mutex> lock(mux_[dst]->send_mutex);
+    NetIO* io = getSendChannel(dst);
+    io->send_data(header, sizeof(header));
+    io->send_data(data, len);
+    io->flush();
+  }
+
+  // Whichever receiver finds no buffered data for its tag reads the next
+  // frame from the connection and buffers it for the tag it belongs to.
+  void recvTagged(int tag, int src, void* data, size_t len) {
+    if (src == -1 || src == party) {
+      return;
+    }
+    Mux& mux = *mux_[src];
+    auto* out = static_cast<uint8_t*>(data);
+    std::unique_lock<std::mutex> lock(mux.recv_mutex);
+    auto& frames = mux.frames[tag];
+    auto& offset = mux.offset[tag];
+    while (len > 0) {
+      if (!frames.empty()) {
+        auto& front = frames.front();
+        size_t num = std::min(len, front.size() - offset);
+        std::memcpy(out, front.data() + offset, num);
+        out += num;
+        len -= num;
+        offset += num;
+        if (offset == front.size()) {
+          frames.pop_front();
+          offset = 0;
+        }
+        continue;
+      }
+      if (mux.reading) {
+        mux.recv_cv.wait(lock);
+        continue;
+      }
+      mux.reading = true;
+      lock.unlock();
+      uint64_t header[2];
+      NetIO* io = getRecvChannel(src);
+      io->recv_data(header, sizeof(header));
+      std::vector<uint8_t> payload(header[1]);
+      io->recv_data(payload.data(), payload.size());
+      lock.lock();
+      mux.reading = false;
+      if (!payload.empty()) {
+        mux.frames[static_cast<int>(header[0])].push_back(std::move(payload));
+      }
+      mux.recv_cv.notify_all();
+    }
+  }
 };
 };  // namespace io
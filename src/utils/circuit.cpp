@@ -25,6 +25,9 @@ FIn4Gate::FIn4Gate(GateType type, wire_t in1, wire_t in2, wire_t in3, wire_t in4
 FIn1Gate::FIn1Gate(GateType type, wire_t in, wire_t out)
     : Gate(type, out), in{in} {}
 
+TruncGate::TruncGate(wire_t in, int shift, wire_t out)
+    : FIn1Gate(GateType::kTrunc, in, out), shift{shift} {}
+
 SIMDGate::SIMDGate(GateType type, std::vector<wire_t> in1, std::vector<wire_t> in2, wire_t out)
     : Gate(type, out), in1(std::move(in1)), in2(std::move(in2)) {}
 
@@ -109,6 +112,10 @@ std::ostream& operator<<(std::ostream& os, GateType type) {
       os << "Public Permutation";
       break;
 
+    case kTrunc:
+      os << "Truncation";
+      break;
+
     default:
       os << "Invalid";
       break;
@@ -125,4 +132,108 @@ std::ostream& operator<<(std::ostream& os, const LevelOrderedCircuit& circ) {
   os << "Depth: " << circ.gates_by_level.size() << std::endl;
   return os;
 }
+
+namespace {
+// FNV-1a over 64-bit words.
+class Fnv64 {
+  uint64_t state_{14695981039346656037ULL};
+
+ public:
+  void add(uint64_t val) {
+    for (int i = 0; i < 8; ++i) {
+      state_ ^= (val >> (8 * i)) & 0xff;
+      state_ *= 1099511628211ULL;
+    }
+  }
+
+  void add(const std::vector<int>& vals) {
+    add(vals.size());
+    for (auto v : vals) { add(static_cast<uint64_t>(v)); }
+  }
+
+  uint64_t value() const { return state_; }
+};
+};  // namespace
+
+uint64_t fingerprint(const LevelOrderedCircuit& circ) {
+  Fnv64 hash;
+  hash.add(circ.num_wires);
+  hash.add(static_cast<uint64_t>(circ.cmp_radix));
+  hash.add(circ.gates_by_level.size());
+  for (const auto& level : circ.gates_by_level) {
+    hash.add(level.size());
+    for (const auto& gate : level) {
+      switch (gate->type) {
+        case kInp:
+        case kMul:
+        case kMul3:
+        case kMul4:
+        case kEqz:
+        case kLtz: {
+          hash.add(gate->type);
+          hash.add(gate->out);
+          break;
+        }
+
+        case kTrunc: {
+          const auto* g = static_cast<TruncGate*>(gate.get());
+          hash.add(gate->type);
+          hash.add(gate->out);
+          hash.add(static_cast<uint64_t>(g->shift));
+          break;
+        }
+
+        case kDotprod: {
+          const auto* g = static_cast<SIMDGate*>(gate.get());
+          hash.add(gate->type);
+          hash.add(gate->out);
+          hash.add(g->in1.size());
+          break;
+        }
+
+        case kShuffle:
+        case kPermAndSh: {
+          const auto* g = static_cast<SIMDOGate*>(gate.get());
+          hash.add(gate->type);
+          hash.add(gate->out);
+          hash.add(static_cast<uint64_t>(gate->owner));
+          hash.add(g->in.size());
+          for (const auto& perm : g->permutation) { hash.add(perm); }
+          break;
+        }
+
+        case kAmortzdPnS: {
+          const auto* g = static_cast<SIMDMOGate*>(gate.get());
+          hash.add(gate->type);
+          hash.add(gate->out);
+          hash.add(g->in.size());
+          for (const auto& perm : g->permutation) { hash.add(perm); }
+          break;
+        }
+
+        default:
+          break;
+      }
+    }
+  }
+  return hash.value();
+}
+
+const LevelOrderedCircuit& multKCircuit(int radix) {
+  static const std::array<LevelOrderedCircuit, 3> circuits = {
+      Circuit<BoolRing>::generateMultK(2).orderGatesByLevel(),
+      Circuit<BoolRing>::generateMultK(3).orderGatesByLevel(),
+      Circuit<BoolRing>::generateMultK(4).orderGatesByLevel()};
+  if (radix < 2 || radix > 4) { throw std::invalid_argument("Comparison radix must be 2, 3 or 4."); }
+  return circuits[radix - 2];
+}
+
+const LevelOrderedCircuit& prefixORCircuit(int radix) {
+  static const std::array<LevelOrderedCircuit, 3> circuits = {
+      Circuit<BoolRing>::generateParaPrefixOR(2, 2).orderGatesByLevel(),
+      Circuit<BoolRing>::generateParaPrefixOR(2, 3).orderGatesByLevel(),
+      Circuit<BoolRing>::generateParaPrefixOR(2, 4).orderGatesByLevel()};
+  if (radix < 2 || radix > 4) { throw std::invalid_argument("Comparison radix must be 2, 3 or 4."); }
+  return circuits[radix - 2];
+}
 };  // namespace common::utils
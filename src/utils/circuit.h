@@ -38,6 +38,7 @@ enum GateType {
   kPermAndSh,
   kAmortzdPnS,
   kPublicPerm,
+  kTrunc,
   kInvalid,
   NumGates
 };
@@ -97,6 +98,15 @@ struct FIn1Gate : public Gate {
   FIn1Gate(GateType type, wire_t in, wire_t out);
 };
 
+// Represents an arithmetic right shift of the input by 'shift' bits, see
+// Circuit::addTruncGate.
+struct TruncGate : public FIn1Gate {
+  int shift{0};
+
+  TruncGate() = default;
+  TruncGate(wire_t in, int shift, wire_t out);
+};
+
 // Represents a gate used to denote SIMD operations.
 // These type is used to represent operations that take vectors of inputs but
 // might not necessarily be SIMD e.g., dot product.
@@ -155,21 +165,45 @@ struct LevelOrderedCircuit {
   std::array<uint64_t, GateType::NumGates> count;
   std::vector<wire_t> outputs;
   std::vector<std::vector<gate_ptr_t>> gates_by_level;
+  // Fan-in of the AND gates in the EQZ/LTZ sub-circuits (see
+  // Circuit::setComparisonRadix).
+  int cmp_radix{4};
 
   friend std::ostream& operator<<(std::ostream& os, const LevelOrderedCircuit& circ);
 };
 
+// Hash of everything preprocessing depends on: the type, output wires and
+// owner of every interactive gate, the sizes of vector gates and the
+// permutations of shuffle and permute-and-share gates. Linear gates and
+// constants are ignored, so circuits with equal fingerprints can share
+// preprocessing. Must be computed before preprocessing, which moves the
+// permutations out of the gates.
+uint64_t fingerprint(const LevelOrderedCircuit& circ);
+
 // Represents an arithmetic circuit.
 template <class R>
 class Circuit {
   std::vector<wire_t> outputs_;
   std::vector<gate_ptr_t> gates_;
   size_t num_wires;
+  int cmp_radix_;
 
   bool isWireValid(wire_t wid) { return wid < num_wires; }
 
  public:
-  Circuit() : num_wires(0) {}
+  Circuit() : num_wires(0), cmp_radix_(4) {}
+
+  // Fan-in (2, 3 or 4) of the AND gates used to evaluate EQZ and LTZ gates.
+  // A comparison takes ceil(log_radix(RINGSIZEBITS)) + 1 Boolean rounds, so a
+  // higher radix saves rounds at the cost of larger preprocessing per AND.
+  void setComparisonRadix(int radix) {
+    if (radix < 2 || radix > 4) {
+      throw std::invalid_argument("Comparison radix must be 2, 3 or 4.");
+    }
+    cmp_radix_ = radix;
+  }
+
+  [[nodiscard]] int comparisonRadix() const { return cmp_radix_; }
 
   // Methods to manually build a circuit.
   wire_t newInputWire() {
@@ -278,6 +312,40 @@ class Circuit {
     return output;
   }
 
+  // Function to add a truncation gate, dividing the input by 2^shift and
+  // rounding down. The secure evaluation may return one more. The input must
+  // be below 2^(RINGSIZEBITS - 2) in absolute value.
+  wire_t addTruncGate(wire_t wid, int shift) {
+    if (shift < 1 || shift >= static_cast<int>(RINGSIZEBITS) - 2) {
+      throw std::invalid_argument("Invalid truncation shift.");
+    }
+
+    if (!isWireValid(wid)) {
+      throw std::invalid_argument("Invalid wire ID.");
+    }
+
+    wire_t output = num_wires;
+    gates_.push_back(std::make_shared<TruncGate>(wid, shift, output));
+    num_wires += 1;
+
+    return output;
+  }
+
+  // Fixed-point product of 'wid' and the constant 'cval', encoded with 'frac'
+  // fractional bits. The result has the scale of 'wid'. The product before
+  // truncation must fit the bound of addTruncGate.
+  wire_t addFixedConstMul(wire_t wid, double cval, int frac = FRACTION) {
+    auto prod = addConstOpGate(GateType::kConstMul, wid, R(toFixed(cval, frac)));
+    return addTruncGate(prod, frac);
+  }
+
+  // Fixed-point product of 'input1' and 'input2', the latter with 'frac'
+  // fractional bits. The result has the scale of 'input1'.
+  wire_t addFixedMul(wire_t input1, wire_t input2, int frac = FRACTION) {
+    auto prod = addGate(GateType::kMul, input1, input2);
+    return addTruncGate(prod, frac);
+  }
+
   // Function to add a multiple fan-in gate.
   wire_t addGate(GateType type, const std::vector<wire_t>& input1,
                  const std::vector<wire_t>& input2) {
@@ -301,7 +369,8 @@ class Circuit {
     return output;
   }
 
-  // Function to add a multiple in + out gate.
+  // Function to add a multiple in + out gate. Only the owner's permutation
+  // of a kPermAndSh gate is used, so the others may be left empty.
   std::vector<wire_t> addMGate(GateType type, const std::vector<wire_t>& input, const std::vector<std::vector<int>> &permutation,
                                int owner = 0) {
     if (type != GateType::kShuffle && type != GateType::kPermAndSh) {
@@ -319,6 +388,9 @@ class Circuit {
     }
 
     for (size_t i = 0; i < permutation.size(); ++i) {
+      if (type == GateType::kPermAndSh && permutation[i].empty()) {
+        continue;
+      }
       if (input.size() != permutation[i].size()) {
         throw std::invalid_argument("Permutation size mismatch.");
       }
@@ -386,7 +458,7 @@ class Circuit {
     std::vector<std::vector<wire_t>> output(nP, std::vector<wire_t>(input.size()));
     for (int pid = 0; pid < nP; ++pid) {
       for (int i = 0; i < input.size(); i++) {
-        output[pid][i] = pid * nP + i + num_wires;
+        output[pid][i] = pid * input.size() + i + num_wires;
       }
     }
     gates_.push_back(std::make_shared<SIMDMOGate>(type, 0, input, output, permutation));
@@ -400,6 +472,7 @@ class Circuit {
     res.outputs = outputs_;
     res.num_gates = gates_.size();
     res.num_wires = num_wires;
+    res.cmp_radix = cmp_radix_;
 
     // Map from output wire id to multiplicative depth/level.
     // Input gates have a depth of 0.
@@ -454,7 +527,8 @@ class Circuit {
         case GateType::kEqz:
         case GateType::kLtz:
         case GateType::kRelu:
-        case GateType::kMsb: {
+        case GateType::kMsb:
+        case GateType::kTrunc: {
           const auto* g = static_cast<FIn1Gate*>(gate.get());
           gate_level[g->out] = gate_level[g->in] + 1;
           depth = std::max(depth, gate_level[gate->out]);
@@ -621,7 +695,7 @@ class Circuit {
               wires[g->out] = wires[g->in];
             } else {
               std::vector<BoolRing> bin = bitDecomposeTwo(wires[g->in]);
-              wires[g->out] = bin[63].val();
+              wires[g->out] = bin[RINGSIZEBITS - 1].val();
             }
             break;
           }
@@ -649,7 +723,17 @@ class Circuit {
               wires[g->out] = wires[g->in];
             } else {
               std::vector<BoolRing> bin = bitDecomposeTwo(wires[g->in]);
-              wires[g->out] = bin[63].val();
+              wires[g->out] = bin[RINGSIZEBITS - 1].val();
+            }
+            break;
+          }
+
+          case GateType::kTrunc: {
+            if constexpr (std::is_same_v<R, BoolRing>) {
+              throw std::runtime_error("Truncation gates are invalid for BoolRing.");
+            } else {
+              auto* g = static_cast<TruncGate*>(gate.get());
+              wires[g->out] = R(static_cast<std::make_signed_t<R>>(wires[g->in]) >> g->shift);
             }
             break;
           }
@@ -695,7 +779,25 @@ class Circuit {
     return outputs;
   }
 
-  static Circuit generateParaPrefixOR(int repeat) {
+  // AND of 'inputs' with a single gate of fan-in inputs.size() (at most 4).
+  wire_t addAndGate(const std::vector<wire_t>& inputs) {
+    switch (inputs.size()) {
+      case 2:
+        return addGate(GateType::kMul, inputs[0], inputs[1]);
+      case 3:
+        return addGate(GateType::kMul3, inputs[0], inputs[1], inputs[2]);
+      case 4:
+        return addGate(GateType::kMul4, inputs[0], inputs[1], inputs[2], inputs[3]);
+      default:
+        throw std::invalid_argument("Invalid fan-in.");
+    }
+  }
+
+  // Prefix OR over the bits of 'repeat' values followed by a dot product of
+  // the first-set-bit indicator with a second input vector. The prefix is
+  // computed as a prefix AND of the complemented inputs, combining 'radix'
+  // blocks per level.
+  static Circuit generateParaPrefixOR(int repeat, int radix = 4) {
     Circuit circ;
     size_t k = RINGSIZEBITS;
     std::vector<wire_t> input(repeat * k);
@@ -712,20 +814,29 @@ class Circuit {
     }
     R zero = R(0);
     R one = R(1);
-    std::vector<wire_t> leveli(repeat * k);
-    leveli = std::move(input);
-    for (size_t level = 1; level <= log(k) / log(4); level++) {
+    std::vector<wire_t> leveli = std::move(input);
+    // After the level with sub-block size 'sub', wire i holds the AND of all
+    // inputs from the start of its block of size sub * radix up to i.
+    for (size_t sub = 1; sub < k; sub *= radix) {
+      size_t block = sub * radix;
       std::vector<wire_t> level_next(repeat * k);
-      for (size_t j = 1; j <= repeat * k / pow(4, level); j++) {
-        size_t p = (j - 1) * pow(4, level);
-        size_t q = (j - 1) * pow(4, level) + pow(4, level - 1);
-        size_t r = (j - 1) * pow(4, level) + 2 * pow(4, level - 1);
-        size_t s = (j - 1) * pow(4, level) + 3 * pow(4, level - 1);
-        for (size_t i = 0; i < pow(4, level - 1); i++) {
-          level_next[p + i] = circ.addConstOpGate(GateType::kConstAdd, leveli[p + i], zero);
-          level_next[q + i] = circ.addGate(GateType::kMul, leveli[q - 1], leveli[q + i]);
-          level_next[r + i] = circ.addGate(GateType::kMul3, leveli[q - 1], leveli[r - 1], leveli[r + i]);
-          level_next[s + i] = circ.addGate(GateType::kMul4, leveli[q - 1], leveli[r - 1], leveli[s - 1], leveli[s + i]);
+      for (int rep = 0; rep < repeat; rep++) {
+        for (size_t p = 0; p < k; p += block) {
+          std::vector<wire_t> lasts;
+          for (size_t t = 0; t < radix && p + t * sub < k; t++) {
+            size_t begin = rep * k + p + t * sub;
+            size_t end = rep * k + std::min(p + (t + 1) * sub, k);
+            for (size_t i = begin; i < end; i++) {
+              if (t == 0) {
+                level_next[i] = circ.addConstOpGate(GateType::kConstAdd, leveli[i], zero);
+              } else {
+                std::vector<wire_t> and_in(lasts);
+                and_in.push_back(leveli[i]);
+                level_next[i] = circ.addAndGate(and_in);
+              }
+            }
+            lasts.push_back(leveli[end - 1]);
+          }
         }
       }
       leveli = std::move(level_next);
@@ -744,35 +855,46 @@ class Circuit {
         wz[i][j] = circ.addGate(GateType::kAdd, wv[i][j], wv[i][j - 1]);
       }
     }
-    std::vector<wire_t> inp1(k * repeat), inp2(k * repeat);
+    std::vector<wire_t> inp1, inp2;
+    inp1.reserve(k * repeat);
+    inp2.reserve(k * repeat);
     for (size_t i = 0; i < repeat; i++) {
-      inp1.insert(inp1.begin(), wz[i].begin(), wz[i].end());
-      inp2.insert(inp2.begin(), inp_d[i].begin(), inp_d[i].end());
+      inp1.insert(inp1.end(), wz[i].begin(), wz[i].end());
+      inp2.insert(inp2.end(), inp_d[i].begin(), inp_d[i].end());
     }
     wire_t res = circ.addGate(GateType::kDotprod, inp1, inp2);
     circ.setAsOutput(res);
     return circ;
   }
 
-  static Circuit generateMultK() {
+  // AND of RINGSIZEBITS inputs as a tree of fan-in 'radix'.
+  static Circuit generateMultK(int radix = 4) {
     Circuit circ;
     size_t k = RINGSIZEBITS;
-    std::vector<wire_t> input(k);
-    for (int i = 0; i < k; i++) {
-      input[i] = circ.newInputWire();
-    }
     std::vector<wire_t> leveli(k);
-    leveli = std::move(input);
-    for (size_t level = 1; level <= log(k) / log(4); level++) {
-      std::vector<wire_t> level_next(k / pow(4, level));
-      for (size_t j = 1; j <= k / pow(4, level); j++) {
-        level_next[j - 1] = circ.addGate(GateType::kMul4, leveli[(4 * j) - 4], leveli[(4 * j) - 3], leveli[(4 * j) - 2], leveli[(4 * j) - 1]);
+    for (int i = 0; i < k; i++) {
+      leveli[i] = circ.newInputWire();
+    }
+    while (leveli.size() > 1) {
+      std::vector<wire_t> level_next;
+      for (size_t j = 0; j < leveli.size(); j += radix) {
+        size_t end = std::min(j + radix, leveli.size());
+        if (end - j == 1) {
+          level_next.push_back(leveli[j]);
+        } else {
+          level_next.push_back(circ.addAndGate(std::vector<wire_t>(leveli.begin() + j, leveli.begin() + end)));
+        }
       }
-      leveli.resize(k / pow(4, level));
       leveli = std::move(level_next);
     }
     circ.setAsOutput(leveli[0]);
     return circ;
   }
 };
+
+// Level-ordered Boolean sub-circuits used by EQZ (MultK) and LTZ (PrefixOR
+// over two values) for the given comparison radix. Built once per radix and
+// shared by the offline and online evaluators.
+const LevelOrderedCircuit& multKCircuit(int radix);
+const LevelOrderedCircuit& prefixORCircuit(int radix);
 };  // namespace common::utils
@@ -0,0 +1,509 @@
+#include "graph.h"
+
+#include <fcntl.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "permutation.h"
+
+namespace common::utils {
+namespace {
+// Read-only memory map of a whole file.
+class MappedFile {
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+
+ public:
+  explicit MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Could not open graph file " + path + ".");
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw std::runtime_error("Could not read graph file " + path + ".");
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ != 0) {
+      void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("Could not map graph file " + path + ".");
+      }
+      madvise(addr, size_, MADV_WILLNEED);
+      data_ = static_cast<const char*>(addr);
+    }
+    close(fd);
+  }
+
+  ~MappedFile() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  [[nodiscard]] const char* data() const { return data_; }
+  [[nodiscard]] size_t size() const { return size_; }
+};
+
+// Edges parsed by one thread.
+struct EdgeChunk {
+  std::vector<Edge> edges;
+  // Kept for text edge lists only, one per edge.
+  std::vector<Ring> weights;
+  bool has_weights = false;
+  // Whether any edge, including self-loops, was read.
+  bool has_ids = false;
+  size_t max_id = 0;
+  // Offset of the first malformed line, or SIZE_MAX.
+  size_t error = SIZE_MAX;
+
+  void add(uint64_t src, uint64_t dst) {
+    has_ids = true;
+    max_id = std::max<size_t>(max_id, std::max(src, dst));
+    if (src != dst) {
+      edges.push_back({static_cast<uint32_t>(src), static_cast<uint32_t>(dst)});
+    }
+  }
+
+  void add(uint64_t src, uint64_t dst, Ring weight) {
+    add(src, dst);
+    if (src != dst) {
+      weights.push_back(weight);
+    }
+  }
+};
+
+bool isSeparator(char c) { return c == ' ' || c == '\t' || c == ',' || c == '\r'; }
+
+// Parse the lines of 'text' starting in [begin, end).
+void parseTextChunk(const char* text, size_t size, size_t begin, size_t end, EdgeChunk& chunk) {
+  size_t pos = begin;
+  if (pos != 0 && text[pos - 1] != '\n') {
+    const auto* nl = static_cast<const char*>(std::memchr(text + pos, '\n', size - pos));
+    pos = nl == nullptr ? size : static_cast<size_t>(nl - text) + 1;
+  }
+  while (pos < end) {
+    const char* p = text + pos;
+    const auto* line_end = static_cast<const char*>(std::memchr(p, '\n', size - pos));
+    if (line_end == nullptr) {
+      line_end = text + size;
+    }
+    size_t line = pos;
+    pos = static_cast<size_t>(line_end - text) + 1;
+
+    while (p < line_end && isSeparator(*p)) {
+      ++p;
+    }
+    if (p == line_end || *p == '#' || *p == '%') {
+      continue;
+    }
+    uint64_t ids[2];
+    int64_t weight = 1;
+    int num_cols = 0;
+    bool ok = true;
+    while (p < line_end && ok) {
+      std::from_chars_result res{};
+      if (num_cols < 2) {
+        res = std::from_chars(p, line_end, ids[num_cols]);
+        ok = res.ec == std::errc() && ids[num_cols] < UINT32_MAX;
+      } else if (num_cols == 2) {
+        res = std::from_chars(p, line_end, weight);
+        ok = res.ec == std::errc();
+      } else {
+        ok = false;
+      }
+      if (!ok) {
+        break;
+      }
+      num_cols++;
+      p = res.ptr;
+      if (p < line_end && !isSeparator(*p)) {
+        ok = false;
+      }
+      while (p < line_end && isSeparator(*p)) {
+        ++p;
+      }
+    }
+    if (!ok || num_cols < 2) {
+      chunk.error = line;
+      return;
+    }
+    chunk.has_weights |= num_cols == 3;
+    chunk.add(ids[0], ids[1], static_cast<Ring>(weight));
+  }
+}
+
+// Concatenate the chunks in order.
+Graph mergeChunks(std::vector<EdgeChunk>& chunks) {
+  Graph graph;
+  std::vector<size_t> offset(chunks.size() + 1, 0);
+  bool has_weights = false;
+  bool has_ids = false;
+  for (size_t t = 0; t < chunks.size(); ++t) {
+    offset[t + 1] = offset[t] + chunks[t].edges.size();
+    has_weights |= chunks[t].has_weights;
+    has_ids |= chunks[t].has_ids;
+    graph.num_vert = std::max(graph.num_vert, chunks[t].max_id);
+  }
+  // The vertices are the IDs up to the largest one read.
+  if (has_ids) {
+    graph.num_vert += 1;
+  }
+  graph.edges.resize(offset.back());
+  if (has_weights) {
+    graph.weights.resize(offset.back());
+  }
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int64_t t = 0; t < static_cast<int64_t>(chunks.size()); ++t) {
+    std::copy(chunks[t].edges.begin(), chunks[t].edges.end(), graph.edges.begin() + offset[t]);
+    if (has_weights) {
+      std::copy(chunks[t].weights.begin(), chunks[t].weights.end(), graph.weights.begin() + offset[t]);
+    }
+    chunks[t] = EdgeChunk();
+  }
+  return graph;
+}
+
+bool endsWith(const std::string& str, const std::string& suffix) {
+  return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Merge the sorted sequences 'lhs' and 'rhs' by less(a, b).
+template <class Less>
+std::vector<int> mergeSorted(const std::vector<int>& lhs, const std::vector<int>& rhs, Less less) {
+  std::vector<int> res(lhs.size() + rhs.size());
+  std::merge(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), res.begin(), less);
+  return res;
+}
+
+// Stable counting sort of the elements [0, n) by key(q) < num_keys. Returns
+// the sorted position of every element.
+template <class Key>
+std::vector<int> stableSortSlots(size_t n, size_t num_keys, Key key) {
+  std::vector<int> next(num_keys + 1, 0);
+  for (size_t q = 0; q < n; ++q) {
+    next[key(q) + 1]++;
+  }
+  for (size_t k = 0; k < num_keys; ++k) {
+    next[k + 1] += next[k];
+  }
+  std::vector<int> slot(n);
+  for (size_t q = 0; q < n; ++q) {
+    slot[q] = next[key(q)]++;
+  }
+  return slot;
+}
+};  // namespace
+
+Graph loadEdgeList(const std::string& path, EdgeListFormat format, int threads) {
+  if (format == EdgeListFormat::kAuto) {
+    format = endsWith(path, ".bin") ? EdgeListFormat::kBinary : EdgeListFormat::kText;
+  }
+  if (threads <= 0) {
+    threads = omp_get_max_threads();
+  }
+  MappedFile file(path);
+  const char* data = file.data();
+  size_t size = file.size();
+  if (format == EdgeListFormat::kBinary && size % (2 * sizeof(uint32_t)) != 0) {
+    throw std::runtime_error("Size of binary edge list " + path + " is not a multiple of 8 bytes.");
+  }
+
+  // Text chunks are split at byte offsets, binary ones at edges.
+  size_t unit = format == EdgeListFormat::kBinary ? 2 * sizeof(uint32_t) : 1;
+  size_t num_units = size / unit;
+  std::vector<EdgeChunk> chunks(threads);
+  #pragma omp parallel for num_threads(threads) schedule(static, 1)
+  for (int t = 0; t < threads; ++t) {
+    size_t begin = num_units * t / threads;
+    size_t end = num_units * (t + 1) / threads;
+    auto& chunk = chunks[t];
+    if (format == EdgeListFormat::kText) {
+      parseTextChunk(data, size, begin, end, chunk);
+      continue;
+    }
+    chunk.edges.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+      uint32_t ids[2];
+      std::memcpy(ids, data + i * unit, unit);
+      chunk.add(ids[0], ids[1]);
+    }
+  }
+  for (const auto& chunk : chunks) {
+    if (chunk.error != SIZE_MAX) {
+      throw std::runtime_error("Malformed edge at byte " + std::to_string(chunk.error) + " of " + path + ".");
+    }
+  }
+  return mergeChunks(chunks);
+}
+
+std::vector<int> rangeOwners(size_t num_vert, int nP) {
+  if (nP < 1) {
+    throw std::invalid_argument("Number of parties must be positive.");
+  }
+  std::vector<int> owner(num_vert);
+  size_t per_party = num_vert / nP;
+  #pragma omp parallel for
+  for (int64_t v = 0; v < static_cast<int64_t>(num_vert); ++v) {
+    owner[v] = per_party == 0 ? nP : static_cast<int>(std::min<size_t>(v / per_party + 1, nP));
+  }
+  return owner;
+}
+
+std::vector<SubgraphDag> buildSubgraphs(const Graph& graph, const std::vector<int>& owner, int nP) {
+  if (owner.size() != graph.num_vert) {
+    throw std::invalid_argument("Vertex owner count mismatch.");
+  }
+  if (graph.num_vert + graph.edges.size() > static_cast<size_t>(INT_MAX)) {
+    throw std::invalid_argument("Graph too large for DAG-list permutations.");
+  }
+  for (int o : owner) {
+    if (o < 1 || o > nP) {
+      throw std::invalid_argument("Invalid vertex owner.");
+    }
+  }
+  const auto& edges = graph.edges;
+  size_t num_edges = edges.size();
+
+  // Edges grouped by the owner of their destination, keeping their order.
+  std::vector<uint32_t> by_owner(num_edges);
+  auto offsets = detail::partitionByBlock(
+      num_edges, nP, [&](size_t i) { return static_cast<size_t>(owner[edges[i].dst] - 1); },
+      [&](size_t i, size_t slot) { by_owner[slot] = static_cast<uint32_t>(i); });
+
+  constexpr uint32_t kNone = UINT32_MAX;
+  std::vector<uint32_t> local(graph.num_vert, kNone);
+  std::vector<SubgraphDag> subgraphs(nP);
+  for (int p = 0; p < nP; ++p) {
+    auto& sub = subgraphs[p];
+    for (size_t v = 0; v < graph.num_vert; ++v) {
+      if (owner[v] == p + 1) {
+        local[v] = static_cast<uint32_t>(sub.vertices.size());
+        sub.vertices.push_back(static_cast<uint32_t>(v));
+      }
+    }
+    sub.num_own = sub.vertices.size();
+
+    size_t begin = offsets[p];
+    size_t num_sub_edges = offsets[p + 1] - begin;
+    sub.edges.resize(num_sub_edges);
+    if (!graph.weights.empty()) {
+      sub.weights.resize(num_sub_edges);
+    }
+    #pragma omp parallel for
+    for (int64_t k = 0; k < static_cast<int64_t>(num_sub_edges); ++k) {
+      sub.edges[k] = edges[by_owner[begin + k]];
+      if (!graph.weights.empty()) {
+        sub.weights[k] = graph.weights[by_owner[begin + k]];
+      }
+    }
+
+    // Sources owned by other parties, in order of global ID.
+    std::vector<uint32_t> neighbours;
+    for (const auto& e : sub.edges) {
+      if (local[e.src] == kNone) {
+        local[e.src] = kNone - 1;
+        neighbours.push_back(e.src);
+      }
+    }
+    std::sort(neighbours.begin(), neighbours.end());
+    for (auto u : neighbours) {
+      local[u] = static_cast<uint32_t>(sub.vertices.size());
+      sub.vertices.push_back(u);
+    }
+
+    sub.perm_g.resize(graph.num_vert);
+    int next = static_cast<int>(sub.vertices.size());
+    for (size_t v = 0; v < graph.num_vert; ++v) {
+      sub.perm_g[v] = local[v] == kNone ? next++ : static_cast<int>(local[v]);
+    }
+
+    // Vertex j has source key 2j and destination key 2j + 1, and an edge
+    // (u, w) has source key 2u + 1 and destination key 2w, in local IDs.
+    size_t num_dag_vert = sub.vertices.size();
+    size_t dag_size = sub.dagSize();
+    std::vector<uint32_t> src_key(dag_size);
+    std::vector<uint32_t> dst_key(dag_size);
+    #pragma omp parallel for
+    for (int64_t i = 0; i < static_cast<int64_t>(dag_size); ++i) {
+      if (i < static_cast<int64_t>(num_dag_vert)) {
+        src_key[i] = 2 * i;
+        dst_key[i] = 2 * i + 1;
+      } else {
+        const auto& e = sub.edges[i - num_dag_vert];
+        src_key[i] = 2 * local[e.src] + 1;
+        dst_key[i] = 2 * local[e.dst];
+      }
+    }
+    sub.perm_s = stableSortSlots(dag_size, 2 * num_dag_vert, [&](size_t i) { return src_key[i]; });
+    auto src_order = invertPermutation(sub.perm_s);
+    sub.perm_d = stableSortSlots(dag_size, 2 * num_dag_vert, [&](size_t q) { return dst_key[src_order[q]]; });
+    sub.perm_v.resize(dag_size);
+    #pragma omp parallel for
+    for (int64_t q = 0; q < static_cast<int64_t>(dag_size); ++q) {
+      sub.perm_v[sub.perm_d[q]] = src_order[q];
+    }
+
+    for (auto v : sub.vertices) {
+      local[v] = kNone;
+    }
+  }
+  return subgraphs;
+}
+
+void applyEdgeUpdates(SubgraphDag& sub, const std::vector<int>& owner, int party, const EdgeUpdates& updates) {
+  size_t num_vert = owner.size();
+  if (sub.perm_g.size() != num_vert) {
+    throw std::invalid_argument("Vertex owner count mismatch.");
+  }
+  if (!updates.inserted_weights.empty() && updates.inserted_weights.size() != updates.inserted.size()) {
+    throw std::invalid_argument("Inserted edge weight count mismatch.");
+  }
+  auto owned = [&](const Edge& e) {
+    if (e.src >= num_vert || e.dst >= num_vert) {
+      throw std::invalid_argument("Updated edge out of range.");
+    }
+    return e.src != e.dst && owner[e.dst] == party;
+  };
+  auto edge_key = [](const Edge& e) { return (static_cast<uint64_t>(e.src) << 32) | e.dst; };
+
+  // Mark one occurrence of every deleted edge, in the order of the edges.
+  std::unordered_map<uint64_t, size_t> to_delete;
+  for (const auto& e : updates.deleted) {
+    if (owned(e)) { to_delete[edge_key(e)]++; }
+  }
+  size_t num_old_edges = sub.edges.size();
+  std::vector<bool> deleted(num_old_edges, false);
+  size_t num_deleted = 0;
+  for (size_t k = 0; k < num_old_edges && num_deleted < updates.deleted.size(); ++k) {
+    auto it = to_delete.find(edge_key(sub.edges[k]));
+    if (it != to_delete.end() && it->second != 0) {
+      it->second--;
+      deleted[k] = true;
+      num_deleted++;
+    }
+  }
+  for (const auto& [key, count] : to_delete) {
+    if (count != 0) {
+      throw std::invalid_argument("Deleted edge not in subgraph.");
+    }
+  }
+
+  std::vector<size_t> inserted;
+  for (size_t k = 0; k < updates.inserted.size(); ++k) {
+    if (owned(updates.inserted[k])) { inserted.push_back(k); }
+  }
+
+  // Sources of inserted edges new to the subgraph, in order of global ID.
+  size_t num_old_vert = sub.vertices.size();
+  std::vector<uint32_t> neighbours;
+  for (auto k : inserted) {
+    auto u = updates.inserted[k].src;
+    if (static_cast<size_t>(sub.perm_g[u]) >= num_old_vert) { neighbours.push_back(u); }
+  }
+  std::sort(neighbours.begin(), neighbours.end());
+  neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+  sub.vertices.insert(sub.vertices.end(), neighbours.begin(), neighbours.end());
+  size_t num_dag_vert = sub.vertices.size();
+  if (num_dag_vert + num_old_edges - num_deleted + inserted.size() > static_cast<size_t>(INT_MAX)) {
+    throw std::invalid_argument("Graph too large for DAG-list permutations.");
+  }
+
+  // New index of every old tuple of the DAG list, -1 if deleted.
+  std::vector<int> remap(num_old_vert + num_old_edges);
+  std::iota(remap.begin(), remap.begin() + num_old_vert, 0);
+  size_t num_kept = 0;
+  bool has_weights = !sub.weights.empty() || !updates.inserted_weights.empty();
+  std::vector<Edge> edges;
+  std::vector<Ring> weights;
+  edges.reserve(num_old_edges - num_deleted + inserted.size());
+  for (size_t k = 0; k < num_old_edges; ++k) {
+    if (deleted[k]) {
+      remap[num_old_vert + k] = -1;
+      continue;
+    }
+    remap[num_old_vert + k] = static_cast<int>(num_dag_vert + num_kept++);
+    edges.push_back(sub.edges[k]);
+    if (has_weights) { weights.push_back(sub.weights.empty() ? Ring(1) : sub.weights[k]); }
+  }
+  for (auto k : inserted) {
+    edges.push_back(updates.inserted[k]);
+    if (has_weights) { weights.push_back(updates.inserted_weights.empty() ? Ring(1) : updates.inserted_weights[k]); }
+  }
+  sub.edges = std::move(edges);
+  sub.weights = std::move(weights);
+
+  // The new neighbours take the first local IDs after the old vertices, the
+  // vertices outside the subgraph follow in global order.
+  std::vector<int> local(num_vert, -1);
+  for (size_t j = 0; j < num_dag_vert; ++j) { local[sub.vertices[j]] = static_cast<int>(j); }
+  int next = static_cast<int>(num_dag_vert);
+  for (size_t v = 0; v < num_vert; ++v) {
+    sub.perm_g[v] = local[v] < 0 ? next++ : local[v];
+  }
+
+  // Keys of buildSubgraphs. Old tuples keep their keys and relative order, so
+  // their sorted orders only need to be merged with the new tuples.
+  size_t dag_size = sub.dagSize();
+  auto src_key = [&](size_t i) -> uint64_t {
+    return i < num_dag_vert ? 2 * i : 2 * static_cast<uint64_t>(local[sub.edges[i - num_dag_vert].src]) + 1;
+  };
+  auto dst_key = [&](size_t i) -> uint64_t {
+    return i < num_dag_vert ? 2 * i + 1 : 2 * static_cast<uint64_t>(local[sub.edges[i - num_dag_vert].dst]);
+  };
+  std::vector<int> added;
+  for (size_t j = num_old_vert; j < num_dag_vert; ++j) { added.push_back(static_cast<int>(j)); }
+  for (size_t i = num_dag_vert + num_kept; i < dag_size; ++i) { added.push_back(static_cast<int>(i)); }
+
+  auto old_src_order = invertPermutation(sub.perm_s);
+  std::vector<int> kept_src;
+  kept_src.reserve(dag_size);
+  for (auto i : old_src_order) {
+    if (remap[i] >= 0) { kept_src.push_back(remap[i]); }
+  }
+  auto src_less = [&](int a, int b) {
+    auto ka = src_key(a);
+    auto kb = src_key(b);
+    return ka != kb ? ka < kb : a < b;
+  };
+  std::sort(added.begin(), added.end(), src_less);
+  auto src_order = mergeSorted(kept_src, added, src_less);
+  std::vector<int> src_pos(dag_size);
+  for (size_t q = 0; q < dag_size; ++q) { src_pos[src_order[q]] = static_cast<int>(q); }
+
+  // The destination order breaks ties by source order.
+  auto old_dst_order = invertPermutation(sub.perm_d);
+  std::vector<int> kept_dst;
+  kept_dst.reserve(dag_size);
+  for (auto q : old_dst_order) {
+    int i = remap[old_src_order[q]];
+    if (i >= 0) { kept_dst.push_back(i); }
+  }
+  auto dst_less = [&](int a, int b) {
+    auto ka = dst_key(a);
+    auto kb = dst_key(b);
+    return ka != kb ? ka < kb : src_pos[a] < src_pos[b];
+  };
+  std::sort(added.begin(), added.end(), dst_less);
+  sub.perm_v = mergeSorted(kept_dst, added, dst_less);
+
+  sub.perm_s = std::move(src_pos);
+  sub.perm_d.resize(dag_size);
+  for (size_t r = 0; r < dag_size; ++r) { sub.perm_d[sub.perm_s[sub.perm_v[r]]] = static_cast<int>(r); }
+}
+};  // namespace common::utils
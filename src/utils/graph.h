@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace common::utils {
+struct Edge {
+  uint32_t src;
+  uint32_t dst;
+
+  bool operator==(const Edge& rhs) const { return src == rhs.src && dst == rhs.dst; }
+};
+
+// Directed graph with vertices [0, num_vert).
+struct Graph {
+  size_t num_vert = 0;
+  std::vector<Edge> edges;
+  // One per edge, or empty if the edge list has no weights.
+  std::vector<Ring> weights;
+};
+
+enum class EdgeListFormat {
+  // kBinary for files ending in ".bin", kText otherwise.
+  kAuto,
+  // One "src dst [weight]" edge per line, separated by spaces, tabs or
+  // commas. Lines starting with '#' or '%' are comments.
+  kText,
+  // Little-endian uint32 pairs (src, dst) without a header.
+  kBinary
+};
+
+// Load an edge list with 'threads' threads (0 for the OpenMP default). The
+// file is memory mapped and parsed in parallel chunks, and the edges keep
+// their order in the file. Self-loops are dropped as GraSP represents a
+// vertex by the tuple (v, v) in DAG lists. Throws std::runtime_error if the
+// file cannot be read or is malformed.
+Graph loadEdgeList(const std::string& path, EdgeListFormat format = EdgeListFormat::kAuto, int threads = 0);
+
+// Owner (1 to nP) of every vertex, splitting the vertices into nP ranges of
+// num_vert / nP with the last party also taking the remainder.
+std::vector<int> rangeOwners(size_t num_vert, int nP);
+
+// Subgraph of one party in the DAG-list form of GraSP: the tuples (v, v) of
+// its vertices followed by its edges. It holds the in-edges of the vertices
+// it owns, and the sources of these edges owned by other parties are part
+// of its vertices.
+//
+// Permutations are given as applied by kPublicPerm and kPermAndSh, i.e.,
+// entry i of the input moves to position perm[i].
+struct SubgraphDag {
+  // Owned vertices followed by the neighbours owned by other parties, each
+  // part sorted by global ID, except for neighbours added by
+  // applyEdgeUpdates. The index in this list is the local ID.
+  std::vector<uint32_t> vertices;
+  size_t num_own = 0;
+  // Edges in global IDs, in the order of the edge list.
+  std::vector<Edge> edges;
+  // Weights of 'edges', or empty.
+  std::vector<Ring> weights;
+  // Global vertex list to 'vertices' followed by the remaining vertices.
+  std::vector<int> perm_g;
+  // DAG list to source order, a vertex preceding its out-edges.
+  std::vector<int> perm_s;
+  // Source order to destination order, a vertex following its in-edges.
+  std::vector<int> perm_d;
+  // Destination order back to the DAG list.
+  std::vector<int> perm_v;
+
+  [[nodiscard]] size_t dagSize() const { return vertices.size() + edges.size(); }
+};
+
+// Subgraphs of parties 1 to nP, owner[v] being the party owning vertex v.
+std::vector<SubgraphDag> buildSubgraphs(const Graph& graph, const std::vector<int>& owner, int nP);
+
+// Batch of edge changes to a graph whose vertices stay the same.
+struct EdgeUpdates {
+  std::vector<Edge> inserted;
+  // Weights of 'inserted', or empty for weight 1.
+  std::vector<Ring> inserted_weights;
+  // Every deleted edge removes one occurrence of it.
+  std::vector<Edge> deleted;
+};
+
+// Apply the updates to the in-edges of the vertices owned by 'party' to its
+// subgraph 'sub', as if buildSubgraphs had been run on the updated graph,
+// except that new neighbours are appended to 'vertices' instead of keeping
+// them sorted. Other updates are ignored. Deleted edges are removed and
+// inserted edges appended, so the remaining tuples keep their order, and the
+// sorted orders of the DAG list are merged with the sorted new tuples instead
+// of being rebuilt. Vertices left without edges stay in the subgraph. Throws
+// std::invalid_argument if an edge is out of range or a deleted edge is not
+// in the subgraph.
+void applyEdgeUpdates(SubgraphDag& sub, const std::vector<int>& owner, int party, const EdgeUpdates& updates);
+};  // namespace common::utils
@@ -0,0 +1,258 @@
+#include "graph_partition.h"
+
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+
+#include "permutation.h"
+
+namespace common::utils {
+namespace {
+// Largest DAG list over the mean tolerated by kEdgeCut while a party with
+// room is left.
+constexpr double kEdgeCutSlack = 1.05;
+
+uint64_t mixHash(uint64_t x) {
+  // splitmix64 finalizer.
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+std::vector<size_t> inDegrees(const Graph& graph) {
+  std::vector<size_t> degree(graph.num_vert, 0);
+  for (const auto& e : graph.edges) {
+    degree[e.dst]++;
+  }
+  return degree;
+}
+
+std::vector<int> hashOwners(size_t num_vert, int nP) {
+  std::vector<int> owner(num_vert);
+  #pragma omp parallel for
+  for (int64_t v = 0; v < static_cast<int64_t>(num_vert); ++v) {
+    owner[v] = static_cast<int>(mixHash(v) % nP) + 1;
+  }
+  return owner;
+}
+
+std::vector<int> degreeOwners(const Graph& graph, int nP) {
+  auto degree = inDegrees(graph);
+  std::vector<uint32_t> order(graph.num_vert);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return degree[a] > degree[b]; });
+
+  // Parties by DAG-list size, ties to the lowest party.
+  using Load = std::pair<size_t, int>;
+  std::priority_queue<Load, std::vector<Load>, std::greater<>> loads;
+  for (int p = 1; p <= nP; ++p) {
+    loads.emplace(0, p);
+  }
+  std::vector<int> owner(graph.num_vert);
+  for (auto v : order) {
+    auto [load, p] = loads.top();
+    loads.pop();
+    owner[v] = p;
+    loads.emplace(load + 1 + degree[v], p);
+  }
+  return owner;
+}
+
+std::vector<int> edgeCutOwners(const Graph& graph, int nP) {
+  size_t num_vert = graph.num_vert;
+  auto degree = inDegrees(graph);
+
+  // Undirected adjacency, both endpoints of every edge.
+  std::vector<size_t> offsets(num_vert + 1, 0);
+  for (const auto& e : graph.edges) {
+    offsets[e.src + 1]++;
+    offsets[e.dst + 1]++;
+  }
+  for (size_t v = 0; v < num_vert; ++v) {
+    offsets[v + 1] += offsets[v];
+  }
+  std::vector<uint32_t> adjacent(offsets.back());
+  {
+    std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (const auto& e : graph.edges) {
+      adjacent[next[e.src]++] = e.dst;
+      adjacent[next[e.dst]++] = e.src;
+    }
+  }
+
+  // Each vertex adds itself and its in-edges to the DAG list of its owner.
+  double capacity = kEdgeCutSlack * static_cast<double>(num_vert + graph.edges.size()) / nP;
+  std::vector<double> load(nP + 1, 0);
+  std::vector<size_t> common(nP + 1, 0);
+  std::vector<int> owner(num_vert, 0);
+  for (size_t v = 0; v < num_vert; ++v) {
+    for (size_t k = offsets[v]; k < offsets[v + 1]; ++k) {
+      common[owner[adjacent[k]]]++;
+    }
+    auto weight = static_cast<double>(1 + degree[v]);
+    int best = 0;
+    double best_score = -1;
+    for (int p = 1; p <= nP; ++p) {
+      if (load[p] + weight > capacity) {
+        continue;
+      }
+      double score = static_cast<double>(common[p]) * (1 - load[p] / capacity);
+      if (best == 0 || score > best_score || (score == best_score && load[p] < load[best])) {
+        best = p;
+        best_score = score;
+      }
+    }
+    if (best == 0) {
+      best = static_cast<int>(std::min_element(load.begin() + 1, load.end()) - load.begin());
+    }
+    owner[v] = best;
+    load[best] += weight;
+    std::fill(common.begin(), common.end(), 0);
+  }
+  return owner;
+}
+};  // namespace
+
+PartitionStrategy partitionStrategyFromString(const std::string& name) {
+  if (name == "range") {
+    return PartitionStrategy::kRange;
+  }
+  if (name == "hash") {
+    return PartitionStrategy::kHash;
+  }
+  if (name == "degree") {
+    return PartitionStrategy::kDegree;
+  }
+  if (name == "edge-cut") {
+    return PartitionStrategy::kEdgeCut;
+  }
+  throw std::invalid_argument("Unknown partition strategy: " + name + ".");
+}
+
+std::string partitionStrategyName(PartitionStrategy strategy) {
+  switch (strategy) {
+    case PartitionStrategy::kRange:
+      return "range";
+    case PartitionStrategy::kHash:
+      return "hash";
+    case PartitionStrategy::kDegree:
+      return "degree";
+    case PartitionStrategy::kEdgeCut:
+      return "edge-cut";
+  }
+  return "unknown";
+}
+
+std::vector<int> partitionGraph(const Graph& graph, int nP, PartitionStrategy strategy) {
+  if (nP < 1) {
+    throw std::invalid_argument("Number of parties must be positive.");
+  }
+  switch (strategy) {
+    case PartitionStrategy::kRange:
+      return rangeOwners(graph.num_vert, nP);
+    case PartitionStrategy::kHash:
+      return hashOwners(graph.num_vert, nP);
+    case PartitionStrategy::kDegree:
+      return degreeOwners(graph, nP);
+    case PartitionStrategy::kEdgeCut:
+      return edgeCutOwners(graph, nP);
+  }
+  throw std::invalid_argument("Unknown partition strategy.");
+}
+
+std::vector<uint32_t> relabelByOwner(Graph& graph, std::vector<int>& owner) {
+  if (owner.size() != graph.num_vert) {
+    throw std::invalid_argument("Vertex owner count mismatch.");
+  }
+  int nP = owner.empty() ? 0 : *std::max_element(owner.begin(), owner.end());
+  std::vector<size_t> first(nP + 2, 0);
+  for (int o : owner) {
+    if (o < 1) {
+      throw std::invalid_argument("Invalid vertex owner.");
+    }
+    first[o + 1]++;
+  }
+  for (int p = 1; p <= nP; ++p) {
+    first[p + 1] += first[p];
+  }
+  std::vector<uint32_t> new_id(graph.num_vert);
+  for (size_t v = 0; v < graph.num_vert; ++v) {
+    new_id[v] = static_cast<uint32_t>(first[owner[v]]++);
+  }
+
+  #pragma omp parallel for
+  for (int64_t i = 0; i < static_cast<int64_t>(graph.edges.size()); ++i) {
+    auto& e = graph.edges[i];
+    e = {new_id[e.src], new_id[e.dst]};
+  }
+  std::vector<int> new_owner(graph.num_vert);
+  for (size_t v = 0; v < graph.num_vert; ++v) {
+    new_owner[new_id[v]] = owner[v];
+  }
+  owner = std::move(new_owner);
+  return new_id;
+}
+
+double imbalance(const std::vector<size_t>& sizes) {
+  if (sizes.empty()) {
+    return 1;
+  }
+  size_t total = std::accumulate(sizes.begin(), sizes.end(), size_t(0));
+  if (total == 0) {
+    return 1;
+  }
+  auto largest = *std::max_element(sizes.begin(), sizes.end());
+  return static_cast<double>(largest) * static_cast<double>(sizes.size()) / static_cast<double>(total);
+}
+
+PartitionStats partitionStats(const Graph& graph, const std::vector<int>& owner, int nP) {
+  if (owner.size() != graph.num_vert) {
+    throw std::invalid_argument("Vertex owner count mismatch.");
+  }
+  const auto& edges = graph.edges;
+  PartitionStats stats;
+  stats.dag_sizes.assign(nP, 0);
+  for (int o : owner) {
+    if (o < 1 || o > nP) {
+      throw std::invalid_argument("Invalid vertex owner.");
+    }
+    stats.dag_sizes[o - 1]++;
+  }
+
+  // Edges grouped by the owner of their destination, as in buildSubgraphs.
+  std::vector<uint32_t> by_owner(edges.size());
+  auto offsets = detail::partitionByBlock(
+      edges.size(), nP, [&](size_t i) { return static_cast<size_t>(owner[edges[i].dst] - 1); },
+      [&](size_t i, size_t slot) { by_owner[slot] = static_cast<uint32_t>(i); });
+
+  // Last party whose subgraph copied a vertex, the edges of a party being
+  // contiguous.
+  std::vector<int> copied(graph.num_vert, 0);
+  size_t num_cut = 0;
+  size_t num_copies = 0;
+  for (int p = 1; p <= nP; ++p) {
+    for (size_t k = offsets[p - 1]; k < offsets[p]; ++k) {
+      auto src = edges[by_owner[k]].src;
+      if (owner[src] == p) {
+        continue;
+      }
+      num_cut++;
+      if (copied[src] != p) {
+        copied[src] = p;
+        num_copies++;
+        stats.dag_sizes[p - 1]++;
+      }
+    }
+    stats.dag_sizes[p - 1] += offsets[p] - offsets[p - 1];
+  }
+
+  stats.imbalance = imbalance(stats.dag_sizes);
+  stats.edge_cut = edges.empty() ? 0 : static_cast<double>(num_cut) / static_cast<double>(edges.size());
+  stats.replication = graph.num_vert == 0
+                          ? 1
+                          : static_cast<double>(graph.num_vert + num_copies) / static_cast<double>(graph.num_vert);
+  return stats;
+}
+};  // namespace common::utils
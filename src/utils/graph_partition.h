@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "graph.h"
+
+namespace common::utils {
+// Strategies assigning vertices to the parties owning them. A party holds
+// the in-edges of its vertices, so its DAG list has one tuple per owned
+// vertex, per in-edge and per outside source of these edges.
+enum class PartitionStrategy {
+  // Contiguous ranges of num_vert / nP vertices, see rangeOwners.
+  kRange,
+  // Vertex IDs hashed to parties.
+  kHash,
+  // Vertices by decreasing in-degree to the party with the smallest DAG
+  // list, balancing owned vertices and in-edges.
+  kDegree,
+  // Streaming greedy placing a vertex with most of its neighbours under a
+  // DAG-list capacity, reducing the outside sources copied into subgraphs.
+  kEdgeCut
+};
+
+PartitionStrategy partitionStrategyFromString(const std::string& name);
+std::string partitionStrategyName(PartitionStrategy strategy);
+
+// Owner (1 to nP) of every vertex of 'graph' under 'strategy'.
+std::vector<int> partitionGraph(const Graph& graph, int nP, PartitionStrategy strategy);
+
+// Renumber the vertices of 'graph' so that the vertices of every party form
+// a contiguous range, in party order and keeping their relative order. The
+// combined vertex list of GraSP concatenates the parties' own vertices, so
+// it is then in global order. Updates 'owner' and returns the new ID of
+// every old vertex.
+std::vector<uint32_t> relabelByOwner(Graph& graph, std::vector<int>& owner);
+
+struct PartitionStats {
+  // DAG-list size of the subgraph of every party.
+  std::vector<size_t> dag_sizes;
+  // Largest DAG list over the mean, 1 being perfect balance.
+  double imbalance = 1;
+  // Fraction of the edges whose endpoints have different owners.
+  double edge_cut = 0;
+  // Vertices over all DAG lists, counting outside sources, per vertex.
+  double replication = 1;
+};
+
+// Largest size over the mean size.
+double imbalance(const std::vector<size_t>& sizes);
+
+PartitionStats partitionStats(const Graph& graph, const std::vector<int>& owner, int nP);
+};  // namespace common::utils
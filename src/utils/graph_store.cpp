@@ -0,0 +1,313 @@
+#include "graph_store.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace common::utils {
+namespace {
+struct StoreHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_parties;
+  uint64_t num_vert;
+  uint64_t num_edges;
+  uint64_t flags;
+};
+
+constexpr uint64_t kHasWeights = 1;
+constexpr uint64_t kShardAlign = 4096;
+
+uint64_t align(uint64_t pos, uint64_t to) { return (pos + to - 1) / to * to; }
+
+// Offsets of the sections of a shard from its start.
+struct ShardLayout {
+  uint64_t vertices = 0;
+  uint64_t edges = 0;
+  uint64_t weights = 0;
+  uint64_t perm_g = 0;
+  uint64_t perm_s = 0;
+  uint64_t perm_d = 0;
+  uint64_t perm_v = 0;
+  uint64_t size = 0;
+
+  ShardLayout(const GraphShardInfo& info, uint64_t num_vert, bool has_weights) {
+    uint64_t pos = 0;
+    auto section = [&](uint64_t bytes) {
+      uint64_t start = pos;
+      pos = align(pos + bytes, 8);
+      return start;
+    };
+    vertices = section(info.num_vertices * sizeof(uint32_t));
+    edges = section(info.num_edges * sizeof(Edge));
+    weights = section(has_weights ? info.num_edges * sizeof(Ring) : 0);
+    perm_g = section(num_vert * sizeof(int));
+    perm_s = section(info.dagSize() * sizeof(int));
+    perm_d = section(info.dagSize() * sizeof(int));
+    perm_v = section(info.dagSize() * sizeof(int));
+    size = pos;
+  }
+};
+
+// Offsets of the global sections of the store.
+struct StoreLayout {
+  uint64_t shard_table = 0;
+  uint64_t owners = 0;
+  uint64_t in_offsets = 0;
+  uint64_t in_sources = 0;
+  uint64_t end = 0;
+
+  StoreLayout(uint64_t num_parties, uint64_t num_vert, uint64_t num_edges) {
+    shard_table = sizeof(StoreHeader);
+    owners = shard_table + num_parties * sizeof(GraphShardInfo);
+    in_offsets = align(owners + num_vert * sizeof(uint32_t), 8);
+    in_sources = in_offsets + (num_vert + 1) * sizeof(uint64_t);
+    end = align(in_sources + num_edges * sizeof(uint32_t), 8);
+  }
+};
+
+// Read-only memory map of [offset, offset + size) of a file.
+class MappedRange {
+  void* addr_ = nullptr;
+  size_t length_ = 0;
+  const char* data_ = nullptr;
+
+ public:
+  MappedRange(int fd, uint64_t offset, uint64_t size) {
+    if (size == 0) {
+      return;
+    }
+    auto page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t start = offset / page * page;
+    length_ = offset + size - start;
+    addr_ = mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(start));
+    if (addr_ == MAP_FAILED) {
+      addr_ = nullptr;
+      throw std::runtime_error("Could not map graph store.");
+    }
+    madvise(addr_, length_, MADV_WILLNEED);
+    data_ = static_cast<const char*>(addr_) + (offset - start);
+  }
+
+  ~MappedRange() {
+    if (addr_ != nullptr) {
+      munmap(addr_, length_);
+    }
+  }
+
+  MappedRange(const MappedRange&) = delete;
+  MappedRange& operator=(const MappedRange&) = delete;
+
+  template <class T>
+  void copyTo(uint64_t offset, std::vector<T>& out, size_t count) const {
+    out.resize(count);
+    if (count != 0) {
+      std::memcpy(out.data(), data_ + offset, count * sizeof(T));
+    }
+  }
+};
+
+// Sequential writer padding sections to their offsets.
+class StoreWriter {
+  std::ofstream out_;
+  uint64_t pos_ = 0;
+
+ public:
+  explicit StoreWriter(const std::string& path) : out_(path, std::ios::binary | std::ios::trunc) {
+    if (!out_) {
+      throw std::runtime_error("Could not create graph store " + path + ".");
+    }
+  }
+
+  void seek(uint64_t pos) {
+    static const char zeros[kShardAlign] = {};
+    while (pos_ < pos) {
+      auto n = std::min<uint64_t>(pos - pos_, kShardAlign);
+      out_.write(zeros, static_cast<std::streamsize>(n));
+      pos_ += n;
+    }
+  }
+
+  void write(const void* data, uint64_t bytes) {
+    out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+    pos_ += bytes;
+  }
+
+  template <class T>
+  void write(uint64_t pos, const std::vector<T>& vals) {
+    seek(pos);
+    write(vals.data(), vals.size() * sizeof(T));
+  }
+
+  void close(const std::string& path) {
+    out_.close();
+    if (!out_) {
+      throw std::runtime_error("Could not write graph store " + path + ".");
+    }
+  }
+};
+
+void invalidStore(const std::string& path, const std::string& reason) {
+  throw std::runtime_error("Invalid graph store " + path + ": " + reason + ".");
+}
+};  // namespace
+
+void writeGraphStore(const std::string& path, const Graph& graph, const std::vector<int>& owner,
+                     const std::vector<SubgraphDag>& subgraphs) {
+  if (owner.size() != graph.num_vert) {
+    throw std::invalid_argument("Vertex owner count mismatch.");
+  }
+  bool has_weights = !graph.weights.empty();
+  uint64_t num_edges = graph.edges.size();
+  StoreLayout layout(subgraphs.size(), graph.num_vert, num_edges);
+
+  std::vector<GraphShardInfo> shards(subgraphs.size());
+  uint64_t pos = layout.end;
+  for (size_t p = 0; p < subgraphs.size(); ++p) {
+    auto& info = shards[p];
+    info.num_vertices = subgraphs[p].vertices.size();
+    info.num_own = subgraphs[p].num_own;
+    info.num_edges = subgraphs[p].edges.size();
+    info.offset = align(pos, kShardAlign);
+    info.size = ShardLayout(info, graph.num_vert, has_weights).size;
+    pos = info.offset + info.size;
+  }
+
+  // In-edges of every vertex, in the order of the edge list.
+  std::vector<uint64_t> in_offsets(graph.num_vert + 1, 0);
+  for (const auto& e : graph.edges) {
+    in_offsets[e.dst + 1]++;
+  }
+  for (size_t v = 0; v < graph.num_vert; ++v) {
+    in_offsets[v + 1] += in_offsets[v];
+  }
+  std::vector<uint32_t> in_sources(num_edges);
+  {
+    std::vector<uint64_t> next(in_offsets.begin(), in_offsets.end() - 1);
+    for (const auto& e : graph.edges) {
+      in_sources[next[e.dst]++] = e.src;
+    }
+  }
+
+  StoreHeader header{};
+  std::memcpy(header.magic, kGraphStoreMagic, sizeof(header.magic));
+  header.version = kGraphStoreVersion;
+  header.num_parties = static_cast<uint32_t>(subgraphs.size());
+  header.num_vert = graph.num_vert;
+  header.num_edges = num_edges;
+  header.flags = has_weights ? kHasWeights : 0;
+
+  StoreWriter writer(path);
+  writer.write(&header, sizeof(header));
+  writer.write(layout.shard_table, shards);
+  writer.write(layout.owners, std::vector<uint32_t>(owner.begin(), owner.end()));
+  writer.write(layout.in_offsets, in_offsets);
+  writer.write(layout.in_sources, in_sources);
+  for (size_t p = 0; p < subgraphs.size(); ++p) {
+    const auto& sub = subgraphs[p];
+    if (has_weights && sub.weights.size() != sub.edges.size()) {
+      throw std::invalid_argument("Subgraph weight count mismatch.");
+    }
+    ShardLayout shard(shards[p], graph.num_vert, has_weights);
+    uint64_t base = shards[p].offset;
+    writer.write(base + shard.vertices, sub.vertices);
+    writer.write(base + shard.edges, sub.edges);
+    if (has_weights) {
+      writer.write(base + shard.weights, sub.weights);
+    }
+    writer.write(base + shard.perm_g, sub.perm_g);
+    writer.write(base + shard.perm_s, sub.perm_s);
+    writer.write(base + shard.perm_d, sub.perm_d);
+    writer.write(base + shard.perm_v, sub.perm_v);
+    writer.seek(base + shard.size);
+  }
+  writer.close(path);
+}
+
+GraphStore loadGraphStore(const std::string& path, const std::vector<int>& parties, bool with_csr) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open graph store " + path + ".");
+  }
+  // Closes the file on every exit, the maps stay valid after close.
+  struct FileCloser {
+    int fd;
+    ~FileCloser() { close(fd); }
+  } closer{fd};
+
+  struct stat st {};
+  if (fstat(fd, &st) != 0) {
+    throw std::runtime_error("Could not read graph store " + path + ".");
+  }
+  auto file_size = static_cast<uint64_t>(st.st_size);
+  StoreHeader header{};
+  if (file_size < sizeof(header) || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+      std::memcmp(header.magic, kGraphStoreMagic, sizeof(header.magic)) != 0) {
+    invalidStore(path, "bad magic");
+  }
+  if (header.version != kGraphStoreVersion) {
+    invalidStore(path, "unsupported version " + std::to_string(header.version));
+  }
+  StoreLayout layout(header.num_parties, header.num_vert, header.num_edges);
+  if (header.num_parties == 0 || layout.end > file_size) {
+    invalidStore(path, "truncated header");
+  }
+
+  GraphStore store;
+  store.num_vert = header.num_vert;
+  store.num_edges = header.num_edges;
+  store.has_weights = (header.flags & kHasWeights) != 0;
+  {
+    MappedRange head(fd, 0, layout.in_offsets);
+    head.copyTo(layout.shard_table, store.shards, header.num_parties);
+    std::vector<uint32_t> owner;
+    head.copyTo(layout.owners, owner, header.num_vert);
+    store.owner.assign(owner.begin(), owner.end());
+  }
+  for (const auto& info : store.shards) {
+    if (info.offset + info.size > file_size ||
+        ShardLayout(info, store.num_vert, store.has_weights).size != info.size) {
+      invalidStore(path, "bad shard table");
+    }
+  }
+  if (with_csr) {
+    MappedRange csr(fd, layout.in_offsets, layout.end - layout.in_offsets);
+    csr.copyTo(0, store.in_offsets, store.num_vert + 1);
+    csr.copyTo(layout.in_sources - layout.in_offsets, store.in_sources, store.num_edges);
+  }
+
+  store.subgraphs.resize(header.num_parties);
+  for (int party : parties) {
+    if (party < 1 || party > static_cast<int>(header.num_parties)) {
+      throw std::invalid_argument("Invalid party " + std::to_string(party) + " for graph store.");
+    }
+    const auto& info = store.shards[party - 1];
+    ShardLayout shard(info, store.num_vert, store.has_weights);
+    MappedRange range(fd, info.offset, info.size);
+    auto& sub = store.subgraphs[party - 1];
+    sub.num_own = info.num_own;
+    range.copyTo(shard.vertices, sub.vertices, info.num_vertices);
+    range.copyTo(shard.edges, sub.edges, info.num_edges);
+    if (store.has_weights) {
+      range.copyTo(shard.weights, sub.weights, info.num_edges);
+    }
+    range.copyTo(shard.perm_g, sub.perm_g, store.num_vert);
+    range.copyTo(shard.perm_s, sub.perm_s, info.dagSize());
+    range.copyTo(shard.perm_d, sub.perm_d, info.dagSize());
+    range.copyTo(shard.perm_v, sub.perm_v, info.dagSize());
+  }
+  return store;
+}
+
+bool isGraphStore(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[sizeof(kGraphStoreMagic)] = {};
+  in.read(magic, sizeof(magic));
+  return in && std::memcmp(magic, kGraphStoreMagic, sizeof(magic)) == 0;
+}
+};  // namespace common::utils
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "graph.h"
+
+namespace common::utils {
+// Binary graph store, written once per graph and partition so that runs
+// neither parse the edge list nor rebuild the subgraphs. Layout, in native
+// byte order with every section aligned to 8 bytes:
+//
+//   header       magic, version, nP, num_vert, num_edges, flags
+//   shard table  nP x GraphShardInfo
+//   vertices     owner of every vertex, uint32
+//   CSR          in-edge offsets, uint64 x (num_vert + 1), then the
+//                sources of the in-edges of every vertex, uint32
+//   shards       one per party, starting on a page boundary: vertices,
+//                edges, weights (if any), perm_g, perm_s, perm_d, perm_v
+//
+// A party maps the header, the vertex table and its own shard only.
+constexpr char kGraphStoreMagic[8] = {'G', 'R', 'A', 'S', 'P', 'G', 'S', '1'};
+constexpr uint32_t kGraphStoreVersion = 1;
+
+// Sizes and position of the shard of one party.
+struct GraphShardInfo {
+  uint64_t offset = 0;
+  uint64_t size = 0;
+  uint64_t num_vertices = 0;
+  uint64_t num_own = 0;
+  uint64_t num_edges = 0;
+
+  [[nodiscard]] size_t dagSize() const { return num_vertices + num_edges; }
+};
+
+struct GraphStore {
+  size_t num_vert = 0;
+  size_t num_edges = 0;
+  bool has_weights = false;
+  // Owner (1 to nP) of every vertex.
+  std::vector<int> owner;
+  std::vector<GraphShardInfo> shards;
+  // Subgraph of party p at index p - 1. Only the requested shards are
+  // loaded, the others are left empty.
+  std::vector<SubgraphDag> subgraphs;
+  // In-edges of vertex v are in_sources[in_offsets[v]:in_offsets[v + 1]],
+  // filled only if requested.
+  std::vector<uint64_t> in_offsets;
+  std::vector<uint32_t> in_sources;
+
+  [[nodiscard]] int numParties() const { return static_cast<int>(shards.size()); }
+};
+
+// Write 'graph' partitioned by 'owner' into subgraphs of buildSubgraphs.
+// Throws std::runtime_error if the file cannot be written.
+void writeGraphStore(const std::string& path, const Graph& graph, const std::vector<int>& owner,
+                     const std::vector<SubgraphDag>& subgraphs);
+
+// Read the graph store at 'path', loading the shards of 'parties' (1 to nP)
+// and the in-edge CSR if 'with_csr' is set. Throws std::runtime_error if the
+// file is not a valid graph store.
+GraphStore loadGraphStore(const std::string& path, const std::vector<int>& parties, bool with_csr = false);
+
+// Whether 'path' starts with the magic of a graph store.
+bool isGraphStore(const std::string& path);
+};  // namespace common::utils
@@ -0,0 +1,14 @@
+#include "permutation.h"
+
+namespace common::utils {
+std::vector<int> invertPermutation(const std::vector<int>& pi) {
+  std::vector<int> res(pi.size());
+  std::vector<int> identity(pi.size());
+  #pragma omp parallel for
+  for (int64_t i = 0; i < static_cast<int64_t>(pi.size()); ++i) {
+    identity[i] = static_cast<int>(i);
+  }
+  permuteScatter(identity.data(), pi.data(), pi.size(), res.data());
+  return res;
+}
+};  // namespace common::utils
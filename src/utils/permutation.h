@@ -0,0 +1,144 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace common::utils {
+// Kernels applying a permutation to a vector. Applying a permutation naively
+// touches a random cache line per element. The kernels are parallel loops
+// that prefetch the random accesses a few iterations ahead. Scatters of more
+// than kPermuteBlockedMinBytes, beyond common last level cache sizes, are
+// first radix partitioned by the block of kPermuteBlock elements they are
+// written to, so that the writes of every partition stay within one block
+// that fits in L2. Gathers only read at random and always use the
+// prefetching loop.
+constexpr size_t kPermuteBlock = 1 << 16;
+constexpr size_t kPermuteBlockedMinBytes = 1 << 27;
+
+// Returns the inverse permutation, i.e., res[pi[i]] = i.
+std::vector<int> invertPermutation(const std::vector<int>& pi);
+
+namespace detail {
+constexpr size_t kPrefetchDistance = 16;
+// Vectors smaller than this are permuted by the calling thread only.
+constexpr size_t kPermuteParallelMin = 1 << 15;
+
+template <class T>
+struct PermEntry {
+  uint32_t pos;
+  T val;
+};
+
+// Stable counting sort of the indices [0, n) by block(i) < num_blocks, run by
+// all threads. emit(i, slot) stores the entry of index i at 'slot'. Returns
+// the first slot of every block, followed by n.
+template <class Block, class Emit>
+std::vector<size_t> partitionByBlock(size_t n, size_t num_blocks, Block block, Emit emit) {
+  int max_threads = omp_get_max_threads();
+  std::vector<size_t> counts(static_cast<size_t>(max_threads) * num_blocks, 0);
+  std::vector<size_t> offsets(num_blocks + 1, 0);
+  #pragma omp parallel num_threads(max_threads)
+  {
+    int tid = omp_get_thread_num();
+    int num_threads = omp_get_num_threads();
+    size_t begin = n * tid / num_threads;
+    size_t end = n * (tid + 1) / num_threads;
+    size_t* count = counts.data() + tid * num_blocks;
+    for (size_t i = begin; i < end; ++i) {
+      count[block(i)]++;
+    }
+    #pragma omp barrier
+    #pragma omp single
+    {
+      // Block major order, so every thread writes its part of a block after
+      // the parts of the threads before it.
+      size_t offset = 0;
+      for (size_t b = 0; b < num_blocks; ++b) {
+        offsets[b] = offset;
+        for (int t = 0; t < max_threads; ++t) {
+          size_t tmp = counts[t * num_blocks + b];
+          counts[t * num_blocks + b] = offset;
+          offset += tmp;
+        }
+      }
+      offsets[num_blocks] = offset;
+    }
+    for (size_t i = begin; i < end; ++i) {
+      emit(i, count[block(i)]++);
+    }
+  }
+  return offsets;
+}
+
+// dst[entries[k].pos] = entries[k].val for all k, the entries being grouped
+// by block of their position as given by 'offsets'.
+template <class T>
+void writeBlocks(const std::vector<PermEntry<T>>& entries, const std::vector<size_t>& offsets, T* dst) {
+  int64_t num_blocks = static_cast<int64_t>(offsets.size()) - 1;
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int64_t b = 0; b < num_blocks; ++b) {
+    for (size_t k = offsets[b]; k < offsets[b + 1]; ++k) {
+      dst[entries[k].pos] = entries[k].val;
+    }
+  }
+}
+
+inline size_t numBlocks(const int* pi, size_t n) {
+  int max_pos = 0;
+  #pragma omp parallel for reduction(max : max_pos)
+  for (int64_t i = 0; i < static_cast<int64_t>(n); ++i) {
+    max_pos = std::max(max_pos, pi[i]);
+  }
+  return static_cast<size_t>(max_pos) / kPermuteBlock + 1;
+}
+};  // namespace detail
+
+// dst[pi[i]] = src[i] for all i in [0, n).
+template <class T>
+void permuteScatter(const T* src, const int* pi, size_t n, T* dst) {
+  if (n * sizeof(T) < kPermuteBlockedMinBytes) {
+    #pragma omp parallel for if (n >= detail::kPermuteParallelMin)
+    for (int64_t i = 0; i < static_cast<int64_t>(n); ++i) {
+      if (i + detail::kPrefetchDistance < n) {
+        __builtin_prefetch(dst + pi[i + detail::kPrefetchDistance], 1);
+      }
+      dst[pi[i]] = src[i];
+    }
+    return;
+  }
+
+  std::vector<detail::PermEntry<T>> entries(n);
+  auto offsets = detail::partitionByBlock(
+      n, detail::numBlocks(pi, n), [&](size_t i) { return pi[i] / kPermuteBlock; },
+      [&](size_t i, size_t slot) { entries[slot] = {static_cast<uint32_t>(pi[i]), src[i]}; });
+  detail::writeBlocks(entries, offsets, dst);
+}
+
+template <class T>
+void permuteScatter(const std::vector<T>& src, const std::vector<int>& pi, std::vector<T>& dst) {
+  dst.resize(src.size());
+  permuteScatter(src.data(), pi.data(), src.size(), dst.data());
+}
+
+// dst[i] = src[pi[i]] for all i in [0, n).
+template <class T>
+void permuteGather(const T* src, const int* pi, size_t n, T* dst) {
+  #pragma omp parallel for if (n >= detail::kPermuteParallelMin)
+  for (int64_t i = 0; i < static_cast<int64_t>(n); ++i) {
+    if (i + detail::kPrefetchDistance < n) {
+      __builtin_prefetch(src + pi[i + detail::kPrefetchDistance], 0);
+    }
+    dst[i] = src[pi[i]];
+  }
+}
+
+template <class T>
+void permuteGather(const std::vector<T>& src, const std::vector<int>& pi, std::vector<T>& dst) {
+  dst.resize(pi.size());
+  permuteGather(src.data(), pi.data(), pi.size(), dst.data());
+}
+};  // namespace common::utils
@@ -3,6 +3,7 @@
 
 #include <NTL/ZZ_p.h>
 
+#include <cmath>
 #include <cstdint>
 #include <iostream>
 #include <vector>
@@ -23,6 +24,16 @@ constexpr uint64_t FRACTION = 16;
 
 using Field = ZZ_p; 
 
+// Two's complement fixed-point encoding of 'val' with 'frac' fractional bits,
+// rounded to the nearest representable value.
+inline Ring toFixed(double val, int frac = FRACTION) {
+  return static_cast<Ring>(static_cast<int64_t>(std::llround(std::ldexp(val, frac))));
+}
+
+inline double fromFixed(Ring val, int frac = FRACTION) {
+  return std::ldexp(static_cast<double>(static_cast<int32_t>(val)), -frac);
+}
+
 class BoolRing {
   bool val_;
 
@@ -0,0 +1,466 @@
+#define BOOST_TEST_MODULE gas
+#include <emp-tool/emp-tool.h>
+#include <io/netmp.h>
+#include <grasp/gas.h>
+#include <grasp/iterative_evaluator.h>
+#include <grasp/offline_evaluator.h>
+#include <grasp/online_evaluator.h>
+#include <grasp/preproc_pool.h>
+#include <utils/graph.h>
+
+#include <boost/test/data/monomorphic.hpp>
+#include <boost/test/data/test_case.hpp>
+#include <boost/test/included/unit_test.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace grasp;
+using namespace common::utils;
+namespace bdata = boost::unit_test::data;
+
+BOOST_TEST_DONT_PRINT_LOG_VALUE(GasBackend)
+
+// A named namespace, since the test cases capture TestGraph in lambdas with
+// external linkage.
+namespace gas_test {
+
+// Random graph split among nP parties by vertex ranges. The permutations of
+// every subgraph are split into a random secret permutation followed by the
+// public one completing it, as the parties would reveal them.
+struct TestGraph {
+  Graph graph;
+  std::vector<int> owner;
+  std::vector<SubgraphDag> subgraphs;
+  // secret[i][k] and pub[i][k] split perm_g, perm_s, perm_d and perm_v of
+  // subgraph i, for k from 0 to 3.
+  std::vector<std::vector<std::vector<int>>> secret;
+  std::vector<std::vector<std::vector<int>>> pub;
+};
+
+// Graphiti shuffles a single DAG list of the whole graph.
+TestGraph randomGraph(size_t num_vert, size_t num_edges, int nP, GasBackend backend, std::mt19937& gen) {
+  TestGraph tg;
+  tg.graph.num_vert = num_vert;
+  while (tg.graph.edges.size() < num_edges) {
+    uint32_t src = gen() % num_vert;
+    uint32_t dst = gen() % num_vert;
+    if (src != dst) {
+      tg.graph.edges.push_back({src, dst});
+      tg.graph.weights.push_back(1 + gen() % 9);
+    }
+  }
+  tg.owner = rangeOwners(num_vert, nP);
+  tg.subgraphs = backend == GasBackend::kGraphiti ? buildSubgraphs(tg.graph, std::vector<int>(num_vert, 1), 1)
+                                                  : buildSubgraphs(tg.graph, tg.owner, nP);
+
+  for (const auto& sub : tg.subgraphs) {
+    tg.secret.emplace_back();
+    tg.pub.emplace_back();
+    for (const auto* perm : {&sub.perm_g, &sub.perm_s, &sub.perm_d, &sub.perm_v}) {
+      std::vector<int> secret(perm->size());
+      std::iota(secret.begin(), secret.end(), 0);
+      std::shuffle(secret.begin(), secret.end(), gen);
+      std::vector<int> pub(perm->size());
+      for (size_t k = 0; k < perm->size(); ++k) { pub[secret[k]] = (*perm)[k]; }
+      tg.secret.back().push_back(std::move(secret));
+      tg.pub.back().push_back(std::move(pub));
+    }
+  }
+  return tg;
+}
+
+// GasGraph of 'tg' as held by party 'pid'. Adds one input wire per edge of
+// every DAG list, its weight. With kGraphiti, party 1 holds the secret
+// permutations and the other parties the identity.
+GasGraph gasGraph(Circuit<Ring>& circ, const TestGraph& tg, int nP, int pid, GasBackend backend) {
+  size_t num_dags = tg.subgraphs.size();
+  auto held = [&](size_t i, int step) {
+    std::vector<std::vector<int>> perms;
+    if (backend == GasBackend::kGraphiti) {
+      std::vector<int> identity(tg.secret[i][step].size());
+      std::iota(identity.begin(), identity.end(), 0);
+      perms.assign(pid == 0 ? nP : 1, identity);
+      if (pid <= 1) { perms[0] = tg.secret[i][step]; }
+      return perms;
+    }
+    for (size_t j = 0; j < num_dags; ++j) {
+      if (pid == 0 || static_cast<int>(j) == pid - 1) { perms.push_back(tg.secret[j][step]); }
+    }
+    return perms;
+  };
+
+  GasGraph graph;
+  graph.backend = backend;
+  if (backend == GasBackend::kGraSP) { graph.perm_g = held(0, 0); }
+  for (size_t i = 0; i < num_dags; ++i) {
+    const auto& sub = tg.subgraphs[i];
+    GasDagList dag;
+    dag.owner = static_cast<int>(i) + 1;
+    dag.num_vert = sub.vertices.size();
+    dag.num_own = sub.num_own;
+    for (size_t k = 0; k < sub.edges.size(); ++k) { dag.edges.push_back(circ.newInputWire()); }
+    auto secret = [&](int step) {
+      return backend == GasBackend::kGraphiti ? held(i, step) : ownerPermutations(held(i, step), pid, dag.owner);
+    };
+    if (backend == GasBackend::kGraSP) { dag.pub_perm_g = tg.pub[i][0]; }
+    dag.perm_s = {secret(1), tg.pub[i][1]};
+    dag.perm_d = {secret(2), tg.pub[i][2]};
+    dag.perm_v = {secret(3), tg.pub[i][3]};
+    graph.dag_lists.push_back(std::move(dag));
+  }
+  return graph;
+}
+
+// Inputs of the edge wires of 'graph', held by the parties holding the DAG
+// lists.
+void setEdgeInputs(const GasGraph& graph, const TestGraph& tg, std::unordered_map<wire_t, int>& input_pid_map,
+                   std::unordered_map<wire_t, Ring>& inputs) {
+  for (size_t i = 0; i < graph.dag_lists.size(); ++i) {
+    const auto& edges = graph.dag_lists[i].edges;
+    for (size_t k = 0; k < edges.size(); ++k) {
+      input_pid_map[edges[k]] = static_cast<int>(i) + 1;
+      inputs[edges[k]] = tg.subgraphs[i].weights[k];
+    }
+  }
+}
+
+// Input wires of the vertex values, held by the vertex owners.
+std::vector<wire_t> addVertexInputs(Circuit<Ring>& circ, const TestGraph& tg, const std::vector<Ring>& values,
+                                    std::unordered_map<wire_t, int>& input_pid_map,
+                                    std::unordered_map<wire_t, Ring>& inputs) {
+  std::vector<wire_t> wires(values.size());
+  for (size_t v = 0; v < values.size(); ++v) {
+    wires[v] = circ.newInputWire();
+    input_pid_map[wires[v]] = tg.owner[v];
+    inputs[wires[v]] = values[v];
+  }
+  return wires;
+}
+
+// Fixed-point values with 'frac' fractional bits.
+std::vector<Ring> toFixedValues(const std::vector<double>& values, int frac) {
+  std::vector<Ring> fixed;
+  for (auto value : values) { fixed.push_back(toFixed(value, frac)); }
+  return fixed;
+}
+
+// Run party(pid, network) for the dealer and parties 1 to nP. Returns the
+// results of parties 1 to nP.
+std::vector<std::vector<Ring>> runParties(
+    int nP, const std::function<std::vector<Ring>(int, std::shared_ptr<io::NetIOMP>)>& party) {
+  std::vector<std::future<std::vector<Ring>>> parties;
+  parties.reserve(nP + 1);
+  for (int i = 0; i <= nP; ++i) {
+    parties.push_back(std::async(std::launch::async, [&, i]() {
+      auto network = std::make_shared<io::NetIOMP>(i, nP + 1, 0, 10000, nullptr, true);
+      return party(i, network);
+    }));
+  }
+
+  std::vector<std::vector<Ring>> outputs;
+  for (int i = 0; i <= nP; ++i) {
+    auto output = parties[i].get();
+    if (i > 0) { outputs.push_back(std::move(output)); }
+  }
+  return outputs;
+}
+
+// Evaluate 'circ' once as party 'pid'. Returns its outputs.
+std::vector<Ring> evaluateOnce(int nP, int pid, std::shared_ptr<io::NetIOMP> network, const LevelOrderedCircuit& circ,
+                               const std::unordered_map<wire_t, int>& input_pid_map,
+                               const std::unordered_map<wire_t, Ring>& inputs) {
+  OfflineEvaluator off_eval(nP, pid, network, circ, 1, 200, 0);
+  auto preproc = off_eval.run(input_pid_map);
+  OnlineEvaluator online_eval(nP, pid, network, std::move(preproc), circ, 1, 200, 0);
+  return online_eval.evaluateCircuit(inputs);
+}
+
+// Evaluate one iteration circuit 'circ' as party 'pid' with an
+// IterativeEvaluator, preprocessed for up to 'iterations' iterations, the
+// outputs of an iteration feeding 'feedback_in'. run(it) evaluates the
+// iterations. Returns the outputs of the last one.
+std::vector<Ring> evaluateIterations(int nP, int pid, std::shared_ptr<io::NetIOMP> network,
+                                     const LevelOrderedCircuit& circ,
+                                     const std::unordered_map<wire_t, int>& input_pid_map,
+                                     const std::unordered_map<wire_t, Ring>& inputs,
+                                     const std::vector<wire_t>& feedback_in, int iterations,
+                                     const std::function<void(IterativeEvaluator&)>& run) {
+  OfflineEvaluator off_eval(nP, pid, network, circ, 1, 200, 0);
+  PreprocPool pool;
+  auto fp = fingerprint(circ);
+  pool.add(fp, off_eval.runBatch(input_pid_map, iterations));
+  OnlineEvaluator online_eval(nP, pid, network, pool.acquire(fp), circ, 1, 200, 0);
+  online_eval.setInputs(inputs);
+  IterativeEvaluator iterative(online_eval, pool, circ, circ.outputs, feedback_in);
+  run(iterative);
+  return online_eval.getOutputs();
+}
+
+}  // namespace gas_test
+
+using namespace gas_test;
+
+BOOST_AUTO_TEST_SUITE(gas)
+
+BOOST_DATA_TEST_CASE(unit_page_rank,
+                     bdata::make({2, 3}) * bdata::make({GasBackend::kGraSP, GasBackend::kGraphiti}), nP,
+                     backend) {
+  const size_t num_vert = 30;
+  const int iterations = 2;
+  std::mt19937 gen(nP);
+  auto tg = randomGraph(num_vert, 80, nP, backend, gen);
+  std::vector<Ring> values(num_vert);
+  for (auto& value : values) { value = gen() % 100; }
+
+  auto expected = values;
+  for (int t = 0; t < iterations; ++t) {
+    std::vector<Ring> next(num_vert, 1);
+    for (const auto& edge : tg.graph.edges) { next[edge.dst] += expected[edge.src]; }
+    expected = next;
+  }
+
+  auto outputs = runParties(nP, [&](int pid, std::shared_ptr<io::NetIOMP> network) {
+    Circuit<Ring> circ;
+    std::unordered_map<wire_t, int> input_pid_map;
+    std::unordered_map<wire_t, Ring> inputs;
+    auto vertices = addVertexInputs(circ, tg, values, input_pid_map, inputs);
+    auto graph = gasGraph(circ, tg, nP, pid, backend);
+    setEdgeInputs(graph, tg, input_pid_map, inputs);
+    for (int t = 0; t < iterations; ++t) { vertices = addGasIteration(circ, graph, unitPageRankProgram(), vertices); }
+    for (auto w : vertices) { circ.setAsOutput(w); }
+    return evaluateOnce(nP, pid, network, circ.orderGatesByLevel(), input_pid_map, inputs);
+  });
+
+  for (const auto& output : outputs) { BOOST_TEST(output == expected); }
+}
+
+// The same iterations chained by IterativeEvaluator on a circuit of one.
+BOOST_DATA_TEST_CASE(iterative_evaluator, bdata::make({2, 3}), nP) {
+  const size_t num_vert = 30;
+  const int iterations = 4;
+  std::mt19937 gen(nP);
+  auto tg = randomGraph(num_vert, 80, nP, GasBackend::kGraSP, gen);
+  std::vector<Ring> values(num_vert);
+  for (auto& value : values) { value = gen() % 100; }
+
+  auto expected = values;
+  for (int t = 0; t < iterations; ++t) {
+    std::vector<Ring> next(num_vert, 1);
+    for (const auto& edge : tg.graph.edges) { next[edge.dst] += expected[edge.src]; }
+    expected = next;
+  }
+
+  std::vector<int> evaluated(nP + 1);
+  auto outputs = runParties(nP, [&](int pid, std::shared_ptr<io::NetIOMP> network) {
+    Circuit<Ring> circ;
+    std::unordered_map<wire_t, int> input_pid_map;
+    std::unordered_map<wire_t, Ring> inputs;
+    auto vertices = addVertexInputs(circ, tg, values, input_pid_map, inputs);
+    auto graph = gasGraph(circ, tg, nP, pid, GasBackend::kGraSP);
+    setEdgeInputs(graph, tg, input_pid_map, inputs);
+    for (auto w : addGasIteration(circ, graph, unitPageRankProgram(), vertices)) { circ.setAsOutput(w); }
+
+    return evaluateIterations(nP, pid, network, circ.orderGatesByLevel(), input_pid_map, inputs, vertices, iterations,
+                              [&](IterativeEvaluator& it) {
+                                it.step();
+                                it.run(iterations - 1);
+                                evaluated[pid] = it.iteration();
+                              });
+  });
+
+  for (const auto& output : outputs) { BOOST_TEST(output == expected); }
+  for (int pid = 0; pid <= nP; ++pid) { BOOST_TEST(evaluated[pid] == iterations); }
+}
+
+// kMin programs, whose comparisons add public terms once whatever the parity
+// of nP.
+BOOST_DATA_TEST_CASE(min_programs,
+                     bdata::make({2, 3}) * bdata::make({GasBackend::kGraSP, GasBackend::kGraphiti}) *
+                         bdata::make({"bfs", "cc", "sssp"}),
+                     nP, backend, algo) {
+  const size_t num_vert = 40;
+  const int iterations = 3;
+  const std::string name = algo;
+  std::mt19937 gen(nP);
+  auto tg = randomGraph(num_vert, 100, nP, backend, gen);
+  std::vector<Ring> values(num_vert);
+  for (size_t v = 0; v < num_vert; ++v) {
+    values[v] = name == "cc" ? Ring((v * 7) % num_vert) : (v % 7 == 0 ? 0 : kGasInfinity);
+  }
+
+  auto expected = values;
+  for (int t = 0; t < iterations; ++t) {
+    auto next = expected;
+    for (size_t k = 0; k < tg.graph.edges.size(); ++k) {
+      const auto& edge = tg.graph.edges[k];
+      Ring msg = expected[edge.src] + (name == "bfs" ? 1 : name == "sssp" ? tg.graph.weights[k] : 0);
+      next[edge.dst] = std::min(next[edge.dst], msg);
+    }
+    expected = next;
+  }
+
+  auto program = name == "cc" ? connectedComponentsProgram() : name == "sssp" ? ssspProgram() : bfsProgram();
+  auto outputs = runParties(nP, [&](int pid, std::shared_ptr<io::NetIOMP> network) {
+    Circuit<Ring> circ;
+    std::unordered_map<wire_t, int> input_pid_map;
+    std::unordered_map<wire_t, Ring> inputs;
+    auto vertices = addVertexInputs(circ, tg, values, input_pid_map, inputs);
+    auto graph = gasGraph(circ, tg, nP, pid, backend);
+    setEdgeInputs(graph, tg, input_pid_map, inputs);
+    for (int t = 0; t < iterations; ++t) { vertices = addGasIteration(circ, graph, program, vertices); }
+    for (auto w : vertices) { circ.setAsOutput(w); }
+    return evaluateOnce(nP, pid, network, circ.orderGatesByLevel(), input_pid_map, inputs);
+  });
+
+  for (const auto& output : outputs) { BOOST_TEST(output == expected); }
+}
+
+// Lanes with different sources share the permutations but not the values.
+BOOST_DATA_TEST_CASE(bfs_lanes, bdata::make({2, 3}) * bdata::make({GasBackend::kGraSP, GasBackend::kGraphiti}), nP,
+                     backend) {
+  const size_t num_vert = 40;
+  const size_t lanes = 2;
+  const int iterations = 3;
+  std::mt19937 gen(nP);
+  auto tg = randomGraph(num_vert, 100, nP, backend, gen);
+  std::vector<std::vector<Ring>> values(lanes, std::vector<Ring>(num_vert, kGasInfinity));
+  values[0][0] = 0;
+  values[1][num_vert - 1] = 0;
+  values[1][num_vert / 2] = 0;
+
+  std::vector<Ring> expected;
+  for (const auto& lane : values) {
+    auto dist = lane;
+    for (int t = 0; t < iterations; ++t) {
+      auto next = dist;
+      for (const auto& edge : tg.graph.edges) { next[edge.dst] = std::min(next[edge.dst], dist[edge.src] + 1); }
+      dist = next;
+    }
+    expected.insert(expected.end(), dist.begin(), dist.end());
+  }
+
+  auto outputs = runParties(nP, [&](int pid, std::shared_ptr<io::NetIOMP> network) {
+    Circuit<Ring> circ;
+    std::unordered_map<wire_t, int> input_pid_map;
+    std::unordered_map<wire_t, Ring> inputs;
+    std::vector<std::vector<wire_t>> vertices;
+    for (const auto& lane : values) { vertices.push_back(addVertexInputs(circ, tg, lane, input_pid_map, inputs)); }
+    auto graph = gasGraph(circ, tg, nP, pid, backend);
+    setEdgeInputs(graph, tg, input_pid_map, inputs);
+    for (int t = 0; t < iterations; ++t) { vertices = addGasIterationLanes(circ, graph, bfsProgram(), vertices); }
+    for (const auto& lane : vertices) {
+      for (auto w : lane) { circ.setAsOutput(w); }
+    }
+    return evaluateOnce(nP, pid, network, circ.orderGatesByLevel(), input_pid_map, inputs);
+  });
+
+  for (const auto& output : outputs) { BOOST_TEST(output == expected); }
+}
+
+// Lanes restarting at different vertices, from the same ranks.
+BOOST_DATA_TEST_CASE(personalized_page_rank_lanes, bdata::make({2, 3}), nP) {
+  const size_t num_vert = 40;
+  const size_t lanes = 2;
+  const double damping = 0.85;
+  std::mt19937 gen(nP);
+  auto tg = randomGraph(num_vert, 100, nP, GasBackend::kGraSP, gen);
+  std::vector<size_t> out_degree(num_vert);
+  for (const auto& edge : tg.graph.edges) { out_degree[edge.src]++; }
+  std::vector<double> inv_out_degree(num_vert);
+  for (size_t v = 0; v < num_vert; ++v) { inv_out_degree[v] = out_degree[v] == 0 ? 0 : 1.0 / out_degree[v]; }
+  std::vector<std::vector<double>> teleport(lanes, std::vector<double>(num_vert));
+  for (auto& lane : teleport) {
+    for (auto& t : lane) { t = (gen() % 512) / 256.0; }
+  }
+
+  std::vector<double> aggregate(num_vert);
+  for (const auto& edge : tg.graph.edges) { aggregate[edge.dst] += inv_out_degree[edge.src]; }
+  std::vector<double> expected;
+  for (const auto& lane : teleport) {
+    for (size_t v = 0; v < num_vert; ++v) {
+      expected.push_back(((1 - damping) * lane[v] + damping * aggregate[v]) * inv_out_degree[v]);
+    }
+  }
+
+  auto outputs = runParties(nP, [&](int pid, std::shared_ptr<io::NetIOMP> network) {
+    Circuit<Ring> circ;
+    std::unordered_map<wire_t, int> input_pid_map;
+    std::unordered_map<wire_t, Ring> inputs;
+    auto add_inputs = [&](const std::vector<double>& values, int frac) {
+      return addVertexInputs(circ, tg, toFixedValues(values, frac), input_pid_map, inputs);
+    };
+    auto vertices = add_inputs(inv_out_degree, kPageRankFraction);
+    auto inv_out_degree_wires = add_inputs(inv_out_degree, kPageRankWeightFraction);
+    std::vector<std::vector<wire_t>> teleport_wires;
+    for (const auto& lane : teleport) { teleport_wires.push_back(add_inputs(lane, kPageRankFraction)); }
+    auto graph = gasGraph(circ, tg, nP, pid, GasBackend::kGraSP);
+    setEdgeInputs(graph, tg, input_pid_map, inputs);
+    auto program = personalizedPageRankProgram(damping, inv_out_degree_wires, teleport_wires);
+    for (const auto& lane :
+         addGasIterationLanes(circ, graph, program, std::vector<std::vector<wire_t>>(lanes, vertices))) {
+      for (auto w : lane) { circ.setAsOutput(w); }
+    }
+    return evaluateOnce(nP, pid, network, circ.orderGatesByLevel(), input_pid_map, inputs);
+  });
+
+  for (const auto& output : outputs) {
+    BOOST_TEST(output.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      BOOST_TEST(std::abs(fromFixed(output[i], kPageRankFraction) - expected[i]) <= 4.0 / (1 << kPageRankFraction));
+    }
+  }
+}
+
+// Iterations stop after the first one that changes no distance.
+BOOST_DATA_TEST_CASE(convergence_check, bdata::make({2, 3, 4}), nP) {
+  const size_t num_vert = 60;
+  const int max_iterations = 16;
+  std::mt19937 gen(1);
+  auto tg = randomGraph(num_vert, 120, nP, GasBackend::kGraSP, gen);
+  std::vector<Ring> values(num_vert, kGasInfinity);
+  values[0] = 0;
+  values[num_vert / 2] = 0;
+
+  auto expected = values;
+  int expected_iterations = 0;
+  while (expected_iterations < max_iterations) {
+    auto next = expected;
+    for (const auto& edge : tg.graph.edges) { next[edge.dst] = std::min(next[edge.dst], expected[edge.src] + 1); }
+    ++expected_iterations;
+    if (next == expected) { break; }
+    expected = next;
+  }
+  BOOST_TEST_REQUIRE(expected_iterations > 2);
+  BOOST_TEST_REQUIRE(expected_iterations < max_iterations);
+
+  std::vector<int> evaluated(nP + 1);
+  auto outputs = runParties(nP, [&](int pid, std::shared_ptr<io::NetIOMP> network) {
+    Circuit<Ring> circ;
+    std::unordered_map<wire_t, int> input_pid_map;
+    std::unordered_map<wire_t, Ring> inputs;
+    auto vertices = addVertexInputs(circ, tg, values, input_pid_map, inputs);
+    auto graph = gasGraph(circ, tg, nP, pid, GasBackend::kGraSP);
+    setEdgeInputs(graph, tg, input_pid_map, inputs);
+    auto next = addGasIteration(circ, graph, bfsProgram(), vertices);
+    for (auto w : next) { circ.setAsOutput(w); }
+    auto converged = addConvergenceCheck(circ, vertices, next, 1);
+
+    return evaluateIterations(nP, pid, network, circ.orderGatesByLevel(), input_pid_map, inputs, vertices,
+                              max_iterations, [&](IterativeEvaluator& it) {
+                                evaluated[pid] = it.runUntilConverged(max_iterations, converged);
+                              });
+  });
+
+  for (const auto& output : outputs) { BOOST_TEST(output == expected); }
+  for (int pid = 0; pid <= nP; ++pid) { BOOST_TEST(evaluated[pid] == expected_iterations); }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,200 @@
+#define BOOST_TEST_MODULE graph
+#include <utils/graph.h>
+#include <utils/graph_partition.h>
+#include <utils/graph_store.h>
+
+#include <boost/test/included/unit_test.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <vector>
+
+using namespace common::utils;
+
+BOOST_TEST_DONT_PRINT_LOG_VALUE(Edge)
+
+// Check the permutations of a DAG list: the source order has every vertex
+// before its out-edges, the destination order every vertex after its
+// in-edges, and perm_v moves the latter back.
+void checkDagList(const SubgraphDag& sub, size_t num_vert) {
+  std::vector<Edge> dag;
+  for (auto v : sub.vertices) { dag.push_back({v, v}); }
+  dag.insert(dag.end(), sub.edges.begin(), sub.edges.end());
+  auto apply = [](const std::vector<Edge>& vals, const std::vector<int>& perm) {
+    std::vector<Edge> res(vals.size());
+    for (size_t i = 0; i < vals.size(); ++i) { res[perm[i]] = vals[i]; }
+    return res;
+  };
+  // Position of the vertex in the subgraph order, a vertex preceding its
+  // out-edges and following its in-edges.
+  std::map<uint32_t, size_t> pos;
+  for (size_t i = 0; i < sub.vertices.size(); ++i) { pos[sub.vertices[i]] = i; }
+  auto src_key = [&](const Edge& e) { return 2 * pos[e.src] + (e.src == e.dst ? 0 : 1); };
+  auto dst_key = [&](const Edge& e) { return 2 * pos[e.dst] + (e.src == e.dst ? 1 : 0); };
+
+  auto by_src = apply(dag, sub.perm_s);
+  for (size_t i = 1; i < by_src.size(); ++i) { BOOST_TEST(src_key(by_src[i - 1]) <= src_key(by_src[i])); }
+  auto by_dst = apply(by_src, sub.perm_d);
+  for (size_t i = 1; i < by_dst.size(); ++i) { BOOST_TEST(dst_key(by_dst[i - 1]) <= dst_key(by_dst[i])); }
+  BOOST_TEST(apply(by_dst, sub.perm_v) == dag);
+
+  std::vector<uint32_t> all(num_vert);
+  for (uint32_t v = 0; v < num_vert; ++v) { all[sub.perm_g[v]] = v; }
+  BOOST_TEST(std::equal(sub.vertices.begin(), sub.vertices.end(), all.begin()));
+}
+
+BOOST_AUTO_TEST_SUITE(graph)
+
+BOOST_AUTO_TEST_CASE(load_edge_list) {
+  std::vector<Edge> expected = {{0, 1}, {2, 1}, {1, 3}, {3, 0}};
+  {
+    std::ofstream text("graph_test_edges.txt");
+    text << "# comment\n0 1 5\n2\t1\n\n1,3 7\n4 4\n3 0";
+    std::ofstream binary("graph_test_edges.bin", std::ios::binary);
+    std::vector<uint32_t> ids = {0, 1, 2, 1, 1, 3, 4, 4, 3, 0};
+    binary.write(reinterpret_cast<const char*>(ids.data()), ids.size() * sizeof(uint32_t));
+  }
+
+  for (int threads : {1, 3}) {
+    auto text = loadEdgeList("graph_test_edges.txt", EdgeListFormat::kAuto, threads);
+    BOOST_TEST(text.num_vert == 5);
+    BOOST_TEST(text.edges == expected);
+    BOOST_TEST(text.weights == std::vector<Ring>({5, 1, 7, 1}));
+
+    auto binary = loadEdgeList("graph_test_edges.bin", EdgeListFormat::kAuto, threads);
+    BOOST_TEST(binary.num_vert == 5);
+    BOOST_TEST(binary.edges == expected);
+    BOOST_TEST(binary.weights.empty());
+  }
+
+  {
+    std::ofstream text("graph_test_edges.txt");
+    text << "0 1\n2 x\n";
+  }
+  BOOST_CHECK_THROW(loadEdgeList("graph_test_edges.txt"), std::runtime_error);
+  std::remove("graph_test_edges.txt");
+  std::remove("graph_test_edges.bin");
+}
+
+BOOST_AUTO_TEST_CASE(subgraph_dag_list) {
+  Graph graph;
+  graph.num_vert = 6;
+  graph.edges = {{0, 1}, {3, 1}, {1, 0}, {5, 2}, {2, 4}, {4, 3}, {1, 2}};
+  auto owner = rangeOwners(graph.num_vert, 2);
+  BOOST_TEST(owner == std::vector<int>({1, 1, 1, 2, 2, 2}));
+  auto subgraphs = buildSubgraphs(graph, owner, 2);
+
+  // Party 1 holds the in-edges of vertices 0 to 2, from its own vertices
+  // and from vertices 3 and 5.
+  const auto& sub = subgraphs[0];
+  BOOST_TEST(sub.num_own == 3);
+  BOOST_TEST(sub.vertices == std::vector<uint32_t>({0, 1, 2, 3, 5}));
+  BOOST_TEST(sub.edges == std::vector<Edge>({{0, 1}, {3, 1}, {1, 0}, {5, 2}, {1, 2}}));
+
+  for (const auto& sub : subgraphs) { checkDagList(sub, graph.num_vert); }
+}
+
+BOOST_AUTO_TEST_CASE(subgraph_edge_updates) {
+  Graph graph;
+  graph.num_vert = 6;
+  graph.edges = {{0, 1}, {3, 1}, {1, 0}, {5, 2}, {2, 4}, {4, 3}, {1, 2}};
+  auto owner = rangeOwners(graph.num_vert, 2);
+  auto subgraphs = buildSubgraphs(graph, owner, 2);
+
+  EdgeUpdates updates;
+  updates.deleted = {{0, 1}, {1, 2}};
+  updates.inserted = {{5, 1}, {2, 0}, {0, 5}, {4, 3}};
+  for (int p = 1; p <= 2; ++p) { applyEdgeUpdates(subgraphs[p - 1], owner, p, updates); }
+
+  // Without new neighbours, the result is that of rebuilding the subgraph
+  // from the updated edge list.
+  Graph updated = graph;
+  updated.edges = {{3, 1}, {1, 0}, {5, 2}, {2, 4}, {4, 3}, {5, 1}, {2, 0}, {0, 5}, {4, 3}};
+  auto rebuilt = buildSubgraphs(updated, owner, 2);
+  BOOST_TEST(subgraphs[0].vertices == rebuilt[0].vertices);
+  BOOST_TEST(subgraphs[0].edges == rebuilt[0].edges);
+  BOOST_TEST(subgraphs[0].perm_g == rebuilt[0].perm_g);
+  BOOST_TEST(subgraphs[0].perm_s == rebuilt[0].perm_s);
+  BOOST_TEST(subgraphs[0].perm_d == rebuilt[0].perm_d);
+  BOOST_TEST(subgraphs[0].perm_v == rebuilt[0].perm_v);
+
+  // Vertex 0 is a new neighbour of party 2, appended to its vertices.
+  BOOST_TEST(subgraphs[1].vertices == std::vector<uint32_t>({3, 4, 5, 2, 0}));
+  BOOST_TEST(subgraphs[1].edges == std::vector<Edge>({{2, 4}, {4, 3}, {0, 5}, {4, 3}}));
+  for (const auto& sub : subgraphs) { checkDagList(sub, graph.num_vert); }
+
+  updates.deleted = {{3, 4}};
+  BOOST_CHECK_THROW(applyEdgeUpdates(subgraphs[1], owner, 2, updates), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(graph_store) {
+  Graph graph;
+  graph.num_vert = 6;
+  graph.edges = {{0, 1}, {3, 1}, {1, 0}, {5, 2}, {2, 4}, {4, 3}, {1, 2}};
+  graph.weights = {1, 2, 3, 4, 5, 6, 7};
+  auto owner = rangeOwners(graph.num_vert, 2);
+  auto subgraphs = buildSubgraphs(graph, owner, 2);
+  writeGraphStore("graph_test_store.grasp", graph, owner, subgraphs);
+  BOOST_TEST(isGraphStore("graph_test_store.grasp"));
+
+  auto store = loadGraphStore("graph_test_store.grasp", {2}, true);
+  BOOST_TEST(store.num_vert == 6);
+  BOOST_TEST(store.num_edges == 7);
+  BOOST_TEST(store.owner == owner);
+  BOOST_TEST(store.numParties() == 2);
+  BOOST_TEST(store.shards[0].dagSize() == subgraphs[0].dagSize());
+  BOOST_TEST(store.subgraphs[0].vertices.empty());
+  const auto& sub = store.subgraphs[1];
+  BOOST_TEST(sub.num_own == subgraphs[1].num_own);
+  BOOST_TEST(sub.vertices == subgraphs[1].vertices);
+  BOOST_TEST(sub.edges == subgraphs[1].edges);
+  BOOST_TEST(sub.weights == subgraphs[1].weights);
+  BOOST_TEST(sub.perm_g == subgraphs[1].perm_g);
+  BOOST_TEST(sub.perm_s == subgraphs[1].perm_s);
+  BOOST_TEST(sub.perm_d == subgraphs[1].perm_d);
+  BOOST_TEST(sub.perm_v == subgraphs[1].perm_v);
+  BOOST_TEST(store.in_offsets == std::vector<uint64_t>({0, 1, 3, 5, 6, 7, 7}));
+  BOOST_TEST(store.in_sources == std::vector<uint32_t>({1, 0, 3, 5, 1, 4, 2}));
+
+  BOOST_TEST(!isGraphStore("graph_test_missing.grasp"));
+  BOOST_CHECK_THROW(loadGraphStore("graph_test_store.grasp", {3}), std::invalid_argument);
+  std::remove("graph_test_store.grasp");
+}
+
+BOOST_AUTO_TEST_CASE(graph_partition) {
+  // Star of in-edges into vertex 0 and a path through the other vertices.
+  Graph graph;
+  graph.num_vert = 8;
+  for (uint32_t v = 1; v < 8; ++v) { graph.edges.push_back({v, 0}); }
+  for (uint32_t v = 1; v < 7; ++v) { graph.edges.push_back({v, v + 1}); }
+
+  auto range = partitionStats(graph, rangeOwners(graph.num_vert, 2), 2);
+  BOOST_TEST(range.dag_sizes == std::vector<size_t>({4 + 9 + 4, 4 + 4 + 1}));
+  BOOST_TEST(range.edge_cut == 5.0 / 13);
+  BOOST_TEST(range.replication == 13.0 / 8);
+
+  for (const auto* name : {"range", "hash", "degree", "edge-cut"}) {
+    auto strategy = partitionStrategyFromString(name);
+    BOOST_TEST(partitionStrategyName(strategy) == name);
+    auto owner = partitionGraph(graph, 2, strategy);
+    BOOST_TEST(std::all_of(owner.begin(), owner.end(), [](int o) { return o == 1 || o == 2; }));
+    auto stats = partitionStats(graph, owner, 2);
+
+    // Relabelling keeps the subgraphs and makes the owners ranges.
+    auto relabelled = graph;
+    auto new_owner = owner;
+    auto new_id = relabelByOwner(relabelled, new_owner);
+    BOOST_TEST(std::is_sorted(new_owner.begin(), new_owner.end()));
+    for (size_t v = 0; v < graph.num_vert; ++v) { BOOST_TEST(new_owner[new_id[v]] == owner[v]); }
+    for (size_t i = 0; i < graph.edges.size(); ++i) {
+      BOOST_TEST(relabelled.edges[i] == Edge({new_id[graph.edges[i].src], new_id[graph.edges[i].dst]}));
+    }
+    auto subgraphs = buildSubgraphs(relabelled, new_owner, 2);
+    for (int p = 0; p < 2; ++p) { BOOST_TEST(subgraphs[p].dagSize() == stats.dag_sizes[p]); }
+  }
+  BOOST_TEST(partitionStats(graph, partitionGraph(graph, 2, PartitionStrategy::kDegree), 2).imbalance < range.imbalance);
+  BOOST_CHECK_THROW(partitionStrategyFromString("metis"), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -12,13 +12,13 @@ BOOST_AUTO_TEST_CASE(echo_2P) {
   std::string message("A test string.");
 
   auto party = std::async(std::launch::async, [=]() {
-    io::NetIOMP net(1, 2, 10000, nullptr, true);
+    io::NetIOMP net(1, 2, 0, 10000, nullptr, true);
     std::vector<uint8_t> data(message.size());
     net.recv(0, data.data(), data.size());
     net.send(0, data.data(), data.size());
   });
 
-  io::NetIOMP net(0, 2, 10000, nullptr, true);
+  io::NetIOMP net(0, 2, 0, 10000, nullptr, true);
   net.send(1, message.data(), message.size());
 
   std::vector<uint8_t> received_message(message.size());
@@ -36,7 +36,7 @@ BOOST_AUTO_TEST_CASE(mssg_pass_4P) {
   std::vector<std::future<void>> parties;
   for (size_t i = 1; i < 4; ++i) {
     parties.push_back(std::async(std::launch::async, [=]() {
-      io::NetIOMP net(i, 4, 10000, nullptr, true);
+      io::NetIOMP net(i, 4, 0, 10000, nullptr, true);
       std::vector<uint8_t> data(message.size());
       net.recvRelative(-1, data.data(), data.size());
       net.sendRelative(1, data.data(), data.size());
@@ -44,7 +44,7 @@ BOOST_AUTO_TEST_CASE(mssg_pass_4P) {
     }));
   }
 
-  io::NetIOMP net(0, 4, 10000, nullptr, true);
+  io::NetIOMP net(0, 4, 0, 10000, nullptr, true);
   net.sendRelative(1, message.data(), message.size());
   net.flush();
 
@@ -71,13 +71,13 @@ BOOST_AUTO_TEST_CASE(echo_bool) {
   }
 
   auto party = std::async(std::launch::async, [=]() {
-    io::NetIOMP net(1, 2, 10000, nullptr, true);
+    io::NetIOMP net(1, 2, 0, 10000, nullptr, true);
     bool data[len];
     net.recvBool(0, static_cast<bool*>(data), len);
     net.sendBool(0, static_cast<bool*>(data), len);
   });
 
-  io::NetIOMP net(0, 2, 10000, nullptr, true);
+  io::NetIOMP net(0, 2, 0, 10000, nullptr, true);
   net.sendBool(1, static_cast<bool*>(message), len);
 
   bool received_message[len];
@@ -90,4 +90,39 @@ BOOST_AUTO_TEST_CASE(echo_bool) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(tagged_channels) {
+  const size_t len = 10000;
+  std::vector<uint32_t> first(len);
+  std::vector<uint32_t> second(len);
+  for (size_t i = 0; i < len; ++i) {
+    first[i] = i;
+    second[i] = 3 * i + 1;
+  }
+
+  auto party = std::async(std::launch::async, [=]() {
+    io::NetIOMP net(1, 2, 0, 10000, nullptr, true);
+    auto ch0 = net.channel(0);
+    auto ch1 = net.channel(1);
+    // Send on both channels from different threads.
+    auto sender = std::async(std::launch::async, [&]() { ch1->send(0, second.data(), len * sizeof(uint32_t)); });
+    ch0->send(0, first.data(), len * sizeof(uint32_t));
+    sender.wait();
+  });
+
+  io::NetIOMP net(0, 2, 0, 10000, nullptr, true);
+  auto ch0 = net.channel(0);
+  auto ch1 = net.channel(1);
+  std::vector<uint32_t> received_first(len);
+  std::vector<uint32_t> received_second(len);
+  // Receive in the opposite order and in parts.
+  ch1->recv(1, received_second.data(), len * sizeof(uint32_t) / 2);
+  ch1->recv(1, received_second.data() + len / 2, len * sizeof(uint32_t) / 2);
+  ch0->recv(1, received_first.data(), len * sizeof(uint32_t));
+
+  party.wait();
+
+  BOOST_TEST(received_first == first);
+  BOOST_TEST(received_second == second);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,437 @@
+#define BOOST_TEST_MODULE online_ring
+#include <emp-tool/emp-tool.h>
+#include <io/netmp.h>
+#include <grasp/offline_evaluator.h>
+#include <grasp/online_evaluator.h>
+#include <grasp/sort.h>
+
+#include <boost/test/data/monomorphic.hpp>
+#include <boost/test/data/test_case.hpp>
+#include <boost/test/included/unit_test.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace grasp;
+using namespace common::utils;
+namespace bdata = boost::unit_test::data;
+
+namespace {
+
+// Run party(pid, network) for the dealer and parties 1 to nP. Returns the
+// results of parties 1 to nP.
+std::vector<std::vector<Ring>> runParties(
+    int nP, const std::function<std::vector<Ring>(int, std::shared_ptr<io::NetIOMP>)>& party) {
+  std::vector<std::future<std::vector<Ring>>> parties;
+  parties.reserve(nP + 1);
+  for (int i = 0; i <= nP; ++i) {
+    parties.push_back(std::async(std::launch::async, [&, i]() {
+      auto network = std::make_shared<io::NetIOMP>(i, nP + 1, 0, 10000, nullptr, true);
+      return party(i, network);
+    }));
+  }
+
+  std::vector<std::vector<Ring>> outputs;
+  for (int i = 0; i <= nP; ++i) {
+    auto output = parties[i].get();
+    if (i > 0) { outputs.push_back(std::move(output)); }
+  }
+  return outputs;
+}
+
+// Run the offline and online phases with nP parties and the dealer, party i
+// evaluating build(i), e.g. the circuit with its own permutations. Returns
+// the outputs of parties 1 to nP.
+std::vector<std::vector<Ring>> evaluateParties(int nP, const std::function<LevelOrderedCircuit(int)>& build,
+                                               const std::unordered_map<wire_t, int>& input_pid_map,
+                                               const std::unordered_map<wire_t, Ring>& inputs,
+                                               KingPolicy policy = KingPolicy::kFixed) {
+  return runParties(nP, [&](int pid, std::shared_ptr<io::NetIOMP> network) {
+    auto circ = build(pid);
+    OfflineEvaluator off_eval(nP, pid, network, circ, 1, 200, 0);
+    auto preproc = off_eval.run(input_pid_map);
+    OnlineEvaluator online_eval(nP, pid, network, std::move(preproc), circ, 1, 200, 0);
+    online_eval.setKingPolicy(policy);
+    return online_eval.evaluateCircuit(inputs);
+  });
+}
+
+std::vector<std::vector<Ring>> evaluateParties(int nP, const LevelOrderedCircuit& circ,
+                                               const std::unordered_map<wire_t, int>& input_pid_map,
+                                               const std::unordered_map<wire_t, Ring>& inputs,
+                                               KingPolicy policy = KingPolicy::kFixed) {
+  return evaluateParties(nP, [&](int) { return circ; }, input_pid_map, inputs, policy);
+}
+
+// Permutations of a gate held by party 'pid', in the format of
+// Circuit::addMGate, from perms[p - 1], the permutation of party p.
+std::vector<std::vector<int>> partyPermutations(const std::vector<std::vector<int>>& perms, int pid) {
+  if (pid == 0) { return perms; }
+  return {perms[pid - 1]};
+}
+
+// Random permutations of n elements for parties 1 to nP.
+std::vector<std::vector<int>> randomPermutations(int nP, size_t n, std::mt19937& gen) {
+  std::vector<std::vector<int>> perms(nP, std::vector<int>(n));
+  for (auto& perm : perms) {
+    std::iota(perm.begin(), perm.end(), 0);
+    std::shuffle(perm.begin(), perm.end(), gen);
+  }
+  return perms;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(comparison_circuits)
+
+// The radix-r multiplication and prefix-OR circuits, evaluated in plaintext,
+// match their radix-2 counterparts and have the expected depth.
+BOOST_DATA_TEST_CASE(plaintext_radix_circuits, bdata::xrange(2, 5), radix) {
+  Circuit multk = Circuit<BoolRing>::generateMultK(radix);
+  Circuit prefix = Circuit<BoolRing>::generateParaPrefixOR(2, radix);
+  Circuit prefix_ref = Circuit<BoolRing>::generateParaPrefixOR(2, 2);
+  const size_t k = RINGSIZEBITS;
+  std::mt19937 gen(radix);
+
+  for (int t = 0; t < 50; ++t) {
+    std::unordered_map<wire_t, BoolRing> multk_input;
+    bool all_set = true;
+    for (size_t i = 0; i < k; ++i) {
+      bool bit = (t % 2 == 0) || (gen() % 16 != 0);
+      multk_input[i] = bit;
+      all_set = all_set && bit;
+    }
+    BOOST_TEST(multk.evaluate(multk_input)[0] == BoolRing(all_set));
+
+    std::unordered_map<wire_t, BoolRing> prefix_input;
+    for (size_t i = 0; i < 4 * k; ++i) {
+      prefix_input[i] = (i < 2 * k) ? (gen() % 4 != 0) : (gen() % 2 != 0);
+    }
+    BOOST_TEST(prefix.evaluate(prefix_input)[0] == prefix_ref.evaluate(prefix_input)[0]);
+  }
+
+  auto multk_depth = multk.orderGatesByLevel().gates_by_level.size();
+  auto expected_depth = static_cast<size_t>(std::ceil(std::log(k) / std::log(radix) - 1e-9)) + 1;
+  BOOST_TEST(multk_depth == expected_depth);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(online_ring_evaluator)
+
+// The Boolean sub-circuits XOR the shares of all parties, so public terms
+// must be added once whatever the parity of nP.
+BOOST_DATA_TEST_CASE(comparisons, bdata::make({2, 3, 4}), nP) {
+  size_t n = 200;
+  std::mt19937 gen(200);
+  std::uniform_int_distribution<int32_t> distrib(-1000, 1000);
+  Circuit<Ring> circ;
+  std::unordered_map<wire_t, int> input_pid_map;
+  std::unordered_map<wire_t, Ring> inputs;
+  for (size_t j = 0; j < n; ++j) {
+    auto winp = circ.newInputWire();
+    input_pid_map[winp] = 1 + j % nP;
+    inputs[winp] = j % 5 == 0 ? Ring(0) : Ring(distrib(gen));
+    circ.setAsOutput(circ.addGate(GateType::kEqz, winp));
+    circ.setAsOutput(circ.addGate(GateType::kLtz, winp));
+  }
+  auto level_circ = circ.orderGatesByLevel();
+  auto exp_output = circ.evaluate(inputs);
+
+  for (const auto& output : evaluateParties(nP, level_circ, input_pid_map, inputs)) {
+    BOOST_TEST(output == exp_output);
+  }
+}
+
+// Comparisons of a level are packed 64 to a preprocessing group, with a
+// partial last group. The second level reads the shared outputs of the first.
+BOOST_DATA_TEST_CASE(packed_comparison_groups, bdata::make({63, 64, 65, 200}), n) {
+  int nP = 4;
+  std::mt19937 gen(n);
+  std::uniform_int_distribution<int32_t> distrib(-1000, 1000);
+  Circuit<Ring> circ;
+  std::unordered_map<wire_t, int> input_pid_map;
+  std::unordered_map<wire_t, Ring> inputs;
+  for (int j = 0; j < n; ++j) {
+    auto winp = circ.newInputWire();
+    input_pid_map[winp] = 1 + j % nP;
+    inputs[winp] = j % 3 == 0 ? Ring(0) : Ring(distrib(gen));
+    // x < 0 ? x : 0 is 0 for the zeros and for the positive values.
+    auto wmin = circ.addGate(GateType::kMul, circ.addGate(GateType::kLtz, winp), winp);
+    circ.setAsOutput(circ.addGate(GateType::kEqz, wmin));
+    circ.setAsOutput(circ.addGate(GateType::kLtz, wmin));
+  }
+  auto level_circ = circ.orderGatesByLevel();
+  auto exp_output = circ.evaluate(inputs);
+
+  for (const auto& output : evaluateParties(nP, level_circ, input_pid_map, inputs)) {
+    BOOST_TEST(output == exp_output);
+  }
+}
+
+BOOST_DATA_TEST_CASE(comparison_radix, bdata::xrange(2, 5) * bdata::make({2, 3}), radix, nP) {
+  size_t n = 100;
+  std::mt19937 gen(radix);
+  std::uniform_int_distribution<int32_t> distrib(-1000, 1000);
+  Circuit<Ring> circ;
+  circ.setComparisonRadix(radix);
+  std::unordered_map<wire_t, int> input_pid_map;
+  std::unordered_map<wire_t, Ring> inputs;
+  for (size_t j = 0; j < n; ++j) {
+    auto winp = circ.newInputWire();
+    input_pid_map[winp] = 1;
+    inputs[winp] = j % 4 == 0 ? Ring(0) : Ring(distrib(gen));
+    circ.setAsOutput(circ.addGate(GateType::kEqz, winp));
+    circ.setAsOutput(circ.addGate(GateType::kLtz, winp));
+  }
+  auto level_circ = circ.orderGatesByLevel();
+  auto exp_output = circ.evaluate(inputs);
+
+  for (const auto& output : evaluateParties(nP, level_circ, input_pid_map, inputs)) {
+    BOOST_TEST(output == exp_output);
+  }
+}
+
+// Values from {0, 1} are mostly equal. Without distinct keys, quicksort would
+// be quadratic and exhaust the preprocessed comparisons.
+BOOST_DATA_TEST_CASE(secure_sort, bdata::make({2, 3}) * bdata::make({100, 2}), nP, range) {
+  size_t n = 200;
+  std::mt19937 gen(200);
+  std::vector<Ring> values(n);
+  for (auto& v : values) { v = gen() % range; }  // With duplicates
+  auto perms = randomPermutations(nP, n, gen);
+
+  auto outputs = runParties(nP, [&](int pid, std::shared_ptr<io::NetIOMP> network) {
+    Circuit<Ring> circ;
+    std::vector<wire_t> input_wires(n);
+    std::unordered_map<wire_t, int> input_pid_map;
+    std::unordered_map<wire_t, Ring> inputs;
+    for (size_t j = 0; j < n; ++j) {
+      input_wires[j] = circ.newInputWire();
+      input_pid_map[input_wires[j]] = 1;
+      inputs[input_wires[j]] = values[j];
+    }
+    auto sort_wires = addSortGates(circ, input_wires, partyPermutations(perms, pid), 0);
+    for (auto w : sort_wires.shuffled) { circ.setAsOutput(w); }
+    auto level_circ = circ.orderGatesByLevel();
+
+    OfflineEvaluator off_eval(nP, pid, network, level_circ, 1, 200, 0);
+    auto preproc = off_eval.run(input_pid_map);
+    OnlineEvaluator online_eval(nP, pid, network, std::move(preproc), level_circ, 1, 200, 0);
+    SecureSorter sorter(online_eval, level_circ, sort_wires, pid);
+    online_eval.setInputs(inputs);
+    for (size_t d = 0; d < level_circ.gates_by_level.size(); ++d) { online_eval.evaluateGatesAtDepth(d); }
+    auto sorted_wires = sorter.sort();
+    auto shuffled = online_eval.getOutputs();
+
+    std::vector<Ring> res;
+    for (auto w : sorted_wires) {
+      auto pos = std::find(sort_wires.shuffled.begin(), sort_wires.shuffled.end(), w) - sort_wires.shuffled.begin();
+      res.push_back(shuffled[pos]);
+    }
+    return res;
+  });
+
+  std::sort(values.begin(), values.end());
+  for (const auto& output : outputs) { BOOST_TEST(output == values); }
+}
+
+// Several kPermAndSh gates of every owner on one level, each with its own
+// permutations, and a second level permuting their outputs again. Every gate
+// has to be matched with its own preprocessing when the gates of an owner
+// are batched.
+BOOST_DATA_TEST_CASE(perm_and_sh_per_owner, bdata::make({2, 3}), nP) {
+  size_t n = 50;
+  int num_gates = 7;
+  std::mt19937 gen(nP);
+  std::vector<Ring> values(n);
+  for (auto& v : values) { v = gen(); }
+  std::vector<std::vector<std::vector<int>>> first(num_gates);
+  std::vector<std::vector<std::vector<int>>> second(num_gates);
+  for (int g = 0; g < num_gates; ++g) {
+    first[g] = randomPermutations(nP, n, gen);
+    second[g] = randomPermutations(nP, n, gen);
+  }
+
+  Circuit<Ring> inputs_circ;
+  std::vector<wire_t> input_wires(n);
+  std::unordered_map<wire_t, int> input_pid_map;
+  std::unordered_map<wire_t, Ring> inputs;
+  for (size_t i = 0; i < n; ++i) {
+    input_wires[i] = inputs_circ.newInputWire();
+    input_pid_map[input_wires[i]] = 1;
+    inputs[input_wires[i]] = values[i];
+  }
+  auto build = [&](int pid) {
+    auto circ = inputs_circ;
+    std::vector<std::vector<wire_t>> permuted(num_gates);
+    for (int g = 0; g < num_gates; ++g) {
+      permuted[g] = circ.addMGate(GateType::kPermAndSh, input_wires, partyPermutations(first[g], pid), 1 + g % nP);
+    }
+    for (int g = 0; g < num_gates; ++g) {
+      for (auto w : circ.addMGate(GateType::kPermAndSh, permuted[g], partyPermutations(second[g], pid),
+                                  1 + (g + 1) % nP)) {
+        circ.setAsOutput(w);
+      }
+    }
+    return circ.orderGatesByLevel();
+  };
+
+  // A gate of owner p moves element i to position perm[p - 1][i].
+  std::vector<Ring> expected;
+  for (int g = 0; g < num_gates; ++g) {
+    const auto& p1 = first[g][g % nP];
+    const auto& p2 = second[g][(g + 1) % nP];
+    std::vector<Ring> out(n);
+    for (size_t i = 0; i < n; ++i) { out[p2[p1[i]]] = values[i]; }
+    expected.insert(expected.end(), out.begin(), out.end());
+  }
+
+  for (const auto& output : evaluateParties(nP, build, input_pid_map, inputs)) {
+    BOOST_TEST(output == expected);
+  }
+}
+
+// Every policy with value counts that do not split evenly among the kings:
+// the comparison reveals of 101 values take two words, and the amortized
+// PnS reconstructs 101 values.
+BOOST_DATA_TEST_CASE(king_policies, bdata::make({"fixed", "round-robin", "range"}) * bdata::make({2, 3, 4}),
+                     policy, nP) {
+  size_t n = 101;
+  std::mt19937 gen(nP);
+  std::uniform_int_distribution<int32_t> distrib(-1000, 1000);
+  auto perms = randomPermutations(nP, n, gen);
+  Circuit<Ring> inputs_circ;
+  std::vector<wire_t> input_wires(n);
+  std::unordered_map<wire_t, int> input_pid_map;
+  std::unordered_map<wire_t, Ring> inputs;
+  std::vector<Ring> values(n);
+  for (size_t i = 0; i < n; ++i) {
+    input_wires[i] = inputs_circ.newInputWire();
+    input_pid_map[input_wires[i]] = 1 + i % nP;
+    values[i] = i % 4 == 0 ? Ring(0) : Ring(distrib(gen));
+    inputs[input_wires[i]] = values[i];
+  }
+  auto build = [&](int pid) {
+    auto circ = inputs_circ;
+    for (auto w : input_wires) { circ.setAsOutput(circ.addGate(GateType::kEqz, w)); }
+    for (auto w : input_wires) { circ.setAsOutput(circ.addGate(GateType::kLtz, w)); }
+    for (const auto& block : circ.addMOGate(GateType::kAmortzdPnS, input_wires, partyPermutations(perms, pid), nP)) {
+      for (auto w : block) { circ.setAsOutput(w); }
+    }
+    return circ.orderGatesByLevel();
+  };
+
+  std::vector<Ring> expected;
+  for (auto v : values) { expected.push_back(v == 0); }
+  for (auto v : values) { expected.push_back(static_cast<int32_t>(v) < 0); }
+  for (const auto& perm : perms) {
+    std::vector<Ring> out(n);
+    for (size_t i = 0; i < n; ++i) { out[perm[i]] = values[i]; }
+    expected.insert(expected.end(), out.begin(), out.end());
+  }
+
+  for (const auto& output : evaluateParties(nP, build, input_pid_map, inputs, kingPolicyFromString(policy))) {
+    BOOST_TEST(output == expected);
+  }
+}
+
+BOOST_DATA_TEST_CASE(truncation, bdata::make({2, 3}), nP) {
+  size_t n = 100;
+  std::mt19937 gen(200);
+  std::uniform_int_distribution<int32_t> distrib(-(1 << 29), (1 << 29) - 1);
+  Circuit<Ring> circ;
+  std::unordered_map<wire_t, int> input_pid_map;
+  std::unordered_map<wire_t, Ring> inputs;
+  for (size_t j = 0; j < n; ++j) {
+    auto winp = circ.newInputWire();
+    input_pid_map[winp] = 1 + j % nP;
+    inputs[winp] = Ring(distrib(gen));
+    circ.setAsOutput(circ.addTruncGate(winp, 1 + j % 20));
+  }
+  // Fixed-point product of 1.5, 0.75 and -2 with 8 fractional bits.
+  constexpr int frac = 8;
+  auto wa = circ.newInputWire();
+  auto wb = circ.newInputWire();
+  input_pid_map[wa] = 1;
+  input_pid_map[wb] = 2;
+  inputs[wa] = toFixed(1.5, frac);
+  inputs[wb] = toFixed(0.75, frac);
+  circ.setAsOutput(circ.addFixedConstMul(circ.addFixedMul(wa, wb, frac), -2.0, frac));
+  auto level_circ = circ.orderGatesByLevel();
+  auto exp_output = circ.evaluate(inputs);
+  BOOST_TEST(fromFixed(exp_output.back(), frac) == -2.25);
+
+  for (const auto& output : evaluateParties(nP, level_circ, input_pid_map, inputs)) {
+    BOOST_TEST(output.size() == exp_output.size());
+    // The protocol may round up instead.
+    for (size_t j = 0; j < n; ++j) {
+      Ring diff = output[j] - exp_output[j];
+      BOOST_TEST((diff == 0 || diff == 1));
+    }
+    BOOST_TEST(std::abs(fromFixed(output.back(), frac) + 2.25) <= 4.0 / (1 << frac));
+  }
+}
+
+// Comparison outputs are shares, so they feed multiplications: min(x, 0) and
+// x == 0 ? y : 0.
+BOOST_DATA_TEST_CASE(comparison_shared_outputs, bdata::make({2, 3, 4}), nP) {
+  size_t n = 100;
+  std::mt19937 gen(200);
+  std::uniform_int_distribution<int32_t> distrib(-1000, 1000);
+  Circuit<Ring> circ;
+  std::unordered_map<wire_t, int> input_pid_map;
+  std::unordered_map<wire_t, Ring> inputs;
+  for (size_t j = 0; j < n; ++j) {
+    auto wx = circ.newInputWire();
+    auto wy = circ.newInputWire();
+    input_pid_map[wx] = 1 + j % nP;
+    input_pid_map[wy] = 1;
+    inputs[wx] = j % 5 == 0 ? Ring(0) : Ring(distrib(gen));
+    inputs[wy] = Ring(distrib(gen));
+    circ.setAsOutput(circ.addGate(GateType::kMul, circ.addGate(GateType::kLtz, wx), wx));
+    circ.setAsOutput(circ.addGate(GateType::kMul, circ.addGate(GateType::kEqz, wx), wy));
+  }
+  auto level_circ = circ.orderGatesByLevel();
+  auto exp_output = circ.evaluate(inputs);
+
+  for (const auto& output : evaluateParties(nP, level_circ, input_pid_map, inputs)) {
+    BOOST_TEST(output == exp_output);
+  }
+}
+
+// Products of three and four wires, alongside two-input multiplications and
+// dot products of the same inputs.
+BOOST_DATA_TEST_CASE(multi_input_products, bdata::make({2, 3}), nP) {
+  size_t n = 50;
+  std::mt19937 gen(200);
+  Circuit<Ring> circ;
+  std::unordered_map<wire_t, int> input_pid_map;
+  std::unordered_map<wire_t, Ring> inputs;
+  for (size_t j = 0; j < n; ++j) {
+    std::vector<wire_t> w(4);
+    for (size_t i = 0; i < w.size(); ++i) {
+      w[i] = circ.newInputWire();
+      input_pid_map[w[i]] = 1 + (j + i) % nP;
+      inputs[w[i]] = Ring(gen());
+    }
+    circ.setAsOutput(circ.addGate(GateType::kMul3, w[0], w[1], w[2]));
+    circ.setAsOutput(circ.addGate(GateType::kMul4, w[0], w[1], w[2], w[3]));
+    circ.setAsOutput(circ.addGate(GateType::kMul, w[0], w[3]));
+    circ.setAsOutput(circ.addGate(GateType::kDotprod, {w[0], w[1]}, {w[2], w[3]}));
+  }
+  auto level_circ = circ.orderGatesByLevel();
+  auto exp_output = circ.evaluate(inputs);
+
+  for (const auto& output : evaluateParties(nP, level_circ, input_pid_map, inputs)) {
+    BOOST_TEST(output == exp_output);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
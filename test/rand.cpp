@@ -58,4 +58,42 @@ BOOST_AUTO_TEST_CASE(matching_output) {
     
 }
 
+BOOST_AUTO_TEST_CASE(ctr_random_access) {
+    grasp::CtrPRG ctr(emp::makeBlock(1, 2));
+    std::vector<Ring> vals(200);
+    ctr.fill(0, vals.data(), vals.size());
+
+    for (size_t i = 0; i < vals.size(); ++i) {
+        BOOST_TEST(ctr.at<Ring>(i) == vals[i]);
+    }
+
+    // Unaligned sub-ranges must match the full expansion.
+    for (size_t offset = 0; offset < 9; ++offset) {
+        std::vector<Ring> part(100);
+        ctr.fill(offset, part.data(), part.size());
+        for (size_t i = 0; i < part.size(); ++i) {
+            BOOST_TEST(part[i] == vals[offset + i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bulk_fill_matching_output) {
+    uint64_t seed = 200;
+    int nP = 4;
+    auto rpool_0 = grasp::RandGenPool(0, nP, seed);
+
+    for (int i = 1; i <= nP; ++i) {
+        auto rpool_i = grasp::RandGenPool(i, nP, seed);
+        std::vector<Ring> v0(37);
+        std::vector<Ring> vi(37);
+        grasp::RandGenPool::fill(rpool_0.pi(i), v0);
+        grasp::RandGenPool::fill(rpool_i.p0(), vi);
+        BOOST_TEST(v0 == vi);
+
+        auto ctr_0 = grasp::RandGenPool::fork(rpool_0.pi(i));
+        auto ctr_i = grasp::RandGenPool::fork(rpool_i.p0());
+        BOOST_TEST(ctr_0.at<Ring>(1000) == ctr_i.at<Ring>(1000));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()